@@ -63,6 +63,10 @@ THE SOFTWARE.
     #endif
 #endif
 
+#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+    #define APE_HAVETHREADS
+#endif
+
 #if defined(__STRICT_ANSI__)
     #define APE_CCENV_ANSIMODE 1
 #endif
@@ -84,12 +88,54 @@ THE SOFTWARE.
 
 #define APE_CONF_SIZE_VM_THISSTACK (512 / 4)
 
+/*
+* how many backward jumps and calls happen between two clock reads when a timeout is set.
+* must be a power of two.
+*/
+#define APE_CONF_CONST_VM_TIMEOUTCHECKINTERVAL (1024)
+
+/* initial number of frames; the frame array doubles when exhausted */
+#define APE_CONF_SIZE_VM_INITFRAMES (64)
+
 #define APE_CONF_SIZE_NATFN_MAXDATALEN (16 * 2)
 #define APE_CONF_SIZE_STRING_BUFSIZE (32)
 
+/* size of the first chunk of an AST arena; each further chunk doubles, up to the max */
+#define APE_CONF_SIZE_ASTARENA_MINCHUNK (4 * 1024)
+#define APE_CONF_SIZE_ASTARENA_MAXCHUNK (256 * 1024)
+
 #define APE_CONF_SIZE_ERRORS_MAXCOUNT (4)
 #define APE_CONF_SIZE_ERROR_MAXMSGLENGTH (80)
 
+/* one slot per bit in ApeObjType (excluding APE_OBJECT_ANY) */
+#define APE_CONF_SIZE_PSEUDOCLASS_TYPES (16)
+
+/* largest member table ape_pseudoclass_buildtable will try before giving up */
+#define APE_CONF_SIZE_PSEUDOCLASS_MAXSLOTS (1024)
+
+/*
+* the heap limit (ape_context_setheaplimit) is enforced between instructions, after collecting
+* garbage. within one instruction the heap may go past it by 1/N of the limit; the allocator
+* refuses to go further, so that a single native call cannot grow the heap without bound.
+*/
+#define APE_CONF_CONST_HEAPLIMIT_HARDMARGINDIV (4)
+
+/* the bytecode peephole pass repeats until nothing changes, but at most this many times */
+#define APE_CONF_CONST_PEEPHOLE_MAXPASSES (4)
+
+/* how many unconditional jumps a jump is threaded through */
+#define APE_CONF_CONST_PEEPHOLE_MAXHOPS (16)
+
+/*
+* instrumentation of ape_vm_execfunc, off unless built with e.g. -DAPE_CONF_VM_OPSTATS=1:
+* 1 counts every executed opcode, and every pair of consecutive ones;
+* 2 also adds up the cycles (or nanoseconds, where there is no cycle counter) spent in each handler.
+* read through VM.opstats() and '--opcode-stats'.
+*/
+#if !defined(APE_CONF_VM_OPSTATS)
+    #define APE_CONF_VM_OPSTATS 0
+#endif
+
 #define APE_STREQ(a, b) (strcmp((a), (b)) == 0)
 #define APE_STRNEQ(a, b, n) (strncmp((a), (b), (n)) == 0)
 #define APE_ARRAY_LEN(array) ((int)(sizeof(array) / sizeof(array[0])))
@@ -466,6 +512,43 @@ enum ApeSymbolType
     APE_SYMBOL_THIS,
 };
 
+/* what the compiler predicts an expression or local evaluates to */
+enum ApeInferType
+{
+    APE_INFER_UNKNOWN = 0,
+    APE_INFER_NUMBER,
+    APE_INFER_BOOL,
+    /* known to be neither (strings, arrays, null, ...) */
+    APE_INFER_OTHER,
+};
+
+/*
+* operand of FORLOOP_PREP/FORLOOP_STEP: the loop test, normalised so the counter is on the left.
+* STEP additionally carries the direction of the +/-1 update.
+*/
+enum ApeForLoopMode
+{
+    APE_FORLOOP_LESSTHAN = 0,
+    APE_FORLOOP_LESSEQUAL = 1,
+    APE_FORLOOP_GREATERTHAN = 2,
+    APE_FORLOOP_GREATEREQUAL = 3,
+    APE_FORLOOP_CMPMASK = 3,
+    APE_FORLOOP_DECREMENT = 4,
+};
+
+/*
+* which source text a compiled file keeps around for error messages.
+* KEEP copies everything that was lexed; REREAD copies only text that did not come from a
+* file, and reads files again the first time one of their lines is asked for; DROP keeps
+* nothing, so errors carry file, line and column only.
+*/
+enum ApeSourceMode
+{
+    APE_SOURCE_KEEP = 0,
+    APE_SOURCE_REREAD = 1,
+    APE_SOURCE_DROP = 2,
+};
+
 enum ApeOpcodeValue
 {
     APE_OPCODE_NONE = 0,
@@ -522,6 +605,38 @@ enum ApeOpcodeValue
     APE_OPCODE_LEFTSHIFT,
     APE_OPCODE_RIGHTSHIFT,
     APE_OPCODE_IMPORT,
+    APE_OPCODE_TAILCALL,
+    /*
+    * number-specialised arithmetic. if either operand is not a number, they fall back to
+    * the generic operation.
+    */
+    APE_OPCODE_ADDNUM,
+    APE_OPCODE_SUBNUM,
+    APE_OPCODE_MULNUM,
+    APE_OPCODE_DIVNUM,
+    /*
+    * number-specialised comparisons. these are emitted right in front of the generic
+    * compare + compare-logical pair: if both operands are numbers, the result is pushed
+    * and the pair is skipped; otherwise execution simply falls through into it.
+    */
+    APE_OPCODE_GREATERTHANNUM,
+    APE_OPCODE_GREATEREQUALNUM,
+    APE_OPCODE_ISEQUALNUM,
+    APE_OPCODE_NOTEQUALNUM,
+    /*
+    * counted for-loops. both take (target, local, mode) and are followed by a generic
+    * compare + compare-logical + conditional jump, which only runs when the limit is
+    * not a number. PREP does the first test, STEP bumps the counter and tests again.
+    */
+    APE_OPCODE_FORLOOPPREP,
+    APE_OPCODE_FORLOOPSTEP,
+    /*
+    * foreach. ITERINIT checks that the source is iterable and pushes the start position;
+    * ITERNEXT (target, pairs) pops source and position, and either jumps to target when
+    * done, or pushes the item (or value and key, if pairs is set) and the next position.
+    */
+    APE_OPCODE_ITERINIT,
+    APE_OPCODE_ITERNEXT,
     APE_OPCODE_MAX,
 };
 
@@ -574,6 +689,9 @@ typedef size_t ApeSize;
 typedef enum /**/ ApeAstTokType ApeAstTokType;
 typedef enum /**/ ApeOperator ApeOperator;
 typedef enum /**/ ApeSymbolType ApeSymbolType;
+typedef enum /**/ ApeInferType ApeInferType;
+typedef enum /**/ ApeForLoopMode ApeForLoopMode;
+typedef enum /**/ ApeSourceMode ApeSourceMode;
 typedef enum /**/ ApeAstExprType ApeAstExprType;
 typedef enum /**/ ApeOpcodeValue ApeOpcodeValue;
 typedef enum /**/ ApeAstPrecedence ApeAstPrecedence;
@@ -611,12 +729,15 @@ typedef struct /**/ ApeAstForExpr ApeAstForExpr;
 typedef struct /**/ ApeAstIncludeExpr ApeAstIncludeExpr;
 typedef struct /**/ ApeAstRecoverExpr ApeAstRecoverExpr;
 typedef struct /**/ ApeAstParser ApeAstParser;
+typedef struct /**/ ApeAstArena ApeAstArena;
+typedef struct /**/ ApeAstArenaChunk ApeAstArenaChunk;
 typedef struct /**/ ApeObject ApeObject;
 typedef struct /**/ ApeScriptFunction ApeScriptFunction;
 typedef struct /**/ ApeNativeFunction ApeNativeFunction;
 typedef struct /**/ ApeExternalData ApeExternalData;
 typedef struct /**/ ApeObjError ApeObjError;
 typedef struct /**/ ApeObjString ApeObjString;
+typedef struct /**/ ApeObjRange ApeObjRange;
 typedef struct /**/ ApeGCObjData ApeGCObjData;
 typedef struct /**/ ApeSymbol ApeSymbol;
 typedef struct /**/ ApeAstBlockScope ApeAstBlockScope;
@@ -624,19 +745,27 @@ typedef struct /**/ ApeSymTable ApeSymTable;
 typedef struct /**/ ApeOpcodeDef ApeOpcodeDef;
 typedef struct /**/ ApeAstCompResult ApeAstCompResult;
 typedef struct /**/ ApeAstCompScope ApeAstCompScope;
+typedef struct /**/ ApeInferEntry ApeInferEntry;
+typedef struct /**/ ApeInferFlow ApeInferFlow;
 typedef struct /**/ ApeGCObjPool ApeGCObjPool;
 typedef struct /**/ ApeGCMemory ApeGCMemory;
+typedef struct /**/ ApeProfiler ApeProfiler;
+typedef struct /**/ ApeOpStats ApeOpStats;
+typedef struct /**/ ApeTracer ApeTracer;
 typedef struct /**/ ApeTracebackItem ApeTracebackItem;
 typedef struct /**/ ApeTraceback ApeTraceback;
 typedef struct /**/ ApeFrame ApeFrame;
 typedef struct /**/ ApeValDict ApeValDict;
 typedef struct /**/ ApeStrDict ApeStrDict;
+typedef struct /**/ ApeNameMap ApeNameMap;
+typedef struct /**/ ApeNameTable ApeNameTable;
 typedef struct /**/ ApeValArray ApeValArray;
 typedef struct /**/ ApePtrArray ApePtrArray;
 typedef struct /**/ ApeWriter ApeWriter;
 typedef struct /**/ ApeGlobalStore ApeGlobalStore;
 typedef struct /**/ ApeModule ApeModule;
 typedef struct /**/ ApeAstFileScope ApeAstFileScope;
+typedef struct /**/ ApeAstPreparsed ApeAstPreparsed;
 typedef struct /**/ ApeAstCompiler ApeAstCompiler;
 typedef struct /**/ ApeNativeFuncWrapper ApeNativeFuncWrapper;
 typedef struct /**/ ApeNativeItem ApeNativeItem;
@@ -658,11 +787,19 @@ typedef size_t (*ApeIOFlushFunc)(ApeContext*, const char*, const char*, size_t);
 typedef size_t (*ApeWriterWriteFunc)(ApeContext*, void*, const char*, size_t);
 typedef void (*ApeWriterFlushFunc)(ApeContext*, void*);
 
+/*
+* called when a function is entered, and when it is left; see ape_context_sethooks.
+* on entry, 'pos' is where a script function starts, or where a native function is called from;
+* on return, it is where the function returns from. 'usec' is from ape_util_timermicros.
+*/
+typedef void (*ApeCallHookFunc)(ApeContext* ctx, const char* name, ApePosition pos, ApeFloat usec, void* userdata);
+
 typedef void* (*ApeMemAllocFunc)(ApeContext*, void*, size_t);
 typedef void (*ApeMemFreeFunc)(ApeContext*, void*, void*);
 typedef unsigned long (*ApeDataHashFunc)(const void*);
 typedef bool (*ApeDataEqualsFunc)(const void*, const void*);
 typedef void* (*ApeDataCallback)(ApeContext*, void*);
+typedef void* (*ApeAstCopyCallback)(ApeAstArena*, void*);
 
 
 typedef ApeAstExpression* (*ApeRightAssocParseFNCallback)(ApeAstParser* p);
@@ -696,6 +833,16 @@ struct ApePseudoClass
     ApeContext* context;
     const char* classname;
     ApeStrDict* fndictref;
+
+    /*
+    * collision-free table of members, built once by ape_pseudoclass_buildtable.
+    * index is ((hash ^ (hash >> slotshift)) & slotmask).
+    * if slots is NULL, lookups fall back to fndictref.
+    */
+    ApeObjMemberItem** slots;
+    unsigned long* slothashes;
+    unsigned long slotmask;
+    unsigned int slotshift;
 };
 
 struct ApeObjMemberItem
@@ -733,6 +880,15 @@ struct ApeObjError
     ApeTraceback* traceback;
 };
 
+/* an array produced by range() that has not been materialised yet */
+struct ApeObjRange
+{
+    bool active;
+    ApeInt start;
+    ApeInt step;
+    ApeSize count;
+};
+
 struct ApeObjString
 {
     //union
@@ -790,13 +946,19 @@ struct ApeGCObjData
     {
         ApeObjString valstring;
         ApeObjError valerror;
-        ApeValArray* valarray;
+        struct
+        {
+            ApeValArray* valarray;
+            ApeObjRange valrange;
+        };
         ApeValDict* valmap;
         ApeScriptFunction valscriptfunc;
         ApeNativeFunction valnatfunc;
         ApeExternalData valextern;
     };
     bool gcmark;
+    /* owned by a shared program: never marked or swept by the contexts that use it */
+    bool gcpermanent;
     ApeObjType datatype;
 };
 
@@ -842,6 +1004,22 @@ struct ApeStrDict
     ApeDataCallback fnstrdestroy;
 };
 
+/*
+* maps interned names (see ApeNameTable) to values, comparing the pointers only.
+* entries are kept in insertion order; while there are only a few, lookups scan them
+* instead of hashing, so a map that stays small never allocates its cells.
+*/
+struct ApeNameMap
+{
+    ApeContext* context;
+    const char** keys;
+    void** values;
+    unsigned int* cells;
+    ApeSize count;
+    ApeSize itemcap;
+    ApeSize cellcap;
+};
+
 
 
 struct ApeWriter
@@ -903,6 +1081,24 @@ struct ApeAllocator
     void* optr;
     ApeMemPool* pool;
     bool ready;
+
+    /* bytes currently handed out, and the high-water mark */
+    ApeSize curbytes;
+    ApeSize peakbytes;
+
+    /*
+    * heap budget in bytes, 0 meaning unlimited.
+    * allocations past this still succeed, up to a margin (APE_CONF_CONST_HEAPLIMIT_HARDMARGINDIV);
+    * the VM checks ape_allocator_overbudget between instructions, where it is safe to run an
+    * emergency collection.
+    */
+    ApeSize maxbytes;
+
+    /* bytes asked for past the margin, and refused, since the VM last looked */
+    ApeSize refusedbytes;
+
+    /* a pthread_mutex_t taken around every call while set, when threads share this allocator */
+    void* lock;
 };
 
 struct ApeError
@@ -936,6 +1132,8 @@ struct ApeAstToken
     ApeAstTokType toktype;
     const char* literal;
     ApeSize len;
+    /* for identifiers: the literal, interned */
+    const char* name;
     ApePosition pos;
 };
 
@@ -944,7 +1142,24 @@ struct ApeAstCompFile
     ApeContext* context;
     char* dirpath;
     char* path;
-    ApePtrArray* lines;
+    /* source text kept for error messages, one chunk per lexed input, each ending in a newline */
+    char* source;
+    ApeSize sourcelen;
+    ApeSize sourcecap;
+    /* lines in every input lexed so far, whether or not its text was kept */
+    ApeSize linecount;
+    /* offset into source at which each line starts, built on the first lookup */
+    ApeValArray* lineoffsets;
+    /* how much of source lineoffsets covers; those lines have their newline replaced by a NUL */
+    ApeSize indexedlen;
+    /* the text is the file at path, 'disksize' bytes long, and can be read again from there */
+    bool ondisk;
+    bool diskread;
+    ApeSize disksize;
+    /* hash and size of the source this file was compiled from, for the module cache */
+    bool hassrchash;
+    uint64_t srchash;
+    ApeSize srcsize;
 };
 
 struct ApeAstLexer
@@ -977,6 +1192,7 @@ struct ApeAstLexer
 struct ApeAstBlockExpr
 {
     ApeContext* context;
+    ApeAstArena* arena;
     ApePtrArray* statements;
 };
 
@@ -996,6 +1212,7 @@ struct ApeAstInfixExpr
 struct ApeAstIfCaseExpr
 {
     ApeContext* context;
+    ApeAstArena* arena;
     ApeAstExpression* test;
     ApeAstBlockExpr* consequence;
 };
@@ -1043,7 +1260,9 @@ struct ApeAstTernaryExpr
 struct ApeAstIdentExpr
 {
     ApeContext* context;
-    char* value;
+    ApeAstArena* arena;
+    /* interned in the context's name table */
+    const char* value;
     ApePosition pos;
 };
 
@@ -1069,6 +1288,8 @@ struct ApeAstWhileLoopExpr
 struct ApeAstForeachExpr
 {
     ApeAstIdentExpr* iterator;
+    /* only set for 'for(key, value in source)', in which case iterator is the key */
+    ApeAstIdentExpr* valueiterator;
     ApeAstExpression* source;
     ApeAstBlockExpr* body;
 };
@@ -1103,6 +1324,7 @@ struct ApeAstLiteralMapExpr
 struct ApeAstExpression
 {
     ApeContext* context;
+    ApeAstArena* arena;
     ApeAstExprType extype;
     bool stringwasallocd;
     ApeSize stringlitlength;
@@ -1134,6 +1356,46 @@ struct ApeAstExpression
         ApeAstRecoverExpr exrecoverstmt;
     };
     ApePosition pos;
+    /* set once ape_optimizer_optexpr has simplified this node and everything below it */
+    bool optimized;
+    /* what it evaluated to, set when it is compiled */
+    ApeInferType infertype;
+};
+
+/*
+* where AST nodes, their lists and their strings are allocated.
+* a bump arena hands out memory from large chunks and frees all of it at once in
+* ape_astarena_release; nodes in it are never destroyed one by one.
+* a heap arena allocates and frees every node through the context allocator, for the
+* few trees that outlive a compilation (constant values kept in symbols).
+*/
+struct ApeAstArenaChunk
+{
+    ApeAstArenaChunk* next;
+    ApeSize size;
+};
+
+struct ApeAstArena
+{
+    ApeContext* context;
+    bool isbump;
+    ApeAstArenaChunk* chunks;
+    char* cursor;
+    ApeSize remaining;
+    ApeSize nextchunksize;
+};
+
+/* one copy of every identifier seen by a context, so that names compare by pointer */
+struct ApeNameTable
+{
+    ApeContext* context;
+    ApeAstArena strings;
+    const char** cells;
+    unsigned long* hashes;
+    ApeSize count;
+    ApeSize cellcap;
+    /* like ApeAllocator.lock */
+    void* lock;
 };
 
 struct ApeAstParser
@@ -1143,21 +1405,29 @@ struct ApeAstParser
     ApeAstLexer lexer;
     ApeErrorList* errors;
     ApeSize depth;
+    /* owns the statements returned by ape_parser_parseall, until the next release */
+    ApeAstArena arena;
 };
 
 struct ApeSymbol
 {
     ApeContext* context;
     ApeSymbolType symtype;
-    char* name;
+    /* interned in the context's name table */
+    const char* name;
     ApeSize index;
     bool assignable;
+    /* literal value of a `const` module global, if it folded to one; owned by the symbol */
+    ApeAstExpression* constvalue;
+    /* for locals: what the current value is, at the point being compiled */
+    ApeInferType infertype;
 };
 
 struct ApeAstBlockScope
 {
     ApeContext* context;
-    ApeStrDict* store;
+    /* symbols defined in this scope, by name */
+    ApeNameMap store;
     ApeInt offset;
     ApeSize numdefinitions;
 };
@@ -1172,13 +1442,18 @@ struct ApeSymTable
     ApePtrArray* modglobalsymbols;
     ApeSize maxnumdefinitions;
     ApeInt modglobaloffset;
+    /*
+    * what each name resolved to so far. an entry is cleared when a symbol of that name is
+    * set in, or popped from, one of the block scopes.
+    */
+    ApeNameMap resolved;
 };
 
 struct ApeOpcodeDef
 {
     const char* name;
     ApeSize operandcount;
-    ApeInt operandwidths[2];
+    ApeInt operandwidths[3];
 };
 
 
@@ -1198,12 +1473,56 @@ struct ApeAstFileScope
     ApePtrArray* loadedmodulenames;
 };
 
+/*
+* an included file, read and parsed before the include is compiled (see ape_prefetch_includes).
+* the parser's arena holds the statements; parse errors wait in 'errors' until then.
+*/
+struct ApeAstPreparsed
+{
+    char* code;
+    size_t codelen;
+    ApeAstCompFile* file;
+    ApeAstParser* parser;
+    ApePtrArray* statements;
+    ApeErrorList errors;
+};
+
 struct ApeAstCompResult
 {
     ApeContext* context;
     ApeUShort* bytecode;
-    ApePosition* srcpositions;
+    /* source positions as runs; decoded by ape_compresult_srcposition */
+    unsigned char* linetable;
+    ApeSize linetablelen;
+    const ApeAstCompFile** linefiles;
+    ApeSize linefilecount;
+    ApeSize count;
+};
+
+/* a local followed through an ApeInferFlow */
+struct ApeInferEntry
+{
+    ApeSymbol* symbol;
+    /* the type each way through starts from; for loops, the type it is assumed to keep */
+    ApeInferType marked;
+    /* the join of the types at the end of each way through so far */
+    ApeInferType joined;
+    /* assigned inside the loop */
+    bool written;
+};
+
+/* the locals visible at the start of a construct with more than one way through it */
+struct ApeInferFlow
+{
+    ApeInferEntry* entries;
     ApeSize count;
+    /* how many ways through have been joined */
+    ApeSize branches;
+    bool isloop;
+    /* some local was given a type in the loop other than the one it was assumed to keep */
+    bool failed;
+    /* for loops: the first of the scope's dupips made inside it */
+    ApeSize firstdup;
 };
 
 struct ApeAstCompScope
@@ -1214,6 +1533,10 @@ struct ApeAstCompScope
     ApeValArray* srcpositions;
     ApeValArray* breakipstack;
     ApeValArray* continueipstack;
+    /* ApeInferFlow* of the loops being compiled, innermost last */
+    ApeValArray* inferloops;
+    /* ips of the 'dup' of assignments of a number or bool, see ape_optimizer_notedup */
+    ApeValArray* dupips;
     ApeOpByte lastopcode;
 };
 
@@ -1231,12 +1554,25 @@ struct ApeAstCompiler
     ApeValArray* srcpositionsstack;
     ApeStrDict* modules;
     ApeStrDict* stringconstantspositions;
+    /* number of includes that found their module already compiled */
+    ApeSize reusedmodules;
+    /* included files parsed ahead of time, by canonical path; NULL when there are none */
+    ApeStrDict* preparsed;
 };
 
+/*
+* a compiled script that can be run in any number of contexts (see ape_program_compilefile).
+* it owns a private context holding its constants and files; it is never modified after
+* compiling, and lives until the last reference is released.
+*/
 struct ApeAstProgram
 {
     ApeContext* context;
     ApeAstCompResult* comp_res;
+    ApeValArray* constants;
+    /* ape_bytecache_signature() of the globals it was compiled against */
+    uint64_t signature;
+    long refcount;
 };
 
 struct ApeGlobalStore
@@ -1248,9 +1584,8 @@ struct ApeGlobalStore
 
 struct ApeFrame
 {
-    bool allocated;
     ApeObject function;
-    ApePosition* srcpositions;
+    ApeScriptFunction* scriptfunc;
     ApeUShort* bytecode;
 
     ApeInt ip;
@@ -1269,17 +1604,32 @@ struct ApeFrame
     //short recoverip;
 
     bool isrecovering;
+
+    /* vm->thisptr on entry; recovering unwinds the this-stack back to this */
+    int thisptr;
 };
 
 
 struct ApeExecState
 {
     ApeFrame* frame;
-    ApeFrame newframe;
     ApeOpcodeValue opcode;
     ApeValArray * constants;
 };
 
+#if (APE_CONF_VM_OPSTATS > 0)
+struct ApeOpStats
+{
+    ApeOpByte previous;
+    uint64_t counts[APE_OPCODE_MAX];
+    /* pairs[a][b] counts how often b ran right after a */
+    uint64_t pairs[APE_OPCODE_MAX][APE_OPCODE_MAX];
+    #if (APE_CONF_VM_OPSTATS > 1)
+        uint64_t cycles[APE_OPCODE_MAX];
+    #endif
+};
+#endif
+
 
 struct ApeVM
 {
@@ -1292,7 +1642,13 @@ struct ApeVM
 
     ApeObject overloadkeys[APE_OPCODE_MAX];
 
-    ApeValDict* globalobjects;
+    /*
+    * module globals, indexed directly by the GETMODULEGLOBAL/SETMODULEGLOBAL operand.
+    * grows geometrically; unset slots hold null.
+    */
+    ApeObject* globalobjects;
+    ApeSize globalcount;
+    ApeSize globalcapacity;
 
     ApeValDict* stackobjects;
     int stackptr;
@@ -1300,14 +1656,34 @@ struct ApeVM
     ApeObject thisobjects[APE_CONF_SIZE_VM_THISSTACK];
     int thisptr;
 
-    //DequeList_t* frameobjects;
-    intptr_t* frameobjects;
+    /*
+    * frames live in one contiguous array; a call initializes the next slot in place,
+    * and a return just decrements countframes.
+    * since the array may be reallocated on push, never hold on to a frame pointer across a call.
+    */
+    ApeFrame* frameobjects;
     ApeSize countframes;
-    ApeFrame* lastframe;
+    ApeSize framecapacity;
 
     ApeObject lastpopped;
     ApeFrame* currentframe;
 
+    /* absolute deadline (in ape_util_timermillis time) if config->max_execution_time_set */
+    ApeFloat deadline;
+    ApeSize timeoutticks;
+
+    /* set while a profiler samples this vm; its samples are collected at safe points */
+    ApeProfiler* profiler;
+
+    /* set by ape_context_sethooks; while NULL, each costs a single branch per call */
+    ApeCallHookFunc hookcall;
+    ApeCallHookFunc hookreturn;
+    void* hookdata;
+
+    #if (APE_CONF_VM_OPSTATS > 0)
+        ApeOpStats opstats;
+    #endif
+
     bool running;
 };
 
@@ -1332,6 +1708,18 @@ struct ApeConfig
     bool dumpast;
     bool dumpbytecode;
     bool dumpstack;
+    /* run the AST optimizer (constant folding, propagation, dead branches) */
+    bool optimize;
+    /* load and write precompiled programs (.apec) in ape_context_executefile */
+    bool bytecache;
+    /* where those live; NULL puts them next to the script */
+    const char* bytecachedir;
+    /* reuse modules compiled by any context in this process (see ape_modcache_replay) */
+    bool modulecache;
+    /* what compiled files keep of their source text */
+    ApeSourceMode sourcemode;
+    /* threads parsing included files; 0 uses one per core, 1 parses each when it is included */
+    ApeSize compilethreads;
 };
 
 
@@ -1357,15 +1745,33 @@ struct ApeContext
     /* contains the typemapping of pseudoclasses where key is the typename */
     ApeStrDict* classmapping;
 
+    /* same as classmapping, but indexed by the bit position of ApeObjType */
+    ApePseudoClass* classbytype[APE_CONF_SIZE_PSEUDOCLASS_TYPES];
+
     /* globally defined object */
     ApeGlobalStore* globalstore;
 
     /* the main compiler instance - may spawn additional compiler instances */
     ApeAstCompiler* compiler;
 
+    /* heap arena for the few AST trees that outlive a compilation */
+    ApeAstArena astheap;
+
+    /* identifiers and symbol names */
+    ApeNameTable names;
+
+    /* programs run in this context; released when it is destroyed */
+    ApePtrArray* programs;
+
     /* the main VM instance - may spawn additional VM instances */
     ApeVM* vm;
 
+    /* the sampling profiler, once ape_context_startprofiler was called */
+    ApeProfiler* profiler;
+
+    /* records compile, gc and run spans once ape_context_starttrace was called */
+    ApeTracer* tracer;
+
     /* the current list of errors (if any) */
     ApeErrorList errors;
 
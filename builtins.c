@@ -297,7 +297,6 @@ err:
 
 static ApeObject cfn_range(ApeVM* vm, void* data, ApeSize argc, ApeObject* args)
 {
-    bool ok;
     const char* typestr;
     const char* expected_str;
     ApeInt i;
@@ -305,7 +304,6 @@ static ApeObject cfn_range(ApeVM* vm, void* data, ApeSize argc, ApeObject* args)
     ApeInt end;
     ApeInt step;
     ApeObject res;
-    ApeObject item;
     ApeObjType type;
     (void)data;
     for(i = 0; i < (ApeInt)argc; i++)
@@ -347,20 +345,8 @@ static ApeObject cfn_range(ApeVM* vm, void* data, ApeSize argc, ApeObject* args)
         ape_vm_adderror(vm, APE_ERROR_RUNTIME, "range step cannot be 0");
         return ape_object_make_null(vm->context);
     }
-    res = ape_object_make_array(vm->context);
-    if(ape_object_value_isnull(res))
-    {
-        return ape_object_make_null(vm->context);
-    }
-    for(i = start; i < end; i += step)
-    {
-        item = ape_object_make_floatnumber(vm->context, i);
-        ok = ape_object_array_pushvalue(res, item);
-        if(!ok)
-        {
-            return ape_object_make_null(vm->context);
-        }
-    }
+    /* elements are computed on demand; see ape_object_make_range */
+    res = ape_object_make_range(vm->context, start, end, step);
     return res;
 }
 
@@ -832,6 +818,34 @@ static ApeObject cfn_vm_gcsweep(ApeVM* vm, void* data, ApeSize argc, ApeObject*
     return ape_object_make_null(vm->context);
 }
 
+/*
+* counts of executed opcodes and opcode pairs (see ape_opstats_toobject), or null if the vm was
+* built without them. VM.opstats(true) also starts counting over.
+*/
+static ApeObject cfn_vm_opstats(ApeVM* vm, void* data, ApeSize argc, ApeObject* args)
+{
+    bool reset;
+    ApeObject res;
+    ApeArgCheck check;
+    (void)data;
+    reset = false;
+    ape_args_init(vm, &check, "opstats", argc, args);
+    if(ape_args_checkoptional(&check, 0, APE_OBJECT_BOOL, true))
+    {
+        reset = ape_object_value_asbool(args[0]);
+    }
+    else if(!check.counterror)
+    {
+        return ape_object_make_null(vm->context);
+    }
+    res = ape_opstats_toobject(vm);
+    if(reset)
+    {
+        ape_opstats_reset(vm);
+    }
+    return res;
+}
+
 static ApeObject cfn_vm_gccollect(ApeVM* vm, void* data, ApeSize argc, ApeObject* args)
 {
     (void)data;
@@ -924,6 +938,7 @@ void ape_builtins_install_vm(ApeVM* vm)
     static ApeNativeItem staticfuncs[]=
     {
         {"sweep", cfn_vm_gcsweep},
+        {"opstats", cfn_vm_opstats},
         {"collect", cfn_vm_gccollect},
         {"stack", cfn_vm_stack},
         #if 0
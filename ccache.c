@@ -0,0 +1,2121 @@
+#if defined(__linux__) || defined(__unix__)
+    #define APE_BYTECACHE_HAVEMMAP
+#endif
+
+#if defined(APE_BYTECACHE_HAVEMMAP)
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+#endif
+
+#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+    #define APE_MODCACHE_HAVETHREADS
+    #include <pthread.h>
+#endif
+
+#include <time.h>
+
+#include "inline.h"
+
+/*
+* precompiled program files (.apec), so that running an unchanged script skips lexing,
+* parsing and compiling entirely.
+*
+* layout (integers are little-endian, 'varint' is LEB128, 'svarint' is zigzag + LEB128):
+*
+*   header     "APEC", u32 version, u64 opcode signature, u32 flags,
+*              u64 signature, u64 payload size, u64 payload checksum
+*   files      varint count, then per file: string path, u64 content hash, u64 content size
+*   constants  varint count, then per constant: u8 kind, followed by
+*                string:   string data
+*                function: string name, varint numlocals, varint numargs, code
+*   code       the top-level program
+*   symbols    varint count, then per symbol: string name, u8 type, varint index,
+*              u8 assignable, u8 owned; then varint numdefinitions, varint maxnumdefinitions
+*
+*   code       varint length, the raw bytecode, varint number of position runs, then per run:
+*              varint length, varint file (0 is none, otherwise 1 + index into files),
+*              svarint line delta, svarint column delta
+*   string     varint length, then the bytes
+*
+* constant and module global indices in the bytecode are absolute, so a cache file is only
+* written and read by a compiler that has not compiled anything yet (see ape_bytecache_usable),
+* and only loaded if everything else it refers to by index is laid out identically (see
+* ape_bytecache_signature).
+* any mismatch makes the loader return NULL; the caller then compiles from source and
+* rewrites the file.
+*/
+
+#define APE_BYTECACHE_VERSION 1
+#define APE_BYTECACHE_HEADERSIZE (4 + 4 + 8 + 4 + 8 + 8 + 8)
+#define APE_BYTECACHE_FLAGOPTIMIZE (1 << 0)
+#define APE_BYTECACHE_CONSTSTRING 0
+#define APE_BYTECACHE_CONSTFUNCTION 1
+
+typedef struct ApeBytecacheReader ApeBytecacheReader;
+
+struct ApeBytecacheReader
+{
+    const ApeUShort* data;
+    ApeSize length;
+    ApeSize pos;
+    bool failed;
+};
+
+static void ape_bytecache_putu8(ApeWriter* wr, unsigned int val)
+{
+    char ch;
+    ch = (char)(val & 0xff);
+    ape_writer_appendlen(wr, &ch, 1);
+}
+
+static void ape_bytecache_putu32(ApeWriter* wr, uint32_t val)
+{
+    int i;
+    for(i = 0; i < 4; i++)
+    {
+        ape_bytecache_putu8(wr, (unsigned int)(val >> (i * 8)));
+    }
+}
+
+static void ape_bytecache_putu64(ApeWriter* wr, uint64_t val)
+{
+    int i;
+    for(i = 0; i < 8; i++)
+    {
+        ape_bytecache_putu8(wr, (unsigned int)(val >> (i * 8)));
+    }
+}
+
+static void ape_bytecache_putvarint(ApeWriter* wr, uint64_t val)
+{
+    while(val >= 0x80)
+    {
+        ape_bytecache_putu8(wr, (unsigned int)((val & 0x7f) | 0x80));
+        val >>= 7;
+    }
+    ape_bytecache_putu8(wr, (unsigned int)val);
+}
+
+static void ape_bytecache_putsvarint(ApeWriter* wr, int64_t val)
+{
+    ape_bytecache_putvarint(wr, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+static void ape_bytecache_putstring(ApeWriter* wr, const char* str, ApeSize len)
+{
+    ape_bytecache_putvarint(wr, len);
+    ape_writer_appendlen(wr, str, len);
+}
+
+static const ApeUShort* ape_bytecache_getbytes(ApeBytecacheReader* rd, ApeSize len)
+{
+    const ApeUShort* res;
+    if(rd->failed || (len > (rd->length - rd->pos)))
+    {
+        rd->failed = true;
+        return NULL;
+    }
+    res = rd->data + rd->pos;
+    rd->pos += len;
+    return res;
+}
+
+static unsigned int ape_bytecache_getu8(ApeBytecacheReader* rd)
+{
+    const ApeUShort* p;
+    p = ape_bytecache_getbytes(rd, 1);
+    if(!p)
+    {
+        return 0;
+    }
+    return p[0];
+}
+
+static uint32_t ape_bytecache_getu32(ApeBytecacheReader* rd)
+{
+    int i;
+    uint32_t val;
+    val = 0;
+    for(i = 0; i < 4; i++)
+    {
+        val |= ((uint32_t)ape_bytecache_getu8(rd) << (i * 8));
+    }
+    return val;
+}
+
+static uint64_t ape_bytecache_getu64(ApeBytecacheReader* rd)
+{
+    int i;
+    uint64_t val;
+    val = 0;
+    for(i = 0; i < 8; i++)
+    {
+        val |= ((uint64_t)ape_bytecache_getu8(rd) << (i * 8));
+    }
+    return val;
+}
+
+static uint64_t ape_bytecache_getvarint(ApeBytecacheReader* rd)
+{
+    int shift;
+    unsigned int byte;
+    uint64_t val;
+    val = 0;
+    for(shift = 0; shift < 64; shift += 7)
+    {
+        byte = ape_bytecache_getu8(rd);
+        val |= ((uint64_t)(byte & 0x7f) << shift);
+        if(!(byte & 0x80))
+        {
+            return val;
+        }
+    }
+    rd->failed = true;
+    return 0;
+}
+
+static int64_t ape_bytecache_getsvarint(ApeBytecacheReader* rd)
+{
+    uint64_t val;
+    val = ape_bytecache_getvarint(rd);
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static const char* ape_bytecache_getstring(ApeBytecacheReader* rd, ApeSize* len)
+{
+    *len = ape_bytecache_getvarint(rd);
+    return (const char*)ape_bytecache_getbytes(rd, *len);
+}
+
+/* changes whenever an opcode is added, removed, renamed or changes its operands */
+static uint64_t ape_bytecache_opcodesignature(void)
+{
+    ApeSize i;
+    ApeOpByte op;
+    uint64_t sig;
+    ApeOpcodeDef* def;
+    sig = APE_OPCODE_MAX;
+    for(op = 0; op < APE_OPCODE_MAX; op++)
+    {
+        def = ape_vm_opcodefind(op);
+        if(!def)
+        {
+            continue;
+        }
+        sig = (sig * 31) + ape_util_hashstring(def->name, strlen(def->name));
+        sig = (sig * 31) + def->operandcount;
+        for(i = 0; i < def->operandcount; i++)
+        {
+            sig = (sig * 31) + def->operandwidths[i];
+        }
+    }
+    return sig;
+}
+
+/* names and indices of the builtins and host globals */
+static uint64_t ape_bytecache_storesignature(ApeGlobalStore* store)
+{
+    ApeSize i;
+    uint64_t sig;
+    const char* name;
+    ApeSymbol* symbol;
+    sig = ape_strdict_count(store->named);
+    for(i = 0; i < ape_strdict_count(store->named); i++)
+    {
+        name = ape_strdict_getkeyat(store->named, i);
+        symbol = (ApeSymbol*)ape_strdict_getvalueat(store->named, i);
+        sig = (sig * 31) + ape_util_hashstring(name, strlen(name));
+        sig = (sig * 31) + symbol->index;
+    }
+    return sig;
+}
+
+/*
+* everything compiled code refers to by index besides its own constants: builtins and host
+* globals (in the global store), and the module globals defined before the script (pseudo
+* classes, for instance). taken before compiling, and compared before loading.
+*/
+uint64_t ape_bytecache_signature(ApeAstCompiler* comp)
+{
+    ApeSize i;
+    uint64_t sig;
+    const char* name;
+    ApeSymbol* symbol;
+    ApeSymTable* symtable;
+    ApeAstBlockScope* topscope;
+    sig = ape_bytecache_storesignature(comp->globalstore);
+    symtable = ape_compiler_getsymboltable(comp);
+    topscope = ape_symtable_getblockscope(symtable);
+    sig = (sig * 31) + topscope->numdefinitions;
+    for(i = 0; i < ape_namemap_count(&topscope->store); i++)
+    {
+        name = ape_namemap_getkeyat(&topscope->store, i);
+        symbol = (ApeSymbol*)ape_namemap_getvalueat(&topscope->store, i);
+        sig = (sig * 31) + ape_util_hashstring(name, strlen(name));
+        sig = (sig * 31) + symbol->index;
+    }
+    return sig;
+}
+
+static uint32_t ape_bytecache_flags(ApeAstCompiler* comp)
+{
+    uint32_t flags;
+    flags = 0;
+    if(comp->config->optimize)
+    {
+        flags |= APE_BYTECACHE_FLAGOPTIMIZE;
+    }
+    return flags;
+}
+
+/*
+* true if no constants have been compiled into this compiler yet. string constants are shared
+* between compilations, so only then do the indices baked into a cache file line up.
+*/
+bool ape_bytecache_usable(ApeAstCompiler* comp)
+{
+    return ape_valarray_count(comp->constants) == 0;
+}
+
+/* "foo.ape" -> "foo.apec", or "<dir>/foo.ape.<pathhash>.apec" when a cache directory is set */
+char* ape_bytecache_getpath(ApeContext* ctx, const char* srcpath)
+{
+    size_t len;
+    const char* base;
+    len = strlen(srcpath);
+    if(ctx->config.bytecachedir == NULL)
+    {
+        if((len > 4) && (strcmp(srcpath + (len - 4), ".ape") == 0))
+        {
+            return ape_util_stringfmt(ctx, "%sc", srcpath);
+        }
+        return ape_util_stringfmt(ctx, "%s.apec", srcpath);
+    }
+    base = strrchr(srcpath, '/');
+    base = (base != NULL) ? (base + 1) : srcpath;
+    return ape_util_stringfmt(ctx, "%s/%s.%016lx.apec", ctx->config.bytecachedir, base, ape_util_hashstring(srcpath, len));
+}
+
+/*
+* reads a source file through the configured hook. a missing file only means the cache is
+* stale, so any error the hook reported is dropped again.
+*/
+static char* ape_bytecache_readsource(ApeAstCompiler* comp, const char* path, size_t* dlen)
+{
+    char* data;
+    ApeSize errcount;
+    errcount = ape_errorlist_count(comp->errors);
+    data = comp->config->fileio.fnreadfile(comp->context, path, -1, dlen);
+    if(!data)
+    {
+        ape_errorlist_truncate(comp->errors, errcount);
+    }
+    return data;
+}
+
+static ApeUShort* ape_bytecache_mapfile(ApeContext* ctx, const char* path, ApeSize* dlen, bool* mapped)
+{
+    size_t rlen;
+    char* data;
+    FILE* hnd;
+    ApeSize errcount;
+    *mapped = false;
+    #if defined(APE_BYTECACHE_HAVEMMAP)
+        int fd;
+        void* map;
+        struct stat st;
+        fd = open(path, O_RDONLY);
+        if(fd < 0)
+        {
+            return NULL;
+        }
+        if((fstat(fd, &st) != 0) || (st.st_size < APE_BYTECACHE_HEADERSIZE))
+        {
+            close(fd);
+            return NULL;
+        }
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(map != MAP_FAILED)
+        {
+            *mapped = true;
+            *dlen = st.st_size;
+            return (ApeUShort*)map;
+        }
+    #endif
+    hnd = fopen(path, "rb");
+    if(!hnd)
+    {
+        return NULL;
+    }
+    errcount = ape_errorlist_count(&ctx->errors);
+    data = ape_util_default_readhandle(ctx, hnd, -1, &rlen);
+    fclose(hnd);
+    if(!data)
+    {
+        ape_errorlist_truncate(&ctx->errors, errcount);
+        return NULL;
+    }
+    *dlen = rlen;
+    return (ApeUShort*)data;
+}
+
+static void ape_bytecache_unmapfile(ApeContext* ctx, ApeUShort* data, ApeSize dlen, bool mapped)
+{
+    (void)dlen;
+    if(data == NULL)
+    {
+        return;
+    }
+    #if defined(APE_BYTECACHE_HAVEMMAP)
+        if(mapped)
+        {
+            munmap(data, dlen);
+            return;
+        }
+    #endif
+    (void)mapped;
+    ape_allocator_free(&ctx->alloc, data);
+}
+
+/*
+* 'slots' has one entry per file compiled since 'filebase': 0 if it is not recorded,
+* otherwise its index in the cache file's file table, plus one.
+*/
+static ApeSize ape_bytecache_fileindex(ApeAstCompiler* comp, ApeSize filebase, const ApeSize* slots, const ApeAstCompFile* file)
+{
+    ApeSize i;
+    if(file == NULL)
+    {
+        return 0;
+    }
+    for(i = filebase; i < ape_ptrarray_count(comp->files); i++)
+    {
+        if((const ApeAstCompFile*)ape_ptrarray_get(comp->files, i) == file)
+        {
+            return slots[i - filebase];
+        }
+    }
+    return 0;
+}
+
+/* flags every file that 'cres' has code from */
+static void ape_bytecache_markfiles(ApeAstCompiler* comp, ApeSize filebase, ApeSize* slots, ApeAstCompResult* cres)
+{
+    ApeSize i;
+    ApeSize j;
+    const ApeAstCompFile* last;
+    for(i = 0; i < cres->linefilecount; i++)
+    {
+        last = cres->linefiles[i];
+        for(j = filebase; j < ape_ptrarray_count(comp->files); j++)
+        {
+            if((const ApeAstCompFile*)ape_ptrarray_get(comp->files, j) == last)
+            {
+                slots[j - filebase] = 1;
+            }
+        }
+    }
+}
+
+static bool ape_bytecache_samepos(const ApePosition* a, const ApePosition* b)
+{
+    return (a->file == b->file) && (a->line == b->line) && (a->column == b->column);
+}
+
+static void ape_bytecache_putcode(ApeWriter* wr, ApeAstCompiler* comp, ApeSize filebase, const ApeSize* slots, const ApeUShort* bytecode, const ApePosition* positions, ApeSize count)
+{
+    ApeSize i;
+    ApeSize run;
+    ApeSize numruns;
+    ApeInt line;
+    ApeInt column;
+    ape_bytecache_putvarint(wr, count);
+    ape_writer_appendlen(wr, (const char*)bytecode, count);
+    numruns = 0;
+    for(i = 0; i < count; i++)
+    {
+        if((i == 0) || !ape_bytecache_samepos(&positions[i], &positions[i - 1]))
+        {
+            numruns++;
+        }
+    }
+    ape_bytecache_putvarint(wr, numruns);
+    line = 0;
+    column = 0;
+    i = 0;
+    while(i < count)
+    {
+        run = 1;
+        while(((i + run) < count) && ape_bytecache_samepos(&positions[i + run], &positions[i]))
+        {
+            run++;
+        }
+        ape_bytecache_putvarint(wr, run);
+        ape_bytecache_putvarint(wr, ape_bytecache_fileindex(comp, filebase, slots, positions[i].file));
+        ape_bytecache_putsvarint(wr, positions[i].line - line);
+        ape_bytecache_putsvarint(wr, positions[i].column - column);
+        line = positions[i].line;
+        column = positions[i].column;
+        i += run;
+    }
+}
+
+/* same as ape_bytecache_putcode, for a finished result whose positions only exist as a line table */
+static bool ape_bytecache_putresult(ApeWriter* wr, ApeAstCompiler* comp, ApeSize filebase, const ApeSize* slots, const ApeUShort* bytecode, const ApeAstCompResult* cres)
+{
+    ApePosition* positions;
+    positions = ape_compresult_getpositions(cres);
+    if(!positions)
+    {
+        return false;
+    }
+    ape_bytecache_putcode(wr, comp, filebase, slots, bytecode, positions, cres->count);
+    ape_allocator_free(&comp->context->alloc, positions);
+    return true;
+}
+
+static ApeAstCompResult* ape_bytecache_getcode(ApeBytecacheReader* rd, ApeContext* ctx, ApeAstCompFile** files, ApeSize filecount)
+{
+    ApeSize i;
+    ApeSize pos;
+    ApeSize run;
+    ApeSize count;
+    ApeSize numruns;
+    ApeSize fileix;
+    ApeInt line;
+    ApeInt column;
+    const ApeUShort* raw;
+    ApeUShort* bytecode;
+    ApePosition* positions;
+    ApeAstCompResult* res;
+    bytecode = NULL;
+    positions = NULL;
+    count = ape_bytecache_getvarint(rd);
+    raw = ape_bytecache_getbytes(rd, count);
+    if(!raw)
+    {
+        goto err;
+    }
+    /* always allocate, even for empty code, so that destroying the result stays uniform */
+    bytecode = (ApeUShort*)ape_allocator_alloc(&ctx->alloc, count + 1);
+    positions = (ApePosition*)ape_allocator_alloc(&ctx->alloc, (count + 1) * sizeof(ApePosition));
+    if(!bytecode || !positions)
+    {
+        goto err;
+    }
+    memcpy(bytecode, raw, count);
+    numruns = ape_bytecache_getvarint(rd);
+    pos = 0;
+    line = 0;
+    column = 0;
+    for(i = 0; i < numruns; i++)
+    {
+        run = ape_bytecache_getvarint(rd);
+        fileix = ape_bytecache_getvarint(rd);
+        line += ape_bytecache_getsvarint(rd);
+        column += ape_bytecache_getsvarint(rd);
+        if(rd->failed || (fileix > filecount) || (run > (count - pos)))
+        {
+            goto err;
+        }
+        while(run > 0)
+        {
+            positions[pos].file = (fileix == 0) ? NULL : files[fileix - 1];
+            positions[pos].line = line;
+            positions[pos].column = column;
+            pos++;
+            run--;
+        }
+    }
+    if(pos != count)
+    {
+        goto err;
+    }
+    res = ape_make_compresult(ctx, bytecode, positions, count);
+    if(!res)
+    {
+        goto err;
+    }
+    ape_allocator_free(&ctx->alloc, positions);
+    return res;
+err:
+    rd->failed = true;
+    ape_allocator_free(&ctx->alloc, bytecode);
+    ape_allocator_free(&ctx->alloc, positions);
+    return NULL;
+}
+
+/* reads a function constant: string name, varint numlocals, varint numargs, code */
+static ApeObject ape_bytecache_getfunction(ApeBytecacheReader* rd, ApeContext* ctx, ApeAstCompFile** files, ApeSize filecount)
+{
+    char* name;
+    const char* str;
+    ApeSize len;
+    ApeSize numlocals;
+    ApeSize numargs;
+    ApeObject obj;
+    ApeAstCompResult* fncode;
+    str = ape_bytecache_getstring(rd, &len);
+    numlocals = ape_bytecache_getvarint(rd);
+    numargs = ape_bytecache_getvarint(rd);
+    if(rd->failed)
+    {
+        return ape_object_make_null(ctx);
+    }
+    name = ape_util_strndup(ctx, str, len);
+    if(!name)
+    {
+        return ape_object_make_null(ctx);
+    }
+    fncode = ape_bytecache_getcode(rd, ctx, files, filecount);
+    if(!fncode)
+    {
+        ape_allocator_free(&ctx->alloc, name);
+        return ape_object_make_null(ctx);
+    }
+    obj = ape_object_make_function(ctx, name, fncode, true, numlocals, numargs, 0);
+    ape_allocator_free(&ctx->alloc, name);
+    if(ape_object_value_isnull(obj))
+    {
+        ape_compresult_destroy(fncode);
+        rd->failed = true;
+    }
+    return obj;
+}
+
+
+/*
+* writes the program just compiled from 'srcpath'.
+* 'filebase' is the number of entries 'comp->files' had before compiling; the first one from
+* there on is the script. it and every included file that has code in the program are
+* recorded with a hash of their contents.
+* 'signature' is ape_bytecache_signature() as it was before compiling.
+*/
+bool ape_bytecache_store(ApeAstCompiler* comp, const char* srcpath, ApeAstCompResult* cres, ApeSize filebase, uint64_t signature)
+{
+    bool ok;
+    size_t clen;
+    char* code;
+    char* cachepath;
+    char* tmppath;
+    ApeSize i;
+    ApeSize j;
+    ApeSize written;
+    ApeSize numfiles;
+    ApeSize recorded;
+    ApeSize* slots;
+    FILE* hnd;
+    ApeObject obj;
+    ApeObjType type;
+    ApeContext* ctx;
+    ApeWriter* payload;
+    ApeWriter* header;
+    ApeAstCompFile* file;
+    ApeScriptFunction* fn;
+    ApeSymTable* symtable;
+    ApeAstBlockScope* topscope;
+    ApeSymbol* symbol;
+    const ApeSymbol* owned;
+    bool isowned;
+    ok = false;
+    ctx = comp->context;
+    cachepath = NULL;
+    tmppath = NULL;
+    header = NULL;
+    slots = NULL;
+    payload = ape_make_writer(ctx);
+    if(!payload || !comp->config->fileio.fnreadfile)
+    {
+        goto end;
+    }
+    /* the script, plus whatever it included that contributed code */
+    numfiles = ape_ptrarray_count(comp->files) - filebase;
+    slots = (ApeSize*)ape_allocator_alloc(&ctx->alloc, (numfiles + 1) * sizeof(ApeSize));
+    if(!slots || (numfiles == 0))
+    {
+        goto end;
+    }
+    memset(slots, 0, (numfiles + 1) * sizeof(ApeSize));
+    slots[0] = 1;
+    ape_bytecache_markfiles(comp, filebase, slots, cres);
+    for(i = 0; i < ape_valarray_count(comp->constants); i++)
+    {
+        obj = *(ApeObject*)ape_valarray_get(comp->constants, i);
+        if(ape_object_value_type(obj) == APE_OBJECT_SCRIPTFUNCTION)
+        {
+            ape_bytecache_markfiles(comp, filebase, slots, ape_object_value_allocated_data(obj)->valscriptfunc.compiledcode);
+        }
+    }
+    recorded = 0;
+    for(i = 0; i < numfiles; i++)
+    {
+        if(slots[i] != 0)
+        {
+            recorded++;
+            slots[i] = recorded;
+        }
+    }
+    ape_bytecache_putvarint(payload, recorded);
+    for(i = filebase; i < ape_ptrarray_count(comp->files); i++)
+    {
+        if(slots[i - filebase] == 0)
+        {
+            continue;
+        }
+        file = (ApeAstCompFile*)ape_ptrarray_get(comp->files, i);
+        code = ape_bytecache_readsource(comp, file->path, &clen);
+        if(!code)
+        {
+            goto end;
+        }
+        ape_bytecache_putstring(payload, file->path, strlen(file->path));
+        ape_bytecache_putu64(payload, ape_util_hashstring(code, clen));
+        ape_bytecache_putu64(payload, clen);
+        ape_allocator_free(&ctx->alloc, code);
+    }
+    ape_bytecache_putvarint(payload, ape_valarray_count(comp->constants));
+    for(i = 0; i < ape_valarray_count(comp->constants); i++)
+    {
+        obj = *(ApeObject*)ape_valarray_get(comp->constants, i);
+        type = ape_object_value_type(obj);
+        if(type == APE_OBJECT_STRING)
+        {
+            ape_bytecache_putu8(payload, APE_BYTECACHE_CONSTSTRING);
+            ape_bytecache_putstring(payload, ape_object_string_getdata(obj), ape_object_string_getlength(obj));
+        }
+        else if(type == APE_OBJECT_SCRIPTFUNCTION)
+        {
+            fn = &ape_object_value_allocated_data(obj)->valscriptfunc;
+            ape_bytecache_putu8(payload, APE_BYTECACHE_CONSTFUNCTION);
+            ape_bytecache_putstring(payload, fn->name, strlen(fn->name));
+            ape_bytecache_putvarint(payload, fn->numlocals);
+            ape_bytecache_putvarint(payload, fn->numargs);
+            if(!ape_bytecache_putresult(payload, comp, filebase, slots, fn->compiledcode->bytecode, fn->compiledcode))
+            {
+                goto end;
+            }
+        }
+        else
+        {
+            /* nothing else is ever emitted as a constant; refuse rather than guess */
+            goto end;
+        }
+    }
+    if(!ape_bytecache_putresult(payload, comp, filebase, slots, cres->bytecode, cres))
+    {
+        goto end;
+    }
+    symtable = ape_compiler_getsymboltable(comp);
+    topscope = ape_symtable_getblockscope(symtable);
+    ape_bytecache_putvarint(payload, ape_namemap_count(&topscope->store));
+    for(i = 0; i < ape_namemap_count(&topscope->store); i++)
+    {
+        symbol = (ApeSymbol*)ape_namemap_getvalueat(&topscope->store, i);
+        isowned = false;
+        for(j = 0; j < ape_symtable_getmoduleglobalsymbolcount(symtable); j++)
+        {
+            owned = ape_symtable_getmoduleglobalsymbolat(symtable, j);
+            if(APE_STREQ(owned->name, symbol->name))
+            {
+                isowned = true;
+                break;
+            }
+        }
+        ape_bytecache_putstring(payload, symbol->name, strlen(symbol->name));
+        ape_bytecache_putu8(payload, symbol->symtype);
+        ape_bytecache_putvarint(payload, symbol->index);
+        ape_bytecache_putu8(payload, symbol->assignable);
+        ape_bytecache_putu8(payload, isowned);
+    }
+    ape_bytecache_putvarint(payload, topscope->numdefinitions);
+    ape_bytecache_putvarint(payload, symtable->maxnumdefinitions);
+    if(ape_writer_failed(payload))
+    {
+        goto end;
+    }
+    header = ape_make_writer(ctx);
+    if(!header)
+    {
+        goto end;
+    }
+    ape_writer_appendlen(header, "APEC", 4);
+    ape_bytecache_putu32(header, APE_BYTECACHE_VERSION);
+    ape_bytecache_putu64(header, ape_bytecache_opcodesignature());
+    ape_bytecache_putu32(header, ape_bytecache_flags(comp));
+    ape_bytecache_putu64(header, signature);
+    ape_bytecache_putu64(header, ape_writer_getlength(payload));
+    ape_bytecache_putu64(header, ape_util_hashstring(ape_writer_getdata(payload), ape_writer_getlength(payload)));
+    ape_writer_appendlen(header, ape_writer_getdata(payload), ape_writer_getlength(payload));
+    if(ape_writer_failed(header))
+    {
+        goto end;
+    }
+    cachepath = ape_bytecache_getpath(ctx, srcpath);
+    if(!cachepath)
+    {
+        goto end;
+    }
+    /* write next to it and rename, so that concurrent runs never see a half-written file */
+    #if defined(APE_BYTECACHE_HAVEMMAP)
+        tmppath = ape_util_stringfmt(ctx, "%s.%ld.tmp", cachepath, (long)getpid());
+    #else
+        tmppath = ape_util_stringfmt(ctx, "%s.tmp", cachepath);
+    #endif
+    if(!tmppath)
+    {
+        goto end;
+    }
+    /* not through the file write hook: that one reports failures as script errors */
+    hnd = fopen(tmppath, "wb");
+    if(!hnd)
+    {
+        goto end;
+    }
+    written = fwrite(ape_writer_getdata(header), 1, ape_writer_getlength(header), hnd);
+    if((fclose(hnd) != 0) || (written != ape_writer_getlength(header)))
+    {
+        remove(tmppath);
+        goto end;
+    }
+    if(rename(tmppath, cachepath) != 0)
+    {
+        remove(tmppath);
+        goto end;
+    }
+    ok = true;
+end:
+    ape_writer_destroy(payload);
+    ape_writer_destroy(header);
+    ape_allocator_free(&ctx->alloc, cachepath);
+    ape_allocator_free(&ctx->alloc, tmppath);
+    ape_allocator_free(&ctx->alloc, slots);
+    return ok;
+}
+
+/*
+* loads the cached program for 'srcpath' into 'comp', whose source is 'code'.
+* 'signature' is the current ape_bytecache_signature().
+* returns NULL if there is no usable cache file, leaving 'comp' as it was.
+*/
+ApeAstCompResult* ape_bytecache_load(ApeAstCompiler* comp, const char* srcpath, const char* code, ApeSize clen, uint64_t signature)
+{
+    bool mapped;
+    bool assignable;
+    bool isowned;
+    size_t otherlen;
+    char* othercode;
+    char* name;
+    char* cachepath;
+    const char* str;
+    ApeSize i;
+    ApeSize len;
+    ApeSize dlen;
+    ApeSize index;
+    ApeSize filebase;
+    ApeSize filecount;
+    ApeSize constcount;
+    ApeSize numsymbols;
+    ApeSize numdefinitions;
+    ApeSize maxnumdefinitions;
+    uint64_t hash;
+    uint64_t size;
+    unsigned int kind;
+    ApeSymbolType symtype;
+    ApeUShort* data;
+    ApeObject obj;
+    ApeContext* ctx;
+    ApeBytecacheReader rd;
+    ApeAstCompFile* file;
+    ApeAstCompFile** files;
+    ApeAstCompResult* res;
+    ApeSymTable* symtable;
+    ApeAstBlockScope* topscope;
+    ApeSymbol* symbol;
+    ApeSymbol* copy;
+    ctx = comp->context;
+    res = NULL;
+    files = NULL;
+    data = NULL;
+    dlen = 0;
+    mapped = false;
+    filebase = ape_ptrarray_count(comp->files);
+    cachepath = ape_bytecache_getpath(ctx, srcpath);
+    if(!cachepath)
+    {
+        return NULL;
+    }
+    data = ape_bytecache_mapfile(ctx, cachepath, &dlen, &mapped);
+    ape_allocator_free(&ctx->alloc, cachepath);
+    if(!data || (dlen < APE_BYTECACHE_HEADERSIZE))
+    {
+        goto err;
+    }
+    rd.data = data;
+    rd.length = dlen;
+    rd.pos = 0;
+    rd.failed = false;
+    if(memcmp(ape_bytecache_getbytes(&rd, 4), "APEC", 4) != 0)
+    {
+        goto err;
+    }
+    if(ape_bytecache_getu32(&rd) != APE_BYTECACHE_VERSION)
+    {
+        goto err;
+    }
+    if(ape_bytecache_getu64(&rd) != ape_bytecache_opcodesignature())
+    {
+        goto err;
+    }
+    if(ape_bytecache_getu32(&rd) != ape_bytecache_flags(comp))
+    {
+        goto err;
+    }
+    if(ape_bytecache_getu64(&rd) != signature)
+    {
+        goto err;
+    }
+    if(ape_bytecache_getu64(&rd) != (dlen - APE_BYTECACHE_HEADERSIZE))
+    {
+        goto err;
+    }
+    if(ape_bytecache_getu64(&rd) != ape_util_hashstring(data + APE_BYTECACHE_HEADERSIZE, dlen - APE_BYTECACHE_HEADERSIZE))
+    {
+        goto err;
+    }
+    /* every source file must be unchanged before anything gets created */
+    filecount = ape_bytecache_getvarint(&rd);
+    if(rd.failed || (filecount == 0) || (filecount > dlen))
+    {
+        goto err;
+    }
+    files = (ApeAstCompFile**)ape_allocator_alloc(&ctx->alloc, filecount * sizeof(ApeAstCompFile*));
+    if(!files)
+    {
+        goto err;
+    }
+    for(i = 0; i < filecount; i++)
+    {
+        str = ape_bytecache_getstring(&rd, &len);
+        hash = ape_bytecache_getu64(&rd);
+        size = ape_bytecache_getu64(&rd);
+        if(rd.failed)
+        {
+            goto err;
+        }
+        if(i == 0)
+        {
+            if((size != clen) || (hash != ape_util_hashstring(code, clen)))
+            {
+                goto err;
+            }
+            continue;
+        }
+        name = ape_util_strndup(ctx, str, len);
+        if(!name)
+        {
+            goto err;
+        }
+        othercode = ape_bytecache_readsource(comp, name, &otherlen);
+        ape_allocator_free(&ctx->alloc, name);
+        if(!othercode)
+        {
+            goto err;
+        }
+        if((size != otherlen) || (hash != ape_util_hashstring(othercode, otherlen)))
+        {
+            ape_allocator_free(&ctx->alloc, othercode);
+            goto err;
+        }
+        ape_allocator_free(&ctx->alloc, othercode);
+    }
+    /* second pass: create the files, the first one being the script itself */
+    rd.pos = APE_BYTECACHE_HEADERSIZE;
+    ape_bytecache_getvarint(&rd);
+    for(i = 0; i < filecount; i++)
+    {
+        str = ape_bytecache_getstring(&rd, &len);
+        ape_bytecache_getu64(&rd);
+        size = ape_bytecache_getu64(&rd);
+        name = ape_util_strndup(ctx, (i == 0) ? srcpath : str, (i == 0) ? strlen(srcpath) : len);
+        if(!name)
+        {
+            goto err;
+        }
+        file = ape_make_compfile(ctx, name);
+        ape_allocator_free(&ctx->alloc, name);
+        if(!file)
+        {
+            goto err;
+        }
+        if(!ape_ptrarray_push(comp->files, &file))
+        {
+            ape_compfile_destroy(ctx, file);
+            goto err;
+        }
+        files[i] = file;
+        if(i == 0)
+        {
+            ape_compfile_setondisk(file, clen);
+            if(!ape_compfile_addsource(file, code, clen))
+            {
+                goto err;
+            }
+        }
+        else if(ctx->config.sourcemode != APE_SOURCE_KEEP)
+        {
+            /* the included files were just checked against the cache; read them again only for an error */
+            ape_compfile_setondisk(file, size);
+        }
+        else
+        {
+            othercode = ape_bytecache_readsource(comp, file->path, &otherlen);
+            if(othercode)
+            {
+                ape_compfile_addsource(file, othercode, otherlen);
+                ape_allocator_free(&ctx->alloc, othercode);
+            }
+        }
+    }
+    constcount = ape_bytecache_getvarint(&rd);
+    if(rd.failed || (constcount > dlen))
+    {
+        goto err;
+    }
+    for(i = 0; i < constcount; i++)
+    {
+        kind = ape_bytecache_getu8(&rd);
+        if(kind == APE_BYTECACHE_CONSTSTRING)
+        {
+            str = ape_bytecache_getstring(&rd, &len);
+            if(rd.failed)
+            {
+                goto err;
+            }
+            obj = ape_object_make_stringlen(ctx, str, len);
+            if(ape_object_value_isnull(obj))
+            {
+                goto err;
+            }
+            ape_object_string_gethash(obj);
+        }
+        else if(kind == APE_BYTECACHE_CONSTFUNCTION)
+        {
+            obj = ape_bytecache_getfunction(&rd, ctx, files, filecount);
+            if(ape_object_value_isnull(obj))
+            {
+                goto err;
+            }
+        }
+        else
+        {
+            goto err;
+        }
+        if(ape_compiler_addconstant(comp, obj) < 0)
+        {
+            goto err;
+        }
+    }
+    res = ape_bytecache_getcode(&rd, ctx, files, filecount);
+    if(!res)
+    {
+        goto err;
+    }
+    /* restore the module globals, so that code compiled later on can still refer to them */
+    symtable = ape_compiler_getsymboltable(comp);
+    topscope = ape_symtable_getblockscope(symtable);
+    numsymbols = ape_bytecache_getvarint(&rd);
+    for(i = 0; (i < numsymbols) && !rd.failed; i++)
+    {
+        str = ape_bytecache_getstring(&rd, &len);
+        symtype = (ApeSymbolType)ape_bytecache_getu8(&rd);
+        index = ape_bytecache_getvarint(&rd);
+        assignable = ape_bytecache_getu8(&rd);
+        isowned = ape_bytecache_getu8(&rd);
+        if(rd.failed)
+        {
+            break;
+        }
+        name = ape_util_strndup(ctx, str, len);
+        if(!name)
+        {
+            goto err;
+        }
+        symbol = ape_make_symbol(ctx, name, symtype, index, assignable);
+        ape_allocator_free(&ctx->alloc, name);
+        if(!symbol)
+        {
+            goto err;
+        }
+        if(isowned)
+        {
+            copy = ape_symbol_copy(ctx, symbol);
+            if(!copy || !ape_ptrarray_push(symtable->modglobalsymbols, &copy))
+            {
+                ape_symbol_destroy(ctx, copy);
+                ape_symbol_destroy(ctx, symbol);
+                goto err;
+            }
+        }
+        if(!ape_symtable_setsymbol(symtable, symbol))
+        {
+            ape_symbol_destroy(ctx, symbol);
+            goto err;
+        }
+    }
+    numdefinitions = ape_bytecache_getvarint(&rd);
+    maxnumdefinitions = ape_bytecache_getvarint(&rd);
+    if(rd.failed)
+    {
+        goto err;
+    }
+    topscope->numdefinitions = numdefinitions;
+    if(maxnumdefinitions > symtable->maxnumdefinitions)
+    {
+        symtable->maxnumdefinitions = maxnumdefinitions;
+    }
+    ape_allocator_free(&ctx->alloc, files);
+    ape_bytecache_unmapfile(ctx, data, dlen, mapped);
+    return res;
+err:
+    ape_compresult_destroy(res);
+    ape_valarray_clear(comp->constants);
+    while(ape_ptrarray_count(comp->files) > filebase)
+    {
+        file = (ApeAstCompFile*)ape_ptrarray_pop(comp->files);
+        ape_compfile_destroy(ctx, file);
+    }
+    ape_allocator_free(&ctx->alloc, files);
+    ape_bytecache_unmapfile(ctx, data, dlen, mapped);
+    return NULL;
+}
+
+/*
+* in-process cache of compiled modules, shared by every context in the process.
+*
+* including a module reads, parses and compiles it into the including program. the first time
+* that succeeds, the code it emitted is kept here in the encoding used above, with everything
+* that depends on where it was emitted made relative:
+*
+*   - jump targets in the top-level code count from where the module's code starts
+*   - constant operands index the entry's own constant table
+*   - module global operands count from the first global the module defined
+*
+* replaying an entry appends that code to the including program, adds its files and constants,
+* and defines the modules it contained, just like compiling it again would have.
+*
+* entries are keyed by canonical path and global store layout (ape_modcache_signature), and
+* only replayed while none of their files changed: size and mtime are compared, and the
+* contents rehashed when those differ or cannot be trusted. a module that included one the
+* program had loaded before is not cached, since its code refers to globals outside its own.
+*
+* entry layout:
+*
+*   files      varint count, then per file: string path, u64 mtime, u8 racy, u64 size, u64 hash,
+*              varint number of lines, then each line as a string
+*   modules    varint count, then per module (the included one first): varint file index,
+*              string name, varint number of symbols, then per symbol: string name, varint index
+*   globals    varint number of module globals defined, u8 last opcode
+*   code       the top-level code
+*   constants  varint count, then per constant as in the cache file
+*/
+
+#define APE_MODCACHE_BUCKETS 64
+#define APE_MODCACHE_TARGET 0
+#define APE_MODCACHE_CONSTANT 1
+#define APE_MODCACHE_GLOBAL 2
+
+typedef struct ApeModcacheEntry ApeModcacheEntry;
+typedef struct ApeModcacheScan ApeModcacheScan;
+typedef bool (*ApeModcacheOperandFunc)(ApeModcacheScan* scan, int kind, ApeSize* value);
+
+struct ApeModcacheEntry
+{
+    ApeModcacheEntry* next;
+    char* path;
+    uint64_t signature;
+    /* replays in progress; an entry that was replaced is freed when the last one ends */
+    long refcount;
+    bool detached;
+    ApeSize length;
+    ApeUShort* data;
+};
+
+/* state for rewriting operands while storing or replaying */
+struct ApeModcacheScan
+{
+    ApeAstCompiler* comp;
+    bool toplevel;
+    ApeSize startip;
+    ApeSize endip;
+    ApeSize constbase;
+    ApeSize globalbase;
+    ApeSize numglobals;
+    /* storing: constant index -> local index (or -1), and local index -> constant index */
+    ApeInt* localof;
+    ApeSize* order;
+    ApeSize numlocal;
+    /* replaying: local index -> constant index */
+    ApeSize* actual;
+};
+
+static ApeModcacheEntry* g_modcache_buckets[APE_MODCACHE_BUCKETS];
+
+#if defined(APE_MODCACHE_HAVETHREADS)
+    static pthread_mutex_t g_modcache_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void ape_modcache_lock(void)
+{
+    #if defined(APE_MODCACHE_HAVETHREADS)
+        pthread_mutex_lock(&g_modcache_lock);
+    #endif
+}
+
+static void ape_modcache_unlock(void)
+{
+    #if defined(APE_MODCACHE_HAVETHREADS)
+        pthread_mutex_unlock(&g_modcache_lock);
+    #endif
+}
+
+/* entries outlive any context, so they live on the plain heap */
+static void ape_modcache_freeentry(ApeModcacheEntry* entry)
+{
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
+
+static uint64_t ape_modcache_signature(ApeAstCompiler* comp)
+{
+    uint64_t sig;
+    sig = ape_bytecache_opcodesignature();
+    sig = (sig * 31) + ape_bytecache_flags(comp);
+    sig = (sig * 31) + ape_bytecache_storesignature(comp->globalstore);
+    return sig;
+}
+
+static ApeModcacheEntry* ape_modcache_acquire(const char* path, uint64_t signature)
+{
+    ApeModcacheEntry* entry;
+    ape_modcache_lock();
+    entry = g_modcache_buckets[ape_util_hashstring(path, strlen(path)) % APE_MODCACHE_BUCKETS];
+    while(entry != NULL)
+    {
+        if((entry->signature == signature) && APE_STREQ(entry->path, path))
+        {
+            entry->refcount++;
+            break;
+        }
+        entry = entry->next;
+    }
+    ape_modcache_unlock();
+    return entry;
+}
+
+static void ape_modcache_release(ApeModcacheEntry* entry)
+{
+    bool dofree;
+    ape_modcache_lock();
+    entry->refcount--;
+    dofree = (entry->detached && (entry->refcount == 0));
+    ape_modcache_unlock();
+    if(dofree)
+    {
+        ape_modcache_freeentry(entry);
+    }
+}
+
+/* adds 'entry', replacing the one with the same key, if any */
+static void ape_modcache_insert(ApeModcacheEntry* entry)
+{
+    ApeModcacheEntry* old;
+    ApeModcacheEntry** link;
+    ApeModcacheEntry** bucket;
+    old = NULL;
+    bucket = &g_modcache_buckets[ape_util_hashstring(entry->path, strlen(entry->path)) % APE_MODCACHE_BUCKETS];
+    ape_modcache_lock();
+    link = bucket;
+    while(*link != NULL)
+    {
+        if(((*link)->signature == entry->signature) && APE_STREQ((*link)->path, entry->path))
+        {
+            old = *link;
+            *link = old->next;
+            old->detached = true;
+            if(old->refcount > 0)
+            {
+                old = NULL;
+            }
+            break;
+        }
+        link = &(*link)->next;
+    }
+    entry->next = *bucket;
+    *bucket = entry;
+    ape_modcache_unlock();
+    if(old != NULL)
+    {
+        ape_modcache_freeentry(old);
+    }
+}
+
+/* drops every entry; entries being replayed right now are freed once that is done */
+void ape_modcache_clear(void)
+{
+    ApeSize i;
+    ApeModcacheEntry* entry;
+    ApeModcacheEntry* next;
+    ApeModcacheEntry* unused;
+    unused = NULL;
+    ape_modcache_lock();
+    for(i = 0; i < APE_MODCACHE_BUCKETS; i++)
+    {
+        entry = g_modcache_buckets[i];
+        g_modcache_buckets[i] = NULL;
+        while(entry != NULL)
+        {
+            next = entry->next;
+            entry->detached = true;
+            if(entry->refcount == 0)
+            {
+                entry->next = unused;
+                unused = entry;
+            }
+            entry = next;
+        }
+    }
+    ape_modcache_unlock();
+    while(unused != NULL)
+    {
+        next = unused->next;
+        ape_modcache_freeentry(unused);
+        unused = next;
+    }
+}
+
+/*
+* size and modification time of 'path', if they can be had without reading it.
+* 'racy' is set when the file changed so recently that another change within the same
+* second would go unnoticed.
+*/
+static bool ape_modcache_statfile(const char* path, uint64_t* mtime, uint64_t* size, bool* racy)
+{
+    #if defined(APE_BYTECACHE_HAVEMMAP)
+        struct stat st;
+        if(stat(path, &st) != 0)
+        {
+            return false;
+        }
+        *mtime = (uint64_t)st.st_mtime;
+        *size = (uint64_t)st.st_size;
+        *racy = ((time_t)st.st_mtime >= (time(NULL) - 1));
+        return true;
+    #else
+        (void)path;
+        (void)mtime;
+        (void)size;
+        (void)racy;
+        return false;
+    #endif
+}
+
+/*
+* calls 'fn' on the operand of every instruction in 'code' that is a jump target, a constant
+* or a module global, and writes back what it leaves there.
+* returns false if the code cannot be decoded, 'fn' refuses, or a value outgrows its operand.
+*/
+static bool ape_modcache_walk(ApeModcacheScan* scan, ApeUShort* code, ApeSize count, ApeModcacheOperandFunc fn)
+{
+    int kind;
+    ApeSize i;
+    ApeSize ip;
+    ApeSize len;
+    ApeSize value;
+    ApeOpByte op;
+    ApeOpcodeDef* def;
+    ip = 0;
+    while(ip < count)
+    {
+        op = code[ip];
+        def = ape_vm_opcodefind(op);
+        if(!def)
+        {
+            return false;
+        }
+        len = 1;
+        for(i = 0; i < def->operandcount; i++)
+        {
+            len += def->operandwidths[i];
+        }
+        if(len > (count - ip))
+        {
+            return false;
+        }
+        kind = -1;
+        switch(op)
+        {
+            case APE_OPCODE_JUMP:
+            case APE_OPCODE_JUMPIFFALSE:
+            case APE_OPCODE_JUMPIFTRUE:
+            case APE_OPCODE_SETRECOVER:
+            case APE_OPCODE_FORLOOPPREP:
+            case APE_OPCODE_FORLOOPSTEP:
+            case APE_OPCODE_ITERNEXT:
+                kind = APE_MODCACHE_TARGET;
+                break;
+            case APE_OPCODE_CONSTANT:
+            case APE_OPCODE_MKFUNCTION:
+                kind = APE_MODCACHE_CONSTANT;
+                break;
+            case APE_OPCODE_GETMODULEGLOBAL:
+            case APE_OPCODE_SETMODULEGLOBAL:
+            case APE_OPCODE_DEFMODULEGLOBAL:
+                kind = APE_MODCACHE_GLOBAL;
+                break;
+            default:
+                break;
+        }
+        if(kind >= 0)
+        {
+            /* all of these have a two byte first operand */
+            value = ((ApeSize)code[ip + 1] << 8) | code[ip + 2];
+            if(!fn(scan, kind, &value) || (value > 0xffff))
+            {
+                return false;
+            }
+            code[ip + 1] = (ApeUShort)(value >> 8);
+            code[ip + 2] = (ApeUShort)value;
+        }
+        ip += len;
+    }
+    return true;
+}
+
+/* storing: makes an operand relative, collecting the constants it refers to */
+static bool ape_modcache_makerelative(ApeModcacheScan* scan, int kind, ApeSize* value)
+{
+    ApeObject obj;
+    ApeObjType type;
+    if(kind == APE_MODCACHE_TARGET)
+    {
+        if(!scan->toplevel)
+        {
+            return true;
+        }
+        if((*value < scan->startip) || (*value > scan->endip))
+        {
+            return false;
+        }
+        *value -= scan->startip;
+        return true;
+    }
+    if(kind == APE_MODCACHE_GLOBAL)
+    {
+        /*
+        * globals defined in blocks lie past those counted in numglobals, so only the lower
+        * bound tells the module's own from those of the includer
+        */
+        if(*value < scan->globalbase)
+        {
+            return false;
+        }
+        *value -= scan->globalbase;
+        return true;
+    }
+    if(*value >= ape_valarray_count(scan->comp->constants))
+    {
+        return false;
+    }
+    if(scan->localof[*value] < 0)
+    {
+        obj = *(ApeObject*)ape_valarray_get(scan->comp->constants, *value);
+        type = ape_object_value_type(obj);
+        /* strings are shared with code compiled earlier; functions must be the module's own */
+        if((type != APE_OBJECT_STRING) && ((type != APE_OBJECT_SCRIPTFUNCTION) || (*value < scan->constbase)))
+        {
+            return false;
+        }
+        scan->localof[*value] = scan->numlocal;
+        scan->order[scan->numlocal] = *value;
+        scan->numlocal++;
+    }
+    *value = scan->localof[*value];
+    return true;
+}
+
+/* replaying: the reverse of ape_modcache_makerelative */
+static bool ape_modcache_makeabsolute(ApeModcacheScan* scan, int kind, ApeSize* value)
+{
+    if(kind == APE_MODCACHE_TARGET)
+    {
+        if(scan->toplevel)
+        {
+            *value += scan->startip;
+        }
+        return true;
+    }
+    if(kind == APE_MODCACHE_GLOBAL)
+    {
+        *value += scan->globalbase;
+        return true;
+    }
+    if(*value >= scan->numlocal)
+    {
+        return false;
+    }
+    *value = scan->actual[*value];
+    return true;
+}
+
+/* true if 'file' is one of the module's own files; code positions without a file count as such */
+static bool ape_modcache_ownsfile(ApeAstCompiler* comp, ApeSize filebase, const ApeAstCompFile* file)
+{
+    ApeSize j;
+    if(file == NULL)
+    {
+        return true;
+    }
+    for(j = filebase; j < ape_ptrarray_count(comp->files); j++)
+    {
+        if((const ApeAstCompFile*)ape_ptrarray_get(comp->files, j) == file)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* copies 'src' for rewriting, and makes sure all of 'files' are the module's own */
+static ApeUShort* ape_modcache_copycode(ApeAstCompiler* comp, ApeSize filebase, const ApeUShort* src, const ApeAstCompFile** files, ApeSize filecount, ApeSize count)
+{
+    ApeSize i;
+    ApeUShort* code;
+    for(i = 0; i < filecount; i++)
+    {
+        if(!ape_modcache_ownsfile(comp, filebase, files[i]))
+        {
+            return NULL;
+        }
+    }
+    code = (ApeUShort*)ape_allocator_alloc(&comp->context->alloc, count + 1);
+    if(!code)
+    {
+        return NULL;
+    }
+    memcpy(code, src, count);
+    return code;
+}
+
+/*
+* caches the module that was just compiled into 'comp'.
+* 'startip', 'constbase', 'filebase', 'modulebase' and 'globalbase' are the current ip, the
+* number of constants, files and modules, and the index of the next module global, all as
+* they were right before the module was compiled.
+* failing only means that the module is not cached.
+*/
+bool ape_modcache_store(ApeAstCompiler* comp, ApeSize startip, ApeSize constbase, ApeSize filebase, ApeSize modulebase, ApeSize globalbase)
+{
+    bool ok;
+    bool racy;
+    uint64_t mtime;
+    uint64_t size;
+    ApeSize i;
+    ApeSize j;
+    ApeSize k;
+    ApeSize count;
+    ApeSize numfiles;
+    ApeSize nummodules;
+    ApeSize numconsts;
+    ApeSize* slots;
+    const char* line;
+    const char* modpath;
+    ApeUShort* top;
+    ApeUShort** codes;
+    ApePosition* positions;
+    ApeObject obj;
+    ApeContext* ctx;
+    ApeWriter* payload;
+    ApeModule* module;
+    ApeSymbol* symbol;
+    ApeAstCompFile* file;
+    ApeScriptFunction* fn;
+    ApeAstCompScope* compscope;
+    ApeAstBlockScope* topscope;
+    ApeModcacheScan scan;
+    ApeModcacheEntry* entry;
+    ok = false;
+    ctx = comp->context;
+    top = NULL;
+    codes = NULL;
+    slots = NULL;
+    memset(&scan, 0, sizeof(ApeModcacheScan));
+    payload = ape_make_writer(ctx);
+    compscope = ape_compiler_getcompscope(comp);
+    topscope = ape_symtable_getblockscope(ape_compiler_getsymboltable(comp));
+    numfiles = ape_ptrarray_count(comp->files) - filebase;
+    nummodules = ape_strdict_count(comp->modules) - modulebase;
+    numconsts = ape_valarray_count(comp->constants);
+    count = ape_valarray_count(compscope->bytecode);
+    if(!payload || (numfiles == 0) || (nummodules == 0) || (count < startip))
+    {
+        goto end;
+    }
+    scan.comp = comp;
+    scan.toplevel = true;
+    scan.startip = startip;
+    scan.endip = count;
+    scan.constbase = constbase;
+    scan.globalbase = globalbase;
+    scan.numglobals = (topscope->offset + topscope->numdefinitions) - globalbase;
+    scan.localof = (ApeInt*)ape_allocator_alloc(&ctx->alloc, (numconsts + 1) * sizeof(ApeInt));
+    scan.order = (ApeSize*)ape_allocator_alloc(&ctx->alloc, (numconsts + 1) * sizeof(ApeSize));
+    codes = (ApeUShort**)ape_allocator_alloc(&ctx->alloc, (numconsts + 1) * sizeof(ApeUShort*));
+    slots = (ApeSize*)ape_allocator_alloc(&ctx->alloc, (numfiles + 1) * sizeof(ApeSize));
+    if(!scan.localof || !scan.order || !codes || !slots)
+    {
+        goto end;
+    }
+    for(i = 0; i < numconsts; i++)
+    {
+        scan.localof[i] = -1;
+        codes[i] = NULL;
+    }
+    for(i = 0; i < numfiles; i++)
+    {
+        slots[i] = i + 1;
+    }
+    positions = (ApePosition*)ape_valarray_data(compscope->srcpositions) + startip;
+    for(i = 0; i < (count - startip); i++)
+    {
+        if(((i == 0) || (positions[i].file != positions[i - 1].file)) && !ape_modcache_ownsfile(comp, filebase, positions[i].file))
+        {
+            goto end;
+        }
+    }
+    top = ape_modcache_copycode(comp, filebase, (ApeUShort*)ape_valarray_data(compscope->bytecode) + startip, NULL, 0, count - startip);
+    if(!top || !ape_modcache_walk(&scan, top, count - startip, ape_modcache_makerelative))
+    {
+        goto end;
+    }
+    /* functions refer to further constants; scan.numlocal grows while this runs */
+    scan.toplevel = false;
+    for(k = 0; k < scan.numlocal; k++)
+    {
+        obj = *(ApeObject*)ape_valarray_get(comp->constants, scan.order[k]);
+        if(ape_object_value_type(obj) != APE_OBJECT_SCRIPTFUNCTION)
+        {
+            continue;
+        }
+        fn = &ape_object_value_allocated_data(obj)->valscriptfunc;
+        codes[k] = ape_modcache_copycode(comp, filebase, fn->compiledcode->bytecode, fn->compiledcode->linefiles, fn->compiledcode->linefilecount, fn->compiledcode->count);
+        if(!codes[k] || !ape_modcache_walk(&scan, codes[k], fn->compiledcode->count, ape_modcache_makerelative))
+        {
+            goto end;
+        }
+    }
+    ape_bytecache_putvarint(payload, numfiles);
+    for(i = filebase; i < ape_ptrarray_count(comp->files); i++)
+    {
+        file = (ApeAstCompFile*)ape_ptrarray_get(comp->files, i);
+        if(!file->hassrchash)
+        {
+            goto end;
+        }
+        if(!ape_modcache_statfile(file->path, &mtime, &size, &racy) || (size != file->srcsize))
+        {
+            mtime = 0;
+            racy = true;
+        }
+        ape_bytecache_putstring(payload, file->path, strlen(file->path));
+        ape_bytecache_putu64(payload, mtime);
+        ape_bytecache_putu8(payload, racy);
+        ape_bytecache_putu64(payload, file->srcsize);
+        ape_bytecache_putu64(payload, file->srchash);
+        /* unless sources are kept, a replayed file reads its lines from disk like any other */
+        if(ctx->config.sourcemode != APE_SOURCE_KEEP)
+        {
+            ape_bytecache_putvarint(payload, 0);
+            continue;
+        }
+        ape_bytecache_putvarint(payload, ape_compfile_linecount(file));
+        for(j = 0; j < ape_compfile_linecount(file); j++)
+        {
+            line = ape_compfile_getline(file, j);
+            ape_bytecache_putstring(payload, line, strlen(line));
+        }
+    }
+    /* the module just included was added last */
+    ape_bytecache_putvarint(payload, nummodules);
+    for(k = 0; k < nummodules; k++)
+    {
+        i = (k == 0) ? (ape_strdict_count(comp->modules) - 1) : (modulebase + k - 1);
+        modpath = ape_strdict_getkeyat(comp->modules, i);
+        module = (ApeModule*)ape_strdict_getvalueat(comp->modules, i);
+        for(j = filebase; j < ape_ptrarray_count(comp->files); j++)
+        {
+            file = (ApeAstCompFile*)ape_ptrarray_get(comp->files, j);
+            if(APE_STREQ(file->path, modpath))
+            {
+                break;
+            }
+        }
+        if(j == ape_ptrarray_count(comp->files))
+        {
+            goto end;
+        }
+        ape_bytecache_putvarint(payload, j - filebase);
+        ape_bytecache_putstring(payload, module->name, strlen(module->name));
+        ape_bytecache_putvarint(payload, ape_ptrarray_count(module->modsymbols));
+        for(j = 0; j < ape_ptrarray_count(module->modsymbols); j++)
+        {
+            symbol = (ApeSymbol*)ape_ptrarray_get(module->modsymbols, j);
+            if(symbol->index < globalbase)
+            {
+                goto end;
+            }
+            ape_bytecache_putstring(payload, symbol->name, strlen(symbol->name));
+            ape_bytecache_putvarint(payload, symbol->index - globalbase);
+        }
+    }
+    ape_bytecache_putvarint(payload, scan.numglobals);
+    ape_bytecache_putu8(payload, compscope->lastopcode);
+    ape_bytecache_putcode(payload, comp, filebase, slots, top, positions, count - startip);
+    ape_bytecache_putvarint(payload, scan.numlocal);
+    for(k = 0; k < scan.numlocal; k++)
+    {
+        obj = *(ApeObject*)ape_valarray_get(comp->constants, scan.order[k]);
+        if(ape_object_value_type(obj) == APE_OBJECT_STRING)
+        {
+            ape_bytecache_putu8(payload, APE_BYTECACHE_CONSTSTRING);
+            ape_bytecache_putstring(payload, ape_object_string_getdata(obj), ape_object_string_getlength(obj));
+            continue;
+        }
+        fn = &ape_object_value_allocated_data(obj)->valscriptfunc;
+        ape_bytecache_putu8(payload, APE_BYTECACHE_CONSTFUNCTION);
+        ape_bytecache_putstring(payload, fn->name, strlen(fn->name));
+        ape_bytecache_putvarint(payload, fn->numlocals);
+        ape_bytecache_putvarint(payload, fn->numargs);
+        if(!ape_bytecache_putresult(payload, comp, filebase, slots, codes[k], fn->compiledcode))
+        {
+            goto end;
+        }
+    }
+    if(ape_writer_failed(payload))
+    {
+        goto end;
+    }
+    entry = (ApeModcacheEntry*)malloc(sizeof(ApeModcacheEntry));
+    if(!entry)
+    {
+        goto end;
+    }
+    memset(entry, 0, sizeof(ApeModcacheEntry));
+    file = (ApeAstCompFile*)ape_ptrarray_get(comp->files, filebase);
+    entry->signature = ape_modcache_signature(comp);
+    entry->length = ape_writer_getlength(payload);
+    entry->path = (char*)malloc(strlen(file->path) + 1);
+    entry->data = (ApeUShort*)malloc(entry->length + 1);
+    if(!entry->path || !entry->data)
+    {
+        ape_modcache_freeentry(entry);
+        goto end;
+    }
+    strcpy(entry->path, file->path);
+    memcpy(entry->data, ape_writer_getdata(payload), entry->length);
+    ape_modcache_insert(entry);
+    ok = true;
+end:
+    if(codes != NULL)
+    {
+        for(k = 0; k < scan.numlocal; k++)
+        {
+            ape_allocator_free(&ctx->alloc, codes[k]);
+        }
+    }
+    ape_allocator_free(&ctx->alloc, codes);
+    ape_allocator_free(&ctx->alloc, top);
+    ape_allocator_free(&ctx->alloc, slots);
+    ape_allocator_free(&ctx->alloc, scan.localof);
+    ape_allocator_free(&ctx->alloc, scan.order);
+    ape_writer_destroy(payload);
+    return ok;
+}
+
+/* true if a file recorded in an entry still has the contents it was compiled from */
+static bool ape_modcache_fileunchanged(ApeAstCompiler* comp, const char* path, uint64_t mtime, bool racy, uint64_t size, uint64_t hash)
+{
+    bool nowracy;
+    bool same;
+    size_t clen;
+    char* code;
+    uint64_t nowmtime;
+    uint64_t nowsize;
+    /* other read hooks may not be backed by the file system at all */
+    if(!racy && (comp->config->fileio.fnreadfile == ape_util_default_readfile))
+    {
+        if(ape_modcache_statfile(path, &nowmtime, &nowsize, &nowracy) && (nowmtime == mtime) && (nowsize == size))
+        {
+            return true;
+        }
+    }
+    code = ape_bytecache_readsource(comp, path, &clen);
+    if(!code)
+    {
+        return false;
+    }
+    same = ((clen == size) && (ape_util_hashstring(code, clen) == hash));
+    ape_allocator_free(&comp->context->alloc, code);
+    return same;
+}
+
+/*
+* includes the module at canonical path 'path' from the module cache, if it has a usable
+* entry for it. on a hit, '*outmodule' is the module, already registered in 'comp->modules'.
+* on a miss it is left NULL, and 'comp' is unchanged.
+* returns false only if replaying failed halfway, after 'comp' was changed.
+*/
+/* whether including 'path' could be replayed; ape_modcache_replay still checks the files */
+bool ape_modcache_has(ApeAstCompiler* comp, const char* path)
+{
+    ApeModcacheEntry* entry;
+    if(!comp->config->modulecache || comp->config->dumpast || !comp->config->fileio.fnreadfile)
+    {
+        return false;
+    }
+    entry = ape_modcache_acquire(path, ape_modcache_signature(comp));
+    if(!entry)
+    {
+        return false;
+    }
+    ape_modcache_release(entry);
+    return true;
+}
+
+bool ape_modcache_replay(ApeAstCompiler* comp, const char* path, ApeModule** outmodule)
+{
+    bool ok;
+    bool racy;
+    char* name;
+    char** paths;
+    const char* str;
+    ApeInt pos;
+    ApeSize i;
+    ApeSize j;
+    ApeSize k;
+    ApeSize len;
+    ApeSize linelen;
+    ApeSize index;
+    ApeSize numlines;
+    ApeSize numfiles;
+    ApeSize nummodules;
+    ApeSize numsymbols;
+    ApeSize numconsts;
+    ApeSize fileix;
+    ApeSize codelen;
+    ApeSize filestart;
+    ApeSize modstart;
+    ApeSize codestart;
+    uint64_t mtime;
+    uint64_t size;
+    uint64_t hash;
+    ApeOpByte lastop;
+    ApeObject obj;
+    ApeContext* ctx;
+    ApeBytecacheReader rd;
+    ApeModcacheScan scan;
+    ApeModcacheEntry* entry;
+    ApeAstCompFile* file;
+    ApeAstCompFile** files;
+    ApeAstCompResult* res;
+    ApeAstCompResult** fncodes;
+    ApePosition* positions;
+    ApeAstCompScope* compscope;
+    ApeAstBlockScope* topscope;
+    ApeAstFileScope* fs;
+    ApeModule* module;
+    ApeSymbol* symbol;
+    *outmodule = NULL;
+    if(!comp->config->modulecache || comp->config->dumpast || !comp->config->fileio.fnreadfile)
+    {
+        return true;
+    }
+    entry = ape_modcache_acquire(path, ape_modcache_signature(comp));
+    if(!entry)
+    {
+        return true;
+    }
+    ok = true;
+    ctx = comp->context;
+    paths = NULL;
+    files = NULL;
+    fncodes = NULL;
+    res = NULL;
+    positions = NULL;
+    numfiles = 0;
+    memset(&scan, 0, sizeof(ApeModcacheScan));
+    rd.data = entry->data;
+    rd.length = entry->length;
+    rd.pos = 0;
+    rd.failed = false;
+    compscope = ape_compiler_getcompscope(comp);
+    topscope = ape_symtable_getblockscope(ape_compiler_getsymboltable(comp));
+    /* first, everything that could make this a miss, before 'comp' is touched */
+    numfiles = ape_bytecache_getvarint(&rd);
+    if(rd.failed || (numfiles == 0) || (numfiles > entry->length))
+    {
+        goto end;
+    }
+    paths = (char**)ape_allocator_alloc(&ctx->alloc, numfiles * sizeof(char*));
+    files = (ApeAstCompFile**)ape_allocator_alloc(&ctx->alloc, numfiles * sizeof(ApeAstCompFile*));
+    if(!paths || !files)
+    {
+        goto end;
+    }
+    memset(paths, 0, numfiles * sizeof(char*));
+    filestart = rd.pos;
+    for(i = 0; i < numfiles; i++)
+    {
+        str = ape_bytecache_getstring(&rd, &len);
+        mtime = ape_bytecache_getu64(&rd);
+        racy = ape_bytecache_getu8(&rd);
+        size = ape_bytecache_getu64(&rd);
+        hash = ape_bytecache_getu64(&rd);
+        numlines = ape_bytecache_getvarint(&rd);
+        for(j = 0; (j < numlines) && !rd.failed; j++)
+        {
+            ape_bytecache_getstring(&rd, &linelen);
+        }
+        if(rd.failed)
+        {
+            goto end;
+        }
+        paths[i] = ape_util_strndup(ctx, str, len);
+        if(!paths[i])
+        {
+            goto end;
+        }
+        /* a file that is being compiled right now: let compiling report the cycle */
+        for(j = 0; j < ape_ptrarray_count(comp->filescopes); j++)
+        {
+            fs = (ApeAstFileScope*)ape_ptrarray_get(comp->filescopes, j);
+            if(APE_STREQ(fs->file->path, paths[i]))
+            {
+                goto end;
+            }
+        }
+        if(!ape_modcache_fileunchanged(comp, paths[i], mtime, racy, size, hash))
+        {
+            goto end;
+        }
+    }
+    modstart = rd.pos;
+    nummodules = ape_bytecache_getvarint(&rd);
+    for(k = 0; (k < nummodules) && !rd.failed; k++)
+    {
+        fileix = ape_bytecache_getvarint(&rd);
+        ape_bytecache_getstring(&rd, &len);
+        numsymbols = ape_bytecache_getvarint(&rd);
+        for(j = 0; (j < numsymbols) && !rd.failed; j++)
+        {
+            ape_bytecache_getstring(&rd, &len);
+            ape_bytecache_getvarint(&rd);
+        }
+        if(rd.failed || (fileix >= numfiles))
+        {
+            goto end;
+        }
+        /* a module it included was loaded since: compiling would now reuse that one */
+        if((k > 0) && (ape_strdict_getbyname(comp->modules, paths[fileix]) != NULL))
+        {
+            goto end;
+        }
+    }
+    scan.numglobals = ape_bytecache_getvarint(&rd);
+    lastop = ape_bytecache_getu8(&rd);
+    codestart = rd.pos;
+    codelen = ape_bytecache_getvarint(&rd);
+    scan.startip = ape_valarray_count(compscope->bytecode);
+    scan.globalbase = topscope->offset + topscope->numdefinitions;
+    if(rd.failed || (nummodules == 0) || ((scan.startip + codelen) > 0xffff) || ((scan.globalbase + scan.numglobals) > 0xffff))
+    {
+        goto end;
+    }
+    /* from here on, failing leaves 'comp' half done */
+    ok = false;
+    rd.pos = filestart;
+    for(i = 0; i < numfiles; i++)
+    {
+        ape_bytecache_getstring(&rd, &len);
+        ape_bytecache_getu64(&rd);
+        ape_bytecache_getu8(&rd);
+        size = ape_bytecache_getu64(&rd);
+        hash = ape_bytecache_getu64(&rd);
+        file = ape_make_compfile(ctx, paths[i]);
+        if(!file)
+        {
+            goto end;
+        }
+        if(!ape_ptrarray_push(comp->files, &file))
+        {
+            ape_compfile_destroy(ctx, file);
+            goto end;
+        }
+        files[i] = file;
+        file->hassrchash = true;
+        file->srchash = hash;
+        file->srcsize = size;
+        ape_compfile_setondisk(file, size);
+        numlines = ape_bytecache_getvarint(&rd);
+        for(j = 0; j < numlines; j++)
+        {
+            str = ape_bytecache_getstring(&rd, &len);
+            if(!ape_compfile_addsource(file, str, len))
+            {
+                goto end;
+            }
+        }
+    }
+    rd.pos = codestart;
+    res = ape_bytecache_getcode(&rd, ctx, files, numfiles);
+    if(!res)
+    {
+        goto end;
+    }
+    numconsts = ape_bytecache_getvarint(&rd);
+    if(rd.failed || (numconsts > entry->length))
+    {
+        goto end;
+    }
+    scan.actual = (ApeSize*)ape_allocator_alloc(&ctx->alloc, (numconsts + 1) * sizeof(ApeSize));
+    fncodes = (ApeAstCompResult**)ape_allocator_alloc(&ctx->alloc, (numconsts + 1) * sizeof(ApeAstCompResult*));
+    if(!scan.actual || !fncodes)
+    {
+        goto end;
+    }
+    for(k = 0; k < numconsts; k++)
+    {
+        fncodes[k] = NULL;
+        if(ape_bytecache_getu8(&rd) == APE_BYTECACHE_CONSTSTRING)
+        {
+            str = ape_bytecache_getstring(&rd, &len);
+            name = rd.failed ? NULL : ape_util_strndup(ctx, str, len);
+            if(!name)
+            {
+                goto end;
+            }
+            pos = ape_compiler_addstringconstant(comp, name, len);
+            ape_allocator_free(&ctx->alloc, name);
+        }
+        else
+        {
+            obj = ape_bytecache_getfunction(&rd, ctx, files, numfiles);
+            if(ape_object_value_isnull(obj))
+            {
+                goto end;
+            }
+            fncodes[k] = ape_object_value_allocated_data(obj)->valscriptfunc.compiledcode;
+            pos = ape_compiler_addconstant(comp, obj);
+        }
+        if(pos < 0)
+        {
+            goto end;
+        }
+        scan.actual[k] = pos;
+    }
+    scan.comp = comp;
+    scan.numlocal = numconsts;
+    for(k = 0; k < numconsts; k++)
+    {
+        if((fncodes[k] != NULL) && !ape_modcache_walk(&scan, fncodes[k]->bytecode, fncodes[k]->count, ape_modcache_makeabsolute))
+        {
+            goto end;
+        }
+    }
+    scan.toplevel = true;
+    if(!ape_modcache_walk(&scan, res->bytecode, res->count, ape_modcache_makeabsolute))
+    {
+        goto end;
+    }
+    positions = ape_compresult_getpositions(res);
+    if(!positions)
+    {
+        goto end;
+    }
+    for(i = 0; i < res->count; i++)
+    {
+        if(!ape_valarray_push(compscope->bytecode, &res->bytecode[i]) || !ape_valarray_push(compscope->srcpositions, &positions[i]))
+        {
+            goto end;
+        }
+    }
+    if(res->count > 0)
+    {
+        compscope->lastopcode = lastop;
+    }
+    topscope->numdefinitions += scan.numglobals;
+    /* define the module and those it included, the way compiling them registers them */
+    rd.pos = modstart;
+    ape_bytecache_getvarint(&rd);
+    for(k = 0; k < nummodules; k++)
+    {
+        fileix = ape_bytecache_getvarint(&rd);
+        str = ape_bytecache_getstring(&rd, &len);
+        name = ape_util_strndup(ctx, str, len);
+        if(!name)
+        {
+            goto end;
+        }
+        module = ape_make_module(ctx, name);
+        ape_allocator_free(&ctx->alloc, name);
+        if(!module)
+        {
+            goto end;
+        }
+        numsymbols = ape_bytecache_getvarint(&rd);
+        for(j = 0; j < numsymbols; j++)
+        {
+            str = ape_bytecache_getstring(&rd, &len);
+            index = ape_bytecache_getvarint(&rd);
+            name = ape_util_strndup(ctx, str, len);
+            symbol = (name != NULL) ? ape_make_symbol(ctx, name, APE_SYMBOL_MODULEGLOBAL, scan.globalbase + index, false) : NULL;
+            ape_allocator_free(&ctx->alloc, name);
+            if(!symbol || !ape_ptrarray_push(module->modsymbols, &symbol))
+            {
+                ape_symbol_destroy(ctx, symbol);
+                ape_module_destroy(ctx, module);
+                goto end;
+            }
+        }
+        if(!ape_strdict_set(comp->modules, files[fileix]->path, module))
+        {
+            ape_module_destroy(ctx, module);
+            goto end;
+        }
+        if(k == 0)
+        {
+            *outmodule = module;
+        }
+    }
+    ok = true;
+end:
+    if(paths != NULL)
+    {
+        for(i = 0; i < numfiles; i++)
+        {
+            ape_allocator_free(&ctx->alloc, paths[i]);
+        }
+        ape_allocator_free(&ctx->alloc, paths);
+    }
+    ape_allocator_free(&ctx->alloc, files);
+    ape_allocator_free(&ctx->alloc, fncodes);
+    ape_allocator_free(&ctx->alloc, scan.actual);
+    ape_allocator_free(&ctx->alloc, positions);
+    ape_compresult_destroy(res);
+    ape_modcache_release(entry);
+    return ok;
+}
@@ -1,56 +1,184 @@
 
 #include "inline.h"
 
+#define APE_LEXCLASS_SPACE (1 << 0)
+#define APE_LEXCLASS_LETTER (1 << 1)
+#define APE_LEXCLASS_DIGIT (1 << 2)
+#define APE_LEXCLASS_NUMBER (1 << 3)
+#define APE_LEXCLASS_IDENT (APE_LEXCLASS_LETTER | APE_LEXCLASS_DIGIT)
+
+#define ape_lexer_charis(ch, cls) ((g_lexer_charclass[(unsigned char)(ch)] & (cls)) != 0)
+
+/*
+* character classes, indexed by byte value:
+* space is ' ', '\t', '\n', '\r'; letter is [a-zA-Z_]; digit is [0-9];
+* number is every character ape_lexer_readnumber accepts (digits and ".xXaAbBcCdDeEfF").
+*/
+static const unsigned char g_lexer_charclass[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8, 0,
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 0, 0, 0, 0, 0, 0,
+    0, 10, 10, 10, 10, 10, 10, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 10, 2, 2, 0, 0, 0, 0, 2,
+    0, 10, 10, 10, 10, 10, 10, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 10, 2, 2, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
 static bool ape_lexer_readchar(ApeAstLexer* lex);
 static char ape_lexer_peekchar(ApeAstLexer* lex);
+static void ape_lexer_skipto(ApeAstLexer* lex, ApeSize position);
 static bool ape_lexer_isletter(char ch);
 static bool ape_lexer_isdigit(char ch);
-static bool ape_lexer_isoneof(char ch, const char* allowed, int allowedlen);
 static const char* ape_lexer_readident(ApeAstLexer* lex, int* outlen);
 static const char* ape_lexer_readnumber(ApeAstLexer* lex, int* outlen);
+static ApeSize ape_lexer_scanstring(ApeAstLexer* lex, ApeSize position, char delimiter, bool istemplate);
 static const char* ape_lexer_readstring(ApeAstLexer* lex, char delimiter, bool istemplate, bool* outtemplatefound, int* outlen);
 static void ape_lexer_skipspace(ApeAstLexer* lex);
-static bool ape_lexer_addline(ApeAstLexer* lex, int offset);
+static void ape_lexer_skipcomment(ApeAstLexer* lex);
+
+static bool ape_lexer_iskeyword(const char* ident, ApeSize len, const char* kw, ApeSize kwlen)
+{
+    return (len == kwlen) && (memcmp(ident, kw, len) == 0);
+}
 
+/* keywords are told apart by their first character, then confirmed by length and content */
 static ApeAstTokType ape_lexer_lookupident(const char* ident, ApeSize len)
 {
-    int i;
-    ApeSize kwlen;
-    static struct
+    if(len < 2 || len > 8)
     {
-        const char* value;
-        ApeAstTokType type;
-    } keywords[] = {
-        { "function", TOKEN_KWFUNCTION },
-        { "const", TOKEN_KWCONST },
-        { "var", TOKEN_KWVAR },
-        { "true", TOKEN_KWTRUE },
-        { "false", TOKEN_KWFALSE },
-        { "if", TOKEN_KWIF },
-        { "else", TOKEN_KWELSE },
-        { "return", TOKEN_KWRETURN },
-        { "while", TOKEN_KWWHILE },
-        { "break", TOKEN_KWBREAK },
-        { "for", TOKEN_KWFOR },
-        { "in", TOKEN_KWIN },
-        { "continue", TOKEN_KWCONTINUE },
-        { "null", TOKEN_KWNULL },
-        { "import", TOKEN_KWIMPORT },
-        { "include", TOKEN_KWINCLUDE },
-        { "recover", TOKEN_KWRECOVER },
+        return TOKEN_VALIDENT;
+    }
+    switch(ident[0])
+    {
+        case 'b':
+            {
+                if(ape_lexer_iskeyword(ident, len, "break", 5))
+                {
+                    return TOKEN_KWBREAK;
+                }
+            }
+            break;
+        case 'c':
+            {
+                if(ape_lexer_iskeyword(ident, len, "const", 5))
+                {
+                    return TOKEN_KWCONST;
+                }
+                if(ape_lexer_iskeyword(ident, len, "continue", 8))
+                {
+                    return TOKEN_KWCONTINUE;
+                }
+            }
+            break;
+        case 'e':
+            {
+                if(ape_lexer_iskeyword(ident, len, "else", 4))
+                {
+                    return TOKEN_KWELSE;
+                }
+            }
+            break;
+        case 'f':
+            {
+                if(ape_lexer_iskeyword(ident, len, "for", 3))
+                {
+                    return TOKEN_KWFOR;
+                }
+                if(ape_lexer_iskeyword(ident, len, "false", 5))
+                {
+                    return TOKEN_KWFALSE;
+                }
+                if(ape_lexer_iskeyword(ident, len, "function", 8))
+                {
+                    return TOKEN_KWFUNCTION;
+                }
+            }
+            break;
         #if 0
-        { "global", TOKEN_KWGLOBAL },
+        case 'g':
+            {
+                if(ape_lexer_iskeyword(ident, len, "global", 6))
+                {
+                    return TOKEN_KWGLOBAL;
+                }
+            }
+            break;
         #endif
-        {NULL, (ApeAstTokType)0},
-    };
-
-    for(i = 0; keywords[i].value != NULL; i++)
-    {
-        kwlen = strlen(keywords[i].value);
-        if(kwlen == len && (strncmp(ident, keywords[i].value, len) == 0))
-        {
-            return keywords[i].type;
-        }
+        case 'i':
+            {
+                if(ape_lexer_iskeyword(ident, len, "if", 2))
+                {
+                    return TOKEN_KWIF;
+                }
+                if(ape_lexer_iskeyword(ident, len, "in", 2))
+                {
+                    return TOKEN_KWIN;
+                }
+                if(ape_lexer_iskeyword(ident, len, "import", 6))
+                {
+                    return TOKEN_KWIMPORT;
+                }
+                if(ape_lexer_iskeyword(ident, len, "include", 7))
+                {
+                    return TOKEN_KWINCLUDE;
+                }
+            }
+            break;
+        case 'n':
+            {
+                if(ape_lexer_iskeyword(ident, len, "null", 4))
+                {
+                    return TOKEN_KWNULL;
+                }
+            }
+            break;
+        case 'r':
+            {
+                if(ape_lexer_iskeyword(ident, len, "return", 6))
+                {
+                    return TOKEN_KWRETURN;
+                }
+                if(ape_lexer_iskeyword(ident, len, "recover", 7))
+                {
+                    return TOKEN_KWRECOVER;
+                }
+            }
+            break;
+        case 't':
+            {
+                if(ape_lexer_iskeyword(ident, len, "true", 4))
+                {
+                    return TOKEN_KWTRUE;
+                }
+            }
+            break;
+        case 'v':
+            {
+                if(ape_lexer_iskeyword(ident, len, "var", 3))
+                {
+                    return TOKEN_KWVAR;
+                }
+            }
+            break;
+        case 'w':
+            {
+                if(ape_lexer_iskeyword(ident, len, "while", 5))
+                {
+                    return TOKEN_KWWHILE;
+                }
+            }
+            break;
+        default:
+            break;
     }
     return TOKEN_VALIDENT;
 }
@@ -69,6 +197,7 @@ void ape_lexer_token_init(ApeAstToken* tok, ApeAstTokType type, const char* lite
     tok->toktype = type;
     tok->literal = literal;
     tok->len = len;
+    tok->name = NULL;
 }
 
 char* ape_lexer_tokendupliteral(ApeContext* ctx, const ApeAstToken* tok)
@@ -85,23 +214,19 @@ bool ape_lexer_init(ApeAstLexer* lex, ApeContext* ctx, ApeErrorList* errs, const
     lex->position = 0;
     lex->nextposition = 0;
     lex->ch = '\0';
-    if(file)
-    {
-        lex->line = ape_ptrarray_count(file->lines);
-    }
-    else
-    {
-        lex->line = 0;
-    }
+    lex->line = 0;
     lex->column = -1;
     lex->file = file;
-    bool ok = ape_lexer_addline(lex, 0);
-    if(!ok)
+    if(file)
     {
-        return false;
+        /* record where every line starts up front, so that readchar only has to count them */
+        lex->line = ape_compfile_linecount(file);
+        if(!ape_compfile_addsource(file, input, inlen))
+        {
+            return false;
+        }
     }
-    ok = ape_lexer_readchar(lex);
-    if(!ok)
+    if(!ape_lexer_readchar(lex))
     {
         return false;
     }
@@ -332,11 +457,7 @@ ApeAstToken ape_lexer_internalnexttoken(ApeAstLexer* lex)
                 {
                     if(ape_lexer_peekchar(lex) == '/')
                     {
-                        ape_lexer_readchar(lex);
-                        while(lex->ch != '\n' && lex->ch != '\0')
-                        {
-                            ape_lexer_readchar(lex);
-                        }
+                        ape_lexer_skipcomment(lex);
                         continue;
                     }
                     else if(ape_lexer_peekchar(lex) == '=')
@@ -534,6 +655,10 @@ ApeAstToken ape_lexer_internalnexttoken(ApeAstLexer* lex)
                         identstr = ape_lexer_readident(lex, &identlen);
                         type = ape_lexer_lookupident(identstr, identlen);
                         ape_lexer_token_init(&outtok, type, identstr, identlen);
+                        if(type == TOKEN_VALIDENT)
+                        {
+                            outtok.name = ape_nametable_intern(&lex->context->names, identstr, identlen);
+                        }
                         return outtok;
                     }
                     else if(ape_lexer_isdigit(lex->ch))
@@ -579,7 +704,6 @@ bool ape_lexer_expectcurrent(ApeAstLexer* lex, ApeAstTokType type)
 
 static bool ape_lexer_readchar(ApeAstLexer* lex)
 {
-    bool ok;
     if(lex->nextposition >= lex->inputlen)
     {
         lex->ch = '\0';
@@ -594,12 +718,6 @@ static bool ape_lexer_readchar(ApeAstLexer* lex)
     {
         lex->line++;
         lex->column = -1;
-        ok = ape_lexer_addline(lex, lex->nextposition);
-        if(!ok)
-        {
-            lex->failed = true;
-            return false;
-        }
     }
     else
     {
@@ -617,68 +735,131 @@ static char ape_lexer_peekchar(ApeAstLexer* lex)
     return lex->input[lex->nextposition];
 }
 
+/*
+* moves forward to position. the characters skipped must not contain a newline,
+* but the one landed on may, just as if readchar had stepped onto it.
+*/
+static void ape_lexer_skipto(ApeAstLexer* lex, ApeSize position)
+{
+    if(position == lex->position)
+    {
+        return;
+    }
+    lex->column += position - lex->position;
+    lex->position = position;
+    lex->nextposition = position + 1;
+    if(position >= lex->inputlen)
+    {
+        lex->ch = '\0';
+    }
+    else
+    {
+        lex->ch = lex->input[position];
+    }
+    if(lex->ch == '\n')
+    {
+        lex->line++;
+        lex->column = -1;
+    }
+}
+
 static bool ape_lexer_isletter(char ch)
 {
-    return (
-        (('a' <= ch) && (ch <= 'z')) || (('A' <= ch) && (ch <= 'Z')) || (ch == '_')
-    );
+    return ape_lexer_charis(ch, APE_LEXCLASS_LETTER);
 }
 
 static bool ape_lexer_isdigit(char ch)
 {
-    return ((ch >= '0') && (ch <= '9'));
+    return ape_lexer_charis(ch, APE_LEXCLASS_DIGIT);
 }
 
-static bool ape_lexer_isoneof(char ch, const char* allowed, int allowedlen)
+static const char* ape_lexer_readident(ApeAstLexer* lex, int* outlen)
 {
-    int i;
-    for(i = 0; i < allowedlen; i++)
+    ApeSize i;
+    ApeSize position;
+    const char* input;
+    input = lex->input;
+    position = lex->position;
+    i = position;
+    while(true)
     {
-        if(ch == allowed[i])
+        while((i < lex->inputlen) && ape_lexer_charis(input[i], APE_LEXCLASS_IDENT))
+        {
+            i++;
+        }
+        /* 'mod::name' is a single identifier */
+        if(((i + 1) < lex->inputlen) && (input[i] == ':') && (input[i + 1] == ':'))
         {
-            return true;
+            i += 2;
+            continue;
         }
+        break;
     }
-    return false;
+    ape_lexer_skipto(lex, i);
+    *outlen = i - position;
+    return input + position;
 }
 
-static const char* ape_lexer_readident(ApeAstLexer* lex, int* outlen)
+static const char* ape_lexer_readnumber(ApeAstLexer* lex, int* outlen)
 {
-    int len;
-    int position;
+    ApeSize i;
+    ApeSize position;
     position = lex->position;
-    len = 0;
-    while(ape_lexer_isdigit(lex->ch) || ape_lexer_isletter(lex->ch) || lex->ch == ':')
+    i = position;
+    while((i < lex->inputlen) && ape_lexer_charis(lex->input[i], APE_LEXCLASS_NUMBER))
     {
-        if(lex->ch == ':')
-        {
-            if(ape_lexer_peekchar(lex) != ':')
-            {
-                goto end;
-            }
-            ape_lexer_readchar(lex);
-        }
-        ape_lexer_readchar(lex);
+        i++;
     }
-end:
-    len = lex->position - position;
-    *outlen = len;
+    ape_lexer_skipto(lex, i);
+    *outlen = i - position;
     return lex->input + position;
 }
 
-static const char* ape_lexer_readnumber(ApeAstLexer* lex, int* outlen)
+/*
+* returns the first position at or after position that readstring has to look at:
+* the delimiter, a backslash, a newline, a NUL, or '$' in template strings.
+* plain runs are skipped eight bytes at a time, testing every byte of a word
+* at once with the usual "has a zero byte" trick.
+*/
+static ApeSize ape_lexer_scanstring(ApeAstLexer* lex, ApeSize position, char delimiter, bool istemplate)
 {
-    int len;
-    int position;
-    static const char allowed[] = ".xXaAbBcCdDeEfF";
-    position = lex->position;
-    while(ape_lexer_isdigit(lex->ch) || ape_lexer_isoneof(lex->ch, allowed, APE_ARRAY_LEN(allowed) - 1))
+    char ch;
+    uint64_t word;
+    uint64_t found;
+    const char* input;
+    const uint64_t ones = UINT64_C(0x0101010101010101);
+    const uint64_t highs = UINT64_C(0x8080808080808080);
+    const uint64_t delimmask = ones * (unsigned char)delimiter;
+    const uint64_t backslashmask = ones * (unsigned char)'\\';
+    const uint64_t newlinemask = ones * (unsigned char)'\n';
+    const uint64_t dollarmask = ones * (unsigned char)(istemplate ? '$' : delimiter);
+    input = lex->input;
+    while((position + sizeof(word)) <= lex->inputlen)
     {
-        ape_lexer_readchar(lex);
+        memcpy(&word, input + position, sizeof(word));
+        found = (
+            (((word ^ delimmask) - ones) & ~(word ^ delimmask)) |
+            (((word ^ backslashmask) - ones) & ~(word ^ backslashmask)) |
+            (((word ^ newlinemask) - ones) & ~(word ^ newlinemask)) |
+            (((word ^ dollarmask) - ones) & ~(word ^ dollarmask)) |
+            ((word - ones) & ~word)
+        );
+        if(found & highs)
+        {
+            break;
+        }
+        position += sizeof(word);
     }
-    len = lex->position - position;
-    *outlen = len;
-    return lex->input + position;
+    while(position < lex->inputlen)
+    {
+        ch = input[position];
+        if((ch == delimiter) || (ch == '\\') || (ch == '\n') || (ch == '\0') || (istemplate && (ch == '$')))
+        {
+            break;
+        }
+        position++;
+    }
+    return position;
 }
 
 static const char* ape_lexer_readstring(ApeAstLexer* lex, char delimiter, bool istemplate, bool* outtemplatefound, int* outlen)
@@ -691,6 +872,10 @@ static const char* ape_lexer_readstring(ApeAstLexer* lex, char delimiter, bool i
     position = lex->position;
     while(true)
     {
+        if(!escaped)
+        {
+            ape_lexer_skipto(lex, ape_lexer_scanstring(lex, lex->position, delimiter, istemplate));
+        }
         if(lex->ch == '\0')
         {
             return NULL;
@@ -716,57 +901,50 @@ static const char* ape_lexer_readstring(ApeAstLexer* lex, char delimiter, bool i
     return lex->input + position;
 }
 
-
 static void ape_lexer_skipspace(ApeAstLexer* lex)
 {
-    char ch;
-    ch = lex->ch;
-    while(ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
+    ApeSize i;
+    ApeSize linestart;
+    const char* input;
+    if(!ape_lexer_charis(lex->ch, APE_LEXCLASS_SPACE))
     {
-        ape_lexer_readchar(lex);
-        ch = lex->ch;
+        return;
     }
-}
-
-static bool ape_lexer_addline(ApeAstLexer* lex, int offset)
-{
-    bool ok;
-    size_t linelen;
-    char* line;
-    const char* linestart;
-    const char* newlineptr;
-    if(!lex->file)
+    /* the current character was already counted by readchar */
+    input = lex->input;
+    i = lex->position + 1;
+    linestart = 0;
+    while((i < lex->inputlen) && ape_lexer_charis(input[i], APE_LEXCLASS_SPACE))
     {
-        return true;
+        if(input[i] == '\n')
+        {
+            lex->line++;
+            linestart = i + 1;
+        }
+        i++;
     }
-    if(lex->line < (ApeInt)ape_ptrarray_count(lex->file->lines))
+    if(linestart > 0)
     {
-        return true;
+        /* let skipto count columns from the start of the last line crossed */
+        lex->position = linestart - 1;
+        lex->column = -1;
     }
-    linestart = lex->input + offset;
-    newlineptr = strchr(linestart, '\n');
-    line= NULL;
-    if(!newlineptr)
+    ape_lexer_skipto(lex, i);
+}
+
+/* skips a '//' comment up to, but not including, the newline that ends it */
+static void ape_lexer_skipcomment(ApeAstLexer* lex)
+{
+    ApeSize end;
+    const char* nl;
+    nl = (const char*)memchr(lex->input + lex->position, '\n', lex->inputlen - lex->position);
+    if(nl)
     {
-        line = ape_util_strdup(lex->context, linestart);
+        end = nl - lex->input;
     }
     else
     {
-        linelen = newlineptr - linestart;
-        line = ape_util_strndup(lex->context, linestart, linelen);
-    }
-    if(!line)
-    {
-        lex->failed = true;
-        return false;
-    }
-    ok = ape_ptrarray_push(lex->file->lines, &line);
-    if(!ok)
-    {
-        lex->failed = true;
-        ape_allocator_free(&lex->context->alloc, line);
-        return false;
+        end = lex->inputlen;
     }
-    return true;
+    ape_lexer_skipto(lex, end);
 }
-
@@ -119,7 +119,6 @@ void ape_compiler_destroy(ApeAstCompiler* comp)
 
 bool ape_compiler_compilecode(ApeAstCompiler* comp, const char* code, size_t csize)
 {
-    bool ok;
     ApeAstFileScope* filescope;
     ApePtrArray* statements;
     filescope = (ApeAstFileScope*)ape_ptrarray_top(comp->filescopes);
@@ -130,18 +129,30 @@ bool ape_compiler_compilecode(ApeAstCompiler* comp, const char* code, size_t csi
         /* errors are added by parser */
         return false;
     }
+    return ape_compiler_compileparsed(comp, statements);
+}
+
+/* compiles statements that live in the arena of the current file scope's parser, and releases them */
+bool ape_compiler_compileparsed(ApeAstCompiler* comp, ApePtrArray* statements)
+{
+    bool ok;
+    ApeAstFileScope* filescope;
+    filescope = (ApeAstFileScope*)ape_ptrarray_top(comp->filescopes);
+    APE_ASSERT(filescope);
     if(comp->context->config.dumpast)
     {
         ape_context_dumpast(comp->context, statements);
         if(!comp->context->config.runafterdump)
         {
-            filescope = NULL;
-            ape_ptrarray_destroywithitems(comp->context, statements, (ApeDataCallback)ape_ast_destroy_expr);
+            ape_astarena_release(&filescope->parser->arena);
             return false;
         }
     }
+    /* whatever this file includes gets parsed now, in parallel, while code is still generated in order */
+    ape_prefetch_includes(comp, filescope->file, statements);
     ok = ape_compiler_compilestmtlist(comp, statements);
-    ape_ptrarray_destroywithitems(comp->context, statements, (ApeDataCallback)ape_ast_destroy_expr);
+    /* the whole tree lives in the parser's arena, which can go now that bytecode exists */
+    ape_astarena_release(&filescope->parser->arena);
     return ok;
 }
 
@@ -164,6 +175,8 @@ ApeAstCompResult* ape_compiler_compilesource(ApeAstCompiler* comp, const char* c
     ape_valarray_clear(compscope->srcpositions);
     ape_valarray_clear(compscope->breakipstack);
     ape_valarray_clear(compscope->continueipstack);
+    ape_valarray_clear(compscope->inferloops);
+    ape_valarray_clear(compscope->dupips);
     ok = ape_compiler_initshallowcopy(&compshallowcopy, comp);
     if(!ok)
     {
@@ -178,11 +191,17 @@ ApeAstCompResult* ape_compiler_compilesource(ApeAstCompiler* comp, const char* c
     compscope = ape_compiler_getcompscope(comp);
     APE_ASSERT(compscope->outer == NULL);
     compscope = ape_compiler_getcompscope(comp);
+    ok = ape_optimizer_peephole(comp, compscope);
+    if(!ok)
+    {
+        goto err;
+    }
     res = ape_compscope_orphanresult(compscope);
     if(!res)
     {
         goto err;
     }
+    ape_prefetch_clear(comp);
     ape_compiler_deinit(&compshallowcopy);
     return res;
 err:
@@ -198,40 +217,47 @@ ApeAstCompResult* ape_compiler_compilefile(ApeAstCompiler* comp, const char* pat
     char* code;
     ApeAstCompFile* file;
     ApeAstCompResult* res;
+    ApeFloat tracestart;
     ApeAstFileScope* filescope;
     ApeAstCompFile* prevfile;
     (void)clen;
     code = NULL;
     file = NULL;
     res = NULL;
+    tracestart = 0;
+    if(comp->context->tracer != NULL)
+    {
+        tracestart = ape_util_timermicros();
+    }
     /* todo: read code function */
     if(!comp->config->fileio.fnreadfile)
     {
         ape_errorlist_add(comp->errors, APE_ERROR_COMPILATION, g_ccpriv_srcposinvalid, "file read function not configured");
-        goto err;
+        goto end;
     }
     code = comp->config->fileio.fnreadfile(comp->context, path, -1, &clen);
     if(!code)
     {
         ape_errorlist_addformat(comp->errors, APE_ERROR_COMPILATION, g_ccpriv_srcposinvalid, "reading file '%s' failed", path);
-        goto err;
+        goto end;
     }
     file = ape_make_compfile(comp->context, path);
     if(!file)
     {
-        goto err;
+        goto end;
     }
+    ape_compfile_setondisk(file, clen);
     ok = ape_ptrarray_push(comp->files, &file);
     if(!ok)
     {
         ape_compfile_destroy(comp->context, file);
-        goto err;
+        goto end;
     }
     APE_ASSERT(ape_ptrarray_count(comp->filescopes) == 1);
     filescope = (ApeAstFileScope*)ape_ptrarray_top(comp->filescopes);
     if(!filescope)
     {
-        goto err;
+        goto end;
     }
     /* todo: push file scope instead? */
     prevfile = filescope->file;
@@ -243,17 +269,19 @@ ApeAstCompResult* ape_compiler_compilefile(ApeAstCompiler* comp, const char* pat
         {
             filescope->file = prevfile;
         }
-        goto err;
+        goto end;
     }
     if(filescope)
     {
         filescope->file = prevfile;
     }
+end:
     ape_allocator_free(&comp->context->alloc, code);
+    if(comp->context->tracer != NULL)
+    {
+        ape_tracer_span(comp->context->tracer, "compile", "compilefile", path, tracestart);
+    }
     return res;
-err:
-    ape_allocator_free(&comp->context->alloc, code);
-    return NULL;
 }
 
 bool ape_compiler_init(ApeAstCompiler* comp, ApeContext* ctx, const ApeConfig* cfg, ApeGCMemory* mem, ApeErrorList* el, ApePtrArray* fl, ApeGlobalStore* gs)
@@ -330,6 +358,7 @@ void ape_compiler_deinit(ApeAstCompiler* comp)
     {
         ape_compiler_popcompscope(comp);
     }
+    ape_prefetch_clear(comp);
     ape_strdict_destroywithitems(comp->context, comp->modules);
     ape_valarray_destroy(comp->srcpositionsstack);
     ape_valarray_destroy(comp->constants);
@@ -502,7 +531,7 @@ bool ape_compiler_pushsymtable(ApeAstCompiler* comp, ApeInt globaloffset)
             return false;
         #else
             ApeAstCompFile* file = ape_make_compfile(comp->context, "none");
-            filescope = ape_compiler_makefilescope(comp, file);
+            filescope = ape_compiler_makefilescope(comp, file, NULL);
             ape_ptrarray_push(comp->filescopes, &filescope);
         #endif
     }
@@ -561,6 +590,33 @@ bool ape_compiler_compilestmtlist(ApeAstCompiler* comp, ApePtrArray* statements)
     return ok;
 }
 
+/* the canonical path of the file that 'include modulepath' refers to, from a file in 'dirpath' */
+char* ape_compiler_includepath(ApeAstCompiler* comp, const char* dirpath, const char* modulepath)
+{
+    char* filepath;
+    ApeWriter* filepathbuf;
+    filepathbuf = ape_make_writer(comp->context);
+    if(!filepathbuf)
+    {
+        return NULL;
+    }
+    if(ape_util_isabspath(modulepath))
+    {
+        ape_writer_appendf(filepathbuf, "%s.ape", modulepath);
+    }
+    else
+    {
+        ape_writer_appendf(filepathbuf, "%s%s.ape", dirpath, modulepath);
+    }
+    if(ape_writer_failed(filepathbuf))
+    {
+        ape_writer_destroy(filepathbuf);
+        return NULL;
+    }
+    filepath = ape_util_canonicalisepath(comp->context, ape_writer_getdata(filepathbuf));
+    ape_writer_destroy(filepathbuf);
+    return filepath;
+}
 
 bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includestmt)
 {
@@ -575,18 +631,31 @@ bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includes
     const char* loadedname;
     const char* modulepath;
     const char* module_name;
-    const char* filepathnoncanonicalised;
     ApeAstFileScope* filescope;
-    ApeWriter* filepathbuf;
     ApeSymTable* symtable;
     ApeAstFileScope* fs;
     ApeModule* module;
     ApeSymTable* st;
     ApeSymbol* symbol;
+    ApeAstBlockScope* topscope;
+    ApeSize startip;
+    ApeSize constbase;
+    ApeSize filebase;
+    ApeSize modulebase;
+    ApeSize globalbase;
+    ApeSize reused;
+    ApeFloat tracestart;
+    ApeAstPreparsed* preparsed;
     (void)clen;
+    tracestart = 0;
+    if(comp->context->tracer != NULL)
+    {
+        tracestart = ape_util_timermicros();
+    }
     result = false;
     filepath = NULL;
     code = NULL;
+    preparsed = NULL;
     filescope = (ApeAstFileScope*)ape_ptrarray_top(comp->filescopes);
     modulepath = includestmt->exincludestmt.path;
     module_name = ape_module_getname(modulepath);
@@ -600,29 +669,7 @@ bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includes
             goto end;
         }
     }
-    filepathbuf = ape_make_writer(comp->context);
-    if(!filepathbuf)
-    {
-        result = false;
-        goto end;
-    }
-    if(ape_util_isabspath(modulepath))
-    {
-        ape_writer_appendf(filepathbuf, "%s.ape", modulepath);
-    }
-    else
-    {
-        ape_writer_appendf(filepathbuf, "%s%s.ape", filescope->file->dirpath, modulepath);
-    }
-    if(ape_writer_failed(filepathbuf))
-    {
-        ape_writer_destroy(filepathbuf);
-        result = false;
-        goto end;
-    }
-    filepathnoncanonicalised = ape_writer_getdata(filepathbuf);
-    filepath = ape_util_canonicalisepath(comp->context, filepathnoncanonicalised);
-    ape_writer_destroy(filepathbuf);
+    filepath = ape_compiler_includepath(comp, filescope->file->dirpath, modulepath);
     if(!filepath)
     {
         result = false;
@@ -646,7 +693,25 @@ bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includes
         }
     }
     module = (ApeModule*)ape_strdict_getbyname(comp->modules, filepath);
+    if(module)
+    {
+        comp->reusedmodules++;
+    }
+    else
+    {
+        ok = ape_modcache_replay(comp, filepath, &module);
+        if(!ok)
+        {
+            ape_errorlist_addformat(comp->errors, APE_ERROR_COMPILATION, includestmt->pos, "loading module '%s' from the module cache failed", filepath);
+            result = false;
+            goto end;
+        }
+    }
     if(!module)
+    {
+        preparsed = ape_prefetch_take(comp, filepath);
+    }
+    if(!module && !preparsed)
     {
         /* todo: create new module function */
         if(!comp->config->fileio.fnreadfile)
@@ -663,20 +728,66 @@ bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includes
             result = false;
             goto end;
         }
+    }
+    if(preparsed)
+    {
+        code = preparsed->code;
+        clen = preparsed->codelen;
+        preparsed->code = NULL;
+    }
+    if(!module)
+    {
         module = ape_make_module(comp->context, module_name);
         if(!module)
         {
             result = false;
             goto end;
         }
-        ok = ape_compiler_pushfilescope(comp, filepath);
+        /* where the module's code, constants, files and globals start, for the module cache */
+        startip = ape_compiler_getip(comp);
+        constbase = ape_valarray_count(comp->constants);
+        filebase = ape_ptrarray_count(comp->files);
+        modulebase = ape_strdict_count(comp->modules);
+        reused = comp->reusedmodules;
+        topscope = ape_symtable_getblockscope(symtable);
+        globalbase = topscope->offset + topscope->numdefinitions;
+        if(preparsed)
+        {
+            /* the file and the parser holding its tree become this file scope's */
+            ok = ape_compiler_adoptfilescope(comp, preparsed->file, preparsed->parser);
+            preparsed->file = NULL;
+            preparsed->parser = NULL;
+        }
+        else
+        {
+            ok = ape_compiler_pushfilescope(comp, filepath);
+        }
         if(!ok)
         {
             ape_module_destroy(comp->context, module);
             result = false;
             goto end;
         }
-        ok = ape_compiler_compilecode(comp, code, clen);
+        fs = (ApeAstFileScope*)ape_ptrarray_top(comp->filescopes);
+        ape_compfile_setondisk(fs->file, clen);
+        if(comp->config->modulecache)
+        {
+            fs->file->hassrchash = true;
+            fs->file->srchash = ape_util_hashstring(code, clen);
+            fs->file->srcsize = clen;
+        }
+        if(preparsed)
+        {
+            ok = ape_prefetch_reporterrors(comp, preparsed);
+            if(ok)
+            {
+                ok = ape_compiler_compileparsed(comp, preparsed->statements);
+            }
+        }
+        else
+        {
+            ok = ape_compiler_compilecode(comp, code, clen);
+        }
         if(!ok)
         {
             ape_module_destroy(comp->context, module);
@@ -697,6 +808,10 @@ bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includes
             result = false;
             goto end;
         }
+        if(comp->config->modulecache && !comp->config->dumpast && (comp->reusedmodules == reused))
+        {
+            ape_modcache_store(comp, startip, constbase, filebase, modulebase, globalbase);
+        }
     }
     for(i = 0; i < ape_ptrarray_count(module->modsymbols); i++)
     {
@@ -723,14 +838,137 @@ bool ape_compiler_includemodule(ApeAstCompiler* comp, ApeAstExpression* includes
     }
     result = true;
 end:
+    if(comp->context->tracer != NULL)
+    {
+        ape_tracer_span(comp->context->tracer, "compile", "include", (filepath != NULL) ? filepath : modulepath, tracestart);
+    }
     ape_allocator_free(&comp->context->alloc, filepath);
     ape_allocator_free(&comp->context->alloc, code);
+    ape_prefetch_destroy(comp->context, preparsed);
     return result;
 }
 
+/*
+* emits '<limit>; op body; compare; greater*; jumpiftrue body' for a counted loop.
+* the trailing generic test only runs when the limit turns out not to be a number; op skips it
+* otherwise (see ape_vm_forlooptaillength). returns the ip of op, and that of the jumpiftrue in *jumpip.
+*/
+ApeInt ape_compiler_emitforlooptest(ApeAstCompiler* comp, ApeAstForExpr* forloop, ApeOpByte op, ApeSymbol* counter, ApeAstExpression* limit, int mode, ApeInt bodyip, ApeInt* jumpip)
+{
+    bool ok;
+    ApeInt ip;
+    ApeInt loopip;
+    ok = ape_valarray_push(comp->srcpositionsstack, &forloop->test->pos);
+    if(!ok)
+    {
+        return -1;
+    }
+    loopip = -1;
+    *jumpip = -1;
+    ok = ape_compiler_compileexpression(comp, limit);
+    if(!ok)
+    {
+        goto end;
+    }
+    loopip = ape_compiler_emit(comp, op, 3, make_u64_array((ApeOpByte)bodyip, (ApeOpByte)counter->index, (ApeOpByte)mode));
+    if(loopip < 0)
+    {
+        goto end;
+    }
+    ip = ape_compiler_emit(comp, APE_OPCODE_COMPAREPLAIN, 0, NULL);
+    if(ip >= 0)
+    {
+        ip = ape_compiler_emit(comp, ape_vm_forloopcmpop(mode), 0, NULL);
+    }
+    if(ip >= 0)
+    {
+        ip = ape_compiler_emit(comp, APE_OPCODE_JUMPIFTRUE, 1, make_u64_array((ApeOpByte)bodyip));
+    }
+    *jumpip = ip;
+    if(ip < 0)
+    {
+        loopip = -1;
+    }
+end:
+    ape_valarray_pop(comp->srcpositionsstack);
+    return loopip;
+}
+
+/*
+* emits a counted for-loop recognised by ape_optimizer_countedloop, once its init clause has been compiled:
+*
+*       <limit>; forloopprep body; <generic test>
+*       jump exit                       (break target)
+*       jump cont                       (continue target)
+*   body:
+*       ...
+*   cont:
+*       <limit>; forloopstep body; <generic test>
+*   exit:
+*/
+bool ape_compiler_compilecountedloop(ApeAstCompiler* comp, ApeAstForExpr* forloop, ApeSymbol* counter, ApeAstExpression* limit, int mode)
+{
+    bool ok;
+    ApeInt ip;
+    ApeInt bodyip;
+    ApeInt prepip;
+    ApeInt prepjumpip;
+    ApeInt stepjumpip;
+    ApeInt breakjumpip;
+    ApeInt contjumpip;
+    prepip = ape_compiler_emitforlooptest(comp, forloop, APE_OPCODE_FORLOOPPREP, counter, limit, mode, 0xbeef, &prepjumpip);
+    if(prepip < 0)
+    {
+        return false;
+    }
+    breakjumpip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xdead));
+    if(breakjumpip < 0)
+    {
+        return false;
+    }
+    contjumpip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xbeef));
+    if(contjumpip < 0)
+    {
+        return false;
+    }
+    /* body */
+    bodyip = ape_compiler_getip(comp);
+    ape_compiler_moduint16operand(comp, prepip + 1, bodyip);
+    ape_compiler_moduint16operand(comp, prepjumpip + 1, bodyip);
+    ok = ape_compiler_pushcontip(comp, contjumpip);
+    if(!ok)
+    {
+        return false;
+    }
+    ok = ape_compiler_pushbreakip(comp, breakjumpip);
+    if(!ok)
+    {
+        return false;
+    }
+    ok = ape_compiler_compilecodeblock(comp, forloop->body);
+    if(!ok)
+    {
+        return false;
+    }
+    ape_compiler_popbreakip(comp);
+    ape_compiler_popcontip(comp);
+    /* step and test again */
+    ape_compiler_moduint16operand(comp, contjumpip + 1, ape_compiler_getip(comp));
+    ip = ape_compiler_emitforlooptest(comp, forloop, APE_OPCODE_FORLOOPSTEP, counter, limit, mode, bodyip, &stepjumpip);
+    if(ip < 0)
+    {
+        return false;
+    }
+    ape_compiler_moduint16operand(comp, breakjumpip + 1, ape_compiler_getip(comp));
+    return true;
+}
+
 bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
 {
     bool ok;
+    bool alwaystaken;
+    bool testval;
+    int loopmode;
     ApeInt afteraltip;
     ApeInt afterbodyip;
     ApeInt afterelifip;
@@ -742,6 +980,7 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
     ApeInt breakip;
     ApeInt continueip;
     ApeInt ip;
+    ApeInt iternextip;
     ApeInt jmptoafterbodyip;
     ApeInt jumptoafterbodyip;
     ApeInt jumptoafterrecoverip;
@@ -753,11 +992,13 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
     ApeInt* pos;
     ApeSize i;
     ApeAstCompScope* compscope;
+    ApeAstExpression* limit;
     ApeAstForExpr* forloop;
     ApeAstForeachExpr* foreach;
     ApeAstIfCaseExpr* ifcase;
     ApeAstIfExpr* ifstmt;
     ApeAstRecoverExpr* recover;
+    ApeInferFlow* flow;
     ApeSymTable* symtable;
     ApeSymbol* errorsymbol;
     ApeSymbol* indexsymbol;
@@ -809,6 +1050,8 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 {
                     return false;
                 }
+                ape_optimizer_noteassign(comp, symbol, stmt->exdefine.value->infertype);
+                ape_optimizer_bindconst(comp, symbol, stmt->exdefine.value);
             }
             break;
         case APE_EXPR_IFELSE:
@@ -819,20 +1062,45 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 {
                     goto statementiferror;
                 }
+                ok = ape_optimizer_flowbegin(comp, stmt->arena, false, &flow);
+                if(!ok)
+                {
+                    goto statementiferror;
+                }
+                alwaystaken = false;
                 for(i = 0; i < ape_ptrarray_count(ifstmt->cases); i++)
                 {
                     ifcase = (ApeAstIfCaseExpr*)ape_ptrarray_get(ifstmt->cases, i);
+                    if(ape_optimizer_constcondition(comp, ifcase->test, &testval))
+                    {
+                        if(!testval)
+                        {
+                            /* dead case */
+                            continue;
+                        }
+                        /* this case is always taken, so nothing after it can run */
+                        ok = ape_compiler_compilecodeblock(comp, ifcase->consequence);
+                        if(!ok)
+                        {
+                            goto statementiferror;
+                        }
+                        ape_optimizer_flowbranch(comp, flow);
+                        alwaystaken = true;
+                        break;
+                    }
                     ok = ape_compiler_compileexpression(comp, ifcase->test);
                     if(!ok)
                     {
                         goto statementiferror;
                     }
+                    ape_optimizer_flowmark(flow);
                     nextcasejumpip = ape_compiler_emit(comp, APE_OPCODE_JUMPIFFALSE, 1, make_u64_array((ApeOpByte)(0xbeef)));
                     ok = ape_compiler_compilecodeblock(comp, ifcase->consequence);
                     if(!ok)
                     {
                         goto statementiferror;
                     }
+                    ape_optimizer_flowbranch(comp, flow);
                     /* don't emit jump for the last statement */
                     if(i < (ape_ptrarray_count(ifstmt->cases) - 1) || ifstmt->alternative)
                     {
@@ -846,14 +1114,21 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                     afterelifip = ape_compiler_getip(comp);
                     ape_compiler_moduint16operand(comp, nextcasejumpip + 1, afterelifip);
                 }
-                if(ifstmt->alternative)
+                if(ifstmt->alternative && !alwaystaken)
                 {
                     ok = ape_compiler_compilecodeblock(comp, ifstmt->alternative);
                     if(!ok)
                     {
                         goto statementiferror;
                     }
+                    ape_optimizer_flowbranch(comp, flow);
                 }
+                else if(!alwaystaken)
+                {
+                    /* no case taken */
+                    ape_optimizer_flowbranch(comp, flow);
+                }
+                ape_optimizer_flowend(comp, flow);
                 afteraltip = ape_compiler_getip(comp);
                 for(i = 0; i < ape_valarray_count(jumptoendips); i++)
                 {
@@ -882,6 +1157,15 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                     {
                         return false;
                     }
+                    /*
+                    * `return f(...)`: turn the CALL that was just emitted into a TAILCALL.
+                    * RETURNVALUE is still emitted, since TAILCALL falls back to a regular call
+                    * for native functions and frames with a recover handler.
+                    */
+                    if((stmt->exreturn->extype == APE_EXPR_CALL) && ape_compiler_lastopcodeis(comp, APE_OPCODE_CALL))
+                    {
+                        ape_compiler_modopcode(comp, ape_compiler_getip(comp) - 2, APE_OPCODE_TAILCALL);
+                    }
                     ip = ape_compiler_emit(comp, APE_OPCODE_RETURNVALUE, 0, NULL);
                 }
                 else
@@ -897,6 +1181,16 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
         case APE_EXPR_WHILELOOP:
             {
                 whileloop = &stmt->exwhilestmt;
+                if(ape_optimizer_constcondition(comp, whileloop->test, &testval) && !testval)
+                {
+                    /* while(false): the body can never run */
+                    break;
+                }
+                ok = ape_optimizer_flowbegin(comp, stmt->arena, true, &flow);
+                if(!ok)
+                {
+                    return false;
+                }
                 beforetestip = ape_compiler_getip(comp);
                 ok = ape_compiler_compileexpression(comp, whileloop->test);
                 if(!ok)
@@ -938,6 +1232,7 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 }
                 afterbodyip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, jumptoafterbodyip + 1, afterbodyip);
+                ape_optimizer_flowend(comp, flow);
             }
             break;
         case APE_EXPR_BREAK:
@@ -984,16 +1279,6 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 {
                     return false;
                 }
-                ip = ape_compiler_emit(comp, APE_OPCODE_MKNUMBER, 1, make_u64_array((ApeOpByte)0));
-                if(ip < 0)
-                {
-                    return false;
-                }
-                ok = ape_compiler_writesym(comp, indexsymbol, true);
-                if(!ok)
-                {
-                    return false;
-                }
                 sourcesymbol = NULL;
                 if(foreach->source->extype == APE_EXPR_IDENT)
                 {
@@ -1023,36 +1308,6 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                         return false;
                     }
                 }
-                /* update */
-                jumptoafterupdateip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xbeef));
-                if(jumptoafterupdateip < 0)
-                {
-                    return false;
-                }
-                updateip = ape_compiler_getip(comp);
-                ok = ape_compiler_readsym(comp, indexsymbol);
-                if(!ok)
-                {
-                    return false;
-                }
-                ip = ape_compiler_emit(comp, APE_OPCODE_MKNUMBER, 1, make_u64_array((ApeOpByte)ape_util_floattouint(1)));
-                if(ip < 0)
-                {
-                    return false;
-                }
-                ip = ape_compiler_emit(comp, APE_OPCODE_ADD, 0, NULL);
-                if(ip < 0)
-                {
-                    return false;
-                }
-                ok = ape_compiler_writesym(comp, indexsymbol, false);
-                if(!ok)
-                {
-                    return false;
-                }
-                afterupdateip = ape_compiler_getip(comp);
-                ape_compiler_moduint16operand(comp, jumptoafterupdateip + 1, afterupdateip);
-                /* test */
                 ok = ape_valarray_push(comp->srcpositionsstack, &foreach->source->pos);
                 if(!ok)
                 {
@@ -1063,35 +1318,37 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 {
                     return false;
                 }
-                ip = ape_compiler_emit(comp, APE_OPCODE_LEN, 0, NULL);
+                ip = ape_compiler_emit(comp, APE_OPCODE_ITERINIT, 0, NULL);
                 if(ip < 0)
                 {
                     return false;
                 }
                 ape_valarray_pop(comp->srcpositionsstack);
-                ok = ape_compiler_readsym(comp, indexsymbol);
+                ok = ape_compiler_writesym(comp, indexsymbol, true);
                 if(!ok)
                 {
                     return false;
                 }
-                ip = ape_compiler_emit(comp, APE_OPCODE_COMPAREPLAIN, 0, NULL);
-                if(ip < 0)
+                jumptoafterupdateip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xbeef));
+                if(jumptoafterupdateip < 0)
                 {
                     return false;
                 }
-                ip = ape_compiler_emit(comp, APE_OPCODE_ISEQUAL, 0, NULL);
-                if(ip < 0)
+                jmptoafterbodyip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xdead));
+                if(jmptoafterbodyip < 0)
                 {
                     return false;
                 }
-                aftertestip = ape_compiler_getip(comp);
-                ip = ape_compiler_emit(comp, APE_OPCODE_JUMPIFFALSE, 1, make_u64_array((ApeOpByte)(aftertestip + 6)));
-                if(ip < 0)
+                ok = ape_optimizer_flowbegin(comp, stmt->arena, true, &flow);
+                if(!ok)
                 {
                     return false;
                 }
-                ApeInt jumptoafterbodyip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xdead));
-                if(jumptoafterbodyip < 0)
+                /* next item */
+                updateip = ape_compiler_getip(comp);
+                ape_compiler_moduint16operand(comp, jumptoafterupdateip + 1, updateip);
+                ok = ape_valarray_push(comp->srcpositionsstack, &foreach->source->pos);
+                if(!ok)
                 {
                     return false;
                 }
@@ -1105,8 +1362,14 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 {
                     return false;
                 }
-                ip = ape_compiler_emit(comp, APE_OPCODE_GETVALUEAT, 0, NULL);
-                if(ip < 0)
+                iternextip = ape_compiler_emit(comp, APE_OPCODE_ITERNEXT, 2, make_u64_array((ApeOpByte)0xdead, (ApeOpByte)(foreach->valueiterator != NULL)));
+                if(iternextip < 0)
+                {
+                    return false;
+                }
+                ape_valarray_pop(comp->srcpositionsstack);
+                ok = ape_compiler_writesym(comp, indexsymbol, false);
+                if(!ok)
                 {
                     return false;
                 }
@@ -1120,13 +1383,26 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 {
                     return false;
                 }
+                if(foreach->valueiterator)
+                {
+                    itersymbol = ape_compiler_definesym(comp, foreach->valueiterator->pos, foreach->valueiterator->value, false, false);
+                    if(!itersymbol)
+                    {
+                        return false;
+                    }
+                    ok = ape_compiler_writesym(comp, itersymbol, true);
+                    if(!ok)
+                    {
+                        return false;
+                    }
+                }
                 /* body */
                 ok = ape_compiler_pushcontip(comp, updateip);
                 if(!ok)
                 {
                     return false;
                 }
-                ok = ape_compiler_pushbreakip(comp, jumptoafterbodyip);
+                ok = ape_compiler_pushbreakip(comp, jmptoafterbodyip);
                 if(!ok)
                 {
                     return false;
@@ -1144,7 +1420,9 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                     return false;
                 }
                 afterbodyip = ape_compiler_getip(comp);
-                ape_compiler_moduint16operand(comp, jumptoafterbodyip + 1, afterbodyip);
+                ape_compiler_moduint16operand(comp, jmptoafterbodyip + 1, afterbodyip);
+                ape_compiler_moduint16operand(comp, iternextip + 1, afterbodyip);
+                ape_optimizer_flowend(comp, flow);
                 ape_symtable_popblockscope(symtable);
             }
             break;
@@ -1166,6 +1444,25 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                     {
                         return false;
                     }
+                }
+                ok = ape_optimizer_flowbegin(comp, stmt->arena, true, &flow);
+                if(!ok)
+                {
+                    return false;
+                }
+                if(forloop->init)
+                {
+                    if(ape_optimizer_countedloop(comp, forloop, &symbol, &limit, &loopmode))
+                    {
+                        ok = ape_compiler_compilecountedloop(comp, forloop, symbol, limit, loopmode);
+                        if(!ok)
+                        {
+                            return false;
+                        }
+                        ape_optimizer_flowend(comp, flow);
+                        ape_symtable_popblockscope(symtable);
+                        break;
+                    }
                     jumptoafterupdateip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xbeef));
                     if(jumptoafterupdateip < 0)
                     {
@@ -1245,6 +1542,7 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 }
                 afterbodyip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, jmptoafterbodyip + 1, afterbodyip);
+                ape_optimizer_flowend(comp, flow);
                 ape_symtable_popblockscope(symtable);
             }
             break;
@@ -1292,6 +1590,12 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                 }
                 afterjumptorecoverip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, recoverip + 1, afterjumptorecoverip);
+                ok = ape_optimizer_flowbegin(comp, stmt->arena, false, &flow);
+                if(!ok)
+                {
+                    return false;
+                }
+                ape_optimizer_flowforget(comp, flow);
                 ok = ape_symtable_pushblockscope(symtable);
                 if(!ok)
                 {
@@ -1318,6 +1622,7 @@ bool ape_compiler_compilestatement(ApeAstCompiler* comp, ApeAstExpression* stmt)
                     return false;
                 }
                 ape_symtable_popblockscope(symtable);
+                ape_optimizer_flowend(comp, flow);
                 afterrecoverip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, jumptoafterrecoverip + 1, afterrecoverip);
             }
@@ -1345,7 +1650,6 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
     ApeAstCompResult* compres;
     ApeAstCompScope* compscope;
     ApeAstExpression* argexpr;
-    ApeAstExpression* exproptimized;
     ApeAstExpression* key;
     ApeAstExpression* left;
     ApeAstExpression* right;
@@ -1364,12 +1668,12 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
     ApeInt ip;
     ApeInt numlocals;
     ApeInt pos;
-    ApeInt* currentpos;
-    ApeInt* posval;
     ApeAstLogicalExpr* logi;
     ApeAstLiteralMapExpr* map;
     ApeObject obj;
     ApeOpByte op;
+    ApeOpByte numop;
+    ApeInferFlow* flow;
     ApePtrArray* freesymbols;
     ApeSize i;
     ApeSize len;
@@ -1381,11 +1685,7 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
     ApeAstTernaryExpr* ternary;
     ok = false;
     ip = -1;
-    exproptimized = ape_optimizer_optexpr(expr);
-    if(exproptimized)
-    {
-        expr = exproptimized;
-    }
+    ape_optimizer_optexpr(comp, expr);
     ok = ape_valarray_push(comp->srcpositionsstack, &expr->pos);
     if(!ok)
     {
@@ -1508,6 +1808,20 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                 {
                     goto error;
                 }
+                numop = ape_optimizer_numopcode(comp, expr);
+                if(numop == APE_OPCODE_ADDNUM || numop == APE_OPCODE_SUBNUM || numop == APE_OPCODE_MULNUM || numop == APE_OPCODE_DIVNUM)
+                {
+                    op = numop;
+                }
+                if(numop != APE_OPCODE_NONE && numop != op)
+                {
+                    /* specialised comparison: skips the generic pair below if its guard passes */
+                    ip = ape_compiler_emit(comp, numop, 0, NULL);
+                    if(ip < 0)
+                    {
+                        goto error;
+                    }
+                }
                 switch(expr->exinfix.op)
                 {
                     case APE_OPERATOR_EQUAL:
@@ -1554,36 +1868,10 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
             break;
         case APE_EXPR_LITERALSTRING:
             {
-                pos = 0;
-                currentpos = (ApeInt*)ape_strdict_getbyname(comp->stringconstantspositions, expr->exliteralstring);
-                if(currentpos)
-                {
-                    pos = *currentpos;
-                }
-                else
+                pos = ape_compiler_addstringconstant(comp, expr->exliteralstring, expr->stringlitlength);
+                if(pos < 0)
                 {
-                    obj = ape_object_make_stringlen(comp->context, expr->exliteralstring, expr->stringlitlength);
-                    if(ape_object_value_isnull(obj))
-                    {
-                        goto error;
-                    }
-                    pos = ape_compiler_addconstant(comp, obj);
-                    if(pos < 0)
-                    {
-                        goto error;
-                    }
-                    posval = (ApeInt*)ape_allocator_alloc(&comp->context->alloc, sizeof(ApeInt));
-                    if(!posval)
-                    {
-                        goto error;
-                    }
-                    *posval = pos;
-                    ok = ape_strdict_set(comp->stringconstantspositions, expr->exliteralstring, posval);
-                    if(!ok)
-                    {
-                        ape_allocator_free(&comp->context->alloc, posval);
-                        goto error;
-                    }
+                    goto error;
                 }
                 ip = ape_compiler_emit(comp, APE_OPCODE_CONSTANT, 1, make_u64_array((ApeOpByte)pos));
                 if(ip < 0)
@@ -1785,6 +2073,11 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                         goto error;
                     }
                 }
+                ok = ape_optimizer_peephole(comp, compscope);
+                if(!ok)
+                {
+                    goto error;
+                }
                 freesymbols = symtable->freesymbols;
                 /* because it gets destroyed with compiler_pop_compilation_scope() */
                 symtable->freesymbols = NULL;
@@ -1864,6 +2157,8 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                 }
                 if(assign->ispostfix)
                 {
+                    /* the destination is read here, but it must stay what it is, not a folded constant */
+                    assign->dest->optimized = true;
                     ok = ape_compiler_compileexpression(comp, assign->dest);
                     if(!ok)
                     {
@@ -1880,6 +2175,11 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                 {
                     goto error;
                 }
+                ok = ape_optimizer_notedup(comp, expr, ip);
+                if(!ok)
+                {
+                    goto error;
+                }
                 ok = ape_valarray_push(comp->srcpositionsstack, &assign->dest->pos);
                 if(!ok)
                 {
@@ -1909,6 +2209,7 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                     {
                         goto error;
                     }
+                    ape_optimizer_noteassign(comp, symbol, assign->source->infertype);
                 }
                 else if(assign->dest->extype == APE_EXPR_INDEX)
                 {
@@ -1971,11 +2272,20 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                 {
                     goto error;
                 }
+                ok = ape_optimizer_flowbegin(comp, expr->arena, false, &flow);
+                if(!ok)
+                {
+                    goto error;
+                }
                 ok = ape_compiler_compileexpression(comp, logi->right);
                 if(!ok)
                 {
                     goto error;
                 }
+                /* the right side, or not */
+                ape_optimizer_flowbranch(comp, flow);
+                ape_optimizer_flowbranch(comp, flow);
+                ape_optimizer_flowend(comp, flow);
                 afterrightip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, afterleftjumpip + 1, afterrightip);
             }
@@ -1989,11 +2299,17 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                     goto error;
                 }
                 elsejumpip = ape_compiler_emit(comp, APE_OPCODE_JUMPIFFALSE, 1, make_u64_array((ApeOpByte)0xbeef));
+                ok = ape_optimizer_flowbegin(comp, expr->arena, false, &flow);
+                if(!ok)
+                {
+                    goto error;
+                }
                 ok = ape_compiler_compileexpression(comp, ternary->iftrue);
                 if(!ok)
                 {
                     goto error;
                 }
+                ape_optimizer_flowbranch(comp, flow);
                 endjumpip = ape_compiler_emit(comp, APE_OPCODE_JUMP, 1, make_u64_array((ApeOpByte)0xbeef));
                 elseip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, elsejumpip + 1, elseip);
@@ -2002,6 +2318,8 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
                 {
                     goto error;
                 }
+                ape_optimizer_flowbranch(comp, flow);
+                ape_optimizer_flowend(comp, flow);
                 endip = ape_compiler_getip(comp);
                 ape_compiler_moduint16operand(comp, endjumpip + 1, endip);
             }
@@ -2014,13 +2332,13 @@ bool ape_compiler_compileexpression(ApeAstCompiler* comp, ApeAstExpression* expr
             }
             break;
     }
+    expr->infertype = ape_optimizer_infertype(comp, expr);
     res = true;
     goto end;
 error:
     res = false;
 end:
     ape_valarray_pop(comp->srcpositionsstack);
-    ape_ast_destroy_expr(comp->context, exproptimized);
     return res;
 }
 
@@ -2080,6 +2398,64 @@ ApeInt ape_compiler_addconstant(ApeAstCompiler* comp, ApeObject obj)
     return pos;
 }
 
+/* adds a string constant, or returns the index of an identical one added before */
+ApeInt ape_compiler_addstringconstant(ApeAstCompiler* comp, const char* str, ApeSize len)
+{
+    bool ok;
+    ApeInt pos;
+    ApeInt* posval;
+    ApeInt* currentpos;
+    ApeObject obj;
+    currentpos = (ApeInt*)ape_strdict_getbyname(comp->stringconstantspositions, str);
+    if(currentpos)
+    {
+        return *currentpos;
+    }
+    obj = ape_object_make_stringlen(comp->context, str, len);
+    if(ape_object_value_isnull(obj))
+    {
+        return -1;
+    }
+    /*
+    * string constants are immutable, so hash them right away; this way
+    * field access (`foo.name`) and map lookups never rehash the key at runtime.
+    */
+    ape_object_string_gethash(obj);
+    pos = ape_compiler_addconstant(comp, obj);
+    if(pos < 0)
+    {
+        return -1;
+    }
+    posval = (ApeInt*)ape_allocator_alloc(&comp->context->alloc, sizeof(ApeInt));
+    if(!posval)
+    {
+        return -1;
+    }
+    *posval = pos;
+    ok = ape_strdict_set(comp->stringconstantspositions, str, posval);
+    if(!ok)
+    {
+        ape_allocator_free(&comp->context->alloc, posval);
+        return -1;
+    }
+    return pos;
+}
+
+void ape_compiler_modopcode(ApeAstCompiler* comp, ApeInt ip, ApeOpByte op)
+{
+    ApeUShort byte;
+    ApeValArray* bytecode;
+    bytecode = ape_compiler_getbytecode(comp);
+    if(ip >= (ApeInt)ape_valarray_count(bytecode))
+    {
+        APE_ASSERT(false);
+        return;
+    }
+    byte = (ApeUShort)op;
+    ape_valarray_set(bytecode, ip, &byte);
+    ape_compiler_getcompscope(comp)->lastopcode = op;
+}
+
 void ape_compiler_moduint16operand(ApeAstCompiler* comp, ApeInt ip, ApeOpByte operand)
 {
     ApeUShort hi;
@@ -2260,17 +2636,23 @@ ApeValArray* ape_compiler_getbytecode(ApeAstCompiler* comp)
     return compscope->bytecode;
 }
 
-ApeAstFileScope* ape_compiler_makefilescope(ApeAstCompiler* comp, ApeAstCompFile* file)
+/* 'parser' is taken over when given, otherwise a new one is made */
+ApeAstFileScope* ape_compiler_makefilescope(ApeAstCompiler* comp, ApeAstCompFile* file, ApeAstParser* parser)
 {
     ApeAstFileScope* filescope;
     filescope = (ApeAstFileScope*)ape_allocator_alloc(&comp->context->alloc, sizeof(ApeAstFileScope));
     if(!filescope)
     {
+        ape_parser_destroy(parser);
         return NULL;
     }
     memset(filescope, 0, sizeof(ApeAstFileScope));
     filescope->context = comp->context;
-    filescope->parser = ape_ast_make_parser(comp->context, comp->config, comp->errors);
+    filescope->parser = parser;
+    if(!filescope->parser)
+    {
+        filescope->parser = ape_ast_make_parser(comp->context, comp->config, comp->errors);
+    }
     if(!filescope->parser)
     {
         goto err;
@@ -2303,30 +2685,37 @@ void ape_compiler_destroyfilescope(ApeAstFileScope* scope)
 }
 
 bool ape_compiler_pushfilescope(ApeAstCompiler* comp, const char* filepath)
+{
+    ApeAstCompFile* file;
+    file = ape_make_compfile(comp->context, filepath);
+    if(!file)
+    {
+        return false;
+    }
+    return ape_compiler_adoptfilescope(comp, file, NULL);
+}
+
+/* pushes a file scope for 'file', which is not in comp->files yet, with 'parser' if given */
+bool ape_compiler_adoptfilescope(ApeAstCompiler* comp, ApeAstCompFile* file, ApeAstParser* parser)
 {
     bool ok;
     ApeAstBlockScope* prevsttopscope;
     ApeSymTable* prevst;
     ApeAstFileScope* filescope;
-    ApeAstCompFile* file;
     ApeInt globaloffset;
     prevst = NULL;
     if(ape_ptrarray_count(comp->filescopes) > 0)
     {
         prevst = ape_compiler_getsymboltable(comp);
     }
-    file = ape_make_compfile(comp->context, filepath);
-    if(!file)
-    {
-        return false;
-    }
     ok = ape_ptrarray_push(comp->files, &file);
     if(!ok)
     {
         ape_compfile_destroy(comp->context, file);
+        ape_parser_destroy(parser);
         return false;
     }
-    filescope = ape_compiler_makefilescope(comp, file);
+    filescope = ape_compiler_makefilescope(comp, file, parser);
     if(!filescope)
     {
         return false;
@@ -1,19 +1,68 @@
 
 #include "inline.h"
 
-ApeAstExpression* ape_optimizer_optexpr(ApeAstExpression* expr)
+/*
+* the optimizer simplifies each expression tree once, bottom-up, right before it is compiled.
+* ape_optimizer_optexpr does the operands of a node first, and then the node itself; when it folds,
+* the replacement is copied over the node, so the tree stays intact and the parent sees the result.
+* every node is marked once it is done, so compiling the operands later doesn't walk them again.
+* the ape_optimizer_opt*expr functions fold one node whose operands are done, and return the
+* replacement (made in the node's arena, or one of its operands), or NULL if nothing could be simplified.
+*
+* folding must produce exactly what the vm would have computed, so anything whose result depends
+* on runtime types (operator overloading, null coercion, string/array '+') is left alone.
+*/
+
+static bool ape_optimizer_iscomparison(ApeOperator op)
+{
+    switch(op)
+    {
+        case APE_OPERATOR_LESSTHAN:
+        case APE_OPERATOR_LESSEQUAL:
+        case APE_OPERATOR_GREATERTHAN:
+        case APE_OPERATOR_GREATEREQUAL:
+        case APE_OPERATOR_EQUAL:
+        case APE_OPERATOR_NOTEQUAL:
+            {
+                return true;
+            }
+            break;
+        default:
+            {
+            }
+            break;
+    }
+    return false;
+}
+
+static bool ape_optimizer_isintegral(ApeFloat val)
+{
+    return isfinite(val) && (((ApeFloat)(ApeInt)val) == val);
+}
+
+/* is expr guaranteed to evaluate to a bool? comparisons always do, regardless of overloading. */
+static bool ape_optimizer_isboolexpr(ApeAstExpression* expr)
 {
-    return NULL;
     switch(expr->extype)
     {
+        case APE_EXPR_LITERALBOOL:
+            {
+                return true;
+            }
+            break;
         case APE_EXPR_INFIX:
             {
-                return ape_optimizer_optinfixexpr(expr);
+                return ape_optimizer_iscomparison(expr->exinfix.op);
             }
             break;
         case APE_EXPR_PREFIX:
             {
-                return ape_optimizer_optprefixexpr(expr);
+                return (expr->exprefix.op == APE_OPERATOR_NOT) && ape_optimizer_isboolexpr(expr->exprefix.right);
+            }
+            break;
+        case APE_EXPR_LOGICAL:
+            {
+                return ape_optimizer_isboolexpr(expr->exlogical.left) && ape_optimizer_isboolexpr(expr->exlogical.right);
             }
             break;
         default:
@@ -21,15 +70,128 @@ ApeAstExpression* ape_optimizer_optexpr(ApeAstExpression* expr)
             }
             break;
     }
-    return NULL;
+    return false;
+}
+
+/* is expr guaranteed to evaluate to a number? */
+static bool ape_optimizer_isnumberexpr(ApeAstExpression* expr)
+{
+    switch(expr->extype)
+    {
+        case APE_EXPR_LITERALNUMBER:
+            {
+                return true;
+            }
+            break;
+        case APE_EXPR_PREFIX:
+            {
+                return (expr->exprefix.op == APE_OPERATOR_MINUS) && ape_optimizer_isnumberexpr(expr->exprefix.right);
+            }
+            break;
+        case APE_EXPR_INFIX:
+            {
+                switch(expr->exinfix.op)
+                {
+                    case APE_OPERATOR_PLUS:
+                    case APE_OPERATOR_MINUS:
+                    case APE_OPERATOR_STAR:
+                    case APE_OPERATOR_SLASH:
+                        {
+                            return ape_optimizer_isnumberexpr(expr->exinfix.left) && ape_optimizer_isnumberexpr(expr->exinfix.right);
+                        }
+                        break;
+                    default:
+                        {
+                        }
+                        break;
+                }
+            }
+            break;
+        default:
+            {
+            }
+            break;
+    }
+    return false;
+}
+
+static bool ape_optimizer_isliteral(ApeAstExpression* expr)
+{
+    return (
+        (expr->extype == APE_EXPR_LITERALNUMBER) ||
+        (expr->extype == APE_EXPR_LITERALBOOL) ||
+        (expr->extype == APE_EXPR_LITERALSTRING)
+    );
+}
+
+static ApeAstExpression* ape_optimizer_makenumber(ApeAstArena* arena, ApeFloat val)
+{
+    /* inf and nan are left to the vm, which produces them the same way */
+    if(!isfinite(val))
+    {
+        return NULL;
+    }
+    return ape_ast_make_literalnumberexpr(arena, val);
+}
+
+void ape_optimizer_optexpr(ApeAstCompiler* comp, ApeAstExpression* expr)
+{
+    ApePosition pos;
+    ApeAstExpression* res;
+    if(!comp->config->optimize || expr->optimized)
+    {
+        return;
+    }
+    res = NULL;
+    switch(expr->extype)
+    {
+        case APE_EXPR_INFIX:
+            {
+                res = ape_optimizer_optinfixexpr(comp, expr);
+            }
+            break;
+        case APE_EXPR_PREFIX:
+            {
+                res = ape_optimizer_optprefixexpr(comp, expr);
+            }
+            break;
+        case APE_EXPR_IDENT:
+            {
+                res = ape_optimizer_optidentexpr(comp, expr);
+            }
+            break;
+        case APE_EXPR_LOGICAL:
+            {
+                res = ape_optimizer_optlogicalexpr(comp, expr);
+            }
+            break;
+        case APE_EXPR_TERNARY:
+            {
+                res = ape_optimizer_optternaryexpr(comp, expr);
+            }
+            break;
+        default:
+            {
+            }
+            break;
+    }
+    if(res)
+    {
+        pos = expr->pos;
+        *expr = *res;
+        expr->pos = pos;
+    }
+    expr->optimized = true;
 }
 
-ApeAstExpression* ape_optimizer_optinfixexpr(ApeAstExpression* expr)
+ApeAstExpression* ape_optimizer_optinfixexpr(ApeAstCompiler* comp, ApeAstExpression* expr)
 {
     bool leftisnum;
     bool rightisnum;
     bool leftisstr;
     bool rightisstr;
+    bool bothint;
+    bool streq;
     ApeInt leftint;
     ApeInt rightint;
     ApeSize rtlen;
@@ -37,25 +199,15 @@ ApeAstExpression* ape_optimizer_optinfixexpr(ApeAstExpression* expr)
     const char* leftstr;
     const char* rightstr;
     ApeAstExpression* leftexpr;
-    ApeAstExpression* leftopt;
     ApeAstExpression* rightexpr;
-    ApeAstExpression* rightopt;
     ApeAstExpression* res;
     ApeWriter* buf;
     ApeFloat leftval;
     ApeFloat rightval;
+    ape_optimizer_optexpr(comp, expr->exinfix.left);
+    ape_optimizer_optexpr(comp, expr->exinfix.right);
     leftexpr = expr->exinfix.left;
-    leftopt = ape_optimizer_optexpr(leftexpr);
-    if(leftopt)
-    {
-        leftexpr = leftopt;
-    }
     rightexpr = expr->exinfix.right;
-    rightopt = ape_optimizer_optexpr(rightexpr);
-    if(rightopt)
-    {
-        rightexpr = rightopt;
-    }
     res = NULL;
     leftisnum = leftexpr->extype == APE_EXPR_LITERALNUMBER || leftexpr->extype == APE_EXPR_LITERALBOOL;
     rightisnum = rightexpr->extype == APE_EXPR_LITERALNUMBER || rightexpr->extype == APE_EXPR_LITERALBOOL;
@@ -65,93 +217,122 @@ ApeAstExpression* ape_optimizer_optinfixexpr(ApeAstExpression* expr)
     {
         leftval = leftexpr->extype == APE_EXPR_LITERALNUMBER ? leftexpr->exliteralnumber : leftexpr->exliteralbool;
         rightval = rightexpr->extype == APE_EXPR_LITERALNUMBER ? rightexpr->exliteralnumber : rightexpr->exliteralbool;
-        leftint = (ApeInt)leftval;
-        rightint = (ApeInt)rightval;
+        /* the integer operators only behave sanely on integral numbers; leave the rest to the vm */
+        bothint = (
+            (leftexpr->extype == APE_EXPR_LITERALNUMBER) && (rightexpr->extype == APE_EXPR_LITERALNUMBER) &&
+            ape_optimizer_isintegral(leftval) && ape_optimizer_isintegral(rightval)
+        );
+        leftint = bothint ? (ApeInt)leftval : 0;
+        rightint = bothint ? (ApeInt)rightval : 0;
         switch(expr->exinfix.op)
         {
             case APE_OPERATOR_PLUS:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, leftval + rightval);
+                    res = ape_optimizer_makenumber(expr->arena, leftval + rightval);
                 }
                 break;
             case APE_OPERATOR_MINUS:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, leftval - rightval);
+                    res = ape_optimizer_makenumber(expr->arena, leftval - rightval);
                 }
                 break;
             case APE_OPERATOR_STAR:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, leftval * rightval);
+                    res = ape_optimizer_makenumber(expr->arena, leftval * rightval);
                 }
                 break;
             case APE_OPERATOR_SLASH:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, leftval / rightval);
+                    res = ape_optimizer_makenumber(expr->arena, leftval / rightval);
                 }
                 break;
             case APE_OPERATOR_LESSTHAN:
                 {
-                    res = ape_ast_make_literalboolexpr(expr->context, leftval < rightval);
+                    res = ape_ast_make_literalboolexpr(expr->arena, leftval < rightval);
                 }
                 break;
             case APE_OPERATOR_LESSEQUAL:
                 {
-                    res = ape_ast_make_literalboolexpr(expr->context, leftval <= rightval);
+                    res = ape_ast_make_literalboolexpr(expr->arena, leftval <= rightval);
                 }
                 break;
             case APE_OPERATOR_GREATERTHAN:
                 {
-                    res = ape_ast_make_literalboolexpr(expr->context, leftval > rightval);
+                    res = ape_ast_make_literalboolexpr(expr->arena, leftval > rightval);
                 }
                 break;
             case APE_OPERATOR_GREATEREQUAL:
                 {
-                    res = ape_ast_make_literalboolexpr(expr->context, leftval >= rightval);
+                    res = ape_ast_make_literalboolexpr(expr->arena, leftval >= rightval);
                 }
                 break;
             case APE_OPERATOR_EQUAL:
                 {
-                    res = ape_ast_make_literalboolexpr(expr->context, APE_DBLEQ(leftval, rightval));
+                    res = ape_ast_make_literalboolexpr(expr->arena, (leftval == rightval));
                 }
                 break;
-
             case APE_OPERATOR_NOTEQUAL:
                 {
-                    res = ape_ast_make_literalboolexpr(expr->context, !APE_DBLEQ(leftval, rightval));
+                    res = ape_ast_make_literalboolexpr(expr->arena, (leftval != rightval));
                 }
                 break;
             case APE_OPERATOR_MODULUS:
                 {
-                    #if 0
-                    res = ape_ast_make_literalnumberexpr(expr->context, fmod(leftval, rightval));
-                    #else
-                    res = ape_ast_make_literalnumberexpr(expr->context, (leftint % rightint));
-                    #endif
+                    /* mirrors the vm: fmod for a fractional left side, integer modulus otherwise */
+                    if(leftexpr->extype == APE_EXPR_LITERALNUMBER && rightexpr->extype == APE_EXPR_LITERALNUMBER)
+                    {
+                        if(!ape_optimizer_isintegral(leftval))
+                        {
+                            res = ape_optimizer_makenumber(expr->arena, fmod(leftval, rightval));
+                        }
+                        else if(bothint && (rightint != 0))
+                        {
+                            res = ape_ast_make_literalnumberexpr(expr->arena, (ApeFloat)(leftint % rightint));
+                        }
+                    }
                 }
                 break;
             case APE_OPERATOR_BITAND:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, (ApeFloat)(leftint & rightint));
+                    if(bothint)
+                    {
+                        res = ape_ast_make_literalnumberexpr(expr->arena, (ApeFloat)(leftint & rightint));
+                    }
                 }
                 break;
             case APE_OPERATOR_BITOR:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, (ApeFloat)(leftint | rightint));
+                    if(bothint)
+                    {
+                        res = ape_ast_make_literalnumberexpr(expr->arena, (ApeFloat)(leftint | rightint));
+                    }
                 }
                 break;
             case APE_OPERATOR_BITXOR:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, (ApeFloat)(leftint ^ rightint));
+                    if(bothint)
+                    {
+                        res = ape_ast_make_literalnumberexpr(expr->arena, (ApeFloat)(leftint ^ rightint));
+                    }
                 }
                 break;
             case APE_OPERATOR_LEFTSHIFT:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, (ApeFloat)(leftint << rightint));
+                    /* shifts are done on 32 bits, like in the vm; unsigned, since shifting a negative int left is undefined */
+                    if(bothint)
+                    {
+                        res = ape_ast_make_literalnumberexpr(expr->arena,
+                            (ApeFloat)(int)(ape_util_numbertouint32(leftval) << (ape_util_numbertouint32(rightval) & 0x1F)));
+                    }
                 }
                 break;
             case APE_OPERATOR_RIGHTSHIFT:
                 {
-                    res = ape_ast_make_literalnumberexpr(expr->context, (ApeFloat)(leftint >> rightint));
+                    if(bothint)
+                    {
+                        res = ape_ast_make_literalnumberexpr(expr->arena,
+                            (ApeFloat)(ape_util_numbertoint32(leftval) >> (ape_util_numbertouint32(rightval) & 0x1F)));
+                    }
                 }
                 break;
             default:
@@ -160,54 +341,1305 @@ ApeAstExpression* ape_optimizer_optinfixexpr(ApeAstExpression* expr)
                 break;
         }
     }
-    else if(expr->exinfix.op == APE_OPERATOR_PLUS && leftisstr && rightisstr)
+    else if(leftisstr && rightisstr)
     {
         leftstr = leftexpr->exliteralstring;
         rightstr = rightexpr->exliteralstring;
-        buf = ape_make_writercapacity(expr->context, leftexpr->stringlitlength + rightexpr->stringlitlength + 1);
-        ape_writer_appendlen(buf, leftstr, leftexpr->stringlitlength);
-        ape_writer_appendlen(buf, rightstr, rightexpr->stringlitlength);
-        rtlen = ape_writer_getlength(buf);
-        rtstr = ape_util_strndup(expr->context, ape_writer_getdata(buf), rtlen);
-        res = ape_ast_make_literalstringexpr(expr->context, rtstr, rtlen, true);
-        ape_writer_destroy(buf);
-    }
-    ape_ast_destroy_expr(expr->context, leftopt);
-    ape_ast_destroy_expr(expr->context, rightopt);
-    if(res)
+        if(expr->exinfix.op == APE_OPERATOR_PLUS)
+        {
+            buf = ape_make_writercapacity(expr->context, leftexpr->stringlitlength + rightexpr->stringlitlength + 1);
+            ape_writer_appendlen(buf, leftstr, leftexpr->stringlitlength);
+            ape_writer_appendlen(buf, rightstr, rightexpr->stringlitlength);
+            rtlen = ape_writer_getlength(buf);
+            rtstr = ape_astarena_strndup(expr->arena, ape_writer_getdata(buf), rtlen);
+            res = ape_ast_make_literalstringexpr(expr->arena, rtstr, rtlen, true);
+            ape_writer_destroy(buf);
+        }
+        else if(expr->exinfix.op == APE_OPERATOR_EQUAL || expr->exinfix.op == APE_OPERATOR_NOTEQUAL)
+        {
+            streq = (
+                (leftexpr->stringlitlength == rightexpr->stringlitlength) &&
+                (memcmp(leftstr, rightstr, leftexpr->stringlitlength) == 0)
+            );
+            res = ape_ast_make_literalboolexpr(expr->arena, (expr->exinfix.op == APE_OPERATOR_EQUAL) ? streq : !streq);
+        }
+    }
+    else
     {
-        res->pos = expr->pos;
+        /*
+        * identities. these only hold when the other operand is known to be a number:
+        * null coerces to 0, and strings, arrays and maps may overload the operator.
+        */
+        switch(expr->exinfix.op)
+        {
+            case APE_OPERATOR_PLUS:
+                {
+                    if(rightexpr->extype == APE_EXPR_LITERALNUMBER && rightexpr->exliteralnumber == 0 && ape_optimizer_isnumberexpr(leftexpr))
+                    {
+                        res = leftexpr;
+                    }
+                    else if(leftexpr->extype == APE_EXPR_LITERALNUMBER && leftexpr->exliteralnumber == 0 && ape_optimizer_isnumberexpr(rightexpr))
+                    {
+                        res = rightexpr;
+                    }
+                }
+                break;
+            case APE_OPERATOR_MINUS:
+                {
+                    if(rightexpr->extype == APE_EXPR_LITERALNUMBER && rightexpr->exliteralnumber == 0 && ape_optimizer_isnumberexpr(leftexpr))
+                    {
+                        res = leftexpr;
+                    }
+                }
+                break;
+            case APE_OPERATOR_STAR:
+                {
+                    if(rightexpr->extype == APE_EXPR_LITERALNUMBER && rightexpr->exliteralnumber == 1 && ape_optimizer_isnumberexpr(leftexpr))
+                    {
+                        res = leftexpr;
+                    }
+                    else if(leftexpr->extype == APE_EXPR_LITERALNUMBER && leftexpr->exliteralnumber == 1 && ape_optimizer_isnumberexpr(rightexpr))
+                    {
+                        res = rightexpr;
+                    }
+                }
+                break;
+            case APE_OPERATOR_SLASH:
+                {
+                    if(rightexpr->extype == APE_EXPR_LITERALNUMBER && rightexpr->exliteralnumber == 1 && ape_optimizer_isnumberexpr(leftexpr))
+                    {
+                        res = leftexpr;
+                    }
+                }
+                break;
+            default:
+                {
+                }
+                break;
+        }
     }
     return res;
 }
 
-ApeAstExpression* ape_optimizer_optprefixexpr(ApeAstExpression* expr)
+ApeAstExpression* ape_optimizer_optprefixexpr(ApeAstCompiler* comp, ApeAstExpression* expr)
 {
     ApeAstExpression* rightexpr;
-    ApeAstExpression* rightopt;
     ApeAstExpression* res;
+    ape_optimizer_optexpr(comp, expr->exprefix.right);
     rightexpr = expr->exprefix.right;
-    rightopt = ape_optimizer_optexpr(rightexpr);
-    if(rightopt)
-    {
-        rightexpr = rightopt;
-    }
     res = NULL;
     if(expr->exprefix.op == APE_OPERATOR_MINUS && rightexpr->extype == APE_EXPR_LITERALNUMBER)
     {
-        res = ape_ast_make_literalnumberexpr(expr->context, -rightexpr->exliteralnumber);
+        res = ape_ast_make_literalnumberexpr(expr->arena, -rightexpr->exliteralnumber);
     }
     else if(expr->exprefix.op == APE_OPERATOR_NOT && rightexpr->extype == APE_EXPR_LITERALBOOL)
     {
-        res = ape_ast_make_literalboolexpr(expr->context, !rightexpr->exliteralbool);
+        res = ape_ast_make_literalboolexpr(expr->arena, !rightexpr->exliteralbool);
     }
-    ape_ast_destroy_expr(expr->context, rightopt);
-    if(res)
+    else if(expr->exprefix.op == APE_OPERATOR_NOT && rightexpr->extype == APE_EXPR_LITERALNUMBER)
+    {
+        /* '!' on a number yields a number, not a bool */
+        res = ape_ast_make_literalnumberexpr(expr->arena, !rightexpr->exliteralnumber);
+    }
+    else if(expr->exprefix.op == APE_OPERATOR_BITNOT && rightexpr->extype == APE_EXPR_LITERALNUMBER && ape_optimizer_isintegral(rightexpr->exliteralnumber))
     {
-        res->pos = expr->pos;
+        res = ape_ast_make_literalnumberexpr(expr->arena, (ApeFloat)(~(ApeInt)rightexpr->exliteralnumber));
+    }
+    else if(expr->exprefix.op == APE_OPERATOR_NOT && rightexpr->extype == APE_EXPR_PREFIX && rightexpr->exprefix.op == APE_OPERATOR_NOT)
+    {
+        /* !!x is x, as long as x is a bool already */
+        if(ape_optimizer_isboolexpr(rightexpr->exprefix.right))
+        {
+            res = rightexpr->exprefix.right;
+        }
     }
     return res;
 }
 
+ApeAstExpression* ape_optimizer_optidentexpr(ApeAstCompiler* comp, ApeAstExpression* expr)
+{
+    ApeSymbol* symbol;
+    symbol = ape_symtable_resolve(ape_compiler_getsymboltable(comp), expr->exident->value);
+    if(!symbol || !symbol->constvalue)
+    {
+        return NULL;
+    }
+    return ape_ast_copy_expr(expr->arena, symbol->constvalue);
+}
+
+ApeAstExpression* ape_optimizer_optlogicalexpr(ApeAstCompiler* comp, ApeAstExpression* expr)
+{
+    bool isand;
+    ApeAstExpression* leftexpr;
+    ape_optimizer_optexpr(comp, expr->exlogical.left);
+    ape_optimizer_optexpr(comp, expr->exlogical.right);
+    leftexpr = expr->exlogical.left;
+    /* only bools are folded here; the truthiness of other literals is decided by the vm */
+    if(leftexpr->extype != APE_EXPR_LITERALBOOL)
+    {
+        return NULL;
+    }
+    isand = expr->exlogical.op == APE_OPERATOR_LOGICALAND;
+    if(leftexpr->exliteralbool == isand)
+    {
+        /* 'true && x', 'false || x': the result is x */
+        return expr->exlogical.right;
+    }
+    return ape_ast_make_literalboolexpr(expr->arena, leftexpr->exliteralbool);
+}
+
+ApeAstExpression* ape_optimizer_optternaryexpr(ApeAstCompiler* comp, ApeAstExpression* expr)
+{
+    bool testval;
+    ApeAstExpression* branch;
+    if(!ape_optimizer_constcondition(comp, expr->externary.test, &testval))
+    {
+        return NULL;
+    }
+    branch = testval ? expr->externary.iftrue : expr->externary.iffalse;
+    ape_optimizer_optexpr(comp, branch);
+    return branch;
+}
+
+/*
+* does this condition always evaluate to the same bool? used to drop dead if/while bodies.
+*/
+bool ape_optimizer_constcondition(ApeAstCompiler* comp, ApeAstExpression* expr, bool* outval)
+{
+    ape_optimizer_optexpr(comp, expr);
+    if(expr->extype != APE_EXPR_LITERALBOOL)
+    {
+        return false;
+    }
+    *outval = expr->exliteralbool;
+    return true;
+}
+
+/*
+* remembers the value of a `const` module global if it folds to a literal, so that reads of it
+* are compiled as that literal. the global itself is still defined, for other modules and for
+* code compiled with the optimizer off.
+*/
+void ape_optimizer_bindconst(ApeAstCompiler* comp, ApeSymbol* symbol, ApeAstExpression* value)
+{
+    /* the repl allows redefining symbols, which would leave stale values in compiled code */
+    if(!comp->config->optimize || comp->config->replmode)
+    {
+        return;
+    }
+    if(symbol->assignable || symbol->symtype != APE_SYMBOL_MODULEGLOBAL || symbol->constvalue)
+    {
+        return;
+    }
+    ape_optimizer_optexpr(comp, value);
+    /* the symbol outlives the parse arena, so its value is copied onto the heap */
+    if(ape_optimizer_isliteral(value))
+    {
+        symbol->constvalue = ape_ast_copy_expr(&comp->context->astheap, value);
+    }
+}
+
+/*
+* bytecode peephole pass, run over a finished compilation scope right before it is orphaned.
+* it threads jumps through unconditional jumps and removes a few redundant sequences:
+*
+*   jump L; L:                      ->  (removed)
+*   jumpiffalse L; jump M; L:       ->  jumpiftrue M
+*   jumpiftrue L; jump M; L:        ->  jumpiffalse M
+*   {null,true,false,constant,number,dup}; pop  ->  (removed), only inside functions
+*   dup; set n; pop                 ->  set n, only inside functions, see below
+*   code after jump/return that no jump lands on  ->  (removed)
+*
+* a pop at the top level is kept, since it sets the vm's lastpopped, which is what eval(),
+* ape_context_executesource and the repl return. dup copies (flatly) what it duplicates, so
+* 'dup; set n; pop' is only folded where the compiler inferred that the value is a number or a
+* bool (ape_optimizer_notedup). assignments of anything else, or of values of unknown type (say,
+* a parameter, or a local assigned in a loop that also gives it a different type), keep their dup,
+* and so do assignments at the top level and to an index.
+*
+* removed instructions are dropped together with their srcpositions, and every jump target
+* is relocated through a table mapping old offsets to new ones.
+*/
+
+static bool ape_optimizer_isjumpop(ApeOpByte op)
+{
+    return (op == APE_OPCODE_JUMP) || (op == APE_OPCODE_JUMPIFFALSE) || (op == APE_OPCODE_JUMPIFTRUE);
+}
+
+static bool ape_optimizer_hastarget(ApeOpByte op)
+{
+    return (
+        ape_optimizer_isjumpop(op) || (op == APE_OPCODE_SETRECOVER) ||
+        (op == APE_OPCODE_FORLOOPPREP) || (op == APE_OPCODE_FORLOOPSTEP) || (op == APE_OPCODE_ITERNEXT)
+    );
+}
+
+static ApeInt ape_optimizer_readtarget(ApeUShort* code, ApeInt ip)
+{
+    return (code[ip + 1] << 8) | code[ip + 2];
+}
+
+static void ape_optimizer_writetarget(ApeUShort* code, ApeInt ip, ApeInt target)
+{
+    code[ip + 1] = (ApeUShort)(target >> 8);
+    code[ip + 2] = (ApeUShort)(target);
+}
+
+static bool ape_optimizer_issetop(ApeOpByte op)
+{
+    return (op == APE_OPCODE_SETLOCAL) || (op == APE_OPCODE_SETMODULEGLOBAL) || (op == APE_OPCODE_SETFREE);
+}
 
+/* where the generic test after FORLOOP_PREP/FORLOOP_STEP at ip ends; the loop mode is their last operand */
+static ApeInt ape_optimizer_forlooptailend(ApeUShort* code, ApeInt ip)
+{
+    ApeInt ilen;
+    ilen = ape_vm_opcodelength(code[ip]);
+    return ip + ilen + ape_vm_forlooptaillength(code[ip + ilen - 1]);
+}
 
+/* returns -1 on failure, 0 if nothing changed, 1 if the bytecode was rewritten */
+static int ape_optimizer_peepholepass(ApeAstCompiler* comp, ApeAstCompScope* scope)
+{
+    int res;
+    bool changed;
+    bool toplevel;
+    bool unreachable;
+    ApeInt i;
+    ApeInt ip;
+    ApeInt len;
+    ApeInt hops;
+    ApeInt next;
+    ApeInt target;
+    ApeInt newlen;
+    ApeInt ninstr;
+    ApeInt ilen;
+    ApeOpByte op;
+    ApeOpByte nextop;
+    ApeUShort* code;
+    ApeUShort* newcode;
+    ApePosition* positions;
+    ApePosition* newpositions;
+    ApeInt* starts;
+    ApeInt* instrat;
+    ApeInt* newoffsets;
+    bool* istarget;
+    bool* removed;
+    bool* flatdup;
+    ApeContext* ctx;
+    ctx = comp->context;
+    code = (ApeUShort*)ape_valarray_data(scope->bytecode);
+    positions = (ApePosition*)ape_valarray_data(scope->srcpositions);
+    len = ape_valarray_count(scope->bytecode);
+    if(len == 0 || (ApeInt)ape_valarray_count(scope->srcpositions) != len)
+    {
+        return 0;
+    }
+    res = -1;
+    changed = false;
+    newcode = NULL;
+    newpositions = NULL;
+    starts = (ApeInt*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeInt) * (len + 1));
+    instrat = (ApeInt*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeInt) * (len + 1));
+    newoffsets = (ApeInt*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeInt) * (len + 1));
+    istarget = (bool*)ape_allocator_alloc(&ctx->alloc, sizeof(bool) * (len + 1));
+    removed = (bool*)ape_allocator_alloc(&ctx->alloc, sizeof(bool) * (len + 1));
+    flatdup = (bool*)ape_allocator_alloc(&ctx->alloc, sizeof(bool) * (len + 1));
+    if(!starts || !instrat || !newoffsets || !istarget || !removed || !flatdup)
+    {
+        goto end;
+    }
+    memset(istarget, 0, sizeof(bool) * (len + 1));
+    memset(removed, 0, sizeof(bool) * (len + 1));
+    memset(flatdup, 0, sizeof(bool) * (len + 1));
+    for(ip = 0; ip <= len; ip++)
+    {
+        instrat[ip] = -1;
+    }
+    /* decode. anything unexpected leaves the bytecode alone. */
+    res = 0;
+    ninstr = 0;
+    for(ip = 0; ip < len; ip += ilen)
+    {
+        ilen = ape_vm_opcodelength(code[ip]);
+        if(ilen == 0 || (ip + ilen) > len)
+        {
+            goto end;
+        }
+        instrat[ip] = ninstr;
+        starts[ninstr] = ip;
+        ninstr++;
+    }
+    starts[ninstr] = len;
+    instrat[len] = ninstr;
+    for(i = 0; i < ninstr; i++)
+    {
+        if(ape_optimizer_hastarget(code[starts[i]]))
+        {
+            target = ape_optimizer_readtarget(code, starts[i]);
+            if(target > len || instrat[target] < 0)
+            {
+                goto end;
+            }
+        }
+        if(code[starts[i]] == APE_OPCODE_FORLOOPPREP || code[starts[i]] == APE_OPCODE_FORLOOPSTEP)
+        {
+            target = ape_optimizer_forlooptailend(code, starts[i]);
+            if(target > len || instrat[target] < 0)
+            {
+                goto end;
+            }
+        }
+    }
+    /* thread jumps that land on unconditional jumps */
+    for(i = 0; i < ninstr; i++)
+    {
+        ip = starts[i];
+        if(!ape_optimizer_isjumpop(code[ip]))
+        {
+            continue;
+        }
+        target = ape_optimizer_readtarget(code, ip);
+        hops = 0;
+        while(target < len && code[target] == APE_OPCODE_JUMP && hops < APE_CONF_CONST_PEEPHOLE_MAXHOPS)
+        {
+            next = ape_optimizer_readtarget(code, target);
+            if(next == target)
+            {
+                break;
+            }
+            target = next;
+            hops++;
+        }
+        if(hops > 0)
+        {
+            ape_optimizer_writetarget(code, ip, target);
+            changed = true;
+        }
+    }
+    for(i = 0; i < ninstr; i++)
+    {
+        if(ape_optimizer_hastarget(code[starts[i]]))
+        {
+            istarget[instrat[ape_optimizer_readtarget(code, starts[i])]] = true;
+        }
+    }
+    /* the noted dups are offsets into the code as the compiler emitted it, so only the first pass sees them */
+    for(i = 0; i < (ApeInt)ape_valarray_count(scope->dupips); i++)
+    {
+        ip = *(ApeInt*)ape_valarray_get(scope->dupips, i);
+        if(ip < len && instrat[ip] >= 0 && code[ip] == APE_OPCODE_DUP)
+        {
+            flatdup[instrat[ip]] = true;
+        }
+    }
+    ape_valarray_clear(scope->dupips);
+    /* rewrite sequences. 'removed' is indexed by instruction */
+    toplevel = (scope->outer == NULL);
+    unreachable = false;
+    for(i = 0; i < ninstr; i++)
+    {
+        ip = starts[i];
+        op = code[ip];
+        nextop = (i + 1 < ninstr) ? code[starts[i + 1]] : APE_OPCODE_NONE;
+        if(unreachable && !istarget[i])
+        {
+            removed[i] = true;
+            continue;
+        }
+        unreachable = false;
+        if(op == APE_OPCODE_FORLOOPPREP || op == APE_OPCODE_FORLOOPSTEP)
+        {
+            /* the vm skips the generic test after these by its length, so leave it as it is */
+            target = ape_optimizer_forlooptailend(code, ip);
+            while((i + 1) < ninstr && starts[i + 1] < target)
+            {
+                i++;
+            }
+        }
+        else if(op == APE_OPCODE_JUMP && ape_optimizer_readtarget(code, ip) == starts[i + 1])
+        {
+            removed[i] = true;
+        }
+        else if(op == APE_OPCODE_JUMP || op == APE_OPCODE_RETURNVALUE || op == APE_OPCODE_RETURNNOTHING)
+        {
+            /* nothing falls through these, so whatever follows is dead until the next jump target */
+            unreachable = true;
+        }
+        else if((op == APE_OPCODE_JUMPIFFALSE || op == APE_OPCODE_JUMPIFTRUE) && nextop == APE_OPCODE_JUMP
+            && !istarget[i + 1] && ape_optimizer_readtarget(code, ip) == starts[i + 2])
+        {
+            code[ip] = (op == APE_OPCODE_JUMPIFFALSE) ? APE_OPCODE_JUMPIFTRUE : APE_OPCODE_JUMPIFFALSE;
+            ape_optimizer_writetarget(code, ip, ape_optimizer_readtarget(code, starts[i + 1]));
+            removed[i + 1] = true;
+            i++;
+        }
+        else if(!toplevel && nextop == APE_OPCODE_POP && !istarget[i + 1] && (
+            op == APE_OPCODE_NULL || op == APE_OPCODE_TRUE || op == APE_OPCODE_FALSE ||
+            op == APE_OPCODE_CONSTANT || op == APE_OPCODE_MKNUMBER || op == APE_OPCODE_DUP))
+        {
+            removed[i] = true;
+            removed[i + 1] = true;
+            i++;
+        }
+        else if(!toplevel && op == APE_OPCODE_DUP && flatdup[i] && (i + 2) < ninstr && ape_optimizer_issetop(nextop)
+            && code[starts[i + 2]] == APE_OPCODE_POP && !istarget[i + 1] && !istarget[i + 2])
+        {
+            removed[i] = true;
+            removed[i + 2] = true;
+            i += 2;
+        }
+    }
+    /* relocation table: a removed instruction maps to whatever follows it */
+    newlen = 0;
+    for(i = 0; i < ninstr; i++)
+    {
+        newoffsets[i] = newlen;
+        if(!removed[i])
+        {
+            newlen += starts[i + 1] - starts[i];
+        }
+    }
+    newoffsets[ninstr] = newlen;
+    if(newlen == len)
+    {
+        res = changed ? 1 : 0;
+        goto end;
+    }
+    res = -1;
+    newcode = (ApeUShort*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeUShort) * newlen);
+    newpositions = (ApePosition*)ape_allocator_alloc(&ctx->alloc, sizeof(ApePosition) * newlen);
+    if(!newcode || !newpositions)
+    {
+        goto end;
+    }
+    for(i = 0; i < ninstr; i++)
+    {
+        if(removed[i])
+        {
+            continue;
+        }
+        ip = starts[i];
+        ilen = starts[i + 1] - ip;
+        memcpy(newcode + newoffsets[i], code + ip, sizeof(ApeUShort) * ilen);
+        memcpy(newpositions + newoffsets[i], positions + ip, sizeof(ApePosition) * ilen);
+        if(ape_optimizer_hastarget(code[ip]))
+        {
+            target = newoffsets[instrat[ape_optimizer_readtarget(code, ip)]];
+            ape_optimizer_writetarget(newcode, newoffsets[i], target);
+        }
+    }
+    ape_valarray_clear(scope->bytecode);
+    ape_valarray_clear(scope->srcpositions);
+    for(ip = 0; ip < newlen; ip++)
+    {
+        if(!ape_valarray_push(scope->bytecode, &newcode[ip]) || !ape_valarray_push(scope->srcpositions, &newpositions[ip]))
+        {
+            goto end;
+        }
+    }
+    res = 1;
+end:
+    ape_allocator_free(&ctx->alloc, starts);
+    ape_allocator_free(&ctx->alloc, instrat);
+    ape_allocator_free(&ctx->alloc, newoffsets);
+    ape_allocator_free(&ctx->alloc, istarget);
+    ape_allocator_free(&ctx->alloc, removed);
+    ape_allocator_free(&ctx->alloc, flatdup);
+    ape_allocator_free(&ctx->alloc, newcode);
+    ape_allocator_free(&ctx->alloc, newpositions);
+    return res;
+}
+
+bool ape_optimizer_peephole(ApeAstCompiler* comp, ApeAstCompScope* scope)
+{
+    int i;
+    int res;
+    if(!comp->config->optimize)
+    {
+        return true;
+    }
+    for(i = 0; i < APE_CONF_CONST_PEEPHOLE_MAXPASSES; i++)
+    {
+        res = ape_optimizer_peepholepass(comp, scope);
+        if(res < 0)
+        {
+            return false;
+        }
+        if(res == 0)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+/*
+* looks up a local of the function being compiled, without the side effects of
+* ape_symtable_resolve (which turns outer locals into free variables).
+*/
+static ApeSymbol* ape_optimizer_findlocal(ApeAstCompiler* comp, const char* name)
+{
+    ApeInt i;
+    ApeSymbol* symbol;
+    ApeSymTable* table;
+    ApeAstBlockScope* scope;
+    table = ape_compiler_getsymboltable(comp);
+    for(i = (ApeInt)ape_ptrarray_count(table->blockscopes) - 1; i >= 0; i--)
+    {
+        scope = (ApeAstBlockScope*)ape_ptrarray_get(table->blockscopes, i);
+        symbol = (ApeSymbol*)ape_namemap_get(&scope->store, name);
+        if(symbol)
+        {
+            return (symbol->symtype == APE_SYMBOL_LOCAL) ? symbol : NULL;
+        }
+    }
+    return NULL;
+}
+
+/*
+* type inference. each expression is given the type of its value when it is compiled, from the
+* types already given to its operands, so every node is looked at once. locals of the function
+* being compiled carry the type of their current value: an assignment sets it, whatever it was
+* before, and where control flow merges again (see the ape_optimizer_flow* functions below) the
+* types from each way in are joined. the types are exact: APE_INFER_NUMBER means a number every time.
+*/
+static ApeInferType ape_optimizer_jointype(ApeInferType a, ApeInferType b)
+{
+    return (a == b) ? a : APE_INFER_UNKNOWN;
+}
+
+static bool ape_optimizer_isnumerictype(ApeInferType type)
+{
+    return (type == APE_INFER_NUMBER) || (type == APE_INFER_BOOL);
+}
+
+/* the type of an expression that has just been compiled; its operands have their types already */
+ApeInferType ape_optimizer_infertype(ApeAstCompiler* comp, ApeAstExpression* expr)
+{
+    ApeSymbol* symbol;
+    switch(expr->extype)
+    {
+        case APE_EXPR_LITERALNUMBER:
+            {
+                return APE_INFER_NUMBER;
+            }
+            break;
+        case APE_EXPR_LITERALBOOL:
+            {
+                return APE_INFER_BOOL;
+            }
+            break;
+        case APE_EXPR_LITERALSTRING:
+        case APE_EXPR_LITERALNULL:
+        case APE_EXPR_LITERALARRAY:
+        case APE_EXPR_LITERALMAP:
+        case APE_EXPR_LITERALFUNCTION:
+            {
+                return APE_INFER_OTHER;
+            }
+            break;
+        case APE_EXPR_IDENT:
+            {
+                symbol = ape_optimizer_findlocal(comp, expr->exident->value);
+                if(symbol)
+                {
+                    return symbol->infertype;
+                }
+            }
+            break;
+        case APE_EXPR_PREFIX:
+            {
+                if(expr->exprefix.op == APE_OPERATOR_MINUS && expr->exprefix.right->infertype == APE_INFER_NUMBER)
+                {
+                    return APE_INFER_NUMBER;
+                }
+                /* '!' keeps the type of a number or bool */
+                if(expr->exprefix.op == APE_OPERATOR_NOT && ape_optimizer_isnumerictype(expr->exprefix.right->infertype))
+                {
+                    return expr->exprefix.right->infertype;
+                }
+            }
+            break;
+        case APE_EXPR_INFIX:
+            {
+                if(ape_optimizer_iscomparison(expr->exinfix.op))
+                {
+                    return APE_INFER_BOOL;
+                }
+                /* the vm does arithmetic on numbers and bools; anything else may be overloaded, or be '+' on a string */
+                if(ape_optimizer_isnumerictype(expr->exinfix.left->infertype) && ape_optimizer_isnumerictype(expr->exinfix.right->infertype))
+                {
+                    return APE_INFER_NUMBER;
+                }
+            }
+            break;
+        case APE_EXPR_ASSIGN:
+            {
+                if(expr->exassign.ispostfix)
+                {
+                    return expr->exassign.dest->infertype;
+                }
+                return expr->exassign.source->infertype;
+            }
+            break;
+        case APE_EXPR_LOGICAL:
+            {
+                return ape_optimizer_jointype(expr->exlogical.left->infertype, expr->exlogical.right->infertype);
+            }
+            break;
+        case APE_EXPR_TERNARY:
+            {
+                return ape_optimizer_jointype(expr->externary.iftrue->infertype, expr->externary.iffalse->infertype);
+            }
+            break;
+        default:
+            {
+            }
+            break;
+    }
+    return APE_INFER_UNKNOWN;
+}
+
+/* gives a local of the function being compiled a type, checking it against the loops around it */
+static void ape_optimizer_settype(ApeAstCompiler* comp, ApeSymbol* symbol, ApeInferType type)
+{
+    ApeSize i;
+    ApeSize j;
+    ApeInferFlow* flow;
+    ApeInferEntry* entry;
+    ApeAstCompScope* compscope;
+    compscope = ape_compiler_getcompscope(comp);
+    for(i = 0; i < ape_valarray_count(compscope->inferloops); i++)
+    {
+        flow = *(ApeInferFlow**)ape_valarray_get(compscope->inferloops, i);
+        for(j = 0; j < flow->count; j++)
+        {
+            entry = &flow->entries[j];
+            if(entry->symbol == symbol)
+            {
+                entry->written = true;
+                if(ape_optimizer_jointype(entry->marked, type) != entry->marked)
+                {
+                    flow->failed = true;
+                }
+                break;
+            }
+        }
+    }
+    symbol->infertype = type;
+}
+
+/* records an assignment (or definition) of a value of the given type */
+void ape_optimizer_noteassign(ApeAstCompiler* comp, ApeSymbol* symbol, ApeInferType type)
+{
+    if(symbol->symtype != APE_SYMBOL_LOCAL)
+    {
+        return;
+    }
+    ape_optimizer_settype(comp, symbol, type);
+}
+
+/*
+* starts following the locals visible now through a construct with more than one way through it:
+* the branches of an if or a ternary, the right side of && and ||, or a recover body. a loop
+* cannot be followed like that, since the types at the end of its body are those at its start
+* next time round. so locals are assumed to keep through a loop the types they enter it with, and
+* any assignment that breaks this marks the loop as failed; such locals are unknown after it.
+* *dest is NULL when nothing is inferred, else it lives in the statement's arena.
+*/
+bool ape_optimizer_flowbegin(ApeAstCompiler* comp, ApeAstArena* arena, bool isloop, ApeInferFlow** dest)
+{
+    ApeSize i;
+    ApeSize j;
+    ApeSize count;
+    ApeSymbol* symbol;
+    ApeSymTable* table;
+    ApeAstBlockScope* scope;
+    ApeInferFlow* flow;
+    ApeAstCompScope* compscope;
+    *dest = NULL;
+    if(!comp->config->optimize)
+    {
+        return true;
+    }
+    table = ape_compiler_getsymboltable(comp);
+    count = 0;
+    for(i = 0; i < ape_ptrarray_count(table->blockscopes); i++)
+    {
+        scope = (ApeAstBlockScope*)ape_ptrarray_get(table->blockscopes, i);
+        count += ape_namemap_count(&scope->store);
+    }
+    flow = (ApeInferFlow*)ape_astarena_alloc(arena, sizeof(ApeInferFlow) + (count * sizeof(ApeInferEntry)));
+    if(!flow)
+    {
+        return false;
+    }
+    flow->entries = (ApeInferEntry*)(flow + 1);
+    flow->count = 0;
+    flow->branches = 0;
+    flow->isloop = isloop;
+    flow->failed = false;
+    compscope = ape_compiler_getcompscope(comp);
+    flow->firstdup = ape_valarray_count(compscope->dupips);
+    for(i = 0; i < ape_ptrarray_count(table->blockscopes); i++)
+    {
+        scope = (ApeAstBlockScope*)ape_ptrarray_get(table->blockscopes, i);
+        for(j = 0; j < ape_namemap_count(&scope->store); j++)
+        {
+            symbol = (ApeSymbol*)ape_namemap_getvalueat(&scope->store, j);
+            if(symbol->symtype != APE_SYMBOL_LOCAL)
+            {
+                continue;
+            }
+            flow->entries[flow->count].symbol = symbol;
+            flow->entries[flow->count].marked = symbol->infertype;
+            flow->entries[flow->count].joined = APE_INFER_UNKNOWN;
+            flow->entries[flow->count].written = false;
+            flow->count++;
+        }
+    }
+    if(isloop)
+    {
+        if(!ape_valarray_push(compscope->inferloops, &flow))
+        {
+            return false;
+        }
+    }
+    *dest = flow;
+    return true;
+}
+
+/* every way through from here on starts from the types as they are now (e.g. after an if's test) */
+void ape_optimizer_flowmark(ApeInferFlow* flow)
+{
+    ApeSize i;
+    if(!flow)
+    {
+        return;
+    }
+    for(i = 0; i < flow->count; i++)
+    {
+        flow->entries[i].marked = flow->entries[i].symbol->infertype;
+    }
+}
+
+/* one way through ends here: joins its types in, and starts the next way from the marked ones */
+void ape_optimizer_flowbranch(ApeAstCompiler* comp, ApeInferFlow* flow)
+{
+    ApeSize i;
+    ApeInferEntry* entry;
+    if(!flow)
+    {
+        return;
+    }
+    for(i = 0; i < flow->count; i++)
+    {
+        entry = &flow->entries[i];
+        if(flow->branches == 0)
+        {
+            entry->joined = entry->symbol->infertype;
+        }
+        else
+        {
+            entry->joined = ape_optimizer_jointype(entry->joined, entry->symbol->infertype);
+        }
+        if(entry->symbol->infertype != entry->marked)
+        {
+            ape_optimizer_settype(comp, entry->symbol, entry->marked);
+        }
+    }
+    flow->branches++;
+}
+
+/* nothing is known from here on (a recover body can be entered from anywhere in the function) */
+void ape_optimizer_flowforget(ApeAstCompiler* comp, ApeInferFlow* flow)
+{
+    ApeSize i;
+    if(!flow)
+    {
+        return;
+    }
+    for(i = 0; i < flow->count; i++)
+    {
+        ape_optimizer_settype(comp, flow->entries[i].symbol, APE_INFER_UNKNOWN);
+    }
+}
+
+/*
+* control flow merges again: the types become the joined ones. a loop pops itself and leaves the
+* locals assigned in it with their assumed types, or unknown if it failed (and then forgets the
+* dups noted in it). a flow with no ways joined (recover) puts back the types it started with.
+*/
+void ape_optimizer_flowend(ApeAstCompiler* comp, ApeInferFlow* flow)
+{
+    ApeSize i;
+    ApeInferType type;
+    ApeInferEntry* entry;
+    ApeAstCompScope* compscope;
+    if(!flow)
+    {
+        return;
+    }
+    if(flow->isloop)
+    {
+        compscope = ape_compiler_getcompscope(comp);
+        ape_valarray_pop(compscope->inferloops);
+        /* the types the loop was compiled with were wrong */
+        while(flow->failed && ape_valarray_count(compscope->dupips) > flow->firstdup)
+        {
+            ape_valarray_pop(compscope->dupips);
+        }
+    }
+    for(i = 0; i < flow->count; i++)
+    {
+        entry = &flow->entries[i];
+        if(flow->isloop)
+        {
+            if(!entry->written)
+            {
+                continue;
+            }
+            type = flow->failed ? APE_INFER_UNKNOWN : entry->marked;
+        }
+        else if(flow->branches > 0)
+        {
+            type = entry->joined;
+        }
+        else
+        {
+            type = entry->marked;
+        }
+        if(entry->symbol->infertype != type)
+        {
+            ape_optimizer_settype(comp, entry->symbol, type);
+        }
+    }
+}
+
+/*
+* notes the 'dup' just emitted at ip for an assignment whose value is a number or bool. a flat
+* copy of those is the value itself, so the peephole pass may fold 'dup; set n; pop' to 'set n'.
+*/
+bool ape_optimizer_notedup(ApeAstCompiler* comp, ApeAstExpression* expr, ApeInt ip)
+{
+    ApeAstCompScope* compscope;
+    if(!comp->config->optimize || expr->exassign.dest->extype != APE_EXPR_IDENT)
+    {
+        return true;
+    }
+    if(!ape_optimizer_isnumerictype(expr->exassign.source->infertype))
+    {
+        return true;
+    }
+    compscope = ape_compiler_getcompscope(comp);
+    return ape_valarray_push(compscope->dupips, &ip);
+}
+
+/*
+* picks the number-specialised opcode for an infix expression whose operands have been compiled,
+* or APE_OPCODE_NONE.
+* '-', '*', '/' and the ordering comparisons only make sense on numbers, so they are specialised
+* unless an operand is known not to be one; '+', '==' and '!=' are common on strings and
+* other objects, so they need an operand that is known to be a number.
+*/
+ApeOpByte ape_optimizer_numopcode(ApeAstCompiler* comp, ApeAstExpression* expr)
+{
+    bool anynum;
+    ApeInferType lefttype;
+    ApeInferType righttype;
+    if(!comp->config->optimize)
+    {
+        return APE_OPCODE_NONE;
+    }
+    lefttype = expr->exinfix.left->infertype;
+    righttype = expr->exinfix.right->infertype;
+    /* the specialised opcodes fall back to the generic ones for bools, so they would only cost time */
+    if(lefttype == APE_INFER_OTHER || righttype == APE_INFER_OTHER || lefttype == APE_INFER_BOOL || righttype == APE_INFER_BOOL)
+    {
+        return APE_OPCODE_NONE;
+    }
+    anynum = (lefttype == APE_INFER_NUMBER) || (righttype == APE_INFER_NUMBER);
+    switch(expr->exinfix.op)
+    {
+        case APE_OPERATOR_PLUS:
+            {
+                return anynum ? APE_OPCODE_ADDNUM : APE_OPCODE_NONE;
+            }
+            break;
+        case APE_OPERATOR_MINUS:
+            {
+                return APE_OPCODE_SUBNUM;
+            }
+            break;
+        case APE_OPERATOR_STAR:
+            {
+                return APE_OPCODE_MULNUM;
+            }
+            break;
+        case APE_OPERATOR_SLASH:
+            {
+                return APE_OPCODE_DIVNUM;
+            }
+            break;
+        case APE_OPERATOR_LESSTHAN:
+        case APE_OPERATOR_GREATERTHAN:
+            {
+                return APE_OPCODE_GREATERTHANNUM;
+            }
+            break;
+        case APE_OPERATOR_LESSEQUAL:
+        case APE_OPERATOR_GREATEREQUAL:
+            {
+                return APE_OPCODE_GREATEREQUALNUM;
+            }
+            break;
+        case APE_OPERATOR_EQUAL:
+            {
+                return anynum ? APE_OPCODE_ISEQUALNUM : APE_OPCODE_NONE;
+            }
+            break;
+        case APE_OPERATOR_NOTEQUAL:
+            {
+                return anynum ? APE_OPCODE_NOTEQUALNUM : APE_OPCODE_NONE;
+            }
+            break;
+        default:
+            {
+            }
+            break;
+    }
+    return APE_OPCODE_NONE;
+}
+
+static bool ape_optimizer_touches(ApeAstExpression* expr, const char* name, bool assignonly);
+
+static bool ape_optimizer_blocktouches(ApeAstBlockExpr* block, const char* name, bool assignonly)
+{
+    ApeSize i;
+    if(!block)
+    {
+        return false;
+    }
+    for(i = 0; i < ape_ptrarray_count(block->statements); i++)
+    {
+        if(ape_optimizer_touches((ApeAstExpression*)ape_ptrarray_get(block->statements, i), name, assignonly))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ape_optimizer_listtouches(ApePtrArray* list, const char* name, bool assignonly)
+{
+    ApeSize i;
+    for(i = 0; i < ape_ptrarray_count(list); i++)
+    {
+        if(ape_optimizer_touches((ApeAstExpression*)ape_ptrarray_get(list, i), name, assignonly))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+* does expr assign to 'name' (or, unless assignonly, refer to it at all)?
+* purely syntactic, so a shadowing local of the same name counts too; that only errs on the safe side.
+*/
+static bool ape_optimizer_touches(ApeAstExpression* expr, const char* name, bool assignonly)
+{
+    ApeSize i;
+    ApeAstIfCaseExpr* ifcase;
+    if(!expr)
+    {
+        return false;
+    }
+    switch(expr->extype)
+    {
+        case APE_EXPR_IDENT:
+            {
+                return !assignonly && APE_STREQ(expr->exident->value, name);
+            }
+            break;
+        case APE_EXPR_LITERALARRAY:
+            {
+                return ape_optimizer_listtouches(expr->exarray, name, assignonly);
+            }
+            break;
+        case APE_EXPR_LITERALMAP:
+            {
+                return (
+                    ape_optimizer_listtouches(expr->exmap.keys, name, assignonly) ||
+                    ape_optimizer_listtouches(expr->exmap.values, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_PREFIX:
+            {
+                return ape_optimizer_touches(expr->exprefix.right, name, assignonly);
+            }
+            break;
+        case APE_EXPR_INFIX:
+            {
+                return (
+                    ape_optimizer_touches(expr->exinfix.left, name, assignonly) ||
+                    ape_optimizer_touches(expr->exinfix.right, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_LITERALFUNCTION:
+            {
+                return ape_optimizer_blocktouches(expr->exliteralfunc.body, name, assignonly);
+            }
+            break;
+        case APE_EXPR_CALL:
+            {
+                return (
+                    ape_optimizer_touches(expr->excall.function, name, assignonly) ||
+                    ape_optimizer_listtouches(expr->excall.args, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_INDEX:
+            {
+                return (
+                    ape_optimizer_touches(expr->exindex.left, name, assignonly) ||
+                    ape_optimizer_touches(expr->exindex.index, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_ASSIGN:
+            {
+                if(expr->exassign.dest->extype == APE_EXPR_IDENT && APE_STREQ(expr->exassign.dest->exident->value, name))
+                {
+                    return true;
+                }
+                return (
+                    ape_optimizer_touches(expr->exassign.dest, name, assignonly) ||
+                    ape_optimizer_touches(expr->exassign.source, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_LOGICAL:
+            {
+                return (
+                    ape_optimizer_touches(expr->exlogical.left, name, assignonly) ||
+                    ape_optimizer_touches(expr->exlogical.right, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_TERNARY:
+            {
+                return (
+                    ape_optimizer_touches(expr->externary.test, name, assignonly) ||
+                    ape_optimizer_touches(expr->externary.iftrue, name, assignonly) ||
+                    ape_optimizer_touches(expr->externary.iffalse, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_DEFINE:
+            {
+                return ape_optimizer_touches(expr->exdefine.value, name, assignonly);
+            }
+            break;
+        case APE_EXPR_IFELSE:
+            {
+                for(i = 0; i < ape_ptrarray_count(expr->exifstmt.cases); i++)
+                {
+                    ifcase = (ApeAstIfCaseExpr*)ape_ptrarray_get(expr->exifstmt.cases, i);
+                    if(ape_optimizer_touches(ifcase->test, name, assignonly) || ape_optimizer_blocktouches(ifcase->consequence, name, assignonly))
+                    {
+                        return true;
+                    }
+                }
+                return ape_optimizer_blocktouches(expr->exifstmt.alternative, name, assignonly);
+            }
+            break;
+        case APE_EXPR_RETURNVALUE:
+            {
+                return ape_optimizer_touches(expr->exreturn, name, assignonly);
+            }
+            break;
+        case APE_EXPR_EXPRESSION:
+            {
+                return ape_optimizer_touches(expr->exexpression, name, assignonly);
+            }
+            break;
+        case APE_EXPR_WHILELOOP:
+            {
+                return (
+                    ape_optimizer_touches(expr->exwhilestmt.test, name, assignonly) ||
+                    ape_optimizer_blocktouches(expr->exwhilestmt.body, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_FOREACH:
+            {
+                return (
+                    ape_optimizer_touches(expr->exforeachstmt.source, name, assignonly) ||
+                    ape_optimizer_blocktouches(expr->exforeachstmt.body, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_FORLOOP:
+            {
+                return (
+                    ape_optimizer_touches(expr->exforstmt.init, name, assignonly) ||
+                    ape_optimizer_touches(expr->exforstmt.test, name, assignonly) ||
+                    ape_optimizer_touches(expr->exforstmt.update, name, assignonly) ||
+                    ape_optimizer_blocktouches(expr->exforstmt.body, name, assignonly)
+                );
+            }
+            break;
+        case APE_EXPR_BLOCK:
+            {
+                return ape_optimizer_blocktouches(expr->exblock, name, assignonly);
+            }
+            break;
+        case APE_EXPR_RECOVER:
+            {
+                return ape_optimizer_blocktouches(expr->exrecoverstmt.body, name, assignonly);
+            }
+            break;
+        default:
+            {
+            }
+            break;
+    }
+    return false;
+}
+
+/*
+* recognises a counted loop, 'for(var i = <number>; i < limit; i++)' and its variations
+* (<, <=, >, >= with the counter on either side; ++/--, += 1, -= 1, i = i +/- 1), where i is a
+* local of the current function that the body never assigns and the limit never mentions.
+* called after the init clause has been compiled, so the counter is already defined.
+*/
+bool ape_optimizer_countedloop(ApeAstCompiler* comp, ApeAstForExpr* forloop, ApeSymbol** outsym, ApeAstExpression** outlimit, int* outmode)
+{
+    bool counterleft;
+    int mode;
+    const char* name;
+    ApeAstExpression* init;
+    ApeAstExpression* test;
+    ApeAstExpression* update;
+    ApeAstExpression* source;
+    ApeAstExpression* other;
+    ApeAstExpression* limit;
+    ApeSymbol* symbol;
+    if(!comp->config->optimize || !forloop->init || !forloop->test || !forloop->update)
+    {
+        return false;
+    }
+    /* init: the counter starts out as a number */
+    init = forloop->init;
+    if(init->extype == APE_EXPR_DEFINE)
+    {
+        name = init->exdefine.name->value;
+        source = init->exdefine.value;
+    }
+    else if(init->extype == APE_EXPR_EXPRESSION && init->exexpression->extype == APE_EXPR_ASSIGN
+        && init->exexpression->exassign.dest->extype == APE_EXPR_IDENT)
+    {
+        name = init->exexpression->exassign.dest->exident->value;
+        source = init->exexpression->exassign.source;
+    }
+    else
+    {
+        return false;
+    }
+    if(!ape_optimizer_isnumberexpr(source))
+    {
+        return false;
+    }
+    /* test: counter against a limit that doesn't depend on it */
+    test = forloop->test;
+    if(test->extype != APE_EXPR_INFIX)
+    {
+        return false;
+    }
+    counterleft = test->exinfix.left->extype == APE_EXPR_IDENT && APE_STREQ(test->exinfix.left->exident->value, name);
+    limit = counterleft ? test->exinfix.right : test->exinfix.left;
+    other = counterleft ? test->exinfix.left : test->exinfix.right;
+    if(other->extype != APE_EXPR_IDENT || !APE_STREQ(other->exident->value, name) || ape_optimizer_touches(limit, name, false))
+    {
+        return false;
+    }
+    switch(test->exinfix.op)
+    {
+        case APE_OPERATOR_LESSTHAN:
+            {
+                mode = counterleft ? APE_FORLOOP_LESSTHAN : APE_FORLOOP_GREATERTHAN;
+            }
+            break;
+        case APE_OPERATOR_LESSEQUAL:
+            {
+                mode = counterleft ? APE_FORLOOP_LESSEQUAL : APE_FORLOOP_GREATEREQUAL;
+            }
+            break;
+        case APE_OPERATOR_GREATERTHAN:
+            {
+                mode = counterleft ? APE_FORLOOP_GREATERTHAN : APE_FORLOOP_LESSTHAN;
+            }
+            break;
+        case APE_OPERATOR_GREATEREQUAL:
+            {
+                mode = counterleft ? APE_FORLOOP_GREATEREQUAL : APE_FORLOOP_LESSEQUAL;
+            }
+            break;
+        default:
+            {
+                return false;
+            }
+            break;
+    }
+    /* update: counter +/- 1, which is how ++, --, += and -= are parsed as well */
+    update = forloop->update;
+    if(update->extype != APE_EXPR_ASSIGN || update->exassign.dest->extype != APE_EXPR_IDENT
+        || !APE_STREQ(update->exassign.dest->exident->value, name) || update->exassign.source->extype != APE_EXPR_INFIX)
+    {
+        return false;
+    }
+    source = update->exassign.source;
+    if(source->exinfix.left->extype == APE_EXPR_IDENT && APE_STREQ(source->exinfix.left->exident->value, name))
+    {
+        other = source->exinfix.right;
+    }
+    else if(source->exinfix.op == APE_OPERATOR_PLUS && source->exinfix.right->extype == APE_EXPR_IDENT
+        && APE_STREQ(source->exinfix.right->exident->value, name))
+    {
+        other = source->exinfix.left;
+    }
+    else
+    {
+        return false;
+    }
+    if(other->extype != APE_EXPR_LITERALNUMBER || other->exliteralnumber != 1)
+    {
+        return false;
+    }
+    if(source->exinfix.op == APE_OPERATOR_MINUS)
+    {
+        mode |= APE_FORLOOP_DECREMENT;
+    }
+    else if(source->exinfix.op != APE_OPERATOR_PLUS)
+    {
+        return false;
+    }
+    if(ape_optimizer_blocktouches(forloop->body, name, true))
+    {
+        return false;
+    }
+    /* only a local of this function is out of reach of everything but this loop */
+    symbol = ape_optimizer_findlocal(comp, name);
+    if(!symbol || symbol->index > 0xff)
+    {
+        return false;
+    }
+    *outsym = symbol;
+    *outlimit = limit;
+    *outmode = mode;
+    return true;
+}
@@ -5,20 +5,16 @@ static const ApePosition g_prspriv_srcposinvalid = { NULL, -1, -1 };
 
 static ApeRightAssocParseFNCallback rightassocparsefns[TOKEN_TYPE_MAX + 1];
 static ApeLeftAssocParseFNCallback  leftassocparsefns[TOKEN_TYPE_MAX + 1];
+#if defined(APE_HAVETHREADS)
+    static pthread_once_t g_prspriv_tablesonce = PTHREAD_ONCE_INIT;
+#else
+    static bool g_prspriv_tablesready = false;
+#endif
 
 
-ApeAstParser* ape_ast_make_parser(ApeContext* ctx, const ApeConfig* config, ApeErrorList* errors)
+/* the tables are the same for every parser; filling them while another thread parses would race */
+static void ape_parser_inittables(void)
 {
-    ApeAstParser* parser;
-    parser = (ApeAstParser*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstParser));
-    if(!parser)
-    {
-        return NULL;
-    }
-    memset(parser, 0, sizeof(ApeAstParser));
-    parser->context = ctx;
-    parser->config = config;
-    parser->errors = errors;
     {
         rightassocparsefns[TOKEN_VALIDENT] = ape_parser_parseident;
         rightassocparsefns[TOKEN_VALNUMBER] = ape_parser_parseliteralnumber;
@@ -75,6 +71,30 @@ ApeAstParser* ape_ast_make_parser(ApeContext* ctx, const ApeConfig* config, ApeE
         leftassocparsefns[TOKEN_OPINCREASE] = ape_parser_parseincdecpostfixexpr;
         leftassocparsefns[TOKEN_OPDECREASE] = ape_parser_parseincdecpostfixexpr;
     }
+}
+
+ApeAstParser* ape_ast_make_parser(ApeContext* ctx, const ApeConfig* config, ApeErrorList* errors)
+{
+    ApeAstParser* parser;
+    parser = (ApeAstParser*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstParser));
+    if(!parser)
+    {
+        return NULL;
+    }
+    memset(parser, 0, sizeof(ApeAstParser));
+    parser->context = ctx;
+    parser->config = config;
+    parser->errors = errors;
+    ape_astarena_init(&parser->arena, ctx, true);
+    #if defined(APE_HAVETHREADS)
+        pthread_once(&g_prspriv_tablesonce, ape_parser_inittables);
+    #else
+        if(!g_prspriv_tablesready)
+        {
+            ape_parser_inittables();
+            g_prspriv_tablesready = true;
+        }
+    #endif
     parser->depth = 0;
     return parser;
 }
@@ -85,10 +105,11 @@ void ape_parser_destroy(ApeAstParser* parser)
     {
         return;
     }
+    ape_astarena_release(&parser->arena);
     ape_allocator_free(&parser->context->alloc, parser);
 }
 
-ApePtrArray * ape_parser_parseall(ApeAstParser* parser, const char* input, size_t inlen, ApeAstCompFile* file)
+static ApePtrArray* ape_parser_parsetokens(ApeAstParser* parser, const char* input, size_t inlen, ApeAstCompFile* file)
 {
     bool ok;
     ApeContext* ctx;
@@ -103,7 +124,7 @@ ApePtrArray * ape_parser_parseall(ApeAstParser* parser, const char* input, size_
     }
     ape_lexer_nexttoken(&parser->lexer);
     ape_lexer_nexttoken(&parser->lexer);
-    statements = ape_make_ptrarray(parser->context);
+    statements = ape_make_ptrarrayarena(&parser->arena);
     if(!statements)
     {
         return NULL;
@@ -133,16 +154,32 @@ ApePtrArray * ape_parser_parseall(ApeAstParser* parser, const char* input, size_
     }
     return statements;
 err:
-    ape_ptrarray_destroywithitems(parser->context, statements, (ApeDataCallback)ape_ast_destroy_expr);
+    ape_astarena_release(&parser->arena);
     return NULL;
 }
 
-ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
+/* tokens are read as the parser asks for them, so a trace shows lexing and parsing as one span */
+ApePtrArray * ape_parser_parseall(ApeAstParser* parser, const char* input, size_t inlen, ApeAstCompFile* file)
+{
+    ApeFloat tracestart;
+    ApePtrArray* statements;
+    if(APE_LIKELY(parser->context->tracer == NULL))
+    {
+        return ape_parser_parsetokens(parser, input, inlen, file);
+    }
+    tracestart = ape_util_timermicros();
+    statements = ape_parser_parsetokens(parser, input, inlen, file);
+    ape_tracer_span(parser->context->tracer, "compile", "parse", (file != NULL) ? file->path : NULL, tracestart);
+    return statements;
+}
+
+ApeAstExpression* ape_ast_copy_expr(ApeAstArena* arena, ApeAstExpression* expr)
 {
     char* pathcopy;
     char* stringcopy;
     char* namecopy;
     ApeAstIdentExpr* ident;
+    ApeAstIdentExpr* valueitercopy;
     ApePtrArray* valuescopy;
     ApePtrArray* keyscopy;
     ApePtrArray* paramscopy;
@@ -165,13 +202,15 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
     ApePtrArray* casescopy;
     ApeAstExpression* valuecopy;
     ApeAstExpression* res;
-    ApeDataCallback copyfn;
+    ApeContext* ctx;
+    ApeAstCopyCallback copyfn;
     ApeDataCallback destroyfn;
     if(!expr)
     {
         return NULL;
     }
     //fprintf(stderr, "copying expr (%s)\n", ape_tostring_exprtype(expr->extype));
+    ctx = arena->context;
     res = NULL;
     switch(expr->extype)
     {
@@ -182,12 +221,12 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_IDENT:
             {
-                ident = ape_ast_copy_ident(ctx, expr->exident);
+                ident = ape_ast_copy_ident(arena, expr->exident);
                 if(!ident)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_identexpr(ctx, ident);
+                res = ape_ast_make_identexpr(arena, ident);
                 if(!res)
                 {
                     ape_ast_destroy_ident(ctx, ident);
@@ -197,44 +236,44 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_LITERALNUMBER:
             {
-                res = ape_ast_make_literalnumberexpr(ctx, expr->exliteralnumber);
+                res = ape_ast_make_literalnumberexpr(arena, expr->exliteralnumber);
             }
             break;
         case APE_EXPR_LITERALBOOL:
             {
-                res = ape_ast_make_literalboolexpr(ctx, expr->exliteralbool);
+                res = ape_ast_make_literalboolexpr(arena, expr->exliteralbool);
             }
             break;
         case APE_EXPR_LITERALSTRING:
             {
-                stringcopy = ape_util_strndup(ctx, expr->exliteralstring, expr->stringlitlength);
+                stringcopy = ape_astarena_strndup(arena, expr->exliteralstring, expr->stringlitlength);
                 if(!stringcopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_literalstringexpr(ctx, stringcopy, expr->stringlitlength, true);
+                res = ape_ast_make_literalstringexpr(arena, stringcopy, expr->stringlitlength, true);
                 if(!res)
                 {
-                    ape_allocator_free(&ctx->alloc, stringcopy);
+                    ape_astarena_free(arena, stringcopy);
                     return NULL;
                 }
             }
             break;
         case APE_EXPR_LITERALNULL:
             {
-                res = ape_ast_make_literalnullexpr(ctx);
+                res = ape_ast_make_literalnullexpr(arena);
             }
             break;
         case APE_EXPR_LITERALARRAY:
             {
-                copyfn = (ApeDataCallback)ape_ast_copy_expr;
+                copyfn = (ApeAstCopyCallback)ape_ast_copy_expr;
                 destroyfn = (ApeDataCallback)ape_ast_destroy_expr;
-                valuescopy = ape_ptrarray_copywithitems(ctx, expr->exarray, copyfn, destroyfn);
+                valuescopy = ape_ast_copylist(arena, expr->exarray, copyfn, destroyfn);
                 if(!valuescopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_literalarrayexpr(ctx, valuescopy);
+                res = ape_ast_make_literalarrayexpr(arena, valuescopy);
                 if(!res)
                 {
                     ape_ptrarray_destroywithitems(ctx, valuescopy, destroyfn);
@@ -244,17 +283,17 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_LITERALMAP:
             {
-                copyfn = (ApeDataCallback)ape_ast_copy_expr;
+                copyfn = (ApeAstCopyCallback)ape_ast_copy_expr;
                 destroyfn = (ApeDataCallback)ape_ast_destroy_expr;
-                keyscopy = ape_ptrarray_copywithitems(ctx, expr->exmap.keys, copyfn, destroyfn);
-                valuescopy = ape_ptrarray_copywithitems(ctx, expr->exmap.values, copyfn, destroyfn);
+                keyscopy = ape_ast_copylist(arena, expr->exmap.keys, copyfn, destroyfn);
+                valuescopy = ape_ast_copylist(arena, expr->exmap.values, copyfn, destroyfn);
                 if(!keyscopy || !valuescopy)
                 {
                     ape_ptrarray_destroywithitems(ctx, keyscopy, destroyfn);
                     ape_ptrarray_destroywithitems(ctx, valuescopy, destroyfn);
                     return NULL;
                 }
-                res = ape_ast_make_literalmapexpr(ctx, keyscopy, valuescopy);
+                res = ape_ast_make_literalmapexpr(arena, keyscopy, valuescopy);
                 if(!res)
                 {
                     ape_ptrarray_destroywithitems(ctx, keyscopy, destroyfn);
@@ -265,12 +304,12 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_PREFIX:
             {
-                rightcopy = ape_ast_copy_expr(ctx, expr->exprefix.right);
+                rightcopy = ape_ast_copy_expr(arena, expr->exprefix.right);
                 if(!rightcopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_prefixexpr(ctx, expr->exprefix.op, rightcopy);
+                res = ape_ast_make_prefixexpr(arena, expr->exprefix.op, rightcopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, rightcopy);
@@ -280,15 +319,15 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_INFIX:
             {
-                leftcopy = ape_ast_copy_expr(ctx, expr->exinfix.left);
-                rightcopy = ape_ast_copy_expr(ctx, expr->exinfix.right);
+                leftcopy = ape_ast_copy_expr(arena, expr->exinfix.left);
+                rightcopy = ape_ast_copy_expr(arena, expr->exinfix.right);
                 if(!leftcopy || !rightcopy)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
                     ape_ast_destroy_expr(ctx, rightcopy);
                     return NULL;
                 }
-                res = ape_ast_make_infixexpr(ctx, expr->exinfix.op, leftcopy, rightcopy);
+                res = ape_ast_make_infixexpr(arena, expr->exinfix.op, leftcopy, rightcopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
@@ -299,24 +338,24 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_LITERALFUNCTION:
             {
-                copyfn = (ApeDataCallback)ape_ast_copy_ident;
+                copyfn = (ApeAstCopyCallback)ape_ast_copy_ident;
                 destroyfn = (ApeDataCallback)ape_ast_destroy_ident;
-                paramscopy = ape_ptrarray_copywithitems(ctx, expr->exliteralfunc.params, copyfn, destroyfn);
-                bodycopy = ape_ast_copy_codeblock(ctx, expr->exliteralfunc.body);
-                namecopy = ape_util_strdup(ctx, expr->exliteralfunc.name);
+                paramscopy = ape_ast_copylist(arena, expr->exliteralfunc.params, copyfn, destroyfn);
+                bodycopy = ape_ast_copy_codeblock(arena, expr->exliteralfunc.body);
+                namecopy = ape_astarena_strdup(arena, expr->exliteralfunc.name);
                 if(!paramscopy || !bodycopy)
                 {
                     ape_ptrarray_destroywithitems(ctx, paramscopy, destroyfn);
                     ape_ast_destroy_codeblock(bodycopy);
-                    ape_allocator_free(&ctx->alloc, namecopy);
+                    ape_astarena_free(arena, namecopy);
                     return NULL;
                 }
-                res = ape_ast_make_literalfuncexpr(ctx, paramscopy, bodycopy);
+                res = ape_ast_make_literalfuncexpr(arena, paramscopy, bodycopy);
                 if(!res)
                 {
                     ape_ptrarray_destroywithitems(ctx, paramscopy, destroyfn);
                     ape_ast_destroy_codeblock(bodycopy);
-                    ape_allocator_free(&ctx->alloc, namecopy);
+                    ape_astarena_free(arena, namecopy);
                     return NULL;
                 }
                 res->exliteralfunc.name = namecopy;
@@ -324,17 +363,17 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_CALL:
             {
-                functioncopy = ape_ast_copy_expr(ctx, expr->excall.function);
-                copyfn = (ApeDataCallback)ape_ast_copy_expr;
+                functioncopy = ape_ast_copy_expr(arena, expr->excall.function);
+                copyfn = (ApeAstCopyCallback)ape_ast_copy_expr;
                 destroyfn = (ApeDataCallback)ape_ast_destroy_expr;
-                argscopy = ape_ptrarray_copywithitems(ctx, expr->excall.args, copyfn, destroyfn);
+                argscopy = ape_ast_copylist(arena, expr->excall.args, copyfn, destroyfn);
                 if(!functioncopy || !argscopy)
                 {
                     ape_ast_destroy_expr(ctx, functioncopy);
                     ape_ptrarray_destroywithitems(ctx, expr->excall.args, destroyfn);
                     return NULL;
                 }
-                res = ape_ast_make_callexpr(ctx, functioncopy, argscopy);
+                res = ape_ast_make_callexpr(arena, functioncopy, argscopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, functioncopy);
@@ -345,15 +384,15 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_INDEX:
             {
-                leftcopy = ape_ast_copy_expr(ctx, expr->exindex.left);
-                indexcopy = ape_ast_copy_expr(ctx, expr->exindex.index);
+                leftcopy = ape_ast_copy_expr(arena, expr->exindex.left);
+                indexcopy = ape_ast_copy_expr(arena, expr->exindex.index);
                 if(!leftcopy || !indexcopy)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
                     ape_ast_destroy_expr(ctx, indexcopy);
                     return NULL;
                 }
-                res = ape_ast_make_indexexpr(ctx, leftcopy, indexcopy);
+                res = ape_ast_make_indexexpr(arena, leftcopy, indexcopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
@@ -364,15 +403,15 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_ASSIGN:
             {
-                destcopy = ape_ast_copy_expr(ctx, expr->exassign.dest);
-                sourcecopy = ape_ast_copy_expr(ctx, expr->exassign.source);
+                destcopy = ape_ast_copy_expr(arena, expr->exassign.dest);
+                sourcecopy = ape_ast_copy_expr(arena, expr->exassign.source);
                 if(!destcopy || !sourcecopy)
                 {
                     ape_ast_destroy_expr(ctx, destcopy);
                     ape_ast_destroy_expr(ctx, sourcecopy);
                     return NULL;
                 }
-                res = ape_ast_make_assignexpr(ctx, destcopy, sourcecopy, expr->exassign.ispostfix);
+                res = ape_ast_make_assignexpr(arena, destcopy, sourcecopy, expr->exassign.ispostfix);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, destcopy);
@@ -383,15 +422,15 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_LOGICAL:
             {
-                leftcopy = ape_ast_copy_expr(ctx, expr->exlogical.left);
-                rightcopy = ape_ast_copy_expr(ctx, expr->exlogical.right);
+                leftcopy = ape_ast_copy_expr(arena, expr->exlogical.left);
+                rightcopy = ape_ast_copy_expr(arena, expr->exlogical.right);
                 if(!leftcopy || !rightcopy)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
                     ape_ast_destroy_expr(ctx, rightcopy);
                     return NULL;
                 }
-                res = ape_ast_make_logicalexpr(ctx, expr->exlogical.op, leftcopy, rightcopy);
+                res = ape_ast_make_logicalexpr(arena, expr->exlogical.op, leftcopy, rightcopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
@@ -402,9 +441,9 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_TERNARY:
             {
-                testcopy = ape_ast_copy_expr(ctx, expr->externary.test);
-                iftruecopy = ape_ast_copy_expr(ctx, expr->externary.iftrue);
-                iffalsecopy = ape_ast_copy_expr(ctx, expr->externary.iffalse);
+                testcopy = ape_ast_copy_expr(arena, expr->externary.test);
+                iftruecopy = ape_ast_copy_expr(arena, expr->externary.iftrue);
+                iffalsecopy = ape_ast_copy_expr(arena, expr->externary.iffalse);
                 if(!testcopy || !iftruecopy || !iffalsecopy)
                 {
                     ape_ast_destroy_expr(ctx, testcopy);
@@ -412,7 +451,7 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
                     ape_ast_destroy_expr(ctx, iffalsecopy);
                     return NULL;
                 }
-                res = ape_ast_make_ternaryexpr(ctx, testcopy, iftruecopy, iffalsecopy);
+                res = ape_ast_make_ternaryexpr(arena, testcopy, iftruecopy, iffalsecopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, testcopy);
@@ -424,12 +463,12 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_DEFINE:
             {
-                valuecopy = ape_ast_copy_expr(ctx, expr->exdefine.value);
+                valuecopy = ape_ast_copy_expr(arena, expr->exdefine.value);
                 if(!valuecopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_definestmt(ctx, ape_ast_copy_ident(ctx, expr->exdefine.name), valuecopy, expr->exdefine.assignable);
+                res = ape_ast_make_definestmt(arena, ape_ast_copy_ident(arena, expr->exdefine.name), valuecopy, expr->exdefine.assignable);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, valuecopy);
@@ -439,18 +478,18 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_IFELSE:
             {
-                copyfn = (ApeDataCallback)ape_ast_copy_ifcase;
+                copyfn = (ApeAstCopyCallback)ape_ast_copy_ifcase;
                 destroyfn = (ApeDataCallback)ape_ast_destroy_ifcase;
-                casescopy = ape_ptrarray_copywithitems(ctx, expr->exifstmt.cases, copyfn, destroyfn);
-                alternativecopy = ape_ast_copy_codeblock(ctx, expr->exifstmt.alternative);
+                casescopy = ape_ast_copylist(arena, expr->exifstmt.cases, copyfn, destroyfn);
+                alternativecopy = ape_ast_copy_codeblock(arena, expr->exifstmt.alternative);
                 if(!casescopy || !alternativecopy)
                 {
                     ape_ptrarray_destroywithitems(ctx, casescopy, destroyfn);
                     ape_ast_destroy_codeblock(alternativecopy);
                     return NULL;
                 }
-                res = ape_ast_make_ifstmt(ctx, casescopy, alternativecopy);
-                if(res)
+                res = ape_ast_make_ifstmt(arena, casescopy, alternativecopy);
+                if(!res)
                 {
                     ape_ptrarray_destroywithitems(ctx, casescopy, destroyfn);
                     ape_ast_destroy_codeblock(alternativecopy);
@@ -460,12 +499,12 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_RETURNVALUE:
             {
-                valuecopy = ape_ast_copy_expr(ctx, expr->exreturn);
+                valuecopy = ape_ast_copy_expr(arena, expr->exreturn);
                 if(!valuecopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_returnstmt(ctx, valuecopy);
+                res = ape_ast_make_returnstmt(arena, valuecopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, valuecopy);
@@ -475,12 +514,12 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_EXPRESSION:
             {
-                valuecopy = ape_ast_copy_expr(ctx, expr->exexpression);
+                valuecopy = ape_ast_copy_expr(arena, expr->exexpression);
                 if(!valuecopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_expressionstmt(ctx, valuecopy);
+                res = ape_ast_make_expressionstmt(arena, valuecopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, valuecopy);
@@ -490,15 +529,15 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_WHILELOOP:
             {
-                testcopy = ape_ast_copy_expr(ctx, expr->exwhilestmt.test);
-                bodycopy = ape_ast_copy_codeblock(ctx, expr->exwhilestmt.body);
+                testcopy = ape_ast_copy_expr(arena, expr->exwhilestmt.test);
+                bodycopy = ape_ast_copy_codeblock(arena, expr->exwhilestmt.body);
                 if(!testcopy || !bodycopy)
                 {
                     ape_ast_destroy_expr(ctx, testcopy);
                     ape_ast_destroy_codeblock(bodycopy);
                     return NULL;
                 }
-                res = ape_ast_make_whilestmt(ctx, testcopy, bodycopy);
+                res = ape_ast_make_whilestmt(arena, testcopy, bodycopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, testcopy);
@@ -509,39 +548,46 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_BREAK:
             {
-                res = ape_ast_make_breakstmt(ctx);
+                res = ape_ast_make_breakstmt(arena);
             }
             break;
         case APE_EXPR_CONTINUE:
             {
-                res = ape_ast_make_continuestmt(ctx);
+                res = ape_ast_make_continuestmt(arena);
             }
             break;
         case APE_EXPR_FOREACH:
             {
-                sourcecopy = ape_ast_copy_expr(ctx, expr->exforeachstmt.source);
-                bodycopy = ape_ast_copy_codeblock(ctx, expr->exforeachstmt.body);
-                if(!sourcecopy || !bodycopy)
+                sourcecopy = ape_ast_copy_expr(arena, expr->exforeachstmt.source);
+                bodycopy = ape_ast_copy_codeblock(arena, expr->exforeachstmt.body);
+                valueitercopy = NULL;
+                if(expr->exforeachstmt.valueiterator)
+                {
+                    valueitercopy = ape_ast_copy_ident(arena, expr->exforeachstmt.valueiterator);
+                }
+                if(!sourcecopy || !bodycopy || (expr->exforeachstmt.valueiterator && !valueitercopy))
                 {
                     ape_ast_destroy_expr(ctx, sourcecopy);
                     ape_ast_destroy_codeblock(bodycopy);
+                    ape_ast_destroy_ident(ctx, valueitercopy);
                     return NULL;
                 }
-                res = ape_ast_make_foreachstmt(ctx, ape_ast_copy_ident(ctx, expr->exforeachstmt.iterator), sourcecopy, bodycopy);
+                res = ape_ast_make_foreachstmt(arena, ape_ast_copy_ident(arena, expr->exforeachstmt.iterator), valueitercopy, sourcecopy, bodycopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, sourcecopy);
                     ape_ast_destroy_codeblock(bodycopy);
+                    ape_ast_destroy_ident(ctx, valueitercopy);
                     return NULL;
                 }
             }
             break;
         case APE_EXPR_FORLOOP:
             {
-                initcopy = ape_ast_copy_expr(ctx, expr->exforstmt.init);
-                testcopy = ape_ast_copy_expr(ctx, expr->exforstmt.test);
-                updatecopy = ape_ast_copy_expr(ctx, expr->exforstmt.update);
-                bodycopy = ape_ast_copy_codeblock(ctx, expr->exforstmt.body);
+                initcopy = ape_ast_copy_expr(arena, expr->exforstmt.init);
+                testcopy = ape_ast_copy_expr(arena, expr->exforstmt.test);
+                updatecopy = ape_ast_copy_expr(arena, expr->exforstmt.update);
+                bodycopy = ape_ast_copy_codeblock(arena, expr->exforstmt.body);
                 if(!initcopy || !testcopy || !updatecopy || !bodycopy)
                 {
                     ape_ast_destroy_expr(ctx, initcopy);
@@ -550,7 +596,7 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
                     ape_ast_destroy_codeblock(bodycopy);
                     return NULL;
                 }
-                res = ape_ast_make_forstmt(ctx, initcopy, testcopy, updatecopy, bodycopy);
+                res = ape_ast_make_forstmt(arena, initcopy, testcopy, updatecopy, bodycopy);
                 if(!res)
                 {
                     ape_ast_destroy_expr(ctx, initcopy);
@@ -563,12 +609,12 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_BLOCK:
             {
-                blockcopy = ape_ast_copy_codeblock(ctx, expr->exblock);
+                blockcopy = ape_ast_copy_codeblock(arena, expr->exblock);
                 if(!blockcopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_blockstmt(ctx, blockcopy);
+                res = ape_ast_make_blockstmt(arena, blockcopy);
                 if(!res)
                 {
                     ape_ast_destroy_codeblock(blockcopy);
@@ -578,30 +624,30 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
             break;
         case APE_EXPR_INCLUDE:
             {
-                pathcopy = ape_util_strdup(ctx, expr->exincludestmt.path);
+                pathcopy = ape_astarena_strdup(arena, expr->exincludestmt.path);
                 if(!pathcopy)
                 {
                     return NULL;
                 }
-                res = ape_ast_make_includestmt(ctx, pathcopy);
+                res = ape_ast_make_includestmt(arena, pathcopy);
                 if(!res)
                 {
-                    ape_allocator_free(&ctx->alloc, pathcopy);
+                    ape_astarena_free(arena, pathcopy);
                     return NULL;
                 }
             }
             break;
         case APE_EXPR_RECOVER:
             {
-                bodycopy = ape_ast_copy_codeblock(ctx, expr->exrecoverstmt.body);
-                erroridentcopy = ape_ast_copy_ident(ctx, expr->exrecoverstmt.errorident);
+                bodycopy = ape_ast_copy_codeblock(arena, expr->exrecoverstmt.body);
+                erroridentcopy = ape_ast_copy_ident(arena, expr->exrecoverstmt.errorident);
                 if(!bodycopy || !erroridentcopy)
                 {
                     ape_ast_destroy_codeblock(bodycopy);
                     ape_ast_destroy_ident(ctx, erroridentcopy);
                     return NULL;
                 }
-                res = ape_ast_make_recoverstmt(ctx, erroridentcopy, bodycopy);
+                res = ape_ast_make_recoverstmt(arena, erroridentcopy, bodycopy);
                 if(!res)
                 {
                     ape_ast_destroy_codeblock(bodycopy);
@@ -624,15 +670,16 @@ ApeAstExpression* ape_ast_copy_expr(ApeContext* ctx, ApeAstExpression* expr)
 
 
 
-ApeAstIfCaseExpr* ape_ast_make_ifcase(ApeContext* ctx, ApeAstExpression* test, ApeAstBlockExpr* consequence)
+ApeAstIfCaseExpr* ape_ast_make_ifcase(ApeAstArena* arena, ApeAstExpression* test, ApeAstBlockExpr* consequence)
 {
     ApeAstIfCaseExpr* res;
-    res = (ApeAstIfCaseExpr*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstIfCaseExpr));
+    res = (ApeAstIfCaseExpr*)ape_astarena_alloc(arena, sizeof(ApeAstIfCaseExpr));
     if(!res)
     {
         return NULL;
     }
-    res->context = ctx;
+    res->context = arena->context;
+    res->arena = arena;
     res->test = test;
     res->consequence = consequence;
     return res;
@@ -640,7 +687,8 @@ ApeAstIfCaseExpr* ape_ast_make_ifcase(ApeContext* ctx, ApeAstExpression* test, A
 
 void* ape_ast_destroy_ifcase(ApeContext* ctx, ApeAstIfCaseExpr* cond)
 {
-    if(!cond)
+    /* nodes in a bump arena go away with the arena */
+    if(!cond || cond->arena->isbump)
     {
         return NULL;
     }
@@ -654,7 +702,7 @@ void* ape_ast_destroy_expr(ApeContext* ctx, ApeAstExpression* expr)
 {
     ApeAstLiteralFuncExpr* fn;
     ApeDataCallback destroyfn;
-    if(!expr)
+    if(!expr || expr->arena->isbump)
     {
         return NULL;
     }
@@ -788,6 +836,7 @@ void* ape_ast_destroy_expr(ApeContext* ctx, ApeAstExpression* expr)
         case APE_EXPR_FOREACH:
             {
                 ape_ast_destroy_ident(ctx, expr->exforeachstmt.iterator);
+                ape_ast_destroy_ident(ctx, expr->exforeachstmt.valueiterator);
                 ape_ast_destroy_expr(ctx, expr->exforeachstmt.source);
                 ape_ast_destroy_codeblock(expr->exforeachstmt.body);
             }
@@ -825,7 +874,7 @@ void* ape_ast_destroy_expr(ApeContext* ctx, ApeAstExpression* expr)
 void* ape_ast_destroy_codeblock(ApeAstBlockExpr* block)
 {
     ApeContext* ctx;
-    if(!block)
+    if(!block || block->arena->isbump)
     {
         return NULL;
     }
@@ -837,11 +886,10 @@ void* ape_ast_destroy_codeblock(ApeAstBlockExpr* block)
 
 void* ape_ast_destroy_ident(ApeContext* ctx, ApeAstIdentExpr* ident)
 {
-    if(!ident)
+    if(!ident || ident->arena->isbump)
     {
         return NULL;
     }
-    ape_allocator_free(&ctx->alloc, ident->value);
     ident->value = NULL;
     ident->pos = g_prspriv_srcposinvalid;
     ape_allocator_free(&ctx->alloc, ident);
@@ -955,7 +1003,7 @@ ApeAstExpression* ape_parser_parsevarstmt(ApeAstParser* p)
     {
         goto err;
     }
-    nameident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+    nameident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
     if(!nameident)
     {
         goto err;
@@ -971,7 +1019,7 @@ ApeAstExpression* ape_parser_parsevarstmt(ApeAstParser* p)
         }
         if(value->extype == APE_EXPR_LITERALFUNCTION)
         {
-            value->exliteralfunc.name = ape_util_strdup(p->context, nameident->value);
+            value->exliteralfunc.name = ape_astarena_strdup(&p->arena, nameident->value);
             if(!value->exliteralfunc.name)
             {
                 goto err;
@@ -980,9 +1028,9 @@ ApeAstExpression* ape_parser_parsevarstmt(ApeAstParser* p)
     }
     else
     {
-        value = ape_ast_make_literalnullexpr(p->context);
+        value = ape_ast_make_literalnullexpr(&p->arena);
     }
-    res = ape_ast_make_definestmt(p->context, nameident, value, assignable);
+    res = ape_ast_make_definestmt(&p->arena, nameident, value, assignable);
     if(!res)
     {
         goto err;
@@ -1007,7 +1055,7 @@ ApeAstExpression* ape_parser_parseifstmt(ApeAstParser* p)
     ctx = p->context;
     cases = NULL;
     alternative = NULL;
-    cases = ape_make_ptrarray(p->context);
+    cases = ape_make_ptrarrayarena(&p->arena);
     if(!cases)
     {
         goto err;
@@ -1018,7 +1066,7 @@ ApeAstExpression* ape_parser_parseifstmt(ApeAstParser* p)
         goto err;
     }
     ape_lexer_nexttoken(&p->lexer);
-    cond = ape_ast_make_ifcase(p->context, NULL, NULL);
+    cond = ape_ast_make_ifcase(&p->arena, NULL, NULL);
     if(!cond)
     {
         goto err;
@@ -1055,7 +1103,7 @@ ApeAstExpression* ape_parser_parseifstmt(ApeAstParser* p)
                 goto err;
             }
             ape_lexer_nexttoken(&p->lexer);
-            elif = ape_ast_make_ifcase(p->context, NULL, NULL);
+            elif = ape_ast_make_ifcase(&p->arena, NULL, NULL);
             if(!elif)
             {
                 goto err;
@@ -1091,7 +1139,7 @@ ApeAstExpression* ape_parser_parseifstmt(ApeAstParser* p)
             }
         }
     }
-    res = ape_ast_make_ifstmt(p->context, cases, alternative);
+    res = ape_ast_make_ifstmt(&p->arena, cases, alternative);
     if(!res)
     {
         goto err;
@@ -1125,7 +1173,7 @@ ApeAstExpression* ape_parser_parsereturnstmt(ApeAstParser* p)
             return NULL;
         }
     }
-    res = ape_ast_make_returnstmt(p->context, expr);
+    res = ape_ast_make_returnstmt(&p->arena, expr);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, expr);
@@ -1157,7 +1205,7 @@ ApeAstExpression* ape_parser_parseexprstmt(ApeAstParser* p)
         }
     }
     #endif
-    res = ape_ast_make_expressionstmt(p->context, expr);
+    res = ape_ast_make_expressionstmt(&p->arena, expr);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, expr);
@@ -1196,7 +1244,7 @@ ApeAstExpression* ape_parser_parsewhileloopstmt(ApeAstParser* p)
     {
         goto err;
     }
-    res = ape_ast_make_whilestmt(p->context, test, body);
+    res = ape_ast_make_whilestmt(&p->arena, test, body);
     if(!res)
     {
         goto err;
@@ -1211,13 +1259,13 @@ err:
 ApeAstExpression* ape_parser_parsebreakstmt(ApeAstParser* p)
 {
     ape_lexer_nexttoken(&p->lexer);
-    return ape_ast_make_breakstmt(p->context);
+    return ape_ast_make_breakstmt(&p->arena);
 }
 
 ApeAstExpression* ape_parser_parsecontinuestmt(ApeAstParser* p)
 {
     ape_lexer_nexttoken(&p->lexer);
-    return ape_ast_make_continuestmt(p->context);
+    return ape_ast_make_continuestmt(&p->arena);
 }
 
 ApeAstExpression* ape_parser_parseblockstmt(ApeAstParser* p)
@@ -1229,7 +1277,7 @@ ApeAstExpression* ape_parser_parseblockstmt(ApeAstParser* p)
     {
         return NULL;
     }
-    res = ape_ast_make_blockstmt(p->context, block);
+    res = ape_ast_make_blockstmt(&p->arena, block);
     if(!res)
     {
         ape_ast_destroy_codeblock(block);
@@ -1248,17 +1296,17 @@ ApeAstExpression* ape_parser_parseincludestmt(ApeAstParser* p)
     {
         return NULL;
     }
-    processedname = ape_ast_processandcopystring(&p->context->alloc, p->lexer.curtoken.literal, p->lexer.curtoken.len, &len);
+    processedname = ape_ast_processandcopystring(&p->arena, p->lexer.curtoken.literal, p->lexer.curtoken.len, &len);
     if(!processedname)
     {
         ape_errorlist_add(p->errors, APE_ERROR_PARSING, p->lexer.curtoken.pos, "error when parsing module name");
         return NULL;
     }
     ape_lexer_nexttoken(&p->lexer);
-    res= ape_ast_make_includestmt(p->context, processedname);
+    res= ape_ast_make_includestmt(&p->arena, processedname);
     if(!res)
     {
-        ape_allocator_free(&p->context->alloc, processedname);
+        ape_astarena_free(&p->arena, processedname);
         return NULL;
     }
     return res;
@@ -1283,7 +1331,7 @@ ApeAstExpression* ape_parser_parserecoverstmt(ApeAstParser* p)
     {
         return NULL;
     }
-    errorident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+    errorident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
     if(!errorident)
     {
         return NULL;
@@ -1299,7 +1347,7 @@ ApeAstExpression* ape_parser_parserecoverstmt(ApeAstParser* p)
     {
         goto err;
     }
-    res = ape_ast_make_recoverstmt(p->context, errorident, body);
+    res = ape_ast_make_recoverstmt(&p->arena, errorident, body);
     if(!res)
     {
         goto err;
@@ -1319,7 +1367,7 @@ ApeAstExpression* ape_parser_parseforloopstmt(ApeAstParser* p)
         return NULL;
     }
     ape_lexer_nexttoken(&p->lexer);
-    if(ape_lexer_currenttokenis(&p->lexer, TOKEN_VALIDENT) && ape_lexer_peektokenis(&p->lexer, TOKEN_KWIN))
+    if(ape_lexer_currenttokenis(&p->lexer, TOKEN_VALIDENT) && (ape_lexer_peektokenis(&p->lexer, TOKEN_KWIN) || ape_lexer_peektokenis(&p->lexer, TOKEN_OPCOMMA)))
     {
         return ape_parser_parseforeachstmt(p);
     }
@@ -1332,16 +1380,33 @@ ApeAstExpression* ape_parser_parseforeachstmt(ApeAstParser* p)
     ApeAstExpression* source;
     ApeAstBlockExpr* body;
     ApeAstIdentExpr* iteratorident;
+    ApeAstIdentExpr* valueident;
     ApeAstExpression* res;
     ctx = p->context;
     source = NULL;
     body = NULL;
-    iteratorident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+    valueident = NULL;
+    iteratorident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
     if(!iteratorident)
     {
         goto err;
     }
     ape_lexer_nexttoken(&p->lexer);
+    /* for(key, value in source) */
+    if(ape_lexer_currenttokenis(&p->lexer, TOKEN_OPCOMMA))
+    {
+        ape_lexer_nexttoken(&p->lexer);
+        if(!ape_lexer_expectcurrent(&p->lexer, TOKEN_VALIDENT))
+        {
+            goto err;
+        }
+        valueident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
+        if(!valueident)
+        {
+            goto err;
+        }
+        ape_lexer_nexttoken(&p->lexer);
+    }
     if(!ape_lexer_expectcurrent(&p->lexer, TOKEN_KWIN))
     {
         goto err;
@@ -1362,7 +1427,7 @@ ApeAstExpression* ape_parser_parseforeachstmt(ApeAstParser* p)
     {
         goto err;
     }
-    res = ape_ast_make_foreachstmt(p->context, iteratorident, source, body);
+    res = ape_ast_make_foreachstmt(&p->arena, iteratorident, valueident, source, body);
     if(!res)
     {
         goto err;
@@ -1371,6 +1436,7 @@ ApeAstExpression* ape_parser_parseforeachstmt(ApeAstParser* p)
 err:
     ape_ast_destroy_codeblock(body);
     ape_ast_destroy_ident(ctx, iteratorident);
+    ape_ast_destroy_ident(ctx, valueident);
     ape_ast_destroy_expr(ctx, source);
     return NULL;
 }
@@ -1437,7 +1503,7 @@ ApeAstExpression* ape_parser_parseclassicforstmt(ApeAstParser* p)
     {
         goto err;
     }
-    res = ape_ast_make_forstmt(p->context, init, test, update, body);
+    res = ape_ast_make_forstmt(&p->arena, init, test, update, body);
     if(!res)
     {
         goto err;
@@ -1467,7 +1533,7 @@ ApeAstExpression* ape_parser_parsefuncstmt(ApeAstParser* p)
     {
         goto err;
     }
-    nameident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+    nameident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
     if(!nameident)
     {
         goto err;
@@ -1479,12 +1545,12 @@ ApeAstExpression* ape_parser_parsefuncstmt(ApeAstParser* p)
         goto err;
     }
     value->pos = pos;
-    value->exliteralfunc.name = ape_util_strdup(p->context, nameident->value);
+    value->exliteralfunc.name = ape_astarena_strdup(&p->arena, nameident->value);
     if(!value->exliteralfunc.name)
     {
         goto err;
     }
-    res = ape_ast_make_definestmt(p->context, nameident, value, false);
+    res = ape_ast_make_definestmt(&p->arena, nameident, value, false);
     if(!res)
     {
         goto err;
@@ -1512,7 +1578,7 @@ ApeAstBlockExpr* ape_parser_parsecodeblock(ApeAstParser* p)
         ape_lexer_nexttoken(&p->lexer);
     }
     p->depth++;
-    statements = ape_make_ptrarray(p->context);
+    statements = ape_make_ptrarrayarena(&p->arena);
     if(!statements)
     {
         goto err;
@@ -1576,7 +1642,7 @@ ApeAstBlockExpr* ape_parser_parsecodeblock(ApeAstParser* p)
         }
     }
     p->depth--;
-    res = ape_ast_make_codeblock(p->context, statements);
+    res = ape_ast_make_codeblock(&p->arena, statements);
     if(!res)
     {
         goto err;
@@ -1648,12 +1714,12 @@ ApeAstExpression* ape_parser_parseident(ApeAstParser* p)
     ApeAstIdentExpr* ident;
     ApeAstExpression* res;
     ctx = p->context;
-    ident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+    ident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
     if(!ident)
     {
         return NULL;
     }
-    res = ape_ast_make_identexpr(p->context, ident);
+    res = ape_ast_make_identexpr(&p->arena, ident);
     if(!res)
     {
         ape_ast_destroy_ident(ctx, ident);
@@ -1681,13 +1747,13 @@ ApeAstExpression* ape_parser_parseliteralnumber(ApeAstParser* p)
         return NULL;
     }
     ape_lexer_nexttoken(&p->lexer);
-    return ape_ast_make_literalnumberexpr(p->context, number);
+    return ape_ast_make_literalnumberexpr(&p->arena, number);
 }
 
 ApeAstExpression* ape_parser_parseliteralbool(ApeAstParser* p)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_literalboolexpr(p->context, p->lexer.curtoken.toktype == TOKEN_KWTRUE);
+    res = ape_ast_make_literalboolexpr(&p->arena, p->lexer.curtoken.toktype == TOKEN_KWTRUE);
     ape_lexer_nexttoken(&p->lexer);
     return res;
 }
@@ -1697,17 +1763,17 @@ ApeAstExpression* ape_parser_parseliteralstring(ApeAstParser* p)
     char* processedliteral;
     ApeSize len;
     ApeAstExpression* res;
-    processedliteral = ape_ast_processandcopystring(&p->context->alloc, p->lexer.curtoken.literal, p->lexer.curtoken.len, &len);
+    processedliteral = ape_ast_processandcopystring(&p->arena, p->lexer.curtoken.literal, p->lexer.curtoken.len, &len);
     if(!processedliteral)
     {
         ape_errorlist_add(p->errors, APE_ERROR_PARSING, p->lexer.curtoken.pos, "error while parsing string literal");
         return NULL;
     }
     ape_lexer_nexttoken(&p->lexer);
-    res = ape_ast_make_literalstringexpr(p->context, processedliteral, len, true);
+    res = ape_ast_make_literalstringexpr(&p->arena, processedliteral, len, true);
     if(!res)
     {
-        ape_allocator_free(&p->context->alloc, processedliteral);
+        ape_astarena_free(&p->arena, processedliteral);
         return NULL;
     }
     return res;
@@ -1733,7 +1799,7 @@ ApeAstExpression* ape_parser_parseliteraltplstring(ApeAstParser* p)
     leftaddexpr = NULL;
     rightexpr = NULL;
     rightaddexpr = NULL;
-    processedliteral = ape_ast_processandcopystring(&p->context->alloc, p->lexer.curtoken.literal, p->lexer.curtoken.len, &len);
+    processedliteral = ape_ast_processandcopystring(&p->arena, p->lexer.curtoken.literal, p->lexer.curtoken.len, &len);
     if(!processedliteral)
     {
         ape_errorlist_add(p->errors, APE_ERROR_PARSING, p->lexer.curtoken.pos, "error while parsing string literal");
@@ -1746,7 +1812,7 @@ ApeAstExpression* ape_parser_parseliteraltplstring(ApeAstParser* p)
     }
     ape_lexer_nexttoken(&p->lexer);
     pos = p->lexer.curtoken.pos;
-    leftstringexpr = ape_ast_make_literalstringexpr(p->context, processedliteral, len, true);
+    leftstringexpr = ape_ast_make_literalstringexpr(&p->arena, processedliteral, len, true);
     if(!leftstringexpr)
     {
         goto err;
@@ -1759,14 +1825,14 @@ ApeAstExpression* ape_parser_parseliteraltplstring(ApeAstParser* p)
     {
         goto err;
     }
-    tostrcallexpr = ape_ast_wrapexprinfunccall(p->context, templateexpr, "tostring");
+    tostrcallexpr = ape_ast_wrapexprinfunccall(&p->arena, templateexpr, "tostring");
     if(!tostrcallexpr)
     {
         goto err;
     }
     tostrcallexpr->pos = pos;
     templateexpr = NULL;
-    leftaddexpr = ape_ast_make_infixexpr(p->context, APE_OPERATOR_PLUS, leftstringexpr, tostrcallexpr);
+    leftaddexpr = ape_ast_make_infixexpr(&p->arena, APE_OPERATOR_PLUS, leftstringexpr, tostrcallexpr);
     if(!leftaddexpr)
     {
         goto err;
@@ -1788,7 +1854,7 @@ ApeAstExpression* ape_parser_parseliteraltplstring(ApeAstParser* p)
     {
         goto err;
     }
-    rightaddexpr = ape_ast_make_infixexpr(p->context, APE_OPERATOR_PLUS, leftaddexpr, rightexpr);
+    rightaddexpr = ape_ast_make_infixexpr(&p->arena, APE_OPERATOR_PLUS, leftaddexpr, rightexpr);
     if(!rightaddexpr)
     {
         goto err;
@@ -1804,14 +1870,14 @@ err:
     ape_ast_destroy_expr(ctx, tostrcallexpr);
     ape_ast_destroy_expr(ctx, templateexpr);
     ape_ast_destroy_expr(ctx, leftstringexpr);
-    ape_allocator_free(&p->context->alloc, processedliteral);
+    ape_astarena_free(&p->arena, processedliteral);
     return NULL;
 }
 
 ApeAstExpression* ape_parser_parseliteralnull(ApeAstParser* p)
 {
     ape_lexer_nexttoken(&p->lexer);
-    return ape_ast_make_literalnullexpr(p->context);
+    return ape_ast_make_literalnullexpr(&p->arena);
 }
 
 ApeAstExpression* ape_parser_parseliteralarray(ApeAstParser* p)
@@ -1825,7 +1891,7 @@ ApeAstExpression* ape_parser_parseliteralarray(ApeAstParser* p)
     {
         return NULL;
     }
-    res = ape_ast_make_literalarrayexpr(p->context, array);
+    res = ape_ast_make_literalarrayexpr(&p->arena, array);
     if(!res)
     {
         ape_ptrarray_destroywithitems(ctx, array, (ApeDataCallback)ape_ast_destroy_expr);
@@ -1845,8 +1911,8 @@ ApeAstExpression* ape_parser_parseliteralmap(ApeAstParser* p)
     ApeAstExpression* value;
     ApeAstExpression* res;
     ctx = p->context;
-    keys = ape_make_ptrarray(p->context);
-    values = ape_make_ptrarray(p->context);
+    keys = ape_make_ptrarrayarena(&p->arena);
+    values = ape_make_ptrarrayarena(&p->arena);
     if(!keys || !values)
     {
         goto err;
@@ -1857,11 +1923,11 @@ ApeAstExpression* ape_parser_parseliteralmap(ApeAstParser* p)
         key = NULL;
         if(ape_lexer_currenttokenis(&p->lexer, TOKEN_VALIDENT))
         {
-            str = ape_lexer_tokendupliteral(p->context, &p->lexer.curtoken);
-            key = ape_ast_make_literalstringexpr(p->context, str, strlen(str), true);
+            str = ape_astarena_strndup(&p->arena, p->lexer.curtoken.literal, p->lexer.curtoken.len);
+            key = ape_ast_make_literalstringexpr(&p->arena, str, p->lexer.curtoken.len, true);
             if(!key)
             {
-                ape_allocator_free(&p->context->alloc, str);
+                ape_astarena_free(&p->arena, str);
                 goto err;
             }
             key->pos = p->lexer.curtoken.pos;
@@ -1944,7 +2010,7 @@ ApeAstExpression* ape_parser_parseliteralmap(ApeAstParser* p)
         #endif
     }
     ape_lexer_nexttoken(&p->lexer);
-    res = ape_ast_make_literalmapexpr(p->context, keys, values);
+    res = ape_ast_make_literalmapexpr(&p->arena, keys, values);
     if(!res)
     {
         goto err;
@@ -1970,7 +2036,7 @@ ApeAstExpression* ape_parser_parseprefixexpr(ApeAstParser* p)
     {
         return NULL;
     }
-    res = ape_ast_make_prefixexpr(p->context, op, right);
+    res = ape_ast_make_prefixexpr(&p->arena, op, right);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, right);
@@ -1995,7 +2061,7 @@ ApeAstExpression* ape_parser_parseinfixexpr(ApeAstParser* p, ApeAstExpression* l
     {
         return NULL;
     }
-    res = ape_ast_make_infixexpr(p->context, op, left, right);
+    res = ape_ast_make_infixexpr(&p->arena, op, left, right);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, right);
@@ -2035,7 +2101,7 @@ ApeAstExpression* ape_parser_parseliteralfunc(ApeAstParser* p)
     {
         ape_lexer_nexttoken(&p->lexer);
     }
-    params = ape_make_ptrarray(p->context);
+    params = ape_make_ptrarrayarena(&p->arena);
     ok = ape_parser_parsefuncparams(p, params);
     if(!ok)
     {
@@ -2046,7 +2112,7 @@ ApeAstExpression* ape_parser_parseliteralfunc(ApeAstParser* p)
     {
         goto err;
     }
-    res = ape_ast_make_literalfuncexpr(p->context, params, body);
+    res = ape_ast_make_literalfuncexpr(&p->arena, params, body);
     if(!res)
     {
         goto err;
@@ -2080,7 +2146,7 @@ bool ape_parser_parsefuncparams(ApeAstParser* p, ApePtrArray * outparams)
     {
         return false;
     }
-    ident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+    ident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
     if(!ident)
     {
         return false;
@@ -2099,7 +2165,7 @@ bool ape_parser_parsefuncparams(ApeAstParser* p, ApePtrArray * outparams)
         {
             return false;
         }
-        ident = ape_ast_make_ident(p->context, p->lexer.curtoken);
+        ident = ape_ast_make_ident(&p->arena, p->lexer.curtoken);
         if(!ident)
         {
             return false;
@@ -2134,7 +2200,7 @@ ApeAstExpression* ape_parser_parsecallexpr(ApeAstParser* p, ApeAstExpression* le
     {
         return NULL;
     }
-    res = ape_ast_make_callexpr(p->context, function, args);
+    res = ape_ast_make_callexpr(&p->arena, function, args);
     if(!res)
     {
         ape_ptrarray_destroywithitems(ctx, args, (ApeDataCallback)ape_ast_destroy_expr);
@@ -2155,7 +2221,7 @@ ApePtrArray* ape_parser_parseexprlist(ApeAstParser* p, ApeAstTokType starttoken,
         return NULL;
     }
     ape_lexer_nexttoken(&p->lexer);
-    res = ape_make_ptrarray(p->context);
+    res = ape_make_ptrarrayarena(&p->arena);
     if(ape_lexer_currenttokenis(&p->lexer, endtoken))
     {
         ape_lexer_nexttoken(&p->lexer);
@@ -2220,7 +2286,7 @@ ApeAstExpression* ape_parser_parseindexexpr(ApeAstParser* p, ApeAstExpression* l
         return NULL;
     }
     ape_lexer_nexttoken(&p->lexer);
-    res = ape_ast_make_indexexpr(p->context, left, index);
+    res = ape_ast_make_indexexpr(&p->arena, left, index);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, index);
@@ -2262,13 +2328,13 @@ ApeAstExpression* ape_parser_parseassignexpr(ApeAstParser* p, ApeAstExpression*
         case TOKEN_ASSIGNRIGHTSHIFT:
             {
                 op = ape_parser_tokentooperator(assigntype);
-                leftcopy = ape_ast_copy_expr(ctx, left);
+                leftcopy = ape_ast_copy_expr(&p->arena, left);
                 if(!leftcopy)
                 {
                     goto err;
                 }
                 pos = source->pos;
-                newsource = ape_ast_make_infixexpr(p->context, op, leftcopy, source);
+                newsource = ape_ast_make_infixexpr(&p->arena, op, leftcopy, source);
                 if(!newsource)
                 {
                     ape_ast_destroy_expr(ctx, leftcopy);
@@ -2288,7 +2354,7 @@ ApeAstExpression* ape_parser_parseassignexpr(ApeAstParser* p, ApeAstExpression*
             }
             break;
     }
-    res = ape_ast_make_assignexpr(p->context, left, source, false);
+    res = ape_ast_make_assignexpr(&p->arena, left, source, false);
     if(!res)
     {
         goto err;
@@ -2313,7 +2379,7 @@ ApeAstExpression* ape_parser_parselogicalexpr(ApeAstParser* p, ApeAstExpression*
     {
         return NULL;
     }
-    res = ape_ast_make_logicalexpr(p->context, op, left, right);
+    res = ape_ast_make_logicalexpr(&p->arena, op, left, right);
     if(!res)
     {
         ape_ast_destroy_expr(p->context, right);
@@ -2347,7 +2413,7 @@ ApeAstExpression* ape_parser_parseternaryexpr(ApeAstParser* p, ApeAstExpression*
         ape_ast_destroy_expr(ctx, iftrue);
         return NULL;
     }
-    res = ape_ast_make_ternaryexpr(p->context, left, iftrue, iffalse);
+    res = ape_ast_make_ternaryexpr(&p->arena, left, iftrue, iffalse);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, iftrue);
@@ -2380,21 +2446,21 @@ ApeAstExpression* ape_parser_parseincdecprefixexpr(ApeAstParser* p)
     {
         goto err;
     }
-    oneliteral = ape_ast_make_literalnumberexpr(p->context, 1);
+    oneliteral = ape_ast_make_literalnumberexpr(&p->arena, 1);
     if(!oneliteral)
     {
         ape_ast_destroy_expr(ctx, dest);
         goto err;
     }
     oneliteral->pos = pos;
-    destcopy = ape_ast_copy_expr(p->context, dest);
+    destcopy = ape_ast_copy_expr(&p->arena, dest);
     if(!destcopy)
     {
         ape_ast_destroy_expr(ctx, oneliteral);
         ape_ast_destroy_expr(ctx, dest);
         goto err;
     }
-    operation = ape_ast_make_infixexpr(p->context, op, destcopy, oneliteral);
+    operation = ape_ast_make_infixexpr(&p->arena, op, destcopy, oneliteral);
     if(!operation)
     {
         ape_ast_destroy_expr(ctx, destcopy);
@@ -2403,7 +2469,7 @@ ApeAstExpression* ape_parser_parseincdecprefixexpr(ApeAstParser* p)
         goto err;
     }
     operation->pos = pos;
-    res = ape_ast_make_assignexpr(p->context, dest, operation, false);
+    res = ape_ast_make_assignexpr(&p->arena, dest, operation, false);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, dest);
@@ -2433,19 +2499,19 @@ ApeAstExpression* ape_parser_parseincdecpostfixexpr(ApeAstParser* p, ApeAstExpre
     pos = p->lexer.curtoken.pos;
     ape_lexer_nexttoken(&p->lexer);
     op = ape_parser_tokentooperator(operationtype);
-    leftcopy = ape_ast_copy_expr(p->context, left);
+    leftcopy = ape_ast_copy_expr(&p->arena, left);
     if(!leftcopy)
     {
         goto err;
     }
-    oneliteral = ape_ast_make_literalnumberexpr(p->context, 1);
+    oneliteral = ape_ast_make_literalnumberexpr(&p->arena, 1);
     if(!oneliteral)
     {
         ape_ast_destroy_expr(ctx, leftcopy);
         goto err;
     }
     oneliteral->pos = pos;
-    operation = ape_ast_make_infixexpr(p->context, op, leftcopy, oneliteral);
+    operation = ape_ast_make_infixexpr(&p->arena, op, leftcopy, oneliteral);
     if(!operation)
     {
         ape_ast_destroy_expr(ctx, oneliteral);
@@ -2453,7 +2519,7 @@ ApeAstExpression* ape_parser_parseincdecpostfixexpr(ApeAstParser* p, ApeAstExpre
         goto err;
     }
     operation->pos = pos;
-    res = ape_ast_make_assignexpr(p->context, left, operation, true);
+    res = ape_ast_make_assignexpr(&p->arena, left, operation, true);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, operation);
@@ -2477,16 +2543,16 @@ ApeAstExpression* ape_parser_parsedotexpr(ApeAstParser* p, ApeAstExpression* lef
     {
         return NULL;
     }
-    str = ape_lexer_tokendupliteral(p->context, &p->lexer.curtoken);
-    index = ape_ast_make_literalstringexpr(p->context, str, strlen(str), true);
+    str = ape_astarena_strndup(&p->arena, p->lexer.curtoken.literal, p->lexer.curtoken.len);
+    index = ape_ast_make_literalstringexpr(&p->arena, str, p->lexer.curtoken.len, true);
     if(!index)
     {
-        ape_allocator_free(&p->context->alloc, str);
+        ape_astarena_free(&p->arena, str);
         return NULL;
     }
     index->pos = p->lexer.curtoken.pos;
     ape_lexer_nexttoken(&p->lexer);
-    res = ape_ast_make_indexexpr(p->context, left, index);
+    res = ape_ast_make_indexexpr(&p->arena, left, index);
     if(!res)
     {
         ape_ast_destroy_expr(ctx, index);
@@ -2682,12 +2748,12 @@ char ape_parser_escapechar(const char c)
     return c;
 }
 
-char* ape_ast_processandcopystring(ApeAllocator* alloc, const char* input, size_t len, ApeSize* destlen)
+char* ape_ast_processandcopystring(ApeAstArena* arena, const char* input, size_t len, ApeSize* destlen)
 {
     size_t ini;
     size_t outi;
     char* output;
-    output = (char*)ape_allocator_alloc(alloc, len + 1);
+    output = (char*)ape_astarena_alloc(arena, len + 1);
     if(!output)
     {
         return NULL;
@@ -2716,11 +2782,11 @@ char* ape_ast_processandcopystring(ApeAllocator* alloc, const char* input, size_
     *destlen = outi;
     return output;
 error:
-    ape_allocator_free(alloc, output);
+    ape_astarena_free(arena, output);
     return NULL;
 }
 
-ApeAstExpression* ape_ast_wrapexprinfunccall(ApeContext* ctx, ApeAstExpression* expr, const char* functionname)
+ApeAstExpression* ape_ast_wrapexprinfunccall(ApeAstArena* arena, ApeAstExpression* expr, const char* functionname)
 {
     bool ok;
     ApeAstExpression* callexpr;
@@ -2730,38 +2796,38 @@ ApeAstExpression* ape_ast_wrapexprinfunccall(ApeContext* ctx, ApeAstExpression*
     ApeAstToken fntoken;
     ape_lexer_token_init(&fntoken, TOKEN_VALIDENT, functionname, (int)strlen(functionname));
     fntoken.pos = expr->pos;
-    ident = ape_ast_make_ident(ctx, fntoken);
+    ident = ape_ast_make_ident(arena, fntoken);
     if(!ident)
     {
         return NULL;
     }
     ident->pos = fntoken.pos;
-    functionidentexpr = ape_ast_make_identexpr(ctx, ident);
+    functionidentexpr = ape_ast_make_identexpr(arena, ident);
     if(!functionidentexpr)
     {
-        ape_ast_destroy_ident(ctx, ident);
+        ape_ast_destroy_ident(arena->context, ident);
         return NULL;
     }
     functionidentexpr->pos = expr->pos;
     ident = NULL;
-    args = ape_make_ptrarray(ctx);
+    args = ape_make_ptrarrayarena(arena);
     if(!args)
     {
-        ape_ast_destroy_expr(ctx, functionidentexpr);
+        ape_ast_destroy_expr(arena->context, functionidentexpr);
         return NULL;
     }
     ok = ape_ptrarray_push(args, &expr);
     if(!ok)
     {
         ape_ptrarray_destroy(args);
-        ape_ast_destroy_expr(ctx, functionidentexpr);
+        ape_ast_destroy_expr(arena->context, functionidentexpr);
         return NULL;
     }
-    callexpr = ape_ast_make_callexpr(ctx, functionidentexpr, args);
+    callexpr = ape_ast_make_callexpr(arena, functionidentexpr, args);
     if(!callexpr)
     {
         ape_ptrarray_destroy(args);
-        ape_ast_destroy_expr(ctx, functionidentexpr);
+        ape_ast_destroy_expr(arena->context, functionidentexpr);
         return NULL;
     }
     callexpr->pos = expr->pos;
@@ -0,0 +1,376 @@
+/*
+* parsing of included files ahead of time.
+* before a file's statements are compiled, its top-level includes are followed, one wave of
+* files at a time, and whatever is not compiled yet is read and parsed into a parser's arena.
+* the files of a wave do not depend on each other, so they are parsed by a small pool of
+* threads. code generation does not change: ape_compiler_includemodule still compiles every
+* module in include order on the calling thread, only it finds the tree already built.
+*/
+
+#include "inline.h"
+
+/* a wave holding fewer files than this is not worth starting threads for */
+#define APE_CONF_PREFETCH_MINTHREADJOBS (2)
+
+typedef struct ApePrefetchQueue ApePrefetchQueue;
+
+struct ApePrefetchQueue
+{
+    ApePtrArray* jobs;
+    ApeSize next;
+    /* like ApeAllocator.lock */
+    void* lock;
+};
+
+static ApeSize ape_prefetch_threadcount(ApeAstCompiler* comp)
+{
+    long ncpu;
+    if(comp->config->compilethreads > 0)
+    {
+        return comp->config->compilethreads;
+    }
+    ncpu = 1;
+    #if defined(APE_HAVETHREADS) && defined(_SC_NPROCESSORS_ONLN)
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    #endif
+    if(ncpu < 1)
+    {
+        return 1;
+    }
+    return ncpu;
+}
+
+/* whether an include of 'path' is already taken care of */
+static bool ape_prefetch_isknown(ApeAstCompiler* comp, const char* path)
+{
+    bool found;
+    ApeSize i;
+    ApeAstFileScope* fs;
+    if(ape_strdict_getbyname(comp->modules, path) != NULL)
+    {
+        return true;
+    }
+    /* also an entry that was taken already, whose module is being compiled */
+    ape_strdict_getcellindex(comp->preparsed, path, ape_util_hashstring(path, strlen(path)), &found);
+    if(found)
+    {
+        return true;
+    }
+    /* a cyclic include; reported by ape_compiler_includemodule */
+    for(i = 0; i < ape_ptrarray_count(comp->filescopes); i++)
+    {
+        fs = (ApeAstFileScope*)ape_ptrarray_get(comp->filescopes, i);
+        if(APE_STREQ(fs->file->path, path))
+        {
+            return true;
+        }
+    }
+    return ape_modcache_has(comp, path);
+}
+
+/*
+* reads 'path' and readies its parse for the next wave.
+* a file that cannot be read is left to ape_compiler_includemodule, which reports it where it is included.
+*/
+static bool ape_prefetch_add(ApeAstCompiler* comp, char* path, ApePtrArray* wave)
+{
+    bool ok;
+    size_t clen;
+    char* code;
+    ApeSize errcount;
+    ApeContext* ctx;
+    ApeAstPreparsed* pp;
+    ctx = comp->context;
+    errcount = ape_errorlist_count(comp->errors);
+    code = comp->config->fileio.fnreadfile(ctx, path, -1, &clen);
+    ape_errorlist_truncate(comp->errors, errcount);
+    if(!code)
+    {
+        return true;
+    }
+    pp = (ApeAstPreparsed*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstPreparsed));
+    if(!pp)
+    {
+        ape_allocator_free(&ctx->alloc, code);
+        return false;
+    }
+    memset(pp, 0, sizeof(ApeAstPreparsed));
+    pp->code = code;
+    pp->codelen = clen;
+    ape_errorlist_initerrors(&pp->errors);
+    pp->file = ape_make_compfile(ctx, path);
+    /* made here, since making a parser also fills in the parser's static tables */
+    pp->parser = ape_ast_make_parser(ctx, comp->config, &pp->errors);
+    if(!pp->file || !pp->parser)
+    {
+        ape_prefetch_destroy(ctx, pp);
+        return false;
+    }
+    ape_compfile_setondisk(pp->file, clen);
+    ok = ape_strdict_set(comp->preparsed, path, pp);
+    if(!ok)
+    {
+        ape_prefetch_destroy(ctx, pp);
+        return false;
+    }
+    ok = ape_ptrarray_push(wave, &pp);
+    if(!ok)
+    {
+        return false;
+    }
+    return true;
+}
+
+/* adds the files included by 'statements' of a file in 'dirpath' to 'wave' */
+static bool ape_prefetch_scan(ApeAstCompiler* comp, const char* dirpath, ApePtrArray* statements, ApePtrArray* wave)
+{
+    bool ok;
+    ApeSize i;
+    char* path;
+    ApeAstExpression* stmt;
+    for(i = 0; i < ape_ptrarray_count(statements); i++)
+    {
+        stmt = (ApeAstExpression*)ape_ptrarray_get(statements, i);
+        if(stmt->extype != APE_EXPR_INCLUDE)
+        {
+            continue;
+        }
+        path = ape_compiler_includepath(comp, dirpath, stmt->exincludestmt.path);
+        if(!path)
+        {
+            return false;
+        }
+        ok = true;
+        if(!ape_prefetch_isknown(comp, path))
+        {
+            ok = ape_prefetch_add(comp, path, wave);
+        }
+        ape_allocator_free(&comp->context->alloc, path);
+        if(!ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ape_prefetch_parse(ApeAstPreparsed* pp)
+{
+    pp->statements = ape_parser_parseall(pp->parser, pp->code, pp->codelen, pp->file);
+}
+
+static ApeAstPreparsed* ape_prefetch_nextjob(ApePrefetchQueue* queue)
+{
+    ApeAstPreparsed* pp;
+    pp = NULL;
+    ape_util_lock(queue->lock);
+    if(queue->next < ape_ptrarray_count(queue->jobs))
+    {
+        pp = (ApeAstPreparsed*)ape_ptrarray_get(queue->jobs, queue->next);
+        queue->next++;
+    }
+    ape_util_unlock(queue->lock);
+    return pp;
+}
+
+static void* ape_prefetch_worker(void* arg)
+{
+    ApeAstPreparsed* pp;
+    while((pp = ape_prefetch_nextjob((ApePrefetchQueue*)arg)) != NULL)
+    {
+        ape_prefetch_parse(pp);
+    }
+    return NULL;
+}
+
+#if defined(APE_HAVETHREADS)
+/*
+* parses the files of 'queue' on 'nthreads' threads, the calling one included.
+* while they run, the allocator and the name table are serialized, which is all that
+* parsers share: every one of them has its own arena, file and error list.
+*/
+static bool ape_prefetch_parsethreaded(ApeContext* ctx, ApePrefetchQueue* queue, ApeSize nthreads)
+{
+    ApeSize i;
+    ApeSize started;
+    pthread_t* threads;
+    pthread_mutex_t queuelock;
+    pthread_mutex_t alloclock;
+    pthread_mutex_t nameslock;
+    threads = (pthread_t*)ape_allocator_alloc(&ctx->alloc, sizeof(pthread_t) * (nthreads - 1));
+    if(!threads)
+    {
+        return false;
+    }
+    pthread_mutex_init(&queuelock, NULL);
+    pthread_mutex_init(&alloclock, NULL);
+    pthread_mutex_init(&nameslock, NULL);
+    queue->lock = &queuelock;
+    ctx->alloc.lock = &alloclock;
+    ctx->names.lock = &nameslock;
+    started = 0;
+    for(i = 0; i < (nthreads - 1); i++)
+    {
+        /* if a thread cannot be started, the others do its share */
+        if(pthread_create(&threads[started], NULL, ape_prefetch_worker, queue) == 0)
+        {
+            started++;
+        }
+    }
+    ape_prefetch_worker(queue);
+    for(i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    queue->lock = NULL;
+    ctx->alloc.lock = NULL;
+    ctx->names.lock = NULL;
+    pthread_mutex_destroy(&nameslock);
+    pthread_mutex_destroy(&alloclock);
+    pthread_mutex_destroy(&queuelock);
+    ape_allocator_free(&ctx->alloc, threads);
+    return true;
+}
+#endif
+
+static void ape_prefetch_parsewave(ApeAstCompiler* comp, ApePtrArray* wave)
+{
+    ApeSize nthreads;
+    ApeAstPreparsed* pp;
+    ApePrefetchQueue queue;
+    nthreads = ape_prefetch_threadcount(comp);
+    if(nthreads > ape_ptrarray_count(wave))
+    {
+        nthreads = ape_ptrarray_count(wave);
+    }
+    queue.jobs = wave;
+    queue.next = 0;
+    queue.lock = NULL;
+    #if defined(APE_HAVETHREADS)
+        if((nthreads > 1) && (ape_ptrarray_count(wave) >= APE_CONF_PREFETCH_MINTHREADJOBS))
+        {
+            if(ape_prefetch_parsethreaded(comp->context, &queue, nthreads))
+            {
+                return;
+            }
+        }
+    #endif
+    while((pp = ape_prefetch_nextjob(&queue)) != NULL)
+    {
+        ape_prefetch_parse(pp);
+    }
+}
+
+/*
+* parses, ahead of time, the files that 'statements' of 'file' include, those that they
+* include, and so on. nothing is reported here: a file that fails to parse keeps its errors
+* until it is included. failing to prefetch only means files get parsed as they are included.
+*/
+void ape_prefetch_includes(ApeAstCompiler* comp, ApeAstCompFile* file, ApePtrArray* statements)
+{
+    bool ok;
+    ApeSize i;
+    ApeContext* ctx;
+    ApePtrArray* wave;
+    ApePtrArray* next;
+    ApeAstPreparsed* pp;
+    ctx = comp->context;
+    if(comp->config->dumpast || !comp->config->fileio.fnreadfile || (ape_prefetch_threadcount(comp) < 2))
+    {
+        return;
+    }
+    if(!comp->preparsed)
+    {
+        comp->preparsed = ape_make_strdict(ctx, NULL, (ApeDataCallback)ape_prefetch_destroy);
+        if(!comp->preparsed)
+        {
+            return;
+        }
+    }
+    wave = ape_make_ptrarray(ctx);
+    if(!wave)
+    {
+        return;
+    }
+    ok = ape_prefetch_scan(comp, file->dirpath, statements, wave);
+    while(ok && (ape_ptrarray_count(wave) > 0))
+    {
+        ape_prefetch_parsewave(comp, wave);
+        next = ape_make_ptrarray(ctx);
+        if(!next)
+        {
+            break;
+        }
+        for(i = 0; ok && (i < ape_ptrarray_count(wave)); i++)
+        {
+            pp = (ApeAstPreparsed*)ape_ptrarray_get(wave, i);
+            if(pp->statements)
+            {
+                ok = ape_prefetch_scan(comp, pp->file->dirpath, pp->statements, next);
+            }
+        }
+        ape_ptrarray_destroy(wave);
+        wave = next;
+    }
+    ape_ptrarray_destroy(wave);
+}
+
+/* takes the parse of 'path' out of the compiler, if there is one; its errors now go to the compiler's */
+ApeAstPreparsed* ape_prefetch_take(ApeAstCompiler* comp, const char* path)
+{
+    ApeAstPreparsed* pp;
+    if(!comp->preparsed)
+    {
+        return NULL;
+    }
+    pp = (ApeAstPreparsed*)ape_strdict_getbyname(comp->preparsed, path);
+    if(!pp)
+    {
+        return NULL;
+    }
+    /* the key stays, so that the file is not parsed again while its module is compiled */
+    ape_strdict_set(comp->preparsed, path, NULL);
+    pp->parser->errors = comp->errors;
+    return pp;
+}
+
+/* moves the errors of parsing 'pp' to the compiler; returns whether there is a tree to compile */
+bool ape_prefetch_reporterrors(ApeAstCompiler* comp, ApeAstPreparsed* pp)
+{
+    ApeSize i;
+    ApeError* err;
+    for(i = 0; i < ape_errorlist_count(&pp->errors); i++)
+    {
+        err = ape_errorlist_getat(&pp->errors, i);
+        ape_errorlist_add(comp->errors, (ApeErrorType)err->errtype, err->pos, err->message);
+    }
+    ape_errorlist_clear(&pp->errors);
+    return (pp->statements != NULL);
+}
+
+void* ape_prefetch_destroy(ApeContext* ctx, ApeAstPreparsed* pp)
+{
+    if(!pp)
+    {
+        return NULL;
+    }
+    ape_parser_destroy(pp->parser);
+    if(pp->file)
+    {
+        ape_compfile_destroy(ctx, pp->file);
+    }
+    ape_errorlist_destroy(&pp->errors);
+    ape_allocator_free(&ctx->alloc, pp->code);
+    ape_allocator_free(&ctx->alloc, pp);
+    return NULL;
+}
+
+/* drops whatever was parsed ahead of time but not included */
+void ape_prefetch_clear(ApeAstCompiler* comp)
+{
+    if(comp->preparsed)
+    {
+        ape_strdict_destroywithitems(comp->context, comp->preparsed);
+        comp->preparsed = NULL;
+    }
+}
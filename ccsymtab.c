@@ -11,7 +11,7 @@ ApeSymbol* ape_make_symbol(ApeContext* ctx, const char* name, ApeSymbolType type
     }
     memset(symbol, 0, sizeof(ApeSymbol));
     symbol->context = ctx;
-    symbol->name = ape_util_strdup(ctx, name);
+    symbol->name = ape_nametable_intern(&ctx->names, name, strlen(name));
     if(!symbol->name)
     {
         ape_allocator_free(&ctx->alloc, symbol);
@@ -29,14 +29,29 @@ void* ape_symbol_destroy(ApeContext* ctx, ApeSymbol* symbol)
     {
         return NULL;
     }
-    ape_allocator_free(&ctx->alloc, symbol->name);
+    ape_ast_destroy_expr(ctx, symbol->constvalue);
     ape_allocator_free(&ctx->alloc, symbol);
     return NULL;
 }
 
 ApeSymbol* ape_symbol_copy(ApeContext* ctx, ApeSymbol* symbol)
 {
-    return ape_make_symbol(ctx, symbol->name, symbol->symtype, symbol->index, symbol->assignable);
+    ApeSymbol* copy;
+    copy = ape_make_symbol(ctx, symbol->name, symbol->symtype, symbol->index, symbol->assignable);
+    if(!copy)
+    {
+        return NULL;
+    }
+    copy->infertype = symbol->infertype;
+    if(symbol->constvalue)
+    {
+        copy->constvalue = ape_ast_copy_expr(&ctx->astheap, symbol->constvalue);
+        if(!copy->constvalue)
+        {
+            return (ApeSymbol*)ape_symbol_destroy(ctx, copy);
+        }
+    }
+    return copy;
 }
 
 ApeSymTable* ape_make_symtable(ApeContext* ctx, ApeSymTable* outer, ApeGlobalStore* global_store, int mgo)
@@ -50,6 +65,7 @@ ApeSymTable* ape_make_symtable(ApeContext* ctx, ApeSymTable* outer, ApeGlobalSto
     }
     memset(table, 0, sizeof(ApeSymTable));
     table->context = ctx;
+    ape_namemap_init(&table->resolved, ctx);
     table->maxnumdefinitions = 0;
     table->outer = outer;
     table->globalstore = global_store;
@@ -95,6 +111,7 @@ void ape_symtable_destroy(ApeSymTable* table)
     ape_ptrarray_destroy(table->blockscopes);
     ape_ptrarray_destroywithitems(ctx, table->modglobalsymbols, (ApeDataCallback)ape_symbol_destroy);
     ape_ptrarray_destroywithitems(ctx, table->freesymbols, (ApeDataCallback)ape_symbol_destroy);
+    ape_namemap_deinit(&table->resolved);
     memset(table, 0, sizeof(ApeSymTable));
     ape_allocator_free(&ctx->alloc, table);
 }
@@ -110,6 +127,7 @@ ApeSymTable* ape_symtable_copy(ApeContext* ctx, ApeSymTable* table)
     }
     memset(copy, 0, sizeof(ApeSymTable));
     copy->context = ctx;
+    ape_namemap_init(&copy->resolved, ctx);
     copy->outer = NULL;
     copy->globalstore = NULL;
     copy->blockscopes = NULL;
@@ -144,6 +162,15 @@ err:
 }
 
 
+/* drops what 'name' resolved to, once a symbol of that name is added or goes away */
+static void ape_symtable_forget(ApeSymTable* table, const char* name)
+{
+    if(ape_namemap_get(&table->resolved, name) != NULL)
+    {
+        ape_namemap_set(&table->resolved, name, NULL);
+    }
+}
+
 bool ape_symtable_setsymbol(ApeSymTable* table, ApeSymbol* symbol)
 {
     ApeAstBlockScope* topscope;
@@ -151,15 +178,13 @@ bool ape_symtable_setsymbol(ApeSymTable* table, ApeSymbol* symbol)
     topscope = (ApeAstBlockScope*)ape_ptrarray_top(table->blockscopes);
     if(topscope != NULL)
     {
-        if(topscope->store)
+        existing = (ApeSymbol*)ape_namemap_get(&topscope->store, symbol->name);
+        if(existing)
         {
-            existing= (ApeSymbol*)ape_strdict_getbyname(topscope->store, symbol->name);
-            if(existing)
-            {
-                ape_symbol_destroy(table->context, existing);
-            }
-            return ape_strdict_set(topscope->store, symbol->name, symbol);
+            ape_symbol_destroy(table->context, existing);
         }
+        ape_symtable_forget(table, symbol->name);
+        return ape_namemap_set(&topscope->store, symbol->name, symbol);
     }
     return false;
 }
@@ -366,7 +391,7 @@ ApeSymbol* ape_symtable_definethis(ApeSymTable* st)
     return symbol;
 }
 
-ApeSymbol* ape_symtable_resolve(ApeSymTable* table, const char* name)
+static ApeSymbol* ape_symtable_lookup(ApeSymTable* table, const char* name)
 {
     ApeInt i;
     ApeSymbol* symbol;
@@ -380,7 +405,7 @@ ApeSymbol* ape_symtable_resolve(ApeSymTable* table, const char* name)
     for(i = (ApeInt)ape_ptrarray_count(table->blockscopes) - 1; i >= 0; i--)
     {
         scope = (ApeAstBlockScope*)ape_ptrarray_get(table->blockscopes, i);
-        symbol = (ApeSymbol*)ape_strdict_getbyname(scope->store, name);
+        symbol = (ApeSymbol*)ape_namemap_get(&scope->store, name);
         if(symbol)
         {
             break;
@@ -407,6 +432,26 @@ ApeSymbol* ape_symtable_resolve(ApeSymTable* table, const char* name)
     return symbol;
 }
 
+/*
+* 'name' must be interned (see ApeNameTable).
+* repeated lookups of a name are answered from table->resolved, without walking the scopes.
+*/
+ApeSymbol* ape_symtable_resolve(ApeSymTable* table, const char* name)
+{
+    ApeSymbol* symbol;
+    symbol = (ApeSymbol*)ape_namemap_get(&table->resolved, name);
+    if(symbol)
+    {
+        return symbol;
+    }
+    symbol = ape_symtable_lookup(table, name);
+    if(symbol)
+    {
+        ape_namemap_set(&table->resolved, name, symbol);
+    }
+    return symbol;
+}
+
 bool ape_symtable_symbol_is_defined(ApeSymTable* table, const char* name)
 {
     ApeAstBlockScope* topscope;
@@ -418,7 +463,7 @@ bool ape_symtable_symbol_is_defined(ApeSymTable* table, const char* name)
         return true;
     }
     topscope = (ApeAstBlockScope*)ape_ptrarray_top(table->blockscopes);
-    symbol = (ApeSymbol*)ape_strdict_getbyname(topscope->store, name);
+    symbol = (ApeSymbol*)ape_namemap_get(&topscope->store, name);
     if(symbol)
     {
         return true;
@@ -458,8 +503,13 @@ bool ape_symtable_pushblockscope(ApeSymTable* table)
 
 void ape_symtable_popblockscope(ApeSymTable* table)
 {
+    ApeSize i;
     ApeAstBlockScope* topscope;
     topscope = (ApeAstBlockScope*)ape_ptrarray_top(table->blockscopes);
+    for(i = 0; i < ape_namemap_count(&topscope->store); i++)
+    {
+        ape_symtable_forget(table, ape_namemap_getkeyat(&topscope->store, i));
+    }
     ape_ptrarray_pop(table->blockscopes);
     ape_blockscope_destroy(table->context, topscope);
 }
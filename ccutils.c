@@ -3,43 +3,146 @@
 
 static const ApePosition g_prspriv_srcposinvalid = { NULL, -1, -1 };
 
-ApeAstIdentExpr* ape_ast_make_ident(ApeContext* ctx, ApeAstToken tok)
+void ape_astarena_init(ApeAstArena* arena, ApeContext* ctx, bool isbump)
+{
+    memset(arena, 0, sizeof(ApeAstArena));
+    arena->context = ctx;
+    arena->isbump = isbump;
+    arena->nextchunksize = APE_CONF_SIZE_ASTARENA_MINCHUNK;
+}
+
+void* ape_astarena_alloc(ApeAstArena* arena, ApeSize size)
+{
+    ApeSize chunksize;
+    void* res;
+    ApeAstArenaChunk* chunk;
+    if(!arena->isbump)
+    {
+        return ape_allocator_alloc(&arena->context->alloc, size);
+    }
+    /* keep every allocation pointer-aligned */
+    size = (size + (sizeof(void*) - 1)) & ~(sizeof(void*) - 1);
+    if(size > arena->remaining)
+    {
+        chunksize = arena->nextchunksize;
+        if(chunksize < size)
+        {
+            chunksize = size;
+        }
+        chunk = (ApeAstArenaChunk*)ape_allocator_alloc(&arena->context->alloc, sizeof(ApeAstArenaChunk) + chunksize);
+        if(!chunk)
+        {
+            return NULL;
+        }
+        chunk->next = arena->chunks;
+        chunk->size = chunksize;
+        arena->chunks = chunk;
+        arena->cursor = (char*)(chunk + 1);
+        arena->remaining = chunksize;
+        if(arena->nextchunksize < APE_CONF_SIZE_ASTARENA_MAXCHUNK)
+        {
+            arena->nextchunksize *= 2;
+        }
+    }
+    res = arena->cursor;
+    arena->cursor += size;
+    arena->remaining -= size;
+    return res;
+}
+
+/* only heap arenas free anything here; bump arenas get their memory back in ape_astarena_release */
+void ape_astarena_free(ApeAstArena* arena, void* ptr)
+{
+    if(!arena->isbump)
+    {
+        ape_allocator_free(&arena->context->alloc, ptr);
+    }
+}
+
+char* ape_astarena_strndup(ApeAstArena* arena, const char* str, ApeSize len)
+{
+    char* res;
+    res = (char*)ape_astarena_alloc(arena, len + 1);
+    if(!res)
+    {
+        return NULL;
+    }
+    memcpy(res, str, len);
+    res[len] = '\0';
+    return res;
+}
+
+char* ape_astarena_strdup(ApeAstArena* arena, const char* str)
+{
+    if(!str)
+    {
+        return NULL;
+    }
+    return ape_astarena_strndup(arena, str, strlen(str));
+}
+
+/* frees everything allocated from a bump arena; it can be used again afterwards */
+void ape_astarena_release(ApeAstArena* arena)
+{
+    ApeAstArenaChunk* chunk;
+    ApeAstArenaChunk* next;
+    for(chunk = arena->chunks; chunk != NULL; chunk = next)
+    {
+        next = chunk->next;
+        ape_allocator_free(&arena->context->alloc, chunk);
+    }
+    arena->chunks = NULL;
+    arena->cursor = NULL;
+    arena->remaining = 0;
+    arena->nextchunksize = APE_CONF_SIZE_ASTARENA_MINCHUNK;
+}
+
+ApeAstIdentExpr* ape_ast_make_ident(ApeAstArena* arena, ApeAstToken tok)
 {
     ApeAstIdentExpr* res;
-    res = (ApeAstIdentExpr*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstIdentExpr));
+    res = (ApeAstIdentExpr*)ape_astarena_alloc(arena, sizeof(ApeAstIdentExpr));
     if(!res)
     {
         return NULL;
     }
-    res->context = ctx;
-    res->value = ape_lexer_tokendupliteral(ctx, &tok);
+    res->context = arena->context;
+    res->arena = arena;
+    /* tokens the parser made up itself were not interned by the lexer */
+    res->value = tok.name;
     if(!res->value)
     {
-        ape_allocator_free(&ctx->alloc, res);
+        res->value = ape_nametable_intern(&arena->context->names, tok.literal, tok.len);
+    }
+    if(!res->value)
+    {
+        ape_astarena_free(arena, res);
         return NULL;
     }
     res->pos = tok.pos;
     return res;
 }
 
-ApeAstExpression* ape_ast_make_expression(ApeContext* ctx, ApeAstExprType type)
+ApeAstExpression* ape_ast_make_expression(ApeAstArena* arena, ApeAstExprType type)
 {
     ApeAstExpression* res;
-    res = (ApeAstExpression*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstExpression));
+    res = (ApeAstExpression*)ape_astarena_alloc(arena, sizeof(ApeAstExpression));
     if(!res)
     {
         return NULL;
     }
-    res->context = ctx;
+    res->context = arena->context;
+    res->arena = arena;
     res->extype = type;
     res->pos = g_prspriv_srcposinvalid;
+    res->optimized = false;
+    res->infertype = APE_INFER_UNKNOWN;
     return res;
 }
 
-ApeAstExpression* ape_ast_make_identexpr(ApeContext* ctx, ApeAstIdentExpr* ident)
+ApeAstExpression* ape_ast_make_identexpr(ApeAstArena* arena, ApeAstIdentExpr* ident)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_IDENT);
+    res = ape_ast_make_expression(arena, APE_EXPR_IDENT);
     if(!res)
     {
         return NULL;
@@ -48,10 +151,10 @@ ApeAstExpression* ape_ast_make_identexpr(ApeContext* ctx, ApeAstIdentExpr* ident
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalnumberexpr(ApeContext* ctx, ApeFloat val)
+ApeAstExpression* ape_ast_make_literalnumberexpr(ApeAstArena* arena, ApeFloat val)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALNUMBER);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALNUMBER);
     if(!res)
     {
         return NULL;
@@ -60,10 +163,10 @@ ApeAstExpression* ape_ast_make_literalnumberexpr(ApeContext* ctx, ApeFloat val)
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalboolexpr(ApeContext* ctx, bool val)
+ApeAstExpression* ape_ast_make_literalboolexpr(ApeAstArena* arena, bool val)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALBOOL);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALBOOL);
     if(!res)
     {
         return NULL;
@@ -72,10 +175,10 @@ ApeAstExpression* ape_ast_make_literalboolexpr(ApeContext* ctx, bool val)
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalstringexpr(ApeContext* ctx, char* value, ApeSize len, bool wasallocd)
+ApeAstExpression* ape_ast_make_literalstringexpr(ApeAstArena* arena, char* value, ApeSize len, bool wasallocd)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALSTRING);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALSTRING);
     if(!res)
     {
         return NULL;
@@ -86,10 +189,10 @@ ApeAstExpression* ape_ast_make_literalstringexpr(ApeContext* ctx, char* value, A
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalnullexpr(ApeContext* ctx)
+ApeAstExpression* ape_ast_make_literalnullexpr(ApeAstArena* arena)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALNULL);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALNULL);
     if(!res)
     {
         return NULL;
@@ -97,10 +200,10 @@ ApeAstExpression* ape_ast_make_literalnullexpr(ApeContext* ctx)
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalarrayexpr(ApeContext* ctx, ApePtrArray * values)
+ApeAstExpression* ape_ast_make_literalarrayexpr(ApeAstArena* arena, ApePtrArray * values)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALARRAY);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALARRAY);
     if(!res)
     {
         return NULL;
@@ -109,10 +212,10 @@ ApeAstExpression* ape_ast_make_literalarrayexpr(ApeContext* ctx, ApePtrArray * v
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalmapexpr(ApeContext* ctx, ApePtrArray * keys, ApePtrArray * values)
+ApeAstExpression* ape_ast_make_literalmapexpr(ApeAstArena* arena, ApePtrArray * keys, ApePtrArray * values)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALMAP);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALMAP);
     if(!res)
     {
         return NULL;
@@ -122,10 +225,10 @@ ApeAstExpression* ape_ast_make_literalmapexpr(ApeContext* ctx, ApePtrArray * key
     return res;
 }
 
-ApeAstExpression* ape_ast_make_prefixexpr(ApeContext* ctx, ApeOperator op, ApeAstExpression* right)
+ApeAstExpression* ape_ast_make_prefixexpr(ApeAstArena* arena, ApeOperator op, ApeAstExpression* right)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_PREFIX);
+    res = ape_ast_make_expression(arena, APE_EXPR_PREFIX);
     if(!res)
     {
         return NULL;
@@ -135,10 +238,10 @@ ApeAstExpression* ape_ast_make_prefixexpr(ApeContext* ctx, ApeOperator op, ApeAs
     return res;
 }
 
-ApeAstExpression* ape_ast_make_infixexpr(ApeContext* ctx, ApeOperator op, ApeAstExpression* left, ApeAstExpression* right)
+ApeAstExpression* ape_ast_make_infixexpr(ApeAstArena* arena, ApeOperator op, ApeAstExpression* left, ApeAstExpression* right)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_INFIX);
+    res = ape_ast_make_expression(arena, APE_EXPR_INFIX);
     if(!res)
     {
         return NULL;
@@ -149,10 +252,10 @@ ApeAstExpression* ape_ast_make_infixexpr(ApeContext* ctx, ApeOperator op, ApeAst
     return res;
 }
 
-ApeAstExpression* ape_ast_make_literalfuncexpr(ApeContext* ctx, ApePtrArray * params, ApeAstBlockExpr* body)
+ApeAstExpression* ape_ast_make_literalfuncexpr(ApeAstArena* arena, ApePtrArray * params, ApeAstBlockExpr* body)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LITERALFUNCTION);
+    res = ape_ast_make_expression(arena, APE_EXPR_LITERALFUNCTION);
     if(!res)
     {
         return NULL;
@@ -163,10 +266,10 @@ ApeAstExpression* ape_ast_make_literalfuncexpr(ApeContext* ctx, ApePtrArray * pa
     return res;
 }
 
-ApeAstExpression* ape_ast_make_callexpr(ApeContext* ctx, ApeAstExpression* function, ApePtrArray * args)
+ApeAstExpression* ape_ast_make_callexpr(ApeAstArena* arena, ApeAstExpression* function, ApePtrArray * args)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_CALL);
+    res = ape_ast_make_expression(arena, APE_EXPR_CALL);
     if(!res)
     {
         return NULL;
@@ -176,10 +279,10 @@ ApeAstExpression* ape_ast_make_callexpr(ApeContext* ctx, ApeAstExpression* funct
     return res;
 }
 
-ApeAstExpression* ape_ast_make_indexexpr(ApeContext* ctx, ApeAstExpression* left, ApeAstExpression* index)
+ApeAstExpression* ape_ast_make_indexexpr(ApeAstArena* arena, ApeAstExpression* left, ApeAstExpression* index)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_INDEX);
+    res = ape_ast_make_expression(arena, APE_EXPR_INDEX);
     if(!res)
     {
         return NULL;
@@ -189,10 +292,10 @@ ApeAstExpression* ape_ast_make_indexexpr(ApeContext* ctx, ApeAstExpression* left
     return res;
 }
 
-ApeAstExpression* ape_ast_make_assignexpr(ApeContext* ctx, ApeAstExpression* dest, ApeAstExpression* source, bool ispostfix)
+ApeAstExpression* ape_ast_make_assignexpr(ApeAstArena* arena, ApeAstExpression* dest, ApeAstExpression* source, bool ispostfix)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_ASSIGN);
+    res = ape_ast_make_expression(arena, APE_EXPR_ASSIGN);
     if(!res)
     {
         return NULL;
@@ -203,10 +306,10 @@ ApeAstExpression* ape_ast_make_assignexpr(ApeContext* ctx, ApeAstExpression* des
     return res;
 }
 
-ApeAstExpression* ape_ast_make_logicalexpr(ApeContext* ctx, ApeOperator op, ApeAstExpression* left, ApeAstExpression* right)
+ApeAstExpression* ape_ast_make_logicalexpr(ApeAstArena* arena, ApeOperator op, ApeAstExpression* left, ApeAstExpression* right)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_LOGICAL);
+    res = ape_ast_make_expression(arena, APE_EXPR_LOGICAL);
     if(!res)
     {
         return NULL;
@@ -217,10 +320,10 @@ ApeAstExpression* ape_ast_make_logicalexpr(ApeContext* ctx, ApeOperator op, ApeA
     return res;
 }
 
-ApeAstExpression* ape_ast_make_ternaryexpr(ApeContext* ctx, ApeAstExpression* test, ApeAstExpression* iftrue, ApeAstExpression* iffalse)
+ApeAstExpression* ape_ast_make_ternaryexpr(ApeAstArena* arena, ApeAstExpression* test, ApeAstExpression* iftrue, ApeAstExpression* iffalse)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_TERNARY);
+    res = ape_ast_make_expression(arena, APE_EXPR_TERNARY);
     if(!res)
     {
         return NULL;
@@ -231,10 +334,10 @@ ApeAstExpression* ape_ast_make_ternaryexpr(ApeContext* ctx, ApeAstExpression* te
     return res;
 }
 
-ApeAstExpression* ape_ast_make_definestmt(ApeContext* ctx, ApeAstIdentExpr* name, ApeAstExpression* value, bool assignable)
+ApeAstExpression* ape_ast_make_definestmt(ApeAstArena* arena, ApeAstIdentExpr* name, ApeAstExpression* value, bool assignable)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_DEFINE);
+    res = ape_ast_make_expression(arena, APE_EXPR_DEFINE);
     if(!res)
     {
         return NULL;
@@ -245,10 +348,10 @@ ApeAstExpression* ape_ast_make_definestmt(ApeContext* ctx, ApeAstIdentExpr* name
     return res;
 }
 
-ApeAstExpression* ape_ast_make_ifstmt(ApeContext* ctx, ApePtrArray * cases, ApeAstBlockExpr* alternative)
+ApeAstExpression* ape_ast_make_ifstmt(ApeAstArena* arena, ApePtrArray * cases, ApeAstBlockExpr* alternative)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_IFELSE);
+    res = ape_ast_make_expression(arena, APE_EXPR_IFELSE);
     if(!res)
     {
         return NULL;
@@ -258,10 +361,10 @@ ApeAstExpression* ape_ast_make_ifstmt(ApeContext* ctx, ApePtrArray * cases, ApeA
     return res;
 }
 
-ApeAstExpression* ape_ast_make_returnstmt(ApeContext* ctx, ApeAstExpression* value)
+ApeAstExpression* ape_ast_make_returnstmt(ApeAstArena* arena, ApeAstExpression* value)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_RETURNVALUE);
+    res = ape_ast_make_expression(arena, APE_EXPR_RETURNVALUE);
     if(!res)
     {
         return NULL;
@@ -270,10 +373,10 @@ ApeAstExpression* ape_ast_make_returnstmt(ApeContext* ctx, ApeAstExpression* val
     return res;
 }
 
-ApeAstExpression* ape_ast_make_expressionstmt(ApeContext* ctx, ApeAstExpression* value)
+ApeAstExpression* ape_ast_make_expressionstmt(ApeAstArena* arena, ApeAstExpression* value)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_EXPRESSION);
+    res = ape_ast_make_expression(arena, APE_EXPR_EXPRESSION);
     if(!res)
     {
         return NULL;
@@ -282,10 +385,10 @@ ApeAstExpression* ape_ast_make_expressionstmt(ApeContext* ctx, ApeAstExpression*
     return res;
 }
 
-ApeAstExpression* ape_ast_make_whilestmt(ApeContext* ctx, ApeAstExpression* test, ApeAstBlockExpr* body)
+ApeAstExpression* ape_ast_make_whilestmt(ApeAstArena* arena, ApeAstExpression* test, ApeAstBlockExpr* body)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_WHILELOOP);
+    res = ape_ast_make_expression(arena, APE_EXPR_WHILELOOP);
     if(!res)
     {
         return NULL;
@@ -295,10 +398,10 @@ ApeAstExpression* ape_ast_make_whilestmt(ApeContext* ctx, ApeAstExpression* test
     return res;
 }
 
-ApeAstExpression* ape_ast_make_breakstmt(ApeContext* ctx)
+ApeAstExpression* ape_ast_make_breakstmt(ApeAstArena* arena)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_BREAK);
+    res = ape_ast_make_expression(arena, APE_EXPR_BREAK);
     if(!res)
     {
         return NULL;
@@ -306,24 +409,25 @@ ApeAstExpression* ape_ast_make_breakstmt(ApeContext* ctx)
     return res;
 }
 
-ApeAstExpression* ape_ast_make_foreachstmt(ApeContext* ctx, ApeAstIdentExpr* iterator, ApeAstExpression* source, ApeAstBlockExpr* body)
+ApeAstExpression* ape_ast_make_foreachstmt(ApeAstArena* arena, ApeAstIdentExpr* iterator, ApeAstIdentExpr* valueiterator, ApeAstExpression* source, ApeAstBlockExpr* body)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_FOREACH);
+    res = ape_ast_make_expression(arena, APE_EXPR_FOREACH);
     if(!res)
     {
         return NULL;
     }
     res->exforeachstmt.iterator = iterator;
+    res->exforeachstmt.valueiterator = valueiterator;
     res->exforeachstmt.source = source;
     res->exforeachstmt.body = body;
     return res;
 }
 
-ApeAstExpression* ape_ast_make_forstmt(ApeContext* ctx, ApeAstExpression* init, ApeAstExpression* test, ApeAstExpression* update, ApeAstBlockExpr* body)
+ApeAstExpression* ape_ast_make_forstmt(ApeAstArena* arena, ApeAstExpression* init, ApeAstExpression* test, ApeAstExpression* update, ApeAstBlockExpr* body)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_FORLOOP);
+    res = ape_ast_make_expression(arena, APE_EXPR_FORLOOP);
     if(!res)
     {
         return NULL;
@@ -335,10 +439,10 @@ ApeAstExpression* ape_ast_make_forstmt(ApeContext* ctx, ApeAstExpression* init,
     return res;
 }
 
-ApeAstExpression* ape_ast_make_continuestmt(ApeContext* ctx)
+ApeAstExpression* ape_ast_make_continuestmt(ApeAstArena* arena)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_CONTINUE);
+    res = ape_ast_make_expression(arena, APE_EXPR_CONTINUE);
     if(!res)
     {
         return NULL;
@@ -346,10 +450,10 @@ ApeAstExpression* ape_ast_make_continuestmt(ApeContext* ctx)
     return res;
 }
 
-ApeAstExpression* ape_ast_make_blockstmt(ApeContext* ctx, ApeAstBlockExpr* block)
+ApeAstExpression* ape_ast_make_blockstmt(ApeAstArena* arena, ApeAstBlockExpr* block)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_BLOCK);
+    res = ape_ast_make_expression(arena, APE_EXPR_BLOCK);
     if(!res)
     {
         return NULL;
@@ -358,10 +462,10 @@ ApeAstExpression* ape_ast_make_blockstmt(ApeContext* ctx, ApeAstBlockExpr* block
     return res;
 }
 
-ApeAstExpression* ape_ast_make_includestmt(ApeContext* ctx, char* path)
+ApeAstExpression* ape_ast_make_includestmt(ApeAstArena* arena, char* path)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_INCLUDE);
+    res = ape_ast_make_expression(arena, APE_EXPR_INCLUDE);
     if(!res)
     {
         return NULL;
@@ -370,10 +474,10 @@ ApeAstExpression* ape_ast_make_includestmt(ApeContext* ctx, char* path)
     return res;
 }
 
-ApeAstExpression* ape_ast_make_recoverstmt(ApeContext* ctx, ApeAstIdentExpr* errorident, ApeAstBlockExpr* body)
+ApeAstExpression* ape_ast_make_recoverstmt(ApeAstArena* arena, ApeAstIdentExpr* errorident, ApeAstBlockExpr* body)
 {
     ApeAstExpression* res;
-    res = ape_ast_make_expression(ctx, APE_EXPR_RECOVER);
+    res = ape_ast_make_expression(arena, APE_EXPR_RECOVER);
     if(!res)
     {
         return NULL;
@@ -383,66 +487,103 @@ ApeAstExpression* ape_ast_make_recoverstmt(ApeContext* ctx, ApeAstIdentExpr* err
     return res;
 }
 
-ApeAstBlockExpr* ape_ast_make_codeblock(ApeContext* ctx, ApePtrArray * statements)
+ApeAstBlockExpr* ape_ast_make_codeblock(ApeAstArena* arena, ApePtrArray * statements)
 {
     ApeAstBlockExpr* block;
-    block = (ApeAstBlockExpr*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstBlockExpr));
+    block = (ApeAstBlockExpr*)ape_astarena_alloc(arena, sizeof(ApeAstBlockExpr));
     if(!block)
     {
         return NULL;
     }
-    block->context = ctx;
+    block->context = arena->context;
+    block->arena = arena;
     block->statements = statements;
     return block;
 }
 
-ApeAstIdentExpr* ape_ast_copy_ident(ApeContext* ctx, ApeAstIdentExpr* ident)
+ApeAstIdentExpr* ape_ast_copy_ident(ApeAstArena* arena, ApeAstIdentExpr* ident)
 {
     ApeAstIdentExpr* res;
-    res = (ApeAstIdentExpr*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstIdentExpr));
+    res = (ApeAstIdentExpr*)ape_astarena_alloc(arena, sizeof(ApeAstIdentExpr));
     if(!res)
     {
         return NULL;
     }
-    res->context = ctx;
-    res->value = ape_util_strdup(ctx, ident->value);
+    res->context = arena->context;
+    res->arena = arena;
+    res->value = ident->value;
+    if(arena->context != ident->context)
+    {
+        res->value = ape_nametable_intern(&arena->context->names, ident->value, strlen(ident->value));
+    }
     if(!res->value)
     {
-        ape_allocator_free(&ctx->alloc, res);
+        ape_astarena_free(arena, res);
         return NULL;
     }
     res->pos = ident->pos;
     return res;
 }
 
-ApeAstBlockExpr* ape_ast_copy_codeblock(ApeContext* ctx, ApeAstBlockExpr* block)
+/* copies a list of nodes into arena; the list itself is allocated there as well */
+ApePtrArray* ape_ast_copylist(ApeAstArena* arena, ApePtrArray* list, ApeAstCopyCallback copyfn, ApeDataCallback destroyfn)
+{
+    ApeSize i;
+    void* item;
+    void* copieditem;
+    ApePtrArray* copy;
+    copy = ape_make_ptrarrayarena(arena);
+    if(!copy)
+    {
+        return NULL;
+    }
+    for(i = 0; i < ape_ptrarray_count(list); i++)
+    {
+        item = ape_ptrarray_get(list, i);
+        copieditem = copyfn(arena, item);
+        if(item && !copieditem)
+        {
+            goto err;
+        }
+        if(!ape_ptrarray_push(copy, &copieditem))
+        {
+            destroyfn(arena->context, copieditem);
+            goto err;
+        }
+    }
+    return copy;
+err:
+    ape_ptrarray_destroywithitems(arena->context, copy, destroyfn);
+    return NULL;
+}
+
+ApeAstBlockExpr* ape_ast_copy_codeblock(ApeAstArena* arena, ApeAstBlockExpr* block)
 {
     ApeAstBlockExpr* res;
     ApePtrArray* statementscopy;
-    ApeDataCallback copyfn;
+    ApeAstCopyCallback copyfn;
     ApeDataCallback destroyfn;
-    copyfn = (ApeDataCallback)ape_ast_copy_expr;
+    copyfn = (ApeAstCopyCallback)ape_ast_copy_expr;
     destroyfn = (ApeDataCallback)ape_ast_destroy_expr;
     if(!block)
     {
         return NULL;
     }
-    statementscopy = ape_ptrarray_copywithitems(ctx, block->statements, copyfn, destroyfn);
+    statementscopy = ape_ast_copylist(arena, block->statements, copyfn, destroyfn);
     if(!statementscopy)
     {
         return NULL;
     }
-    res = ape_ast_make_codeblock(ctx, statementscopy);
+    res = ape_ast_make_codeblock(arena, statementscopy);
     if(!res)
     {
-        ape_ptrarray_destroywithitems(ctx, statementscopy, destroyfn);
+        ape_ptrarray_destroywithitems(arena->context, statementscopy, destroyfn);
         return NULL;
     }
-    res->context = ctx;
     return res;
 }
 
-ApeAstIfCaseExpr* ape_ast_copy_ifcase(ApeContext* ctx, ApeAstIfCaseExpr* ifcase)
+ApeAstIfCaseExpr* ape_ast_copy_ifcase(ApeAstArena* arena, ApeAstIfCaseExpr* ifcase)
 {
     ApeAstExpression* testcopy;
     ApeAstBlockExpr* consequencecopy;
@@ -454,27 +595,26 @@ ApeAstIfCaseExpr* ape_ast_copy_ifcase(ApeContext* ctx, ApeAstIfCaseExpr* ifcase)
     testcopy = NULL;
     consequencecopy = NULL;
     ifcasecopy = NULL;
-    testcopy = ape_ast_copy_expr(ctx, ifcase->test);
+    testcopy = ape_ast_copy_expr(arena, ifcase->test);
     if(!testcopy)
     {
         goto err;
     }
-    consequencecopy = ape_ast_copy_codeblock(ctx, ifcase->consequence);
+    consequencecopy = ape_ast_copy_codeblock(arena, ifcase->consequence);
     if(!testcopy || !consequencecopy)
     {
         goto err;
     }
-    ifcasecopy = ape_ast_make_ifcase(ctx, testcopy, consequencecopy);
+    ifcasecopy = ape_ast_make_ifcase(arena, testcopy, consequencecopy);
     if(!ifcasecopy)
     {
         goto err;
     }
-    ifcasecopy->context = ctx;
     return ifcasecopy;
 err:
-    ape_ast_destroy_expr(ctx, testcopy);
+    ape_ast_destroy_expr(arena->context, testcopy);
     ape_ast_destroy_codeblock(consequencecopy);
-    ape_ast_destroy_ifcase(ctx, ifcasecopy);
+    ape_ast_destroy_ifcase(arena->context, ifcasecopy);
     return NULL;
 }
 
@@ -510,11 +650,6 @@ ApeAstCompFile* ape_make_compfile(ApeContext* ctx, const char* path)
     {
         goto error;
     }
-    file->lines = ape_make_ptrarray(ctx);
-    if(!file->lines)
-    {
-        goto error;
-    }
     return file;
 error:
     ape_compfile_destroy(ctx, file);
@@ -523,24 +658,176 @@ error:
 
 void* ape_compfile_destroy(ApeContext* ctx, ApeAstCompFile* file)
 {
-    ApeSize i;
-    void* item;
     if(!file)
     {
         return NULL;
     }
-    for(i = 0; i < ape_ptrarray_count(file->lines); i++)
-    {
-        item = (void*)ape_ptrarray_get(file->lines, i);
-        ape_allocator_free(&ctx->alloc, item);
-    }
-    ape_ptrarray_destroy(file->lines);
+    ape_valarray_destroy(file->lineoffsets);
+    ape_allocator_free(&ctx->alloc, file->source);
     ape_allocator_free(&ctx->alloc, file->dirpath);
     ape_allocator_free(&ctx->alloc, file->path);
     ape_allocator_free(&ctx->alloc, file);
     return NULL;
 }
 
+/* appends 'len' bytes of text plus a newline ending them, keeping a NUL after the lot */
+static bool ape_compfile_appendtext(ApeAstCompFile* file, const char* src, ApeSize len)
+{
+    ApeSize newcap;
+    char* newsource;
+    if((file->sourcelen + len + 2) > file->sourcecap)
+    {
+        newcap = (file->sourcecap * 2) + len + 2;
+        newsource = (char*)ape_allocator_realloc(&file->context->alloc, file->source, file->sourcecap, newcap);
+        if(!newsource)
+        {
+            return false;
+        }
+        file->source = newsource;
+        file->sourcecap = newcap;
+    }
+    memcpy(file->source + file->sourcelen, src, len);
+    file->sourcelen += len;
+    file->source[file->sourcelen] = '\n';
+    file->sourcelen++;
+    file->source[file->sourcelen] = '\0';
+    return true;
+}
+
+/*
+* appends a source text to the file, starting a new line.
+* only the lines are counted here; whether the text is copied depends on the source mode,
+* and where each line starts is left to ape_compfile_loadlines.
+*/
+bool ape_compfile_addsource(ApeAstCompFile* file, const char* src, ApeSize len)
+{
+    const char* p;
+    const char* end;
+    const char* nl;
+    ApeSourceMode mode;
+    p = src;
+    end = src + len;
+    file->linecount++;
+    while((nl = (const char*)memchr(p, '\n', end - p)) != NULL)
+    {
+        file->linecount++;
+        p = nl + 1;
+    }
+    mode = file->context->config.sourcemode;
+    if((mode == APE_SOURCE_DROP) || ((mode == APE_SOURCE_REREAD) && file->ondisk))
+    {
+        return true;
+    }
+    return ape_compfile_appendtext(file, src, len);
+}
+
+/*
+* marks the file's text as the contents of the file at its path, 'size' bytes long.
+* must be called before its text is added.
+*/
+void ape_compfile_setondisk(ApeAstCompFile* file, ApeSize size)
+{
+    file->ondisk = true;
+    file->disksize = size;
+}
+
+/*
+* makes every line of the file available to ape_compfile_getline: reads the file again if
+* none of its text was kept, then indexes what was added since the last call.
+* a file that cannot be read, or no longer has the size it was compiled from, has no lines.
+*/
+bool ape_compfile_loadlines(ApeAstCompFile* file)
+{
+    size_t len;
+    char* data;
+    char* start;
+    char* nl;
+    ApeSize offset;
+    ApeSize errcount;
+    ApeContext* ctx;
+    ctx = file->context;
+    if(file->ondisk && !file->diskread && (file->sourcelen == 0) && (ctx->config.sourcemode != APE_SOURCE_DROP))
+    {
+        file->diskread = true;
+        if(ctx->config.fileio.fnreadfile)
+        {
+            /* a missing file only means there is no line to show */
+            errcount = ape_errorlist_count(&ctx->errors);
+            data = ctx->config.fileio.fnreadfile(ctx, file->path, -1, &len);
+            ape_errorlist_truncate(&ctx->errors, errcount);
+            if(data)
+            {
+                if(len == file->disksize)
+                {
+                    if(!ape_compfile_appendtext(file, data, len))
+                    {
+                        ape_allocator_free(&ctx->alloc, data);
+                        return false;
+                    }
+                }
+                ape_allocator_free(&ctx->alloc, data);
+            }
+        }
+    }
+    if(file->indexedlen == file->sourcelen)
+    {
+        return true;
+    }
+    if(!file->lineoffsets)
+    {
+        file->lineoffsets = ape_make_valarray(ctx, sizeof(ApeSize));
+        if(!file->lineoffsets)
+        {
+            return false;
+        }
+    }
+    start = file->source + file->indexedlen;
+    while(start < (file->source + file->sourcelen))
+    {
+        offset = start - file->source;
+        if(!ape_valarray_push(file->lineoffsets, &offset))
+        {
+            return false;
+        }
+        /* every chunk ends in a newline, so there always is one */
+        nl = (char*)memchr(start, '\n', (file->source + file->sourcelen) - start);
+        *nl = '\0';
+        start = nl + 1;
+    }
+    file->indexedlen = file->sourcelen;
+    /* a file replayed from the module cache without its text learns its line count here */
+    if(file->linecount == 0)
+    {
+        file->linecount = ape_valarray_count(file->lineoffsets);
+    }
+    return true;
+}
+
+ApeSize ape_compfile_linecount(const ApeAstCompFile* file)
+{
+    return file->linecount;
+}
+
+/*
+* returns the text of a line, or NULL if it was not kept.
+* the first lookup may index (or re-read) the source; a file shared across threads must
+* have had ape_compfile_loadlines called on it beforehand.
+*/
+const char* ape_compfile_getline(const ApeAstCompFile* file, ApeSize line)
+{
+    ApeSize* offset;
+    if(!ape_compfile_loadlines((ApeAstCompFile*)file))
+    {
+        return NULL;
+    }
+    if(!file->lineoffsets || (line >= ape_valarray_count(file->lineoffsets)))
+    {
+        return NULL;
+    }
+    offset = (ApeSize*)ape_valarray_get(file->lineoffsets, line);
+    return file->source + *offset;
+}
+
 ApeAstCompScope* ape_make_compscope(ApeContext* ctx, ApeAstCompScope* outer)
 {
     ApeAstCompScope* scope;
@@ -572,6 +859,16 @@ ApeAstCompScope* ape_make_compscope(ApeContext* ctx, ApeAstCompScope* outer)
     {
         goto err;
     }
+    scope->inferloops = ape_make_valarray(ctx, sizeof(ApeInferFlow*));
+    if(!scope->inferloops)
+    {
+        goto err;
+    }
+    scope->dupips = ape_make_valarray(ctx, sizeof(ApeInt));
+    if(!scope->dupips)
+    {
+        goto err;
+    }
     return scope;
 err:
     ape_compscope_destroy(scope);
@@ -582,6 +879,8 @@ void ape_compscope_destroy(ApeAstCompScope* scope)
 {
     ApeContext* ctx;
     ctx = scope->context;
+    ape_valarray_destroy(scope->dupips);
+    ape_valarray_destroy(scope->inferloops);
     ape_valarray_destroy(scope->continueipstack);
     ape_valarray_destroy(scope->breakipstack);
     ape_valarray_destroy(scope->bytecode);
@@ -602,12 +901,171 @@ ApeAstCompResult* ape_compscope_orphanresult(ApeAstCompScope* scope)
         return NULL;
     }
     ape_valarray_reset(scope->bytecode);
-    ape_valarray_reset(scope->srcpositions);
+    ape_valarray_clear(scope->srcpositions);
+    return res;
+}
+
+/*
+* source positions of a compilation result are kept as a line table rather than one
+* ApePosition per byte of code. it is a sequence of runs, one per stretch of code that
+* shares a position, each being
+*
+*   varint length, varint file (0 for none, else 1 + index into linefiles),
+*   svarint line delta, svarint column delta
+*
+* with the same varint encoding as the bytecode cache. it is only decoded when a position
+* is actually asked for, which is when an error or traceback is being built.
+*/
+
+static ApeSize ape_linetable_putvarint(unsigned char* out, uint64_t val)
+{
+    ApeSize n;
+    n = 0;
+    while(val >= 0x80)
+    {
+        if(out)
+        {
+            out[n] = (unsigned char)((val & 0x7f) | 0x80);
+        }
+        n++;
+        val >>= 7;
+    }
+    if(out)
+    {
+        out[n] = (unsigned char)val;
+    }
+    return n + 1;
+}
+
+static ApeSize ape_linetable_putsvarint(unsigned char* out, int64_t val)
+{
+    return ape_linetable_putvarint(out, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+static uint64_t ape_linetable_getvarint(const unsigned char** p)
+{
+    int shift;
+    uint64_t val;
+    val = 0;
+    for(shift = 0; shift < 64; shift += 7)
+    {
+        val |= ((uint64_t)(**p & 0x7f) << shift);
+        if(!(*((*p)++) & 0x80))
+        {
+            break;
+        }
+    }
+    return val;
+}
+
+static int64_t ape_linetable_getsvarint(const unsigned char** p)
+{
+    uint64_t val;
+    val = ape_linetable_getvarint(p);
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static bool ape_linetable_samepos(const ApePosition* a, const ApePosition* b)
+{
+    return (a->file == b->file) && (a->line == b->line) && (a->column == b->column);
+}
+
+/* 1-based index of 'file' in 'files', which gets it appended if it is not there yet */
+static ApeSize ape_linetable_fileindex(ApePtrArray* files, const ApeAstCompFile* file)
+{
+    ApeSize i;
+    if(file == NULL)
+    {
+        return 0;
+    }
+    for(i = 0; i < ape_ptrarray_count(files); i++)
+    {
+        if(ape_ptrarray_get(files, i) == file)
+        {
+            return i + 1;
+        }
+    }
+    if(!ape_ptrarray_push(files, &file))
+    {
+        return 0;
+    }
+    return ape_ptrarray_count(files);
+}
+
+/* writes the runs of 'positions' to 'out', or only measures them when 'out' is NULL */
+static ApeSize ape_linetable_encode(unsigned char* out, ApePtrArray* files, const ApePosition* positions, ApeSize count)
+{
+    ApeSize i;
+    ApeSize run;
+    ApeSize len;
+    int line;
+    int column;
+    len = 0;
+    line = 0;
+    column = 0;
+    i = 0;
+    while(i < count)
+    {
+        run = 1;
+        while(((i + run) < count) && ape_linetable_samepos(&positions[i + run], &positions[i]))
+        {
+            run++;
+        }
+        len += ape_linetable_putvarint(out ? (out + len) : NULL, run);
+        len += ape_linetable_putvarint(out ? (out + len) : NULL, ape_linetable_fileindex(files, positions[i].file));
+        len += ape_linetable_putsvarint(out ? (out + len) : NULL, (int64_t)positions[i].line - line);
+        len += ape_linetable_putsvarint(out ? (out + len) : NULL, (int64_t)positions[i].column - column);
+        line = positions[i].line;
+        column = positions[i].column;
+        i += run;
+    }
+    return len;
+}
+
+/* 'positions' holds one entry per byte of 'bytecode'; it is only read, and stays the caller's */
+ApeAstCompResult* ape_make_compresult(ApeContext* ctx, ApeUShort* bytecode, const ApePosition* positions, int count)
+{
+    ApeSize i;
+    ApeSize tablelen;
+    ApeSize filecount;
+    ApePtrArray* files;
+    ApeAstCompResult* res;
+    res = (ApeAstCompResult*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstCompResult));
+    files = ape_make_ptrarray(ctx);
+    if(!res || !files)
+    {
+        goto err;
+    }
+    memset(res, 0, sizeof(ApeAstCompResult));
+    res->context = ctx;
+    res->bytecode = bytecode;
+    res->count = count;
+    tablelen = ape_linetable_encode(NULL, files, positions, count);
+    filecount = ape_ptrarray_count(files);
+    /* the file list and the runs share one block */
+    res->linefiles = (const ApeAstCompFile**)ape_allocator_alloc(&ctx->alloc, (filecount * sizeof(ApeAstCompFile*)) + tablelen + 1);
+    if(!res->linefiles)
+    {
+        goto err;
+    }
+    for(i = 0; i < filecount; i++)
+    {
+        res->linefiles[i] = (const ApeAstCompFile*)ape_ptrarray_get(files, i);
+    }
+    res->linefilecount = filecount;
+    res->linetable = (unsigned char*)(res->linefiles + filecount);
+    res->linetablelen = ape_linetable_encode(res->linetable, files, positions, count);
+    ape_ptrarray_destroy(files);
     return res;
+err:
+    ape_ptrarray_destroy(files);
+    ape_allocator_free(&ctx->alloc, res);
+    return NULL;
 }
 
-ApeAstCompResult* ape_make_compresult(ApeContext* ctx, ApeUShort* bytecode, ApePosition* src_positions, int count)
+ApeAstCompResult* ape_compresult_copy(ApeContext* ctx, const ApeAstCompResult* src)
 {
+    ApeSize blocklen;
     ApeAstCompResult* res;
     res = (ApeAstCompResult*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstCompResult));
     if(!res)
@@ -616,12 +1074,103 @@ ApeAstCompResult* ape_make_compresult(ApeContext* ctx, ApeUShort* bytecode, ApeP
     }
     memset(res, 0, sizeof(ApeAstCompResult));
     res->context = ctx;
-    res->bytecode = bytecode;
-    res->srcpositions = src_positions;
-    res->count = count;
+    res->count = src->count;
+    res->linefilecount = src->linefilecount;
+    res->linetablelen = src->linetablelen;
+    blocklen = (src->linefilecount * sizeof(ApeAstCompFile*)) + src->linetablelen + 1;
+    res->bytecode = (ApeUShort*)ape_allocator_alloc(&ctx->alloc, (sizeof(ApeUShort) * src->count) + 1);
+    res->linefiles = (const ApeAstCompFile**)ape_allocator_alloc(&ctx->alloc, blocklen);
+    if(!res->bytecode || !res->linefiles)
+    {
+        ape_compresult_destroy(res);
+        return NULL;
+    }
+    memcpy(res->bytecode, src->bytecode, sizeof(ApeUShort) * src->count);
+    memcpy(res->linefiles, src->linefiles, blocklen);
+    res->linetable = (unsigned char*)(res->linefiles + res->linefilecount);
     return res;
 }
 
+/* walks the line table up to 'ip'; cheap enough for errors and tracebacks, which is all it is for */
+ApePosition ape_compresult_srcposition(const ApeAstCompResult* res, ApeSize ip)
+{
+    ApeSize start;
+    ApeSize run;
+    ApeSize fileix;
+    ApePosition pos;
+    const unsigned char* p;
+    const unsigned char* end;
+    pos = g_prspriv_srcposinvalid;
+    if(res == NULL || res->linetable == NULL)
+    {
+        return pos;
+    }
+    p = res->linetable;
+    end = res->linetable + res->linetablelen;
+    start = 0;
+    pos.line = 0;
+    pos.column = 0;
+    while(p < end)
+    {
+        run = ape_linetable_getvarint(&p);
+        fileix = ape_linetable_getvarint(&p);
+        pos.line += (int)ape_linetable_getsvarint(&p);
+        pos.column += (int)ape_linetable_getsvarint(&p);
+        if(ip < (start + run))
+        {
+            pos.file = (fileix == 0 || fileix > res->linefilecount) ? NULL : res->linefiles[fileix - 1];
+            return pos;
+        }
+        start += run;
+    }
+    return g_prspriv_srcposinvalid;
+}
+
+/*
+* expands the line table back into one position per byte of code, for the few places that
+* want all of them (dumping bytecode, writing caches). the caller frees the result.
+*/
+ApePosition* ape_compresult_getpositions(const ApeAstCompResult* res)
+{
+    ApeSize i;
+    ApeSize run;
+    ApeSize fileix;
+    ApePosition pos;
+    ApePosition* positions;
+    const unsigned char* p;
+    const unsigned char* end;
+    positions = (ApePosition*)ape_allocator_alloc(&res->context->alloc, (res->count + 1) * sizeof(ApePosition));
+    if(!positions)
+    {
+        return NULL;
+    }
+    p = res->linetable;
+    end = res->linetable + res->linetablelen;
+    pos.line = 0;
+    pos.column = 0;
+    i = 0;
+    while((p < end) && (i < res->count))
+    {
+        run = ape_linetable_getvarint(&p);
+        fileix = ape_linetable_getvarint(&p);
+        pos.line += (int)ape_linetable_getsvarint(&p);
+        pos.column += (int)ape_linetable_getsvarint(&p);
+        pos.file = (fileix == 0 || fileix > res->linefilecount) ? NULL : res->linefiles[fileix - 1];
+        while((run > 0) && (i < res->count))
+        {
+            positions[i] = pos;
+            i++;
+            run--;
+        }
+    }
+    while(i < res->count)
+    {
+        positions[i] = g_prspriv_srcposinvalid;
+        i++;
+    }
+    return positions;
+}
+
 void ape_compresult_destroy(ApeAstCompResult* res)
 {
     ApeContext* ctx;
@@ -631,7 +1180,7 @@ void ape_compresult_destroy(ApeAstCompResult* res)
     }
     ctx = res->context;
     ape_allocator_free(&ctx->alloc, res->bytecode);
-    ape_allocator_free(&ctx->alloc, res->srcpositions);
+    ape_allocator_free(&ctx->alloc, res->linefiles);
     ape_allocator_free(&ctx->alloc, res);
 }
 
@@ -646,12 +1195,7 @@ ApeAstBlockScope* ape_make_blockscope(ApeContext* ctx, int offset)
     }
     memset(sc, 0, sizeof(ApeAstBlockScope));
     sc->context = ctx;
-    sc->store = ape_make_strdict(ctx, (ApeDataCallback)ape_symbol_copy, (ApeDataCallback)ape_symbol_destroy);
-    if(!sc->store)
-    {
-        ape_blockscope_destroy(ctx, sc);
-        return NULL;
-    }
+    ape_namemap_init(&sc->store, ctx);
     sc->numdefinitions = 0;
     sc->offset = offset;
     return sc;
@@ -659,12 +1203,14 @@ ApeAstBlockScope* ape_make_blockscope(ApeContext* ctx, int offset)
 
 void* ape_blockscope_destroy(ApeContext* ctx, ApeAstBlockScope* scope)
 {
+    ApeSize i;
     if(scope != NULL)
     {
-        if(scope->store != NULL)
+        for(i = 0; i < ape_namemap_count(&scope->store); i++)
         {
-            ape_strdict_destroywithitems(ctx, scope->store);
+            ape_symbol_destroy(ctx, (ApeSymbol*)ape_namemap_getvalueat(&scope->store, i));
         }
+        ape_namemap_deinit(&scope->store);
         ape_allocator_free(&ctx->alloc, scope);
     }
     return NULL;
@@ -672,25 +1218,30 @@ void* ape_blockscope_destroy(ApeContext* ctx, ApeAstBlockScope* scope)
 
 ApeAstBlockScope* ape_blockscope_copy(ApeContext* ctx, ApeAstBlockScope* scope)
 {
+    ApeSize i;
+    ApeSymbol* symbol;
     ApeAstBlockScope* copy;
     if(scope == NULL)
     {
         return NULL;
     }
-    copy = (ApeAstBlockScope*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeAstBlockScope));
+    copy = ape_make_blockscope(ctx, scope->offset);
     if(!copy)
     {
         return NULL;
     }
-    memset(copy, 0, sizeof(ApeAstBlockScope));
-    copy->context = ctx;
     copy->numdefinitions = scope->numdefinitions;
-    copy->offset = scope->offset;
-    if(copy->store != NULL)
+    for(i = 0; i < ape_namemap_count(&scope->store); i++)
     {
-        copy->store = ape_strdict_copywithitems(ctx, scope->store);
-        if(!copy->store)
+        symbol = ape_symbol_copy(ctx, (ApeSymbol*)ape_namemap_getvalueat(&scope->store, i));
+        if(!symbol)
+        {
+            ape_blockscope_destroy(ctx, copy);
+            return NULL;
+        }
+        if(!ape_namemap_set(&copy->store, symbol->name, symbol))
         {
+            ape_symbol_destroy(ctx, symbol);
             ape_blockscope_destroy(ctx, copy);
             return NULL;
         }
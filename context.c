@@ -1,6 +1,8 @@
 
 #include "inline.h"
 
+static const ApePosition g_ctxpriv_srcposinvalid = { NULL, -1, -1 };
+
 ApeContext* ape_make_context()
 {
     return ape_make_contextex(NULL, NULL, NULL);
@@ -29,6 +31,8 @@ ApeContext* ape_make_contextex(ApeMemAllocFunc malloc_fn, ApeMemFreeFunc free_fn
     ctx->debugwriter = ape_make_writerio(ctx, stderr, false, true);
     ctx->stdoutwriter = ape_make_writerio(ctx, stdout, false, true);
     ape_errorlist_initerrors(&ctx->errors);
+    ape_astarena_init(&ctx->astheap, ctx, false);
+    ape_nametable_init(&ctx->names, ctx);
     ctx->mem = ape_make_gcmem(ctx);
     if(!ctx->mem)
     {
@@ -51,6 +55,11 @@ ApeContext* ape_make_contextex(ApeMemAllocFunc malloc_fn, ApeMemFreeFunc free_fn
     {
         goto err;
     }
+    ctx->programs = ape_make_ptrarray(ctx);
+    if(!ctx->programs)
+    {
+        goto err;
+    }
     ctx->vm = ape_make_vm(ctx, &ctx->config, ctx->mem, &ctx->errors, ctx->globalstore);
     if(!ctx->vm)
     {
@@ -84,6 +93,12 @@ void ape_context_destroy(ApeContext* ctx)
 
 void ape_context_deinit(ApeContext* ctx)
 {
+    ApeAstProgram* program;
+    /* first, so that no more samples are taken of the vm */
+    ape_profiler_destroy(ctx->profiler);
+    /* and no more spans recorded while everything is torn down */
+    ape_tracer_destroy(ctx->tracer);
+    ctx->tracer = NULL;
     ape_writer_destroy(ctx->debugwriter);
     ape_writer_destroy(ctx->stdoutwriter);
     ape_strdict_destroy(ctx->objstringfuncs);
@@ -96,6 +111,14 @@ void ape_context_deinit(ApeContext* ctx)
     ape_ptrarray_destroywithitems(ctx, ctx->pseudoclasses, (ApeDataCallback)ape_pseudoclass_destroy);
     ape_ptrarray_destroywithitems(ctx, ctx->files, (ApeDataCallback)ape_compfile_destroy);
     ape_errorlist_destroy(&ctx->errors);
+    /* last: functions, errors and tracebacks above may point into their code and files */
+    while(ctx->programs && (ape_ptrarray_count(ctx->programs) > 0))
+    {
+        program = (ApeAstProgram*)ape_ptrarray_pop(ctx->programs);
+        ape_program_release(program);
+    }
+    ape_ptrarray_destroy(ctx->programs);
+    ape_nametable_deinit(&ctx->names);
 }
 
 void ape_context_freeallocated(ApeContext* ctx, void* ptr)
@@ -129,11 +152,208 @@ void ape_context_debugvalue(ApeContext* ctx, const char* name, ApeObject val)
     }
 }
 
+/*
+* a negative value disables the timeout.
+* scripts exceeding it fail with APE_ERROR_TIMEOUT, which cannot be caught by recover.
+*/
 bool ape_context_settimeout(ApeContext* ctx, ApeFloat max_execution_time_ms)
 {
+    if(max_execution_time_ms < 0)
+    {
+        ctx->config.max_execution_time_ms = -1;
+        ctx->config.max_execution_time_set = false;
+        return false;
+    }
     ctx->config.max_execution_time_ms = max_execution_time_ms;
-    ctx->config.max_execution_time_set = false;
-    return false;
+    ctx->config.max_execution_time_set = true;
+    return true;
+}
+
+/*
+* limits the bytes this context may hold; 0 removes the limit.
+* once exceeded, the VM collects garbage, and if that doesn't help, raises
+* APE_ERROR_ALLOCATION, which scripts can catch with recover. a single allocation that
+* would take the heap well past the limit is refused, and raises the same error.
+*/
+void ape_context_setheaplimit(ApeContext* ctx, ApeSize maxbytes)
+{
+    ctx->alloc.maxbytes = maxbytes;
+}
+
+/*
+* caches compiled scripts on disk, keyed on the script's contents (and anything it includes).
+* 'dir' may be NULL to keep the '.apec' file next to the script; it is not copied.
+*/
+void ape_context_setbytecache(ApeContext* ctx, bool enable, const char* dir)
+{
+    ctx->config.bytecache = enable;
+    ctx->config.bytecachedir = dir;
+}
+
+void ape_context_setmodulecache(ApeContext* ctx, bool enable)
+{
+    ctx->config.modulecache = enable;
+}
+
+void ape_context_setsourcemode(ApeContext* ctx, ApeSourceMode mode)
+{
+    ctx->config.sourcemode = mode;
+}
+
+/*
+* starts sampling the scripts this context runs, every 'intervalusec' microseconds of cpu time
+* (0 for 1ms), until ape_context_stopprofiler. fails when another context is being profiled,
+* or when there is no SIGPROF. samples add up over several starts.
+*/
+bool ape_context_startprofiler(ApeContext* ctx, ApeInt intervalusec)
+{
+    if(!ctx->profiler)
+    {
+        ctx->profiler = ape_make_profiler(ctx);
+        if(!ctx->profiler)
+        {
+            return false;
+        }
+    }
+    return ape_profiler_start(ctx->profiler, intervalusec);
+}
+
+void ape_context_stopprofiler(ApeContext* ctx)
+{
+    if(ctx->profiler)
+    {
+        ape_profiler_stop(ctx->profiler);
+    }
+}
+
+/* writes the collapsed stacks to 'path', through the file write function */
+bool ape_context_writeprofile(ApeContext* ctx, const char* path)
+{
+    bool ok;
+    size_t written;
+    ApeWriter* buf;
+    if(!ctx->profiler || !ctx->config.fileio.fnwritefile)
+    {
+        return false;
+    }
+    buf = ape_make_writer(ctx);
+    if(!buf)
+    {
+        return false;
+    }
+    ok = ape_profiler_writefolded(ctx->profiler, buf);
+    if(ok)
+    {
+        written = ctx->config.fileio.fnwritefile(ctx, path, ape_writer_getdata(buf), ape_writer_getlength(buf));
+        ok = (written == ape_writer_getlength(buf));
+    }
+    ape_writer_destroy(buf);
+    return ok;
+}
+
+/* prints the 'maxlines' source lines that took the most samples (0 for all of them) */
+bool ape_context_printprofile(ApeContext* ctx, FILE* hnd, ApeSize maxlines)
+{
+    bool ok;
+    ApeWriter* buf;
+    if(!ctx->profiler)
+    {
+        return false;
+    }
+    buf = ape_make_writerio(ctx, hnd, false, true);
+    if(!buf)
+    {
+        return false;
+    }
+    ok = ape_profiler_writehotspots(ctx->profiler, buf, maxlines);
+    ape_writer_destroy(buf);
+    return ok;
+}
+
+/*
+* from now on, records how long parsing, compiling, including, collecting garbage and running
+* take, keeping the latest 'capacity' spans (0 for a default). see ape_context_writetrace.
+*/
+bool ape_context_starttrace(ApeContext* ctx, ApeSize capacity)
+{
+    if(ctx->tracer != NULL)
+    {
+        return true;
+    }
+    ctx->tracer = ape_make_tracer(ctx, capacity);
+    return (ctx->tracer != NULL);
+}
+
+/* writes the recorded spans to 'path' as Chrome trace events, through the file write function */
+bool ape_context_writetrace(ApeContext* ctx, const char* path)
+{
+    bool ok;
+    size_t written;
+    ApeWriter* buf;
+    if(!ctx->tracer || !ctx->config.fileio.fnwritefile)
+    {
+        return false;
+    }
+    buf = ape_make_writer(ctx);
+    if(!buf)
+    {
+        return false;
+    }
+    ok = ape_tracer_writejson(ctx->tracer, buf);
+    if(ok)
+    {
+        written = ctx->config.fileio.fnwritefile(ctx, path, ape_writer_getdata(buf), ape_writer_getlength(buf));
+        ok = (written == ape_writer_getlength(buf));
+    }
+    ape_writer_destroy(buf);
+    return ok;
+}
+
+/* the busiest opcodes and opcode pairs; false unless built with APE_CONF_VM_OPSTATS */
+bool ape_context_printopstats(ApeContext* ctx, FILE* hnd, ApeSize maxlines)
+{
+    bool ok;
+    ApeWriter* buf;
+    if(!ape_opstats_enabled())
+    {
+        return false;
+    }
+    buf = ape_make_writerio(ctx, hnd, false, true);
+    if(!buf)
+    {
+        return false;
+    }
+    ok = ape_opstats_write(ctx->vm, buf, maxlines);
+    ape_writer_destroy(buf);
+    return ok;
+}
+
+/*
+* calls 'oncall' whenever a function (script or native) is entered, and 'onreturn' whenever
+* it is left, be it by returning, by an error unwinding it or by a tail call replacing it.
+* either may be NULL; hooks must not call back into the context.
+*/
+void ape_context_sethooks(ApeContext* ctx, ApeCallHookFunc oncall, ApeCallHookFunc onreturn, void* userdata)
+{
+    ctx->vm->hookcall = oncall;
+    ctx->vm->hookreturn = onreturn;
+    ctx->vm->hookdata = userdata;
+}
+
+/* how many threads parse included files ahead of their compilation; 0 is one per core */
+void ape_context_setcompilethreads(ApeContext* ctx, ApeSize count)
+{
+    ctx->config.compilethreads = count;
+}
+
+ApeSize ape_context_getheapbytes(ApeContext* ctx)
+{
+    return ctx->alloc.curbytes;
+}
+
+ApeSize ape_context_getheappeak(ApeContext* ctx)
+{
+    return ctx->alloc.peakbytes;
 }
 
 void ape_context_setstdoutwrite(ApeContext* ctx, ApeIOStdoutWriteFunc stdout_write, void* ptr)
@@ -215,14 +435,59 @@ err:
     return ape_object_make_null(ctx);
 }
 
+/*
+* compiles the file at 'path' into the context's compiler, going through the bytecode cache
+* if enabled. returns NULL (with errors set) on failure.
+*/
+ApeAstCompResult* ape_context_compilefile(ApeContext* ctx, const char* path)
+{
+    bool usecache;
+    size_t clen;
+    char* code;
+    uint64_t signature;
+    ApeSize filebase;
+    ApeAstCompResult* cres;
+    cres = NULL;
+    signature = 0;
+    usecache = (ctx->config.bytecache && !ctx->config.dumpast && ape_bytecache_usable(ctx->compiler));
+    if(usecache)
+    {
+        signature = ape_bytecache_signature(ctx->compiler);
+        code = ctx->config.fileio.fnreadfile(ctx, path, -1, &clen);
+        if(code)
+        {
+            cres = ape_bytecache_load(ctx->compiler, path, code, clen, signature);
+            ape_allocator_free(&ctx->alloc, code);
+        }
+        /* a missing script is reported by the compiler below */
+        ape_context_clearerrors(ctx);
+        if(cres)
+        {
+            return cres;
+        }
+    }
+    filebase = ape_ptrarray_count(ctx->files);
+    cres = ape_compiler_compilefile(ctx->compiler, path);
+    if(!cres || ape_errorlist_count(&ctx->errors) > 0)
+    {
+        ape_compresult_destroy(cres);
+        return NULL;
+    }
+    if(usecache)
+    {
+        ape_bytecache_store(ctx->compiler, path, cres, filebase, signature);
+    }
+    return cres;
+}
+
 ApeObject ape_context_executefile(ApeContext* ctx, const char* path)
 {
     bool ok;
     ApeObject objres;
     ApeAstCompResult* cres;
     ape_context_resetstate(ctx);
-    cres = ape_compiler_compilefile(ctx->compiler, path);
-    if(!cres || ape_errorlist_count(&ctx->errors) > 0)
+    cres = ape_context_compilefile(ctx, path);
+    if(!cres)
     {
         goto err;
     }
@@ -253,6 +518,165 @@ err:
     return ape_object_make_null(ctx);
 }
 
+static long ape_program_addref(ApeAstProgram* program, long delta)
+{
+    #if defined(__GNUC__)
+        return __atomic_add_fetch(&program->refcount, delta, __ATOMIC_ACQ_REL);
+    #else
+        program->refcount += delta;
+        return program->refcount;
+    #endif
+}
+
+/*
+* compiles 'path' once, for running in any context whose globals (builtins, natives and
+* globals set by the host, in that order) are laid out like those of 'ctx'.
+* 'ctx' provides the configuration and receives compile errors; the program does not
+* refer to it afterwards. returns NULL on failure.
+*/
+ApeAstProgram* ape_program_compilefile(ApeContext* ctx, const char* path)
+{
+    ApeSize i;
+    const char* name;
+    ApeError* err;
+    ApeContext* home;
+    ApeGCObjData* data;
+    ApeObject* constant;
+    ApeAstProgram* program;
+    home = ape_make_context();
+    if(!home)
+    {
+        return NULL;
+    }
+    program = (ApeAstProgram*)ape_allocator_alloc(&home->alloc, sizeof(ApeAstProgram));
+    if(!program)
+    {
+        ape_context_destroy(home);
+        return NULL;
+    }
+    memset(program, 0, sizeof(ApeAstProgram));
+    program->context = home;
+    program->refcount = 1;
+    home->config = ctx->config;
+    /* only the names and indices of the globals matter for compiling, not their values */
+    for(i = 0; i < ape_strdict_count(ctx->globalstore->named); i++)
+    {
+        name = ape_strdict_getkeyat(ctx->globalstore->named, i);
+        if(!ape_globalstore_getsymbol(home->globalstore, name))
+        {
+            ape_globalstore_set(home->globalstore, name, ape_object_make_null(home));
+        }
+    }
+    program->signature = ape_bytecache_signature(ctx->compiler);
+    if(ape_bytecache_signature(home->compiler) != program->signature)
+    {
+        ape_errorlist_add(&ctx->errors, APE_ERROR_USER, g_ctxpriv_srcposinvalid, "cannot compile a shared program: context has a different set of globals");
+        goto err;
+    }
+    program->comp_res = ape_context_compilefile(home, path);
+    if(!program->comp_res)
+    {
+        goto err;
+    }
+    program->constants = ape_compiler_getconstants(home->compiler);
+    for(i = 0; i < ape_valarray_count(program->constants); i++)
+    {
+        constant = (ApeObject*)ape_valarray_get(program->constants, i);
+        data = ape_object_value_allocated_data(*constant);
+        if(data != NULL)
+        {
+            data->gcpermanent = true;
+        }
+    }
+    /* errors may be reported from any thread later, so the source lines are looked up now */
+    for(i = 0; i < ape_ptrarray_count(home->files); i++)
+    {
+        ape_compfile_loadlines((ApeAstCompFile*)ape_ptrarray_get(home->files, i));
+    }
+    return program;
+err:
+    /* hand over the errors; 'ctx' keeps the home context alive for the files their positions point into */
+    for(i = 0; i < ape_errorlist_count(&home->errors); i++)
+    {
+        err = ape_errorlist_getat(&home->errors, i);
+        ape_errorlist_add(&ctx->errors, (ApeErrorType)err->errtype, err->pos, err->message);
+    }
+    if(!ape_ptrarray_push(ctx->programs, &program))
+    {
+        ape_program_release(program);
+    }
+    return NULL;
+}
+
+ApeAstProgram* ape_program_retain(ApeAstProgram* program)
+{
+    ape_program_addref(program, 1);
+    return program;
+}
+
+void ape_program_release(ApeAstProgram* program)
+{
+    ApeContext* home;
+    if(!program)
+    {
+        return;
+    }
+    if(ape_program_addref(program, -1) > 0)
+    {
+        return;
+    }
+    home = program->context;
+    ape_compresult_destroy(program->comp_res);
+    ape_allocator_free(&home->alloc, program);
+    ape_context_destroy(home);
+}
+
+/*
+* runs a shared program in 'ctx', which keeps a reference to it until destroyed.
+* module globals the program defines are not visible to code compiled in 'ctx' later on.
+*/
+ApeObject ape_context_executeprogram(ApeContext* ctx, ApeAstProgram* program)
+{
+    bool ok;
+    bool found;
+    ApeSize i;
+    ApeObject objres;
+    ape_context_resetstate(ctx);
+    if(ape_bytecache_signature(ctx->compiler) != program->signature)
+    {
+        ape_errorlist_add(&ctx->errors, APE_ERROR_USER, g_ctxpriv_srcposinvalid, "cannot run a shared program: context has a different set of globals");
+        return ape_object_make_null(ctx);
+    }
+    found = false;
+    for(i = 0; i < ape_ptrarray_count(ctx->programs); i++)
+    {
+        if((ApeAstProgram*)ape_ptrarray_get(ctx->programs, i) == program)
+        {
+            found = true;
+            break;
+        }
+    }
+    if(!found)
+    {
+        if(!ape_ptrarray_push(ctx->programs, &program))
+        {
+            return ape_object_make_null(ctx);
+        }
+        ape_program_retain(program);
+    }
+    ok = ape_vm_run(ctx->vm, program->comp_res, program->constants);
+    if(!ok || ape_errorlist_count(&ctx->errors) > 0)
+    {
+        return ape_object_make_null(ctx);
+    }
+    objres = ape_vm_getlastpopped(ctx->vm);
+    if(ape_object_value_type(objres) == APE_OBJECT_NONE)
+    {
+        return ape_object_make_null(ctx);
+    }
+    return objres;
+}
+
 bool ape_context_haserrors(ApeContext* ctx)
 {
     return ape_context_errorcount(ctx) > 0;
@@ -383,6 +807,12 @@ void ape_context_setdefaultconfig(ApeContext* ctx)
     ctx->config.dumpast = false;
     ctx->config.dumpstack = false;
     ctx->config.replmode = false;
+    ctx->config.optimize = true;
+    ctx->config.bytecache = false;
+    ctx->config.bytecachedir = NULL;
+    ctx->config.modulecache = true;
+    ctx->config.sourcemode = APE_SOURCE_REREAD;
+    ctx->config.compilethreads = 0;
     ape_context_settimeout(ctx, -1);
     ape_context_setfileread(ctx, ape_util_default_readfile, ctx);
     ape_context_setfilewrite(ctx, ape_util_default_writefile, ctx);
@@ -32,6 +32,7 @@
 extern void* ds_extmalloc(size_t size, void* userptr);
 extern void* ds_extrealloc(void* ptr, size_t oldsz, size_t newsz, void* userptr);
 extern void ds_extfree(void* ptr, void* userptr);
+extern void* da_extmalloc(size_t size, void* userptr);
 
 static APE_INLINE intptr_t* da_grow_internal(void* uptr, intptr_t* arr, size_t capacity, size_t tsize);
 
@@ -211,48 +212,44 @@ static APE_INLINE intptr_t* da_grow_internal(void* uptr, intptr_t* arr, size_t c
 {
     size_t asize;
     size_t acount;
-    size_t zerosize;
+    size_t usedsize;
     size_t actualcapacity;
     intptr_t* res;
     intptr_t* ptr;
     res = NULL;
-    acount = 0;
     actualcapacity = capacity;
-    tsize = tsize + sizeof(intptr_t);
+    /*
+    * items are always stored as intptr_t (see da_push), and the two header
+    * slots (count, capacity) precede them; $tsize is only checked for sanity.
+    */
+    (void)tsize;
+    assert(tsize <= sizeof(intptr_t));
+    tsize = sizeof(intptr_t);
     if(actualcapacity == 0)
     {
         actualcapacity = 1;
     }
+    acount = actualcapacity;
     if(arr != NULL)
     {
         acount = JK_DYNARRAY_MAX(2 * da_count(arr), da_count(arr) + actualcapacity);
     }
     asize = ((2 * tsize) + (acount * tsize));
-
-
-    //fprintf(stderr, "da_grow_internal: arg.uptr=%p arg.arr=%p arg.capacity=%zu arg.tsize=%zu asize=%zu acount=%zu\n", uptr, arr, actualcapacity, tsize, asize, acount);
-
-
+    ptr = (intptr_t*)da_extmalloc(asize, uptr);
+    assert(ptr != NULL);
     if(arr)
     {
-        ptr = (intptr_t*)ds_extmalloc(asize * tsize, uptr);
-        if(ptr)
-        {
-            memcpy(ptr, ((intptr_t*)arr) - 2, ((da_count(arr) * tsize) + (2 * tsize)));
-            da_destroy(uptr, arr);
-        }
-        assert(ptr != NULL);
-        zerosize = ((asize - (2 * tsize)) - (ptr[0] * tsize));
-        memset(((intptr_t*)ptr) + (asize - zerosize), 0, zerosize);
+        usedsize = ((da_count(arr) * tsize) + (2 * tsize));
+        memcpy(ptr, ((intptr_t*)arr) - 2, usedsize);
+        da_destroy(uptr, arr);
+        memset(((char*)ptr) + usedsize, 0, asize - usedsize);
         res = (intptr_t*)(ptr + 2);
         da_capacity_internal(res) = acount;
     }
     else
     {
-        ptr = (intptr_t*)ds_extmalloc(asize*tsize, uptr);
-        assert(ptr != NULL);
-        res = (intptr_t*)(ptr + 2);
         memset(ptr, 0, asize);
+        res = (intptr_t*)(ptr + 2);
         da_count_internal(res) = 0;
         da_capacity_internal(res) = acount;
     }
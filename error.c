@@ -63,7 +63,7 @@ bool ape_traceback_appendfromvm(ApeTraceback* traceback, ApeVM* vm)
     ApeFrame* frame;
     for(i = vm->countframes - 1; i >= 0; i--)
     {
-        frame = (ApeFrame*)da_get(vm->frameobjects, i);        
+        frame = &vm->frameobjects[i];
         ok = ape_traceback_append(traceback, ape_object_function_getname(frame->function), ape_frame_srcposition(frame));
         if(!ok)
         {
@@ -267,6 +267,25 @@ void ape_errorlist_clear(ApeErrorList* errors)
     errors->count = 0;
 }
 
+/* drops every error after the first 'count' */
+void ape_errorlist_truncate(ApeErrorList* errors, ApeSize count)
+{
+    ApeSize i;
+    ApeError* error;
+    for(i = count; i < ape_errorlist_count(errors); i++)
+    {
+        error = ape_errorlist_getat(errors, i);
+        if(error->traceback)
+        {
+            ape_traceback_destroy(error->traceback);
+        }
+    }
+    if(count < errors->count)
+    {
+        errors->count = count;
+    }
+}
+
 ApeSize ape_errorlist_count(ApeErrorList* errors)
 {
     return errors->count;
@@ -315,13 +334,11 @@ const char* ape_error_getsource(ApeError* error)
     {
         return NULL;
     }
-    ApePtrArray* lines = error->pos.file->lines;
-    if(error->pos.line >= (ApeInt)ape_ptrarray_count(lines))
+    if(error->pos.line < 0)
     {
         return NULL;
     }
-    const char* line = (const char*)ape_ptrarray_get(lines, error->pos.line);
-    return line;
+    return ape_compfile_getline(error->pos.file, error->pos.line);
 }
 
 int ape_error_getline(ApeError* error)
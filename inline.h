@@ -17,6 +17,10 @@
 #include <math.h>
 #include "ape.h"
 
+#if defined(APE_HAVETHREADS)
+    #include <pthread.h>
+#endif
+
 #if defined(__GNUC__)
     #if !defined(isfinite)
         #define isfinite(v) (__builtin_isfinite(v))
@@ -200,3 +204,28 @@ static APE_INLINE void ape_valdict_clear(ApeValDict* dict)
         dict->cells[i] = APE_CONF_INVALID_VALDICT_IX;
     }
 }
+
+/* 'lock' is a pthread_mutex_t, or NULL while nothing runs concurrently (see ccprefetch.c) */
+static APE_INLINE void ape_util_lock(void* lock)
+{
+    #if defined(APE_HAVETHREADS)
+        if(lock != NULL)
+        {
+            pthread_mutex_lock((pthread_mutex_t*)lock);
+        }
+    #else
+        (void)lock;
+    #endif
+}
+
+static APE_INLINE void ape_util_unlock(void* lock)
+{
+    #if defined(APE_HAVETHREADS)
+        if(lock != NULL)
+        {
+            pthread_mutex_unlock((pthread_mutex_t*)lock);
+        }
+    #else
+        (void)lock;
+    #endif
+}
@@ -19,12 +19,15 @@ struct ApeValArray
     ApeSize count;
     ApeSize capacity;
     bool lock_capacity;
+    /* non-NULL when storage comes from an AST bump arena; such arrays never free */
+    ApeAstArena* arena;
 };
 
 struct ApePtrArray
 {
     ApeContext* context;
     ApeValArray* arr;
+    ApeAstArena* arena;
 };
 
 #if defined(__GNUC__)
@@ -54,6 +57,16 @@ static inline void debugmsg(void* self, const char* name, const char* fmt, ...)
     va_end(va);
 }
 
+/* parsers on other threads make arrays too (see ccprefetch.c) */
+static ApeSize ape_valarray_nextident(void)
+{
+    #if defined(__GNUC__)
+        return __atomic_fetch_add(&g_arrayident, 1, __ATOMIC_RELAXED);
+    #else
+        return g_arrayident++;
+    #endif
+}
+
 ApeValArray* ape_make_valarray(ApeContext* ctx, ApeSize elsz)
 {
     return ape_make_valarraycapacity(ctx, APE_CONF_ARRAY_INITIAL_CAPACITY, elsz);
@@ -68,11 +81,11 @@ ApeValArray* ape_make_valarraycapacity(ApeContext* ctx, ApeSize capacity, ApeSiz
     {
         return NULL;
     }
-    arr->ident = g_arrayident;
+    arr->ident = ape_valarray_nextident();
     arr->context = ctx;
     arr->elemsize = elsz;
     arr->arraydata = NULL;
-    g_arrayident++;
+    arr->arena = NULL;
     ok = ape_valarray_init(ctx, arr, capacity);
     if(!ok)
     {
@@ -118,7 +131,7 @@ void ape_valarray_deinit(ApeValArray* arr)
     if(arr)
     {
         ctx = arr->context;
-        if(arr->allocdata != NULL)
+        if(arr->allocdata != NULL && arr->arena == NULL)
         {
             ape_allocator_free(&ctx->alloc, arr->allocdata);
             arr->allocdata = NULL;
@@ -135,7 +148,10 @@ void ape_valarray_destroy(ApeValArray* arr)
     }
     ctx = arr->context;
     ape_valarray_deinit(arr);
-    ape_allocator_free(&ctx->alloc, arr);
+    if(arr->arena == NULL)
+    {
+        ape_allocator_free(&ctx->alloc, arr);
+    }
 }
 
 ApeSize ape_valarray_count(ApeValArray* arr)
@@ -207,6 +223,7 @@ bool ape_valarray_push(ApeValArray* arr, void* value)
     ApeSize toalloc;
     ApeSize elmsz;
     ApeSize acnt;
+    unsigned char* newdata;
     (void)initcap;
     elmsz = arr->elemsize;
     oldcap = arr->capacity;
@@ -264,7 +281,29 @@ bool ape_valarray_push(ApeValArray* arr, void* value)
         toalloc = (newcap + 0) * elmsz;
 
         //fprintf(stderr, "tmpcap=%zu newcap=%zd toalloc=%zd\n", tmpcap, newcap, toalloc);
-        arr->allocdata = ape_allocator_realloc(&ctx->alloc, arr->allocdata, prevalloc, toalloc);
+        if(arr->arena != NULL)
+        {
+            /* the old block stays in the arena until it is released as a whole */
+            arr->allocdata = (unsigned char*)ape_astarena_alloc(arr->arena, toalloc);
+            if(arr->allocdata == NULL)
+            {
+                return false;
+            }
+            if(arr->count > 0)
+            {
+                memcpy(arr->allocdata, arr->arraydata, arr->count * elmsz);
+            }
+        }
+        else
+        {
+            newdata = (unsigned char*)ape_allocator_realloc(&ctx->alloc, arr->allocdata, prevalloc, toalloc);
+            if(newdata == NULL)
+            {
+                /* the array keeps what it had */
+                return false;
+            }
+            arr->allocdata = newdata;
+        }
         arr->arraydata = arr->allocdata;
         arr->capacity = newcap;
     }
@@ -523,6 +562,7 @@ ApePtrArray* ape_make_ptrarraycapacity(ApeContext* ctx, ApeSize capacity)
         return NULL;
     }
     ptrarr->context = ctx;
+    ptrarr->arena = NULL;
     ptrarr->arr = ape_make_valarraycapacity(ctx, capacity, psz);
     if(!ok)
     {
@@ -532,10 +572,39 @@ ApePtrArray* ape_make_ptrarraycapacity(ApeContext* ctx, ApeSize capacity)
     return ptrarr;
 }
 
+/*
+* makes a pointer array whose storage lives in arena.
+* heap arenas (see ape_astarena_init) get an ordinary array.
+*/
+ApePtrArray* ape_make_ptrarrayarena(ApeAstArena* arena)
+{
+    ApePtrArray* ptrarr;
+    ApeValArray* arr;
+    if(!arena->isbump)
+    {
+        return ape_make_ptrarray(arena->context);
+    }
+    ptrarr = (ApePtrArray*)ape_astarena_alloc(arena, sizeof(ApePtrArray));
+    arr = (ApeValArray*)ape_astarena_alloc(arena, sizeof(ApeValArray));
+    if(!ptrarr || !arr)
+    {
+        return NULL;
+    }
+    memset(arr, 0, sizeof(ApeValArray));
+    arr->ident = ape_valarray_nextident();
+    arr->context = arena->context;
+    arr->elemsize = sizeof(void*);
+    arr->arena = arena;
+    ptrarr->context = arena->context;
+    ptrarr->arr = arr;
+    ptrarr->arena = arena;
+    return ptrarr;
+}
+
 void ape_ptrarray_destroy(ApePtrArray* arr)
 {
     ApeContext* ctx;
-    if(!arr)
+    if(!arr || arr->arena)
     {
         return;
     }
@@ -626,7 +695,14 @@ ApeSize ape_ptrarray_count(ApePtrArray* arr)
 
 void* ape_ptrarray_pop(ApePtrArray* arr)
 {
-    return ape_valarray_pop(arr->arr);
+    void** res;
+    res = (void**)ape_valarray_pop(arr->arr);
+    if(!res)
+    {
+        return NULL;
+    }
+    /* the slot itself is still readable: removing only shrinks the count */
+    return *res;
 }
 
 void* ape_ptrarray_top(ApePtrArray* arr)
@@ -698,6 +774,7 @@ ApeObject ape_object_make_arraycapacity(ApeContext* ctx, unsigned capacity)
         if(data)
         {
             ape_valarray_clear(data->valarray);
+            data->valrange.active = false;
             return object_make_from_data(ctx, APE_OBJECT_ARRAY, data);
         }
         #endif
@@ -717,12 +794,53 @@ ApeObject ape_object_make_arraycapacity(ApeContext* ctx, unsigned capacity)
     return object_make_from_data(ctx, APE_OBJECT_ARRAY, data);
 }
 
+/*
+* range(start, end, step) as an array whose elements are computed on read.
+* the backing valarray stays empty until something needs it (see ape_object_array_getarray).
+*/
+ApeObject ape_object_make_range(ApeContext* ctx, ApeInt start, ApeInt end, ApeInt step)
+{
+    ApeSize count;
+    ApeObject res;
+    ApeGCObjData* data;
+    count = 0;
+    if((step > 0) && (start < end))
+    {
+        count = ((end - start) + step - 1) / step;
+    }
+    else if((step < 0) && (start > end))
+    {
+        count = ((start - end) + (-step) - 1) / (-step);
+    }
+    res = ape_object_make_arraycapacity(ctx, 1);
+    if(ape_object_value_isnull(res))
+    {
+        return res;
+    }
+    data = ape_object_value_allocated_data(res);
+    data->valrange.active = (count > 0);
+    data->valrange.start = start;
+    data->valrange.step = step;
+    data->valrange.count = count;
+    return res;
+}
+
 ApeObject ape_object_array_getvalue(ApeObject object, ApeSize ix)
 {
     ApeObject* res;
     ApeValArray* array;
+    ApeGCObjData* data;
     APE_ASSERT(ape_object_value_type(object) == APE_OBJECT_ARRAY);
-    array = ape_object_array_getarray(object);
+    data = ape_object_value_allocated_data(object);
+    if(data->valrange.active)
+    {
+        if(ix >= data->valrange.count)
+        {
+            return ape_object_make_null(data->context);
+        }
+        return ape_object_make_floatnumber(data->context, data->valrange.start + ((ApeInt)ix * data->valrange.step));
+    }
+    array = data->valarray;
     if(ix >= ape_valarray_count(array))
     {
         return ape_object_make_null(array->context);
@@ -778,8 +896,14 @@ bool ape_object_array_popvalue(ApeObject object, ApeObject* dest)
 ApeSize ape_object_array_getlength(ApeObject object)
 {
     ApeValArray* array;
+    ApeGCObjData* data;
     APE_ASSERT(ape_object_value_type(object) == APE_OBJECT_ARRAY);
-    array = ape_object_array_getarray(object);
+    data = ape_object_value_allocated_data(object);
+    if(data->valrange.active)
+    {
+        return data->valrange.count;
+    }
+    array = data->valarray;
     return ape_valarray_count(array);
 }
 
@@ -804,11 +928,26 @@ bool ape_object_array_pushstring(ApeContext* ctx, ApeObject obj, const char* str
 }
 
 
+/* callers may mutate the returned array, so a lazy range is materialised first */
 ApeValArray * ape_object_array_getarray(ApeObject object)
 {
+    ApeSize i;
+    ApeObject item;
     ApeGCObjData* data;
     APE_ASSERT(ape_object_value_type(object) == APE_OBJECT_ARRAY);
     data = ape_object_value_allocated_data(object);
+    if(data->valrange.active)
+    {
+        data->valrange.active = false;
+        for(i = 0; i < data->valrange.count; i++)
+        {
+            item = ape_object_make_floatnumber(data->context, data->valrange.start + ((ApeInt)i * data->valrange.step));
+            if(!ape_valarray_push(data->valarray, &item))
+            {
+                break;
+            }
+        }
+    }
     return data->valarray;
 }
 
@@ -917,7 +1056,10 @@ static ApeObject objfn_array_fill(ApeVM* vm, void* data, ApeSize argc, ApeObject
     len = ape_object_array_getlength(self);
     for(i=0; i<howmuch; i++)
     {
-        ape_object_array_pushvalue(self, val);
+        if(!ape_object_array_pushvalue(self, val))
+        {
+            break;
+        }
     }
     return ape_object_make_null(vm->context);
 }
@@ -1122,5 +1264,6 @@ void ape_builtins_install_array(ApeVM* vm)
     {
         ape_pseudoclass_setmethod(psc, memberfuncs[i].name, &memberfuncs[i]);
     }
+    ape_pseudoclass_buildtable(psc);
 }
 
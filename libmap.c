@@ -4,6 +4,10 @@
 #define APE_CONF_DICT_INITIAL_SIZE (2)
 //#define APE_CONF_MAP_INITIAL_CAPACITY (64/4)
 #define APE_CONF_MAP_INITIAL_CAPACITY 0
+/* up to this many entries, a name map is scanned instead of hashed */
+#define APE_CONF_NAMEMAP_SCANMAX (8)
+#define APE_CONF_NAMEMAP_MINCELLS (32)
+#define APE_CONF_NAMETABLE_MINCELLS (256)
 
 ApeValDict* ape_make_valdict(ApeContext* ctx, ApeSize ksz, ApeSize vsz)
 {
@@ -682,6 +686,283 @@ bool ape_strdict_setinternal(ApeStrDict* dict, const char* ckey, char* mkey, voi
     return true;
 }
 
+void ape_nametable_init(ApeNameTable* table, ApeContext* ctx)
+{
+    memset(table, 0, sizeof(ApeNameTable));
+    table->context = ctx;
+    ape_astarena_init(&table->strings, ctx, true);
+}
+
+void ape_nametable_deinit(ApeNameTable* table)
+{
+    ApeContext* ctx;
+    ctx = table->context;
+    ape_astarena_release(&table->strings);
+    ape_allocator_free(&ctx->alloc, table->cells);
+    ape_allocator_free(&ctx->alloc, table->hashes);
+    table->cells = NULL;
+    table->hashes = NULL;
+    table->count = 0;
+    table->cellcap = 0;
+}
+
+static bool ape_nametable_grow(ApeNameTable* table)
+{
+    ApeSize i;
+    ApeSize ix;
+    ApeSize newcap;
+    const char** cells;
+    unsigned long* hashes;
+    ApeContext* ctx;
+    ctx = table->context;
+    newcap = (table->cellcap == 0) ? APE_CONF_NAMETABLE_MINCELLS : (table->cellcap * 2);
+    cells = (const char**)ape_allocator_alloc(&ctx->alloc, newcap * sizeof(const char*));
+    hashes = (unsigned long*)ape_allocator_alloc(&ctx->alloc, newcap * sizeof(unsigned long));
+    if(!cells || !hashes)
+    {
+        ape_allocator_free(&ctx->alloc, cells);
+        ape_allocator_free(&ctx->alloc, hashes);
+        return false;
+    }
+    memset(cells, 0, newcap * sizeof(const char*));
+    for(i = 0; i < table->cellcap; i++)
+    {
+        if(table->cells[i] == NULL)
+        {
+            continue;
+        }
+        ix = table->hashes[i] & (newcap - 1);
+        while(cells[ix] != NULL)
+        {
+            ix = (ix + 1) & (newcap - 1);
+        }
+        cells[ix] = table->cells[i];
+        hashes[ix] = table->hashes[i];
+    }
+    ape_allocator_free(&ctx->alloc, table->cells);
+    ape_allocator_free(&ctx->alloc, table->hashes);
+    table->cells = cells;
+    table->hashes = hashes;
+    table->cellcap = newcap;
+    return true;
+}
+
+/*
+* returns the table's copy of the first 'len' bytes of 'str', adding it if it is not there yet.
+* the copy lives as long as the table, and equal names always give the same pointer.
+*/
+static const char* ape_nametable_internlocked(ApeNameTable* table, const char* str, ApeSize len)
+{
+    ApeSize ix;
+    char* copy;
+    const char* name;
+    unsigned long hash;
+    if(((table->count + 1) * 2) > table->cellcap)
+    {
+        if(!ape_nametable_grow(table))
+        {
+            return NULL;
+        }
+    }
+    hash = ape_util_hashstring(str, len);
+    ix = hash & (table->cellcap - 1);
+    while((name = table->cells[ix]) != NULL)
+    {
+        if((table->hashes[ix] == hash) && (strncmp(name, str, len) == 0) && (name[len] == '\0'))
+        {
+            return name;
+        }
+        ix = (ix + 1) & (table->cellcap - 1);
+    }
+    copy = ape_astarena_strndup(&table->strings, str, len);
+    if(!copy)
+    {
+        return NULL;
+    }
+    table->cells[ix] = copy;
+    table->hashes[ix] = hash;
+    table->count++;
+    return copy;
+}
+
+const char* ape_nametable_intern(ApeNameTable* table, const char* str, ApeSize len)
+{
+    const char* name;
+    ape_util_lock(table->lock);
+    name = ape_nametable_internlocked(table, str, len);
+    ape_util_unlock(table->lock);
+    return name;
+}
+
+void ape_namemap_init(ApeNameMap* map, ApeContext* ctx)
+{
+    memset(map, 0, sizeof(ApeNameMap));
+    map->context = ctx;
+}
+
+void ape_namemap_deinit(ApeNameMap* map)
+{
+    ApeContext* ctx;
+    ctx = map->context;
+    ape_allocator_free(&ctx->alloc, map->keys);
+    ape_allocator_free(&ctx->alloc, map->values);
+    ape_allocator_free(&ctx->alloc, map->cells);
+    ape_namemap_init(map, ctx);
+}
+
+static ApeSize ape_namemap_hashname(const char* name)
+{
+    ApeSize h;
+    h = (ApeSize)(uintptr_t)name;
+    h ^= (h >> 4) ^ (h >> 12);
+    return h * 2654435761u;
+}
+
+/* cells hold an entry's index plus one; zero marks a free cell */
+static void ape_namemap_putcell(ApeNameMap* map, ApeSize item)
+{
+    ApeSize ix;
+    ix = ape_namemap_hashname(map->keys[item]) & (map->cellcap - 1);
+    while(map->cells[ix] != 0)
+    {
+        ix = (ix + 1) & (map->cellcap - 1);
+    }
+    map->cells[ix] = item + 1;
+}
+
+static bool ape_namemap_rehash(ApeNameMap* map, ApeSize cellcap)
+{
+    ApeSize i;
+    unsigned int* cells;
+    cells = (unsigned int*)ape_allocator_alloc(&map->context->alloc, cellcap * sizeof(unsigned int));
+    if(!cells)
+    {
+        return false;
+    }
+    memset(cells, 0, cellcap * sizeof(unsigned int));
+    ape_allocator_free(&map->context->alloc, map->cells);
+    map->cells = cells;
+    map->cellcap = cellcap;
+    for(i = 0; i < map->count; i++)
+    {
+        ape_namemap_putcell(map, i);
+    }
+    return true;
+}
+
+/* returns the index of the entry for 'name', or the entry count if there is none */
+static ApeSize ape_namemap_indexof(const ApeNameMap* map, const char* name)
+{
+    ApeSize i;
+    ApeSize cell;
+    if(map->cellcap == 0)
+    {
+        for(i = 0; i < map->count; i++)
+        {
+            if(map->keys[i] == name)
+            {
+                return i;
+            }
+        }
+        return map->count;
+    }
+    i = ape_namemap_hashname(name) & (map->cellcap - 1);
+    while((cell = map->cells[i]) != 0)
+    {
+        if(map->keys[cell - 1] == name)
+        {
+            return cell - 1;
+        }
+        i = (i + 1) & (map->cellcap - 1);
+    }
+    return map->count;
+}
+
+void* ape_namemap_get(const ApeNameMap* map, const char* name)
+{
+    ApeSize ix;
+    ix = ape_namemap_indexof(map, name);
+    if(ix == map->count)
+    {
+        return NULL;
+    }
+    return map->values[ix];
+}
+
+bool ape_namemap_set(ApeNameMap* map, const char* name, void* value)
+{
+    ApeSize ix;
+    ApeSize newcap;
+    void** values;
+    const char** keys;
+    ApeContext* ctx;
+    ctx = map->context;
+    ix = ape_namemap_indexof(map, name);
+    if(ix < map->count)
+    {
+        map->values[ix] = value;
+        return true;
+    }
+    if(map->count == map->itemcap)
+    {
+        newcap = (map->itemcap == 0) ? 4 : (map->itemcap * 2);
+        keys = (const char**)ape_allocator_realloc(&ctx->alloc, map->keys, map->itemcap * sizeof(const char*), newcap * sizeof(const char*));
+        if(!keys)
+        {
+            return false;
+        }
+        map->keys = keys;
+        values = (void**)ape_allocator_realloc(&ctx->alloc, map->values, map->itemcap * sizeof(void*), newcap * sizeof(void*));
+        if(!values)
+        {
+            return false;
+        }
+        map->values = values;
+        map->itemcap = newcap;
+    }
+    map->keys[map->count] = name;
+    map->values[map->count] = value;
+    map->count++;
+    if(map->count <= APE_CONF_NAMEMAP_SCANMAX)
+    {
+        return true;
+    }
+    if((map->count * 2) > map->cellcap)
+    {
+        if(!ape_namemap_rehash(map, (map->cellcap == 0) ? APE_CONF_NAMEMAP_MINCELLS : (map->cellcap * 2)))
+        {
+            map->count--;
+            return false;
+        }
+        return true;
+    }
+    ape_namemap_putcell(map, map->count - 1);
+    return true;
+}
+
+ApeSize ape_namemap_count(const ApeNameMap* map)
+{
+    return map->count;
+}
+
+const char* ape_namemap_getkeyat(const ApeNameMap* map, ApeSize ix)
+{
+    if(ix >= map->count)
+    {
+        return NULL;
+    }
+    return map->keys[ix];
+}
+
+void* ape_namemap_getvalueat(const ApeNameMap* map, ApeSize ix)
+{
+    if(ix >= map->count)
+    {
+        return NULL;
+    }
+    return map->values[ix];
+}
+
 ApeObject ape_object_make_map(ApeContext* ctx)
 {
     return ape_object_make_mapcapacity(ctx, APE_CONF_MAP_INITIAL_CAPACITY);
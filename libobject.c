@@ -192,7 +192,6 @@ void ape_tostring_object(ApeWriter* buf, ApeObject obj, bool quote_str)
     ApeObject val;
     ApeTraceback* traceback;
     ApeObjType type;
-    ApeValArray* arr;
     const ApeScriptFunction* compfunc;
     (void)compfunc;
     type = ape_object_value_type(obj);
@@ -270,7 +269,7 @@ void ape_tostring_object(ApeWriter* buf, ApeObject obj, bool quote_str)
                     }
                     else
                     {
-                        ape_tostring_bytecode(buf, compfunc->compiledcode->bytecode, compfunc->compiledcode->srcpositions, compfunc->compiledcode->count, true);
+                        ape_tostring_compresult(buf, compfunc->compiledcode, true);
                     }
                 #else
                     ape_writer_appendf(buf, "<function '%s'>", fname);
@@ -279,12 +278,11 @@ void ape_tostring_object(ApeWriter* buf, ApeObject obj, bool quote_str)
             break;
         case APE_OBJECT_ARRAY:
             {
-                arr = ape_object_array_getarray(obj);
                 ape_writer_append(buf, "[");
                 for(i = 0; i < ape_object_array_getlength(obj); i++)
                 {
                     iobj = ape_object_array_getvalue(obj, i);
-                    if(ape_object_value_isarray(iobj) && (ape_object_array_getarray(iobj) == arr))
+                    if(ape_object_value_isarray(iobj) && (ape_object_value_allocated_data(iobj) == ape_object_value_allocated_data(obj)))
                     {
                         ape_writer_append(buf, "<recursion>");
                     }
@@ -600,10 +598,8 @@ ApeObject ape_object_value_internalcopydeep(ApeContext* ctx, ApeObject obj, ApeV
     ApeSize len;
     bool ok;
     const char* str;
-    ApeUShort* bytecode_copy;
     ApeScriptFunction* function_copy;
     ApeScriptFunction* function;
-    ApePosition* src_positions_copy;
     ApeAstCompResult* comp_res_copy;
     ApeObject free_val;
     ApeObject free_val_copy;
@@ -659,28 +655,9 @@ ApeObject ape_object_value_internalcopydeep(ApeContext* ctx, ApeObject obj, ApeV
         case APE_OBJECT_SCRIPTFUNCTION:
             {
                 function = ape_object_value_asscriptfunction(obj);
-                bytecode_copy = NULL;
-                src_positions_copy = NULL;
-                comp_res_copy = NULL;
-                bytecode_copy = (ApeUShort*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeUShort) * function->compiledcode->count);
-                if(!bytecode_copy)
-                {
-                    return ape_object_make_null(ctx);
-                }
-                memcpy(bytecode_copy, function->compiledcode->bytecode, sizeof(ApeUShort) * function->compiledcode->count);
-                src_positions_copy = (ApePosition*)ape_allocator_alloc(&ctx->alloc, sizeof(ApePosition) * function->compiledcode->count);
-                if(!src_positions_copy)
-                {
-                    ape_allocator_free(&ctx->alloc, bytecode_copy);
-                    return ape_object_make_null(ctx);
-                }
-                memcpy(src_positions_copy, function->compiledcode->srcpositions, sizeof(ApePosition) * function->compiledcode->count);
-                /* todo: add compilation result copy function */
-                comp_res_copy = ape_make_compresult(ctx, bytecode_copy, src_positions_copy, function->compiledcode->count);
+                comp_res_copy = ape_compresult_copy(ctx, function->compiledcode);
                 if(!comp_res_copy)
                 {
-                    ape_allocator_free(&ctx->alloc, src_positions_copy);
-                    ape_allocator_free(&ctx->alloc, bytecode_copy);
                     return ape_object_make_null(ctx);
                 }
                 copy = ape_object_make_function(ctx, ape_object_function_getname(obj), comp_res_copy, true, function->numlocals, function->numargs, 0);
@@ -14,6 +14,8 @@ ApePseudoClass* ape_make_pseudoclass(ApeContext* ctx, ApeStrDict* dictref, const
 
 void* ape_pseudoclass_destroy(ApeContext* ctx, ApePseudoClass* psc)
 {
+    ape_allocator_free(&ctx->alloc, psc->slots);
+    ape_allocator_free(&ctx->alloc, psc->slothashes);
     ape_allocator_free(&ctx->alloc, psc);
     psc = NULL;
     return NULL;
@@ -24,10 +26,96 @@ bool ape_pseudoclass_setmethod(ApePseudoClass* psc, const char* name, ApeObjMemb
     return ape_strdict_set(psc->fndictref, name, itm);
 }
 
+static unsigned long ape_pseudoclass_slotindex(unsigned long hash, unsigned int shift, unsigned long mask)
+{
+    return ((hash ^ (hash >> shift)) & mask);
+}
+
+/*
+* builds a collision-free table from the members in fndictref.
+* this is tried for increasing power-of-two sizes and shifts; the first combination
+* where every member lands in its own slot wins.
+* the member set never changes after ape_builtins_install_*, so this is done exactly once.
+*/
+bool ape_pseudoclass_buildtable(ApePseudoClass* psc)
+{
+    bool collides;
+    ApeSize i;
+    ApeSize count;
+    ApeSize size;
+    unsigned int shift;
+    unsigned long ix;
+    unsigned long hash;
+    const char* name;
+    ApeObjMemberItem** slots;
+    unsigned long* hashes;
+    count = ape_strdict_count(psc->fndictref);
+    if(count == 0)
+    {
+        return false;
+    }
+    for(size = 1; size < count; size *= 2)
+    {
+    }
+    for(; size <= APE_CONF_SIZE_PSEUDOCLASS_MAXSLOTS; size *= 2)
+    {
+        slots = (ApeObjMemberItem**)ape_allocator_alloc(&psc->context->alloc, sizeof(ApeObjMemberItem*) * size);
+        hashes = (unsigned long*)ape_allocator_alloc(&psc->context->alloc, sizeof(unsigned long) * size);
+        if(!slots || !hashes)
+        {
+            ape_allocator_free(&psc->context->alloc, slots);
+            ape_allocator_free(&psc->context->alloc, hashes);
+            return false;
+        }
+        for(shift = 0; shift < 32; shift++)
+        {
+            memset(slots, 0, sizeof(ApeObjMemberItem*) * size);
+            collides = false;
+            for(i = 0; i < count; i++)
+            {
+                name = ape_strdict_getkeyat(psc->fndictref, i);
+                hash = ape_util_hashstring(name, strlen(name));
+                ix = ape_pseudoclass_slotindex(hash, shift, size - 1);
+                if(slots[ix] != NULL)
+                {
+                    collides = true;
+                    break;
+                }
+                slots[ix] = (ApeObjMemberItem*)ape_strdict_getvalueat(psc->fndictref, i);
+                hashes[ix] = hash;
+            }
+            if(!collides)
+            {
+                ape_allocator_free(&psc->context->alloc, psc->slots);
+                ape_allocator_free(&psc->context->alloc, psc->slothashes);
+                psc->slots = slots;
+                psc->slothashes = hashes;
+                psc->slotmask = size - 1;
+                psc->slotshift = shift;
+                return true;
+            }
+        }
+        ape_allocator_free(&psc->context->alloc, slots);
+        ape_allocator_free(&psc->context->alloc, hashes);
+    }
+    return false;
+}
+
 ApeObjMemberItem* ape_pseudoclass_getmethodbyhash(ApePseudoClass* psc, const char* name, unsigned long hash)
 {
     void* raw;
+    unsigned long ix;
     ApeObjMemberItem* aom;
+    if(psc->slots != NULL)
+    {
+        ix = ape_pseudoclass_slotindex(hash, psc->slotshift, psc->slotmask);
+        aom = psc->slots[ix];
+        if((aom != NULL) && (psc->slothashes[ix] == hash) && APE_STREQ(aom->name, name))
+        {
+            return aom;
+        }
+        return NULL;
+    }
     raw = ape_strdict_getbyhash(psc->fndictref, name, hash);
     aom = (ApeObjMemberItem*)raw;
     return aom;
@@ -42,15 +130,40 @@ ApeObjMemberItem* ape_pseudoclass_getmethodbyname(ApePseudoClass* psc, const cha
     return ape_pseudoclass_getmethodbyhash(psc, name, hs);
 }
 
-/** TODO: ctx->pseudoclasses should perhaps be a StrDict, for better lookup? */
+static int ape_context_pseudoclassindex(ApeObjType typ)
+{
+    int ix;
+    unsigned int bits;
+    bits = (unsigned int)typ;
+    if((bits == 0) || ((bits & (bits - 1)) != 0))
+    {
+        return -1;
+    }
+    for(ix = 0; (bits & 1) == 0; ix++)
+    {
+        bits >>= 1;
+    }
+    if(ix >= APE_CONF_SIZE_PSEUDOCLASS_TYPES)
+    {
+        return -1;
+    }
+    return ix;
+}
+
 ApePseudoClass* ape_context_make_pseudoclass(ApeContext* ctx, ApeStrDict* dictref, ApeObjType typ, const char* classname)
 {
     bool ok;
+    int tix;
     const char* stag;
     ApePseudoClass* psc;
     stag = ape_object_value_typename(typ);
     psc = ape_make_pseudoclass(ctx, dictref, classname);
     ape_ptrarray_push(ctx->pseudoclasses, &psc);
+    tix = ape_context_pseudoclassindex(typ);
+    if(tix != -1)
+    {
+        ctx->classbytype[tix] = psc;
+    }
     ok = ape_strdict_set(ctx->classmapping, stag, psc);
     if(!ok)
     {
@@ -61,10 +174,15 @@ ApePseudoClass* ape_context_make_pseudoclass(ApeContext* ctx, ApeStrDict* dictre
 
 ApePseudoClass* ape_context_findpseudoclassbytype(ApeContext* ctx, ApeObjType typ)
 {
+    int tix;
     void* raw;
     const char* stag;
     ApePseudoClass* psc;
-    /* if(typ == APE_OBJECT_) */
+    tix = ape_context_pseudoclassindex(typ);
+    if(tix != -1)
+    {
+        return ctx->classbytype[tix];
+    }
     stag = ape_object_value_typename(typ);
     raw = ape_strdict_getbyname(ctx->classmapping, stag);
     if(raw == NULL)
@@ -105,10 +105,19 @@ void ape_object_string_setlength(ApeObject object, ApeSize len)
 
 bool ape_object_string_append(ApeContext* ctx, ApeObject obj, const char* src, ApeSize len)
 {
+    DynString_t* newstr;
     ApeGCObjData* data;
     APE_ASSERT(ape_object_value_type(obj) == APE_OBJECT_STRING);
     data = ape_object_value_allocated_data(obj);
-    data->valstring.valalloc = ds_appendlen(data->valstring.valalloc, src, len, ctx);
+    newstr = ds_appendlen(data->valstring.valalloc, src, len, ctx);
+    if(newstr == NULL)
+    {
+        /* the string keeps what it had */
+        return false;
+    }
+    data->valstring.valalloc = newstr;
+    /* contents changed, so a cached hash is no longer valid */
+    data->valstring.hash = 0;
     return true;
 }
 
@@ -629,4 +638,5 @@ void ape_builtins_install_string(ApeVM* vm)
     {
         ape_pseudoclass_setmethod(psc, memberfuncs[i].name, &memberfuncs[i]);
     }
+    ape_pseudoclass_buildtable(psc);
 }
@@ -42,6 +42,9 @@ struct FlagContext_t
 };
 
 typedef struct Options_t Options_t;
+typedef struct FuncTime_t FuncTime_t;
+typedef struct FuncFrame_t FuncFrame_t;
+typedef struct FuncTimes_t FuncTimes_t;
 
 struct Options_t
 {
@@ -51,6 +54,15 @@ struct Options_t
     bool printast;
     bool printbytecode;
     bool alsorun;
+    bool noopt;
+    bool bytecache;
+    const char* bytecachedir;
+    ApeSourceMode sourcemode;
+    int compilethreads;
+    const char* profilefile;
+    const char* tracefile;
+    bool opstats;
+    bool functimes;
     int n_paths;
     const char** paths;
     const char* codeline;
@@ -58,6 +70,37 @@ struct Options_t
 };
 
 
+/* one row of '--function-times'; 'pos' is where the function starts, or where a native is called */
+struct FuncTime_t
+{
+    char* name;
+    const ApeAstCompFile* file;
+    int line;
+    long calls;
+    /* how many of its calls are running; recursive calls count towards 'inclusive' only once */
+    long active;
+    double inclusive;
+    double exclusive;
+};
+
+struct FuncFrame_t
+{
+    /* an index, since 'rows' moves as it grows */
+    int row;
+    double start;
+    double children;
+};
+
+struct FuncTimes_t
+{
+    FuncTime_t* rows;
+    int rowcount;
+    int rowcap;
+    FuncFrame_t* stack;
+    int depth;
+    int stackcap;
+};
+
 static bool populate_flags(int argc, int begin, char** argv, const char* expectvalue, FlagContext_t* fx)
 {
     int i;
@@ -78,7 +121,14 @@ static bool populate_flags(int argc, int begin, char** argv, const char* expectv
         {
             nextarg = argv[i+1];
         }
-        if(arg[0] == '-')
+        if((arg[0] == '-') && (arg[1] == '-'))
+        {
+            /* long options are stored under '-', with the name (and any "=value") as the value */
+            fx->flags[flidx].flag = '-';
+            fx->flags[flidx].value = arg + 2;
+            flidx++;
+        }
+        else if(arg[0] == '-')
         {
             fx->flags[flidx].flag = arg[1];
             fx->flags[flidx].value = NULL;
@@ -134,6 +184,136 @@ static void print_errors(ApeContext* ctx)
     }
 }
 
+/*
+* an example of ape_context_sethooks: inclusive and exclusive time per function.
+* the rows are searched linearly, which is fine for the few hundred functions of a script.
+*/
+static int functimes_getrow(FuncTimes_t* ft, const char* name, ApePosition pos)
+{
+    int i;
+    FuncTime_t* row;
+    for(i=0; i<ft->rowcount; i++)
+    {
+        row = &ft->rows[i];
+        if((row->file == pos.file) && (row->line == pos.line) && (strcmp(row->name, name) == 0))
+        {
+            return i;
+        }
+    }
+    if(ft->rowcount == ft->rowcap)
+    {
+        ft->rowcap = (ft->rowcap == 0) ? 32 : (ft->rowcap * 2);
+        ft->rows = (FuncTime_t*)realloc(ft->rows, ft->rowcap * sizeof(FuncTime_t));
+    }
+    row = &ft->rows[ft->rowcount];
+    ft->rowcount++;
+    memset(row, 0, sizeof(FuncTime_t));
+    row->name = strdup(name);
+    row->file = pos.file;
+    row->line = pos.line;
+    return ft->rowcount - 1;
+}
+
+static void functimes_oncall(ApeContext* ctx, const char* name, ApePosition pos, ApeFloat usec, void* userdata)
+{
+    FuncTime_t* row;
+    FuncTimes_t* ft;
+    FuncFrame_t* frame;
+    (void)ctx;
+    ft = (FuncTimes_t*)userdata;
+    if(ft->depth == ft->stackcap)
+    {
+        ft->stackcap = (ft->stackcap == 0) ? 64 : (ft->stackcap * 2);
+        ft->stack = (FuncFrame_t*)realloc(ft->stack, ft->stackcap * sizeof(FuncFrame_t));
+    }
+    frame = &ft->stack[ft->depth];
+    ft->depth++;
+    frame->row = functimes_getrow(ft, (name != NULL) ? name : "?", pos);
+    row = &ft->rows[frame->row];
+    row->calls++;
+    row->active++;
+    frame->start = usec;
+    frame->children = 0;
+}
+
+static void functimes_onreturn(ApeContext* ctx, const char* name, ApePosition pos, ApeFloat usec, void* userdata)
+{
+    double elapsed;
+    FuncTime_t* row;
+    FuncTimes_t* ft;
+    FuncFrame_t* frame;
+    (void)ctx;
+    (void)name;
+    (void)pos;
+    ft = (FuncTimes_t*)userdata;
+    if(ft->depth == 0)
+    {
+        return;
+    }
+    ft->depth--;
+    frame = &ft->stack[ft->depth];
+    row = &ft->rows[frame->row];
+    elapsed = usec - frame->start;
+    row->active--;
+    if(row->active == 0)
+    {
+        row->inclusive += elapsed;
+    }
+    row->exclusive += elapsed - frame->children;
+    if(ft->depth > 0)
+    {
+        ft->stack[ft->depth - 1].children += elapsed;
+    }
+}
+
+static int functimes_compare(const void* a, const void* b)
+{
+    const FuncTime_t* ra;
+    const FuncTime_t* rb;
+    ra = (const FuncTime_t*)a;
+    rb = (const FuncTime_t*)b;
+    if(ra->exclusive != rb->exclusive)
+    {
+        return (ra->exclusive > rb->exclusive) ? -1 : 1;
+    }
+    return strcmp(ra->name, rb->name);
+}
+
+static void functimes_print(FuncTimes_t* ft, FILE* hnd, int maxrows)
+{
+    int i;
+    int count;
+    FuncTime_t* row;
+    qsort(ft->rows, ft->rowcount, sizeof(FuncTime_t), functimes_compare);
+    count = ft->rowcount;
+    if((maxrows > 0) && (maxrows < count))
+    {
+        count = maxrows;
+    }
+    fprintf(hnd, "      calls  inclusive ms  exclusive ms  function\n");
+    for(i=0; i<count; i++)
+    {
+        row = &ft->rows[i];
+        fprintf(hnd, "  %9ld  %12.3f  %12.3f  %s", row->calls, row->inclusive / 1000.0, row->exclusive / 1000.0, row->name);
+        if(row->file != NULL)
+        {
+            fprintf(hnd, " (%s:%d)", row->file->path, row->line + 1);
+        }
+        fprintf(hnd, "\n");
+    }
+}
+
+static void functimes_destroy(FuncTimes_t* ft)
+{
+    int i;
+    for(i=0; i<ft->rowcount; i++)
+    {
+        free(ft->rows[i].name);
+    }
+    free(ft->rows);
+    free(ft->stack);
+}
+
 static ApeObject exit_repl(ApeContext* ctx, void* data, ApeSize argc, ApeObject* args)
 {
     bool* exit_repl;
@@ -167,7 +347,6 @@ static void do_repl(ApeContext* ctx)
     char* object_str;
     ApeObject res;
     ctx->config.replmode = true;
-    ape_context_settimeout(ctx, 100.0);
     while(true)
     {
         line = readline(">> ");
@@ -187,7 +366,7 @@ static void do_repl(ApeContext* ctx)
         {
             object_str = ape_object_value_serialize(ctx, res, &len);
             printf("%.*s\n", (int)len, object_str);
-            free(object_str);
+            ape_context_freeallocated(ctx, object_str);
         }
     }
 }
@@ -205,6 +384,28 @@ static void show_usage()
         "              'ast': print ast\n"
         "              'bc': print bytecode\n"
         "  -t          print type sizes (for debugging)\n"
+        "  --no-opt    disable the AST optimizer and the bytecode peephole pass\n"
+        "  --cache     keep compiled scripts in '<script>.apec' and reuse them while unchanged\n"
+        "  --cache-dir=<dir>\n"
+        "              same as '--cache', but keep them in <dir>\n"
+        "  --source=<mode>\n"
+        "              source text kept for error messages: 'keep' (all of it),\n"
+        "              'reread' (read files again on error; default), 'drop' (none)\n"
+        "  --profile=<file>\n"
+        "              sample the script, write its collapsed stacks to <file>\n"
+        "              (for flamegraphs) and print the busiest lines to stderr\n"
+        "  --trace=<file>\n"
+        "              write a timeline of parsing, compiling, garbage collection and\n"
+        "              running to <file>, for chrome://tracing or ui.perfetto.dev\n"
+        "  --opcode-stats\n"
+        "              print the most executed opcodes and opcode pairs to stderr\n"
+        "              (needs a build with -DAPE_CONF_VM_OPSTATS=1, or =2 to time them)\n"
+        "  --function-times\n"
+        "              print calls, inclusive and exclusive time per function to stderr\n"
+        "  --threads=<n>\n"
+        "              parse included files on <n> threads (default: one per core)\n"
+        "  --dump-bytecode\n"
+        "              same as '-b'\n"
         "\n"
     );
 }
@@ -227,6 +428,15 @@ static bool parse_options(Options_t* opts, Flag_t* flags, int fcnt)
     opts->filename = NULL;
     opts->debugmode = NULL;
     opts->alsorun = false;
+    opts->noopt = false;
+    opts->bytecache = false;
+    opts->bytecachedir = NULL;
+    opts->sourcemode = APE_SOURCE_REREAD;
+    opts->compilethreads = 0;
+    opts->profilefile = NULL;
+    opts->tracefile = NULL;
+    opts->opstats = false;
+    opts->functimes = false;
     opts->printast = false;
     opts->printbytecode = false;
     opts->memdbglogfile = NULL;
@@ -301,6 +511,82 @@ static bool parse_options(Options_t* opts, Flag_t* flags, int fcnt)
                     opts->package = flags[i].value;
                 }
                 break;
+            case '-':
+                {
+                    if(strcmp(flags[i].value, "no-opt") == 0)
+                    {
+                        opts->noopt = true;
+                    }
+                    else if(strcmp(flags[i].value, "dump-bytecode") == 0)
+                    {
+                        opts->printbytecode = true;
+                    }
+                    else if(strcmp(flags[i].value, "cache") == 0)
+                    {
+                        opts->bytecache = true;
+                    }
+                    else if(strncmp(flags[i].value, "cache-dir=", 10) == 0)
+                    {
+                        opts->bytecache = true;
+                        opts->bytecachedir = flags[i].value + 10;
+                    }
+                    else if(strncmp(flags[i].value, "source=", 7) == 0)
+                    {
+                        if(strcmp(flags[i].value + 7, "keep") == 0)
+                        {
+                            opts->sourcemode = APE_SOURCE_KEEP;
+                        }
+                        else if(strcmp(flags[i].value + 7, "reread") == 0)
+                        {
+                            opts->sourcemode = APE_SOURCE_REREAD;
+                        }
+                        else if(strcmp(flags[i].value + 7, "drop") == 0)
+                        {
+                            opts->sourcemode = APE_SOURCE_DROP;
+                        }
+                        else
+                        {
+                            fprintf(stderr, "flag '--source' expects 'keep', 'reread' or 'drop'\n");
+                            return false;
+                        }
+                    }
+                    else if(strncmp(flags[i].value, "profile=", 8) == 0)
+                    {
+                        opts->profilefile = flags[i].value + 8;
+                    }
+                    else if(strncmp(flags[i].value, "trace=", 6) == 0)
+                    {
+                        opts->tracefile = flags[i].value + 6;
+                    }
+                    else if(strcmp(flags[i].value, "opcode-stats") == 0)
+                    {
+                        if(!ape_opstats_enabled())
+                        {
+                            fprintf(stderr, "flag '--opcode-stats' needs a build with APE_CONF_VM_OPSTATS\n");
+                            return false;
+                        }
+                        opts->opstats = true;
+                    }
+                    else if(strcmp(flags[i].value, "function-times") == 0)
+                    {
+                        opts->functimes = true;
+                    }
+                    else if(strncmp(flags[i].value, "threads=", 8) == 0)
+                    {
+                        opts->compilethreads = atoi(flags[i].value + 8);
+                        if(opts->compilethreads < 1)
+                        {
+                            fprintf(stderr, "flag '--threads' expects a number above 0\n");
+                            return false;
+                        }
+                    }
+                    else
+                    {
+                        fprintf(stderr, "unknown option '--%s'. run '-h' for possible options\n", flags[i].value);
+                        return false;
+                    }
+                }
+                break;
             default:
                 break;
         }
@@ -369,11 +655,13 @@ int main(int argc, char* argv[])
     const char* dm;
     const char* filename;
     FlagContext_t fx;
+    FuncTimes_t functimes;
     Options_t opts;
     ApeContext* ctx;
     ApeObject args_array;
     replexit = false;
     cmdfailed = false;
+    memset(&functimes, 0, sizeof(FuncTimes_t));
     populate_flags(argc, 1, argv, "epIdm", &fx);
     ctx = ape_make_context();
     if(!parse_options(&opts, fx.flags, fx.fcnt))
@@ -396,6 +684,16 @@ int main(int argc, char* argv[])
         {
             ctx->config.dumpbytecode = true;
         }
+        if(opts.noopt)
+        {
+            ctx->config.optimize = false;
+        }
+        if(opts.bytecache)
+        {
+            ape_context_setbytecache(ctx, true, opts.bytecachedir);
+        }
+        ape_context_setsourcemode(ctx, opts.sourcemode);
+        ape_context_setcompilethreads(ctx, opts.compilethreads);
         if(opts.debugmode != NULL)
         {
             dm = opts.debugmode;
@@ -429,6 +727,24 @@ int main(int argc, char* argv[])
                 ape_object_array_pushstring(ctx, args_array, fx.positional[i]);
             }
             ape_context_setglobal(ctx, "args", args_array);
+            if(opts.tracefile != NULL)
+            {
+                if(!ape_context_starttrace(ctx, 0))
+                {
+                    fprintf(stderr, "cannot start tracing\n");
+                }
+            }
+            if(opts.profilefile != NULL)
+            {
+                if(!ape_context_startprofiler(ctx, 0))
+                {
+                    fprintf(stderr, "cannot start the profiler\n");
+                }
+            }
+            if(opts.functimes)
+            {
+                ape_context_sethooks(ctx, functimes_oncall, functimes_onreturn, &functimes);
+            }
             if(opts.codeline)
             {
                 ape_context_executesource(ctx, opts.codeline, strlen(opts.codeline), true);
@@ -442,6 +758,31 @@ int main(int argc, char* argv[])
             {
                 print_errors(ctx);
             }
+            if(ctx->profiler != NULL)
+            {
+                ape_context_stopprofiler(ctx);
+                if(!ape_context_writeprofile(ctx, opts.profilefile))
+                {
+                    fprintf(stderr, "cannot write profile to '%s'\n", opts.profilefile);
+                }
+                ape_context_printprofile(ctx, stderr, 20);
+            }
+            if(ctx->tracer != NULL)
+            {
+                if(!ape_context_writetrace(ctx, opts.tracefile))
+                {
+                    fprintf(stderr, "cannot write trace to '%s'\n", opts.tracefile);
+                }
+            }
+            if(opts.opstats)
+            {
+                ape_context_printopstats(ctx, stderr, 20);
+            }
+            if(opts.functimes)
+            {
+                ape_context_sethooks(ctx, NULL, NULL, NULL);
+                functimes_print(&functimes, stderr, 20);
+            }
         }
         else
         {
@@ -453,6 +794,7 @@ int main(int argc, char* argv[])
         }
     }
     ape_context_destroy(ctx);
+    functimes_destroy(&functimes);
     if(cmdfailed)
     {
         return 1;
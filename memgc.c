@@ -18,6 +18,12 @@
 #define APE_CONF_SIZE_MEMPOOL_INITIAL (1024/4)
 #define APE_CONF_SIZE_MEMPOOL_MAX 0
 
+/*
+* every allocation is prefixed with its size, so that ape_allocator_free can
+* keep curbytes accurate. twice sizeof(ApeSize) keeps 16-byte alignment.
+*/
+#define APE_CONF_SIZE_ALLOCHEADER (sizeof(ApeSize) * 2)
+
 struct ApeGCObjPool
 {
     intptr_t* datapool;
@@ -45,6 +51,14 @@ void* ds_extmalloc(size_t size, void* userptr)
     return ape_allocator_alloc(&ctx->alloc, size);
 }
 
+/* dnarray.h grows the gc's object lists with this, and has no way to fail */
+void* da_extmalloc(size_t size, void* userptr)
+{
+    ApeContext* ctx;
+    ctx = (ApeContext*)userptr;
+    return ape_allocator_allocunlimited(&ctx->alloc, size);
+}
+
 void* ds_extrealloc(void* ptr, size_t oldsz, size_t newsz, void* userptr)
 {
     ApeContext* ctx;
@@ -109,48 +123,135 @@ void ape_mem_defaultfree(ApeContext* ctx, void* userptr, void* objptr)
     ape_allocator_free(&ctx->custom_allocator, objptr);
 }
 
-void* ape_allocator_alloc_real(ApeAllocator* alloc, const char* str, const char* func, const char* file, int line, ApeInt size)
+static void ape_allocator_account(ApeAllocator* alloc, ApeSize added, ApeSize removed)
+{
+    if(removed > alloc->curbytes)
+    {
+        removed = alloc->curbytes;
+    }
+    alloc->curbytes = (alloc->curbytes - removed) + added;
+    if(alloc->curbytes > alloc->peakbytes)
+    {
+        alloc->peakbytes = alloc->curbytes;
+    }
+}
+
+/*
+* whether handing out 'added' more bytes takes the heap past the budget plus its margin.
+* going over the budget alone is left to the VM, which can collect garbage first.
+*/
+static bool ape_allocator_overhardlimit(ApeAllocator* alloc, ApeSize added)
+{
+    if(alloc->maxbytes == 0)
+    {
+        return false;
+    }
+    return (alloc->curbytes + added) > (alloc->maxbytes + (alloc->maxbytes / APE_CONF_CONST_HEAPLIMIT_HARDMARGINDIV));
+}
+
+static void ape_allocator_ensureready(ApeAllocator* alloc)
 {
-    void* rt;
     if(!alloc->ready)
     {
         fprintf(stderr, "not ready, must initialize\n");
         alloc->pool = ape_mempool_init(APE_CONF_SIZE_MEMPOOL_INITIAL, APE_CONF_SIZE_MEMPOOL_MAX);
         alloc->ready = true;
     }
-    if(APE_UNLIKELY(alloc->pool->enabledebug))
-    {
-        ape_mempool_debugprintf(alloc->pool, "ape_allocator_alloc: %zu [%s:%d:%s] %s\n", size, file, line, func, str);
-    }
-    if(size == 0)
+}
+
+static void* ape_allocator_allocsize(ApeAllocator* alloc, ApeInt size, bool checklimit)
+{
+    ApeSize* hdr;
+    void* rt;
+    ape_util_lock(alloc->lock);
+    if(APE_UNLIKELY(checklimit && ape_allocator_overhardlimit(alloc, size)))
     {
-        //return NULL;
+        alloc->refusedbytes += size;
+        ape_util_unlock(alloc->lock);
+        return NULL;
     }
-    rt = ape_mempool_alloc(alloc->pool, size);
-    if(rt == NULL)
+    hdr = (ApeSize*)ape_mempool_alloc(alloc->pool, size + APE_CONF_SIZE_ALLOCHEADER);
+    if(hdr == NULL)
     {
+        ape_util_unlock(alloc->lock);
         fprintf(stderr, "internal error: FAILED to allocate %ld bytes\n", size);
+        return NULL;
     }
+    hdr[0] = size;
+    ape_allocator_account(alloc, size, 0);
+    ape_util_unlock(alloc->lock);
+    rt = ((char*)hdr) + APE_CONF_SIZE_ALLOCHEADER;
     return rt;
 }
 
+void* ape_allocator_alloc_real(ApeAllocator* alloc, const char* str, const char* func, const char* file, int line, ApeInt size)
+{
+    ape_allocator_ensureready(alloc);
+    if(APE_UNLIKELY(alloc->pool->enabledebug))
+    {
+        ape_mempool_debugprintf(alloc->pool, "ape_allocator_alloc: %zu [%s:%d:%s] %s\n", size, file, line, func, str);
+    }
+    return ape_allocator_allocsize(alloc, size, true);
+}
+
+/* for memory the runtime cannot do without (the gc's own object lists): not held to the heap limit */
+void* ape_allocator_allocunlimited(ApeAllocator* alloc, ApeInt size)
+{
+    ape_allocator_ensureready(alloc);
+    return ape_allocator_allocsize(alloc, size, false);
+}
+
 void ape_allocator_free(ApeAllocator* alloc, void* ptr)
 {
+    ApeSize* hdr;
     if(ptr != NULL)
     {
-        /* nothing to do */
-        ape_mempool_free(alloc->pool, ptr);
+        hdr = (ApeSize*)(((char*)ptr) - APE_CONF_SIZE_ALLOCHEADER);
+        ape_util_lock(alloc->lock);
+        ape_allocator_account(alloc, 0, hdr[0]);
+        ape_mempool_free(alloc->pool, hdr);
+        ape_util_unlock(alloc->lock);
         ptr = NULL;
     }
 }
 
 void* ape_allocator_realloc_real(ApeAllocator* alloc, const char *str, const char *func, const char *file, int line, void* ptr, size_t oldsz, size_t newsz)
 {
+    ApeSize realold;
+    ApeSize* hdr;
     if(APE_UNLIKELY(alloc->pool->enabledebug))
     {
         ape_mempool_debugprintf(alloc->pool, "ape_allocator_realloc: %zu (old %zu) [%s:%d:%s] %s\n", newsz, oldsz, file, line, func, str);
     }
-    return ape_mempool_realloc(alloc->pool, ptr, oldsz, newsz);
+    if(ptr == NULL)
+    {
+        return ape_allocator_alloc_real(alloc, str, func, file, line, newsz);
+    }
+    /* the header knows the real size; $oldsz is only a hint from the caller */
+    hdr = (ApeSize*)(((char*)ptr) - APE_CONF_SIZE_ALLOCHEADER);
+    realold = hdr[0];
+    ape_util_lock(alloc->lock);
+    if(APE_UNLIKELY((newsz > realold) && ape_allocator_overhardlimit(alloc, newsz - realold)))
+    {
+        alloc->refusedbytes += newsz - realold;
+        ape_util_unlock(alloc->lock);
+        return NULL;
+    }
+    hdr = (ApeSize*)ape_mempool_realloc(alloc->pool, hdr, realold + APE_CONF_SIZE_ALLOCHEADER, newsz + APE_CONF_SIZE_ALLOCHEADER);
+    if(hdr == NULL)
+    {
+        ape_util_unlock(alloc->lock);
+        return NULL;
+    }
+    hdr[0] = newsz;
+    ape_allocator_account(alloc, newsz, realold);
+    ape_util_unlock(alloc->lock);
+    return ((char*)hdr) + APE_CONF_SIZE_ALLOCHEADER;
+}
+
+bool ape_allocator_overbudget(ApeAllocator* alloc)
+{
+    return ((alloc->maxbytes > 0) && (alloc->curbytes > alloc->maxbytes));
 }
 
 ApeAllocator* ape_make_allocator(ApeContext* ctx, ApeAllocator* dest, ApeMemAllocFunc malloc_fn, ApeMemFreeFunc free_fn, void* optr)
@@ -474,7 +575,7 @@ void ape_gcmem_markobject(ApeObject obj)
     {
         return;
     }
-    if(data->gcmark)
+    if(data->gcmark || data->gcpermanent)
     {
         return;
     }
@@ -491,9 +592,12 @@ void ape_gcmem_markobject(ApeObject obj)
                     {
 
                         key_data = ape_object_value_allocated_data(key);
-                        if(!key_data->gcmark)
+                        if(key_data != NULL)
                         {
-                            ape_gcmem_markobject(key);
+                            if(!key_data->gcmark)
+                            {
+                                ape_gcmem_markobject(key);
+                            }
                         }
                     }
                     val = ape_object_map_getvalueat(obj, i);
@@ -513,6 +617,11 @@ void ape_gcmem_markobject(ApeObject obj)
             break;
         case APE_OBJECT_ARRAY:
             {
+                /* a lazy range only holds numbers */
+                if(data->valrange.active)
+                {
+                    break;
+                }
                 len = ape_object_array_getlength(obj);
                 for(i = 0; i < len; i++)
                 {
@@ -608,6 +717,42 @@ void ape_gcmem_sweep(ApeGCMemory* mem)
     mem->allocations_since_sweep = 0;
 }
 
+/* objects that survived the last sweep, and those allocated since */
+ApeSize ape_gcmem_objectcount(ApeGCMemory* mem)
+{
+    return da_count(mem->frontobjects);
+}
+
+/*
+* releases everything held in the object pools.
+* pooled arrays and maps keep their buffers for reuse, which is exactly what
+* an emergency collection (see ape_vm_checkheaplimit) doesn't want.
+*/
+void ape_gcmem_drainpools(ApeGCMemory* mem)
+{
+    ApeSize i;
+    ApeSize j;
+    ApeGCObjData* data;
+    ApeGCObjPool* pool;
+    for(i = 0; i < APE_CONF_SIZE_GCMEM_POOLCOUNT; i++)
+    {
+        pool = &mem->pools[i];
+        for(j = 0; j < pool->count; j++)
+        {
+            data = poolget(pool, j);
+            ape_object_data_deinit(mem->context, data);
+            ape_allocator_free(&mem->context->alloc, data);
+        }
+        pool->count = 0;
+    }
+    for(j = 0; j < mem->data_only_pool.count; j++)
+    {
+        data = poolget(&mem->data_only_pool, j);
+        ape_allocator_free(&mem->context->alloc, data);
+    }
+    mem->data_only_pool.count = 0;
+}
+
 int ape_gcmem_shouldsweep(ApeGCMemory* mem)
 {
     return mem->allocations_since_sweep > APE_CONF_CONST_GCMEM_SWEEPINTERVAL;
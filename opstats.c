@@ -0,0 +1,225 @@
+/*
+* reading the per-opcode counters that ape_vm_execfunc keeps when built with APE_CONF_VM_OPSTATS.
+* the busiest opcodes are the handlers worth a faster path; the busiest pairs are the
+* candidates for superinstructions. without APE_CONF_VM_OPSTATS there are no counters, and
+* these functions only tell so.
+*/
+
+#include "inline.h"
+
+#if (APE_CONF_VM_OPSTATS > 0)
+typedef struct ApeOpStatsRow ApeOpStatsRow;
+
+/* an opcode (with 'first' being APE_OPCODE_NONE), or a pair of them */
+struct ApeOpStatsRow
+{
+    ApeOpByte first;
+    ApeOpByte second;
+    uint64_t count;
+};
+
+static int ape_opstats_comparerows(const void* a, const void* b)
+{
+    const ApeOpStatsRow* ra;
+    const ApeOpStatsRow* rb;
+    ra = (const ApeOpStatsRow*)a;
+    rb = (const ApeOpStatsRow*)b;
+    if(ra->count != rb->count)
+    {
+        return (ra->count > rb->count) ? -1 : 1;
+    }
+    if(ra->first != rb->first)
+    {
+        return (ra->first < rb->first) ? -1 : 1;
+    }
+    if(ra->second != rb->second)
+    {
+        return (ra->second < rb->second) ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+* fills 'rows' with the opcodes (or the pairs) that ran at all, busiest first, and returns how many.
+* 'rows' must have room for APE_OPCODE_MAX * APE_OPCODE_MAX of them.
+*/
+static ApeSize ape_opstats_collect(ApeVM* vm, bool pairs, ApeOpStatsRow* rows)
+{
+    ApeSize count;
+    ApeOpByte a;
+    ApeOpByte b;
+    count = 0;
+    for(a = APE_OPCODE_NONE + 1; a < APE_OPCODE_MAX; a++)
+    {
+        if(!pairs)
+        {
+            if(vm->opstats.counts[a] > 0)
+            {
+                rows[count].first = APE_OPCODE_NONE;
+                rows[count].second = a;
+                rows[count].count = vm->opstats.counts[a];
+                count++;
+            }
+            continue;
+        }
+        for(b = APE_OPCODE_NONE + 1; b < APE_OPCODE_MAX; b++)
+        {
+            if(vm->opstats.pairs[a][b] > 0)
+            {
+                rows[count].first = a;
+                rows[count].second = b;
+                rows[count].count = vm->opstats.pairs[a][b];
+                count++;
+            }
+        }
+    }
+    qsort(rows, count, sizeof(ApeOpStatsRow), ape_opstats_comparerows);
+    return count;
+}
+
+static ApeOpStatsRow* ape_opstats_makerows(ApeVM* vm)
+{
+    return (ApeOpStatsRow*)ape_allocator_alloc(&vm->context->alloc, sizeof(ApeOpStatsRow) * APE_OPCODE_MAX * APE_OPCODE_MAX);
+}
+
+static uint64_t ape_opstats_total(ApeVM* vm)
+{
+    uint64_t total;
+    ApeOpByte op;
+    total = 0;
+    for(op = 0; op < APE_OPCODE_MAX; op++)
+    {
+        total += vm->opstats.counts[op];
+    }
+    return total;
+}
+#endif
+
+/* whether ape_vm_execfunc counts opcodes at all */
+bool ape_opstats_enabled(void)
+{
+    return (APE_CONF_VM_OPSTATS > 0);
+}
+
+void ape_opstats_reset(ApeVM* vm)
+{
+    #if (APE_CONF_VM_OPSTATS > 0)
+        memset(&vm->opstats, 0, sizeof(ApeOpStats));
+    #else
+        (void)vm;
+    #endif
+}
+
+/*
+* the counters as a map: 'total', 'opcodes' (name to count), 'pairs' ("first second" to count)
+* and, when handlers are timed, 'cycles' (name to the total spent in it). null without counters.
+*/
+ApeObject ape_opstats_toobject(ApeVM* vm)
+{
+    #if (APE_CONF_VM_OPSTATS > 0)
+        ApeSize i;
+        ApeSize count;
+        ApeObject res;
+        ApeObject opcodes;
+        ApeObject pairs;
+        ApeOpStatsRow* rows;
+        char key[128];
+        #if (APE_CONF_VM_OPSTATS > 1)
+            ApeObject cycles;
+        #endif
+        res = ape_object_make_map(vm->context);
+        opcodes = ape_object_make_map(vm->context);
+        pairs = ape_object_make_map(vm->context);
+        rows = ape_opstats_makerows(vm);
+        if(!rows)
+        {
+            return ape_object_make_null(vm->context);
+        }
+        ape_object_map_setnamednumber(vm->context, res, "total", ape_opstats_total(vm));
+        ape_object_map_setnamedvalue(vm->context, res, "opcodes", opcodes);
+        ape_object_map_setnamedvalue(vm->context, res, "pairs", pairs);
+        count = ape_opstats_collect(vm, false, rows);
+        for(i = 0; i < count; i++)
+        {
+            ape_object_map_setnamednumber(vm->context, opcodes, ape_vm_opcodename(rows[i].second), rows[i].count);
+        }
+        count = ape_opstats_collect(vm, true, rows);
+        for(i = 0; i < count; i++)
+        {
+            snprintf(key, sizeof(key), "%s %s", ape_vm_opcodename(rows[i].first), ape_vm_opcodename(rows[i].second));
+            ape_object_map_setnamednumber(vm->context, pairs, key, rows[i].count);
+        }
+        #if (APE_CONF_VM_OPSTATS > 1)
+            cycles = ape_object_make_map(vm->context);
+            ape_object_map_setnamedvalue(vm->context, res, "cycles", cycles);
+            count = ape_opstats_collect(vm, false, rows);
+            for(i = 0; i < count; i++)
+            {
+                ape_object_map_setnamednumber(vm->context, cycles, ape_vm_opcodename(rows[i].second), vm->opstats.cycles[rows[i].second]);
+            }
+        #endif
+        ape_allocator_free(&vm->context->alloc, rows);
+        return res;
+    #else
+        return ape_object_make_null(vm->context);
+    #endif
+}
+
+/* the 'maxlines' busiest opcodes and opcode pairs (0 for all of them); false without counters */
+bool ape_opstats_write(ApeVM* vm, ApeWriter* buf, ApeSize maxlines)
+{
+    #if (APE_CONF_VM_OPSTATS > 0)
+        ApeSize i;
+        ApeSize count;
+        uint64_t total;
+        ApeOpStatsRow* rows;
+        rows = ape_opstats_makerows(vm);
+        if(!rows)
+        {
+            return false;
+        }
+        total = ape_opstats_total(vm);
+        ape_writer_appendf(buf, "opcodes: %llu executed\n", (unsigned long long)total);
+        if(total == 0)
+        {
+            ape_allocator_free(&vm->context->alloc, rows);
+            return !ape_writer_failed(buf);
+        }
+        count = ape_opstats_collect(vm, false, rows);
+        if((maxlines > 0) && (maxlines < count))
+        {
+            count = maxlines;
+        }
+        #if (APE_CONF_VM_OPSTATS > 1)
+            ape_writer_append(buf, "        count       %   per op  opcode\n");
+        #else
+            ape_writer_append(buf, "        count       %  opcode\n");
+        #endif
+        for(i = 0; i < count; i++)
+        {
+            ape_writer_appendf(buf, "  %11llu  %5.1f%%  ", (unsigned long long)rows[i].count, (100.0 * rows[i].count) / total);
+            #if (APE_CONF_VM_OPSTATS > 1)
+                ape_writer_appendf(buf, "%7.1f  ", (double)vm->opstats.cycles[rows[i].second] / rows[i].count);
+            #endif
+            ape_writer_appendf(buf, "%s\n", ape_vm_opcodename(rows[i].second));
+        }
+        count = ape_opstats_collect(vm, true, rows);
+        if((maxlines > 0) && (maxlines < count))
+        {
+            count = maxlines;
+        }
+        ape_writer_append(buf, "pairs:\n        count       %  opcodes\n");
+        for(i = 0; i < count; i++)
+        {
+            ape_writer_appendf(buf, "  %11llu  %5.1f%%  %s %s\n", (unsigned long long)rows[i].count, (100.0 * rows[i].count) / total,
+                ape_vm_opcodename(rows[i].first), ape_vm_opcodename(rows[i].second));
+        }
+        ape_allocator_free(&vm->context->alloc, rows);
+        return !ape_writer_failed(buf);
+    #else
+        (void)vm;
+        (void)buf;
+        (void)maxlines;
+        return false;
+    #endif
+}
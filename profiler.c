@@ -0,0 +1,435 @@
+/*
+* a sampling profiler for scripts.
+* a SIGPROF timer interrupts the process every so often; the handler copies the frame stack
+* of the vm (function, code and instruction of every frame) into a ring buffer, and nothing
+* else, since it may run in the middle of anything. the vm empties the ring at its safe points
+* (see ape_vm_checktimeout and ape_vm_collectgarbage), where the code of every sampled frame
+* is still alive, and that is where samples become function names and source lines.
+* only one profiler can run in a process at a time, since there is only one SIGPROF.
+*/
+
+#include "inline.h"
+
+#if defined(APE_POSIX) && defined(SIGPROF)
+    #define APE_PROFILER_HAVESIGNALS
+    #include <sys/time.h>
+#endif
+
+#if defined(__GNUC__)
+    #define APE_PROFILER_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+    #define APE_PROFILER_STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#else
+    #define APE_PROFILER_LOAD(ptr) (*(ptr))
+    #define APE_PROFILER_STORE(ptr, val) (*(ptr) = (val))
+#endif
+
+/* samples the handler can take before the vm gets to empty the ring; must be a power of two */
+#define APE_CONF_SIZE_PROFILER_RING (512)
+/* frames kept per sample, innermost first; deeper stacks lose their outermost frames */
+#define APE_CONF_SIZE_PROFILER_MAXDEPTH (64)
+#define APE_CONF_CONST_PROFILER_DEFAULTINTERVAL (1000)
+
+typedef struct ApeProfileFrame ApeProfileFrame;
+typedef struct ApeProfileSample ApeProfileSample;
+typedef struct ApeProfileCount ApeProfileCount;
+
+struct ApeProfileFrame
+{
+    const ApeAstCompResult* code;
+    const char* name;
+    ApeInt srcip;
+};
+
+struct ApeProfileSample
+{
+    ApeSize depth;
+    bool truncated;
+    ApeProfileFrame frames[APE_CONF_SIZE_PROFILER_MAXDEPTH];
+};
+
+struct ApeProfileCount
+{
+    const char* key;
+    ApeSize count;
+};
+
+struct ApeProfiler
+{
+    ApeContext* context;
+    bool running;
+    ApeInt intervalusec;
+    /* written by the handler only */
+    ApeSize ringhead;
+    /* written by ape_profiler_drain only */
+    ApeSize ringtail;
+    ApeProfileSample* ring;
+    /* samples that found no script running, and samples lost to a full ring */
+    volatile ApeSize outside;
+    volatile ApeSize dropped;
+    ApeSize total;
+    /* folded stack -> ApeSize* count, and innermost frame -> ApeSize* count */
+    ApeStrDict* stacks;
+    ApeStrDict* lines;
+    #if defined(APE_PROFILER_HAVESIGNALS)
+        struct sigaction oldaction;
+        #if defined(APE_HAVETHREADS)
+            /* the thread running the vm; SIGPROF goes to whichever thread is busy */
+            pthread_t thread;
+        #endif
+    #endif
+};
+
+static ApeProfiler* volatile g_profiler = NULL;
+
+ApeProfiler* ape_make_profiler(ApeContext* ctx)
+{
+    ApeProfiler* prof;
+    prof = (ApeProfiler*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeProfiler));
+    if(!prof)
+    {
+        return NULL;
+    }
+    memset(prof, 0, sizeof(ApeProfiler));
+    prof->context = ctx;
+    prof->ring = (ApeProfileSample*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeProfileSample) * APE_CONF_SIZE_PROFILER_RING);
+    prof->stacks = ape_make_strdict(ctx, NULL, NULL);
+    prof->lines = ape_make_strdict(ctx, NULL, NULL);
+    if(!prof->ring || !prof->stacks || !prof->lines)
+    {
+        ape_profiler_destroy(prof);
+        return NULL;
+    }
+    return prof;
+}
+
+static void ape_profiler_destroycounts(ApeContext* ctx, ApeStrDict* dict)
+{
+    ApeSize i;
+    if(!dict)
+    {
+        return;
+    }
+    for(i = 0; i < ape_strdict_count(dict); i++)
+    {
+        ape_allocator_free(&ctx->alloc, ape_strdict_getvalueat(dict, i));
+    }
+    ape_strdict_destroy(dict);
+}
+
+void ape_profiler_destroy(ApeProfiler* prof)
+{
+    ApeContext* ctx;
+    if(!prof)
+    {
+        return;
+    }
+    ctx = prof->context;
+    ape_profiler_stop(prof);
+    ape_profiler_destroycounts(ctx, prof->stacks);
+    ape_profiler_destroycounts(ctx, prof->lines);
+    ape_allocator_free(&ctx->alloc, prof->ring);
+    ape_allocator_free(&ctx->alloc, prof);
+}
+
+#if defined(APE_PROFILER_HAVESIGNALS)
+/* runs on a signal: reads the vm, writes one ring slot, and must not do anything else */
+static void ape_profiler_onsignal(int sig)
+{
+    int savederrno;
+    ApeSize i;
+    ApeSize skip;
+    ApeSize head;
+    ApeSize depth;
+    ApeVM* vm;
+    ApeFrame* frame;
+    ApeProfiler* prof;
+    ApeProfileSample* sample;
+    (void)sig;
+    savederrno = errno;
+    prof = g_profiler;
+    if((prof == NULL) || !prof->running)
+    {
+        goto end;
+    }
+    #if defined(APE_HAVETHREADS)
+        if(!pthread_equal(pthread_self(), prof->thread))
+        {
+            prof->outside++;
+            goto end;
+        }
+    #endif
+    vm = prof->context->vm;
+    depth = vm->countframes;
+    if(depth == 0)
+    {
+        prof->outside++;
+        goto end;
+    }
+    head = prof->ringhead;
+    if((head - APE_PROFILER_LOAD(&prof->ringtail)) >= APE_CONF_SIZE_PROFILER_RING)
+    {
+        prof->dropped++;
+        goto end;
+    }
+    sample = &prof->ring[head & (APE_CONF_SIZE_PROFILER_RING - 1)];
+    skip = 0;
+    if(depth > APE_CONF_SIZE_PROFILER_MAXDEPTH)
+    {
+        skip = depth - APE_CONF_SIZE_PROFILER_MAXDEPTH;
+    }
+    sample->truncated = (skip > 0);
+    sample->depth = depth - skip;
+    for(i = skip; i < depth; i++)
+    {
+        frame = &vm->frameobjects[i];
+        sample->frames[i - skip].code = NULL;
+        if(frame->scriptfunc != NULL)
+        {
+            sample->frames[i - skip].code = frame->scriptfunc->compiledcode;
+            sample->frames[i - skip].name = frame->scriptfunc->const_name;
+            sample->frames[i - skip].srcip = frame->srcip;
+        }
+    }
+    APE_PROFILER_STORE(&prof->ringhead, head + 1);
+end:
+    errno = savederrno;
+}
+#endif
+
+/* 'intervalusec' is in microseconds of cpu time; 0 picks the default of 1ms */
+bool ape_profiler_start(ApeProfiler* prof, ApeInt intervalusec)
+{
+    #if defined(APE_PROFILER_HAVESIGNALS)
+        struct sigaction action;
+        struct itimerval timer;
+        if(prof->running)
+        {
+            return true;
+        }
+        if(g_profiler != NULL)
+        {
+            return false;
+        }
+        if(intervalusec <= 0)
+        {
+            intervalusec = APE_CONF_CONST_PROFILER_DEFAULTINTERVAL;
+        }
+        prof->intervalusec = intervalusec;
+        #if defined(APE_HAVETHREADS)
+            prof->thread = pthread_self();
+        #endif
+        memset(&action, 0, sizeof(struct sigaction));
+        action.sa_handler = ape_profiler_onsignal;
+        sigemptyset(&action.sa_mask);
+        #if defined(SA_RESTART)
+            action.sa_flags = SA_RESTART;
+        #endif
+        if(sigaction(SIGPROF, &action, &prof->oldaction) != 0)
+        {
+            return false;
+        }
+        g_profiler = prof;
+        prof->context->vm->profiler = prof;
+        prof->running = true;
+        timer.it_interval.tv_sec = intervalusec / 1000000;
+        timer.it_interval.tv_usec = intervalusec % 1000000;
+        timer.it_value = timer.it_interval;
+        if(setitimer(ITIMER_PROF, &timer, NULL) != 0)
+        {
+            ape_profiler_stop(prof);
+            return false;
+        }
+        return true;
+    #else
+        (void)prof;
+        (void)intervalusec;
+        return false;
+    #endif
+}
+
+void ape_profiler_stop(ApeProfiler* prof)
+{
+    #if defined(APE_PROFILER_HAVESIGNALS)
+        struct itimerval timer;
+        if(!prof->running)
+        {
+            return;
+        }
+        memset(&timer, 0, sizeof(struct itimerval));
+        setitimer(ITIMER_PROF, &timer, NULL);
+        sigaction(SIGPROF, &prof->oldaction, NULL);
+        prof->running = false;
+        g_profiler = NULL;
+        ape_profiler_drain(prof);
+        prof->context->vm->profiler = NULL;
+    #else
+        (void)prof;
+    #endif
+}
+
+static bool ape_profiler_count(ApeProfiler* prof, ApeStrDict* dict, const char* key)
+{
+    bool ok;
+    ApeSize* count;
+    count = (ApeSize*)ape_strdict_getbyname(dict, key);
+    if(count)
+    {
+        (*count)++;
+        return true;
+    }
+    count = (ApeSize*)ape_allocator_alloc(&prof->context->alloc, sizeof(ApeSize));
+    if(!count)
+    {
+        return false;
+    }
+    *count = 1;
+    ok = ape_strdict_set(dict, key, count);
+    if(!ok)
+    {
+        ape_allocator_free(&prof->context->alloc, count);
+        return false;
+    }
+    return true;
+}
+
+/* 'name (file:line)', as a frame appears in both outputs */
+static void ape_profiler_appendframe(ApeWriter* buf, const ApeProfileFrame* frame)
+{
+    ApePosition pos;
+    if(frame->code == NULL)
+    {
+        ape_writer_append(buf, "(native)");
+        return;
+    }
+    pos = ape_compresult_srcposition(frame->code, frame->srcip);
+    if((pos.file == NULL) || (pos.line < 0))
+    {
+        ape_writer_append(buf, frame->name);
+        return;
+    }
+    ape_writer_appendf(buf, "%s (%s:%d)", frame->name, pos.file->path, pos.line + 1);
+}
+
+static void ape_profiler_account(ApeProfiler* prof, const ApeProfileSample* sample)
+{
+    ApeSize i;
+    ApeWriter* buf;
+    buf = ape_make_writer(prof->context);
+    if(!buf)
+    {
+        return;
+    }
+    prof->total++;
+    ape_profiler_appendframe(buf, &sample->frames[sample->depth - 1]);
+    if(!ape_writer_failed(buf))
+    {
+        ape_profiler_count(prof, prof->lines, ape_writer_getdata(buf));
+    }
+    ape_writer_destroy(buf);
+    buf = ape_make_writer(prof->context);
+    if(!buf)
+    {
+        return;
+    }
+    if(sample->truncated)
+    {
+        ape_writer_append(buf, "(truncated);");
+    }
+    for(i = 0; i < sample->depth; i++)
+    {
+        if(i > 0)
+        {
+            ape_writer_append(buf, ";");
+        }
+        ape_profiler_appendframe(buf, &sample->frames[i]);
+    }
+    if(!ape_writer_failed(buf))
+    {
+        ape_profiler_count(prof, prof->stacks, ape_writer_getdata(buf));
+    }
+    ape_writer_destroy(buf);
+}
+
+/*
+* turns the samples in the ring into counts. only call this where the code of every frame
+* sampled since the last call is still alive: anywhere in the vm's loop, or when it returns.
+*/
+void ape_profiler_drain(ApeProfiler* prof)
+{
+    ApeSize head;
+    ApeSize tail;
+    head = APE_PROFILER_LOAD(&prof->ringhead);
+    tail = prof->ringtail;
+    while(tail != head)
+    {
+        ape_profiler_account(prof, &prof->ring[tail & (APE_CONF_SIZE_PROFILER_RING - 1)]);
+        tail++;
+        /* frees the slot for the handler right away */
+        APE_PROFILER_STORE(&prof->ringtail, tail);
+    }
+}
+
+/* collapsed stacks, one 'outer;...;inner count' per line, as read by flamegraph.pl and friends */
+bool ape_profiler_writefolded(ApeProfiler* prof, ApeWriter* buf)
+{
+    ApeSize i;
+    for(i = 0; i < ape_strdict_count(prof->stacks); i++)
+    {
+        ape_writer_appendf(buf, "%s %zu\n", ape_strdict_getkeyat(prof->stacks, i), *(ApeSize*)ape_strdict_getvalueat(prof->stacks, i));
+    }
+    return !ape_writer_failed(buf);
+}
+
+static int ape_profiler_comparecounts(const void* a, const void* b)
+{
+    const ApeProfileCount* ca;
+    const ApeProfileCount* cb;
+    ca = (const ApeProfileCount*)a;
+    cb = (const ApeProfileCount*)b;
+    if(ca->count != cb->count)
+    {
+        return (ca->count > cb->count) ? -1 : 1;
+    }
+    return strcmp(ca->key, cb->key);
+}
+
+/* the 'maxlines' source lines with the most samples in them (0 for all of them) */
+bool ape_profiler_writehotspots(ApeProfiler* prof, ApeWriter* buf, ApeSize maxlines)
+{
+    ApeSize i;
+    ApeSize count;
+    ApeProfileCount* counts;
+    ape_writer_appendf(buf, "profile: %zu samples every %ldus", prof->total, (long)prof->intervalusec);
+    if((prof->outside > 0) || (prof->dropped > 0))
+    {
+        ape_writer_appendf(buf, " (and %zu outside of scripts, %zu dropped)", (ApeSize)prof->outside, (ApeSize)prof->dropped);
+    }
+    ape_writer_append(buf, "\n");
+    count = ape_strdict_count(prof->lines);
+    if(count == 0)
+    {
+        return !ape_writer_failed(buf);
+    }
+    counts = (ApeProfileCount*)ape_allocator_alloc(&prof->context->alloc, sizeof(ApeProfileCount) * count);
+    if(!counts)
+    {
+        return false;
+    }
+    for(i = 0; i < count; i++)
+    {
+        counts[i].key = ape_strdict_getkeyat(prof->lines, i);
+        counts[i].count = *(ApeSize*)ape_strdict_getvalueat(prof->lines, i);
+    }
+    qsort(counts, count, sizeof(ApeProfileCount), ape_profiler_comparecounts);
+    if((maxlines > 0) && (maxlines < count))
+    {
+        count = maxlines;
+    }
+    ape_writer_append(buf, "  samples       %  line\n");
+    for(i = 0; i < count; i++)
+    {
+        ape_writer_appendf(buf, "  %7zu  %5.1f%%  %s\n", counts[i].count, (100.0 * counts[i].count) / prof->total, counts[i].key);
+    }
+    ape_allocator_free(&prof->context->alloc, counts);
+    return !ape_writer_failed(buf);
+}
@@ -143,7 +143,7 @@ const char* ape_tostring_exprtype(ApeAstExprType type)
     return "unknown";
 }
 
-static bool ape_tostring_opcodecoderead(ApeOpcodeDef* def, ApeUShort* instr, ApeOpByte outop[2])
+static bool ape_tostring_opcodecoderead(ApeOpcodeDef* def, ApeUShort* instr, ApeOpByte outop[3])
 {
     ApeSize i;
     ApeOpByte operand;
@@ -499,6 +499,10 @@ bool ape_tostring_expression(ApeWriter* buf, ApeAstExpression* expr)
             {
                 ape_writer_append(buf, "for (");
                 ape_writer_appendf(buf, "%s", expr->exforeachstmt.iterator->value);
+                if(expr->exforeachstmt.valueiterator)
+                {
+                    ape_writer_appendf(buf, ", %s", expr->exforeachstmt.valueiterator->value);
+                }
                 ape_writer_append(buf, " in ");
                 ape_tostring_expression(buf, expr->exforeachstmt.source);
                 ape_writer_append(buf, ")");
@@ -562,7 +566,16 @@ bool ape_tostring_codeblock(ApeWriter* buf, ApeAstBlockExpr* stmt)
 
 bool ape_tostring_compresult(ApeWriter* buf, ApeAstCompResult* res, bool sparse)
 {
-    return ape_tostring_bytecode(buf, res->bytecode, res->srcpositions, res->count, sparse);
+    bool ok;
+    ApePosition* positions;
+    positions = ape_compresult_getpositions(res);
+    if(!positions)
+    {
+        return false;
+    }
+    ok = ape_tostring_bytecode(buf, res->bytecode, positions, res->count, sparse);
+    ape_allocator_free(&res->context->alloc, positions);
+    return ok;
 }
 
 bool ape_tostring_bytecode(ApeWriter* buf, ApeUShort* code, ApePosition* source_positions, size_t code_size, bool sparse)
@@ -570,7 +583,7 @@ bool ape_tostring_bytecode(ApeWriter* buf, ApeUShort* code, ApePosition* source_
     enum { kMaxDepth = 128*2 };
     bool ok;
     unsigned int pos;
-    ApeOpByte operands[2];
+    ApeOpByte operands[3];
     ApeSize i;
     ApeSize cntdef;
     ApeSize cntdepth;
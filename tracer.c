@@ -0,0 +1,255 @@
+/*
+* a timeline of what a context spends its time on: parsing, compiling, including modules,
+* collecting garbage and running scripts. each of these is recorded as a span once it ends,
+* into a ring buffer that keeps the latest ones. ape_tracer_writejson writes them out as
+* Chrome trace events, which chrome://tracing and Perfetto show as one track per thread.
+* files may be parsed on several threads (see ccprefetch.c), which is why the ring has a lock.
+*/
+
+#include "inline.h"
+
+/* spans kept when ape_make_tracer is given 0; older ones are overwritten */
+#define APE_CONF_SIZE_TRACER_RING (16 * 1024)
+/* longer paths keep their last part */
+#define APE_CONF_SIZE_TRACER_PATH (96)
+/* threads with a track of their own; any others share the last one */
+#define APE_CONF_SIZE_TRACER_THREADS (32)
+
+typedef struct ApeTraceSpan ApeTraceSpan;
+
+struct ApeTraceSpan
+{
+    const char* category;
+    const char* name;
+    char path[APE_CONF_SIZE_TRACER_PATH];
+    ApeFloat start;
+    ApeFloat duration;
+    ApeSize thread;
+    const char* countnames[2];
+    ApeSize counts[2];
+};
+
+struct ApeTracer
+{
+    ApeContext* context;
+    /* timestamps are written relative to this */
+    ApeFloat origin;
+    ApeTraceSpan* spans;
+    ApeSize capacity;
+    /* the oldest span is at 'first'; once the ring is full, every new span replaces it */
+    ApeSize first;
+    ApeSize count;
+    ApeSize dropped;
+    ApeSize threadcount;
+    #if defined(APE_HAVETHREADS)
+        /* threads[0] is the one that made the tracer */
+        pthread_t threads[APE_CONF_SIZE_TRACER_THREADS];
+        pthread_mutex_t mutex;
+    #endif
+    /* like ApeAllocator.lock; points at 'mutex' where there are threads */
+    void* lock;
+};
+
+ApeTracer* ape_make_tracer(ApeContext* ctx, ApeSize capacity)
+{
+    ApeTracer* tracer;
+    if(capacity == 0)
+    {
+        capacity = APE_CONF_SIZE_TRACER_RING;
+    }
+    tracer = (ApeTracer*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeTracer));
+    if(!tracer)
+    {
+        return NULL;
+    }
+    memset(tracer, 0, sizeof(ApeTracer));
+    tracer->context = ctx;
+    tracer->capacity = capacity;
+    tracer->spans = (ApeTraceSpan*)ape_allocator_alloc(&ctx->alloc, sizeof(ApeTraceSpan) * capacity);
+    if(!tracer->spans)
+    {
+        ape_allocator_free(&ctx->alloc, tracer);
+        return NULL;
+    }
+    tracer->origin = ape_util_timermicros();
+    tracer->threadcount = 1;
+    #if defined(APE_HAVETHREADS)
+        tracer->threads[0] = pthread_self();
+        pthread_mutex_init(&tracer->mutex, NULL);
+        tracer->lock = &tracer->mutex;
+    #endif
+    return tracer;
+}
+
+void ape_tracer_destroy(ApeTracer* tracer)
+{
+    if(!tracer)
+    {
+        return;
+    }
+    #if defined(APE_HAVETHREADS)
+        pthread_mutex_destroy(&tracer->mutex);
+    #endif
+    ape_allocator_free(&tracer->context->alloc, tracer->spans);
+    ape_allocator_free(&tracer->context->alloc, tracer);
+}
+
+/* the track of the calling thread, starting at 1; must hold the lock */
+static ApeSize ape_tracer_threadlocked(ApeTracer* tracer)
+{
+    #if defined(APE_HAVETHREADS)
+        ApeSize i;
+        pthread_t self;
+        self = pthread_self();
+        for(i = 0; i < tracer->threadcount; i++)
+        {
+            if(pthread_equal(tracer->threads[i], self))
+            {
+                return i + 1;
+            }
+        }
+        if(tracer->threadcount == APE_CONF_SIZE_TRACER_THREADS)
+        {
+            return APE_CONF_SIZE_TRACER_THREADS;
+        }
+        tracer->threads[tracer->threadcount] = self;
+        tracer->threadcount++;
+        return tracer->threadcount;
+    #else
+        (void)tracer;
+        return 1;
+    #endif
+}
+
+/*
+* records a span that started at 'start' (from ape_util_timermicros) and ends now,
+* along with up to two counts, each left out where its name is NULL.
+* 'category', 'name' and the count names must outlive the tracer; 'path' is copied.
+*/
+void ape_tracer_spancounts(ApeTracer* tracer, const char* category, const char* name, const char* path, ApeFloat start,
+                           const char* countname1, ApeSize count1, const char* countname2, ApeSize count2)
+{
+    size_t len;
+    ApeFloat end;
+    ApeTraceSpan* span;
+    end = ape_util_timermicros();
+    ape_util_lock(tracer->lock);
+    if(tracer->count == tracer->capacity)
+    {
+        span = &tracer->spans[tracer->first];
+        tracer->first = (tracer->first + 1) % tracer->capacity;
+        tracer->dropped++;
+    }
+    else
+    {
+        span = &tracer->spans[(tracer->first + tracer->count) % tracer->capacity];
+        tracer->count++;
+    }
+    span->category = category;
+    span->name = name;
+    span->path[0] = 0;
+    if(path != NULL)
+    {
+        len = strlen(path);
+        if(len >= APE_CONF_SIZE_TRACER_PATH)
+        {
+            path += len - (APE_CONF_SIZE_TRACER_PATH - 1);
+        }
+        strcpy(span->path, path);
+    }
+    span->start = start - tracer->origin;
+    span->duration = end - start;
+    span->thread = ape_tracer_threadlocked(tracer);
+    span->countnames[0] = countname1;
+    span->counts[0] = count1;
+    span->countnames[1] = countname2;
+    span->counts[1] = count2;
+    ape_util_unlock(tracer->lock);
+}
+
+void ape_tracer_span(ApeTracer* tracer, const char* category, const char* name, const char* path, ApeFloat start)
+{
+    ape_tracer_spancounts(tracer, category, name, path, start, NULL, 0, NULL, 0);
+}
+
+/* a JSON string; unlike ape_tostring_quotestring, with escapes JSON knows */
+static void ape_tracer_writestring(ApeWriter* buf, const char* str)
+{
+    unsigned char ch;
+    ape_writer_append(buf, "\"");
+    for(; *str != 0; str++)
+    {
+        ch = (unsigned char)*str;
+        if((ch == '\"') || (ch == '\\'))
+        {
+            ape_writer_appendf(buf, "\\%c", ch);
+        }
+        else if(ch < 32)
+        {
+            ape_writer_appendf(buf, "\\u%04x", ch);
+        }
+        else
+        {
+            ape_writer_appendlen(buf, (const char*)&ch, 1);
+        }
+    }
+    ape_writer_append(buf, "\"");
+}
+
+/* the spans, oldest first, in the Chrome trace event format */
+bool ape_tracer_writejson(ApeTracer* tracer, ApeWriter* buf)
+{
+    bool first;
+    ApeSize i;
+    ApeSize j;
+    ApeTraceSpan* span;
+    ape_util_lock(tracer->lock);
+    ape_writer_append(buf, "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped\": ");
+    ape_writer_appendf(buf, "%zu}, \"traceEvents\": [\n", tracer->dropped);
+    /* names for the tracks; there is always the main one, so every other event follows a comma */
+    for(i = 0; i < tracer->threadcount; i++)
+    {
+        ape_writer_appendf(buf, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": ", (i > 0) ? ",\n" : "", i + 1);
+        if(i == 0)
+        {
+            ape_writer_append(buf, "\"main\"}}");
+        }
+        else
+        {
+            ape_writer_appendf(buf, "\"worker %zu\"}}", i);
+        }
+    }
+    for(i = 0; i < tracer->count; i++)
+    {
+        span = &tracer->spans[(tracer->first + i) % tracer->capacity];
+        ape_writer_append(buf, ",\n{\"name\": ");
+        ape_tracer_writestring(buf, span->name);
+        ape_writer_append(buf, ", \"cat\": ");
+        ape_tracer_writestring(buf, span->category);
+        ape_writer_appendf(buf, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %zu, \"args\": {", span->start, span->duration, span->thread);
+        first = true;
+        if(span->path[0] != 0)
+        {
+            ape_writer_append(buf, "\"path\": ");
+            ape_tracer_writestring(buf, span->path);
+            first = false;
+        }
+        for(j = 0; j < 2; j++)
+        {
+            if(span->countnames[j] != NULL)
+            {
+                if(!first)
+                {
+                    ape_writer_append(buf, ", ");
+                }
+                ape_tracer_writestring(buf, span->countnames[j]);
+                ape_writer_appendf(buf, ": %zu", span->counts[j]);
+                first = false;
+            }
+        }
+        ape_writer_append(buf, "}}");
+    }
+    ape_writer_append(buf, "\n]}\n");
+    ape_util_unlock(tracer->lock);
+    return !ape_writer_failed(buf);
+}
@@ -7,9 +7,6 @@
 #undef _XOPEN_SOURCE
 #define _XOPEN_SOURCE 500
 #include <time.h>
-#if defined(__linux__)
-    #include <sys/time.h>
-#endif
 #include "inline.h"
 
 /*
@@ -194,12 +191,13 @@ unsigned long ape_util_hashstring(const void* ptr, size_t len)
 /* djb2 */
 unsigned long ape_util_hashfloat(ApeFloat val)
 {
-    uintptr_t* vptr;
+    uint32_t parts[2];
     unsigned long hash;
-    vptr = (uintptr_t*)&val;
+    /* exactly the bytes of the double; reading past it made the hash depend on stack garbage */
+    memcpy(parts, &val, sizeof(parts));
     hash = 5381;
-    hash = ((hash << 5) + hash) + vptr[0];
-    hash = ((hash << 5) + hash) + vptr[1];
+    hash = ((hash << 5) + hash) + parts[0];
+    hash = ((hash << 5) + hash) + parts[1];
     return hash;
 }
 
@@ -215,6 +213,33 @@ unsigned int ape_util_upperpoweroftwo(unsigned int v)
     return v;
 }
 
+/*
+* a clock in milliseconds; only ever used for differences (i.e., timeouts).
+* monotonic where possible, so that setting the system time does not move deadlines.
+*/
+ApeFloat ape_util_timermillis(void)
+{
+    #if defined(__linux__) || defined(__unix__)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((ApeFloat)ts.tv_sec * 1000.0) + ((ApeFloat)ts.tv_nsec / 1000000.0);
+    #else
+        return ((ApeFloat)clock() * 1000.0) / (ApeFloat)CLOCKS_PER_SEC;
+    #endif
+}
+
+/* a monotonic clock in microseconds, for timestamps that are compared with each other */
+ApeFloat ape_util_timermicros(void)
+{
+    #if defined(__linux__) || defined(__unix__)
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((ApeFloat)ts.tv_sec * 1000000.0) + ((ApeFloat)ts.tv_nsec / 1000.0);
+    #else
+        return ((ApeFloat)clock() * 1000000.0) / (ApeFloat)CLOCKS_PER_SEC;
+    #endif
+}
+
 
 char* ape_util_default_readhandle(ApeContext* ctx, FILE* hnd, long int wantedamount, size_t* dlen)
 {
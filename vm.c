@@ -31,6 +31,10 @@ THE SOFTWARE.
 
 #include "inline.h"
 
+#if (APE_CONF_VM_OPSTATS > 1)
+    #include <time.h>
+#endif
+
 static const ApePosition g_vmpriv_srcposinvalid = { NULL, -1, -1 };
 
 
@@ -97,6 +101,19 @@ static ApeOpcodeDef g_definitions[APE_OPCODE_MAX + 1] =
     { "op(<<)", 0, { 0 } },
     { "op(>>)", 0, { 0 } },
     { "import", 1, {1} },
+    { "tailcall", 1, { 1 } },
+    { "addnum", 0, { 0 } },
+    { "subnum", 0, { 0 } },
+    { "mulnum", 0, { 0 } },
+    { "divnum", 0, { 0 } },
+    { "greaterthannum", 0, { 0 } },
+    { "greaterequalnum", 0, { 0 } },
+    { "equalnum", 0, { 0 } },
+    { "notequalnum", 0, { 0 } },
+    { "forloopprep", 3, { 2, 1, 1 } },
+    { "forloopstep", 3, { 2, 1, 1 } },
+    { "iterinit", 0, { 0 } },
+    { "iternext", 2, { 2, 1 } },
     { "invalid_max", 0, { 0 } },
 };
 
@@ -109,6 +126,47 @@ ApeOpcodeDef* ape_vm_opcodefind(ApeOpByte op)
     return &g_definitions[op];
 }
 
+/* length in code units of an instruction with this opcode, operands included; 0 if there is no such opcode */
+ApeInt ape_vm_opcodelength(ApeOpByte op)
+{
+    ApeSize i;
+    ApeInt len;
+    ApeOpcodeDef* def;
+    def = ape_vm_opcodefind(op);
+    if(!def)
+    {
+        return 0;
+    }
+    len = 1;
+    for(i = 0; i < def->operandcount; i++)
+    {
+        len += def->operandwidths[i];
+    }
+    return len;
+}
+
+/* the generic comparison a counted for-loop falls back to, for its APE_FORLOOP_* mode */
+ApeOpByte ape_vm_forloopcmpop(int mode)
+{
+    if((mode & APE_FORLOOP_CMPMASK) == APE_FORLOOP_LESSTHAN || (mode & APE_FORLOOP_CMPMASK) == APE_FORLOOP_GREATERTHAN)
+    {
+        return APE_OPCODE_GREATERTHAN;
+    }
+    return APE_OPCODE_GREATEREQUAL;
+}
+
+/*
+* length of the generic test after FORLOOP_PREP/FORLOOP_STEP (see ape_compiler_emitforlooptest):
+* compare, compare-logical and jumpiftrue, which these skip once they have decided the test.
+*/
+ApeInt ape_vm_forlooptaillength(int mode)
+{
+    return (
+        ape_vm_opcodelength(APE_OPCODE_COMPAREPLAIN) + ape_vm_opcodelength(ape_vm_forloopcmpop(mode)) +
+        ape_vm_opcodelength(APE_OPCODE_JUMPIFTRUE)
+    );
+}
+
 const char* ape_vm_opcodename(ApeOpByte op)
 {
     if(op <= APE_OPCODE_NONE || op >= APE_OPCODE_MAX)
@@ -386,9 +444,9 @@ ApePosition ape_frame_srcposition(const ApeFrame* frame)
 {
     if(frame != NULL)
     {
-        if(frame->srcpositions != NULL)
+        if(frame->scriptfunc != NULL)
         {
-            return frame->srcpositions[frame->srcip];
+            return ape_compresult_srcposition(frame->scriptfunc->compiledcode, frame->srcip);
         }
     }
     return g_vmpriv_srcposinvalid;
@@ -406,19 +464,43 @@ bool ape_vm_haserrors(ApeVM* vm)
 
 bool ape_vm_setglobal(ApeVM* vm, ApeSize ix, ApeObject val)
 {
-    ape_valdict_set(vm->globalobjects, &ix, &val);
+    ApeSize i;
+    ApeSize newcap;
+    ApeObject* newobjects;
+    if(APE_UNLIKELY(ix >= vm->globalcapacity))
+    {
+        newcap = (vm->globalcapacity == 0) ? 16 : vm->globalcapacity;
+        while(newcap <= ix)
+        {
+            newcap *= 2;
+        }
+        newobjects = (ApeObject*)ape_allocator_realloc(&vm->context->alloc, vm->globalobjects, vm->globalcapacity * sizeof(ApeObject), newcap * sizeof(ApeObject));
+        if(!newobjects)
+        {
+            return false;
+        }
+        vm->globalobjects = newobjects;
+        vm->globalcapacity = newcap;
+    }
+    if(ix >= vm->globalcount)
+    {
+        for(i = vm->globalcount; i < ix; i++)
+        {
+            vm->globalobjects[i] = ape_object_make_null(vm->context);
+        }
+        vm->globalcount = ix + 1;
+    }
+    vm->globalobjects[ix] = val;
     return true;
 }
 
 ApeObject ape_vm_getglobal(ApeVM* vm, ApeSize ix)
 {
-    ApeObject* rt;
-    rt = (ApeObject*)ape_valdict_getbykey(vm->globalobjects, &ix);
-    if(rt == NULL)
+    if(APE_UNLIKELY(ix >= vm->globalcount))
     {
         return ape_object_make_null(vm->context);
     }
-    return *rt;
+    return vm->globalobjects[ix];
 }
 
 void ape_vm_setstackpointer(ApeVM* vm, int new_sp)
@@ -502,8 +584,9 @@ ApeObject ape_vm_popstack(ApeVM* vm)
     * specifically, objres.handle->datatype gets ***sometimes*** set to APE_OBJECT_NONE, and
     * so far i've only observed this when objres.type==APE_OBJECT_NUMBER.
     * very strange, very weird, very heisenbug-ish.
+    * permanent data (constants of a shared program) may be read by other threads, and is left alone.
     */
-    if(objres.handle != NULL)
+    if((objres.handle != NULL) && !objres.handle->gcpermanent)
     {
         objres.handle->datatype = objres.type;
     }
@@ -609,7 +692,7 @@ void ape_vm_dumpstack(ApeVM* vm)
     ape_writer_destroy(wr);
 }
 
-ApeObject ape_vm_callnativefunction(ApeVM* vm, ApeObject callee, ApePosition src_pos, int argc, ApeObject* args)
+ApeObject ape_vm_callnativefunction(ApeVM* vm, ApeObject callee, int argc, ApeObject* args)
 {
     ApeError* err;
     ApeObject objres;
@@ -617,11 +700,20 @@ ApeObject ape_vm_callnativefunction(ApeVM* vm, ApeObject callee, ApePosition src
     ApeNativeFunction* nfunc;
     ApeTraceback* traceback;
     nfunc = ape_object_value_asnativefunction(callee);
+    if(APE_UNLIKELY(vm->hookcall != NULL))
+    {
+        vm->hookcall(vm->context, nfunc->name, ape_frame_srcposition(vm->currentframe), ape_util_timermicros(), vm->hookdata);
+    }
     objres = nfunc->nativefnptr(vm, nfunc->dataptr, argc, args);
+    if(APE_UNLIKELY(vm->hookreturn != NULL))
+    {
+        vm->hookreturn(vm->context, nfunc->name, ape_frame_srcposition(vm->currentframe), ape_util_timermicros(), vm->hookdata);
+    }
     if(ape_errorlist_haserrors(vm->errors) && !APE_STREQ(nfunc->name, "crash"))
     {
         err = ape_errorlist_lasterror(vm->errors);
-        err->pos = src_pos;
+        /* the position is only decoded now that there is an error to attach it to */
+        err->pos = ape_frame_srcposition(vm->currentframe);
         err->traceback = ape_make_traceback(vm->context);
         if(err->traceback)
         {
@@ -655,7 +747,6 @@ bool ape_vm_callobjectargs(ApeVM* vm, ApeObject callee, ApeInt nargs, ApeObject*
     ApeInt actualargs;
     ApeObjType calleetype;
     ApeScriptFunction* scriptcallee;
-    ApeFrame framecallee;
     ApeObject* fwdargs;
     ApeObject* stackpos;
     ApeObject* stackvals;
@@ -682,13 +773,7 @@ bool ape_vm_callobjectargs(ApeVM* vm, ApeObject callee, ApeInt nargs, ApeObject*
         {
             ofs = 0;
         }
-        ok = ape_vm_frameinit(&framecallee, callee, vm->stackptr - ofs);
-        if(!ok)
-        {
-            ape_vm_adderror(vm, APE_ERROR_RUNTIME, "frame init failed in ape_vm_callobjectargs");
-            return false;
-        }
-        ok = ape_vm_framepush(vm, framecallee);
+        ok = ape_vm_framepush(vm, callee, vm->stackptr - ofs);
         if(!ok)
         {
             ape_vm_adderror(vm, APE_ERROR_RUNTIME, "pushing frame failed in ape_vm_callobjectargs");
@@ -722,7 +807,7 @@ bool ape_vm_callobjectargs(ApeVM* vm, ApeObject callee, ApeInt nargs, ApeObject*
         {
             actualargs = vm->stackptr - ofs;
         }
-        objres = ape_vm_callnativefunction(vm, callee, ape_frame_srcposition(vm->currentframe), actualargs, fwdargs);
+        objres = ape_vm_callnativefunction(vm, callee, actualargs, fwdargs);
         if(ape_vm_haserrors(vm))
         {
             return false;
@@ -850,10 +935,17 @@ ApeVM* ape_make_vm(ApeContext* ctx, const ApeConfig* config, ApeGCMemory* mem, A
     vm->countframes = 0;
     vm->lastpopped = ape_object_make_null(ctx);
     vm->running = false;
-    vm->globalobjects = ape_make_valdict(ctx, sizeof(ApeSize), sizeof(ApeObject));
+    vm->globalobjects = NULL;
+    vm->globalcount = 0;
+    vm->globalcapacity = 0;
     vm->stackobjects = ape_make_valdict(ctx, sizeof(ApeSize), sizeof(ApeObject));
-    vm->lastframe = NULL;
-    vm->frameobjects = da_make(ctx, vm->frameobjects, 0, sizeof(ApeFrame));
+    vm->frameobjects = (ApeFrame*)ape_allocator_alloc(&ctx->alloc, APE_CONF_SIZE_VM_INITFRAMES * sizeof(ApeFrame));
+    if(!vm->frameobjects)
+    {
+        goto err;
+    }
+    memset(vm->frameobjects, 0, APE_CONF_SIZE_VM_INITFRAMES * sizeof(ApeFrame));
+    vm->framecapacity = APE_CONF_SIZE_VM_INITFRAMES;
     for(i = 0; i < APE_OPCODE_MAX; i++)
     {
         vm->overloadkeys[i] = ape_object_make_null(ctx);
@@ -886,32 +978,14 @@ err:
 void ape_vm_destroy(ApeVM* vm)
 {
     ApeContext* ctx;
-    ApeFrame* popped;
-    (void)popped;
     if(!vm)
     {
         return;
     }
     ctx = vm->context;
-    ape_valdict_destroy(vm->globalobjects);
+    ape_allocator_free(&ctx->alloc, vm->globalobjects);
     ape_valdict_destroy(vm->stackobjects);
-    fprintf(stderr, "deqlist_count(vm->frameobjects)=%d\n", da_count(vm->frameobjects));
-    if(da_count(vm->frameobjects) != 0)
-    {
-        while(da_count(vm->frameobjects) != 0)
-        {
-            popped = (ApeFrame*)da_get(vm->frameobjects, da_count(vm->frameobjects)-1);
-            if(popped != NULL)
-            {
-                //if(popped->allocated)
-                {
-                    ape_allocator_free(&vm->context->alloc, popped);
-                }
-            }
-            da_pop(vm->frameobjects);
-        }
-    }
-    da_destroy(vm->context, vm->frameobjects);
+    ape_allocator_free(&ctx->alloc, vm->frameobjects);
     ape_allocator_free(&ctx->alloc, vm);
 }
 
@@ -926,6 +1000,16 @@ void ape_vm_reset(ApeVM* vm)
 }
 
 
+static void ape_vm_hookframecall(ApeVM* vm, const ApeFrame* frame)
+{
+    vm->hookcall(vm->context, ape_object_function_getname(frame->function), ape_frame_srcposition(frame), ape_util_timermicros(), vm->hookdata);
+}
+
+static void ape_vm_hookframereturn(ApeVM* vm, const ApeFrame* frame)
+{
+    vm->hookreturn(vm->context, ape_object_function_getname(frame->function), ape_frame_srcposition(frame), ape_util_timermicros(), vm->hookdata);
+}
+
 bool ape_vm_frameinit(ApeFrame* frame, ApeObject funcobj, int bptr)
 {
     ApeScriptFunction* function;
@@ -935,11 +1019,11 @@ bool ape_vm_frameinit(ApeFrame* frame, ApeObject funcobj, int bptr)
     }
     function = ape_object_value_asscriptfunction(funcobj);
     frame->function = funcobj;
+    frame->scriptfunc = function;
     frame->ip = 0;
     frame->basepointer = bptr;
     frame->srcip = 0;
     frame->bytecode = function->compiledcode->bytecode;
-    frame->srcpositions = function->compiledcode->srcpositions;
     frame->bcsize = function->compiledcode->count;
     frame->recoverip = -1;
     frame->isrecovering = false;
@@ -947,72 +1031,52 @@ bool ape_vm_frameinit(ApeFrame* frame, ApeObject funcobj, int bptr)
 }
 
 /*
-* this function updates an existing stack-alloc'd frame.
-* since frames only hold primitive data (integrals and pointers), NO copying
-* beyond primitives is done here.
-* if a frame needs to copy something, do so in ape_frame_copyalloc.
-*/
-ApeFrame* ape_frame_update(ApeVM* vm, ApeFrame* rt, ApeFrame* from)
-{
-    (void)vm;
-    rt->allocated = true;
-    rt->function = from->function;
-    rt->srcpositions = from->srcpositions;
-    rt->bytecode = from->bytecode;
-    rt->ip = from->ip;
-    rt->basepointer = from->basepointer;
-    rt->srcip = from->srcip;
-    rt->bcsize = from->bcsize;
-    rt->recoverip = from->recoverip;
-    rt->isrecovering = from->isrecovering;
-    return rt;
-}
-
-/*
-* creates a new frame with data provided by an existing frame.
+* initializes the next frame directly in vm->frameobjects.
+* the array is doubled when full, which is why currentframe is recomputed afterwards.
+* the old array is only freed once the new one is in place, since a profiler's signal
+* handler may read the frames at any point.
 */
-ApeFrame* ape_frame_copyalloc(ApeVM* vm, ApeFrame* from)
+bool ape_vm_framepush(ApeVM* vm, ApeObject funcobj, int bptr)
 {
-    ApeFrame* rt;
-    rt = (ApeFrame*)ape_allocator_alloc(&vm->context->alloc, sizeof(ApeFrame));
-    ape_frame_update(vm, rt, from);
-    return rt;
-}
-
-bool ape_vm_framepush(ApeVM* vm, ApeFrame frame)
-{
-    ApeFrame* pf;
-    ApeFrame* tmp;
-    ApeScriptFunction* fn;
-    /*
-    * when a new frame exceeds existing the frame list, then
-    * allocate a new one from $frame ...
-    * ... otherwise, copy data from $frame, and stuff it back into the frame list.
-    * this saves a considerable amount of memory by reusing existing memory.
-    */
-    if(vm->countframes >= da_count(vm->frameobjects))
+    bool ok;
+    ApeSize newcap;
+    ApeFrame* frame;
+    ApeFrame* newframes;
+    ApeFrame* oldframes;
+    if(APE_UNLIKELY(vm->countframes >= vm->framecapacity))
     {
-        pf = ape_frame_copyalloc(vm, &frame);
-        da_push(vm->context, vm->frameobjects, pf);
-    }
-    else
+        newcap = vm->framecapacity * 2;
+        newframes = (ApeFrame*)ape_allocator_alloc(&vm->context->alloc, newcap * sizeof(ApeFrame));
+        if(!newframes)
+        {
+            return false;
+        }
+        memcpy(newframes, vm->frameobjects, vm->framecapacity * sizeof(ApeFrame));
+        memset(newframes + vm->framecapacity, 0, (newcap - vm->framecapacity) * sizeof(ApeFrame));
+        oldframes = vm->frameobjects;
+        vm->frameobjects = newframes;
+        vm->framecapacity = newcap;
+        ape_allocator_free(&vm->context->alloc, oldframes);
+    }
+    frame = &vm->frameobjects[vm->countframes];
+    ok = ape_vm_frameinit(frame, funcobj, bptr);
+    if(!ok)
     {
-        tmp = (ApeFrame*)da_get(vm->frameobjects, vm->countframes);
-        pf = ape_frame_update(vm, tmp, &frame);
-        da_set(vm->frameobjects, vm->countframes, pf);
+        return false;
     }
-    vm->lastframe = pf;
-    vm->currentframe = (ApeFrame*)da_get(vm->frameobjects, vm->countframes);
+    frame->thisptr = vm->thisptr;
+    vm->currentframe = frame;
     vm->countframes++;
-    fn = ape_object_value_asscriptfunction(frame.function);
-    ape_vm_setstackpointer(vm, frame.basepointer + fn->numlocals);
+    ape_vm_setstackpointer(vm, bptr + frame->scriptfunc->numlocals);
+    if(APE_UNLIKELY(vm->hookcall != NULL))
+    {
+        ape_vm_hookframecall(vm, frame);
+    }
     return true;
 }
 
 bool ape_vm_framepop(ApeVM* vm)
 {
-    ApeFrame* popped;
-    (void)popped;
     ape_vm_setstackpointer(vm, vm->currentframe->basepointer - 1);
     if(vm->countframes <= 0)
     {
@@ -1020,34 +1084,49 @@ bool ape_vm_framepop(ApeVM* vm)
         vm->currentframe = NULL;
         return false;
     }
+    if(APE_UNLIKELY(vm->hookreturn != NULL))
+    {
+        ape_vm_hookframereturn(vm, vm->currentframe);
+    }
     vm->countframes--;
     if(vm->countframes == 0)
     {
         vm->currentframe = NULL;
         return false;
     }
-    popped = (ApeFrame*)da_get(vm->frameobjects, vm->countframes);
-    /*
-    * don't deallocate $popped here - they'll be deallocated in ape_vm_destroy.
-    */
-    vm->currentframe = (ApeFrame*)da_get(vm->frameobjects, vm->countframes - 1);
+    vm->currentframe = &vm->frameobjects[vm->countframes - 1];
     return true;
 }
 
 void ape_vm_collectgarbage(ApeVM* vm, ApeValArray* constants, bool alsostack)
 {
     ApeSize i;
+    ApeSize live;
+    ApeSize before;
+    ApeFloat tracestart;
     ApeFrame* frame;
+    /* samples may refer to code that is about to be freed */
+    if(vm->profiler != NULL)
+    {
+        ape_profiler_drain(vm->profiler);
+    }
+    before = 0;
+    tracestart = 0;
+    if(vm->context->tracer != NULL)
+    {
+        before = ape_gcmem_objectcount(vm->mem);
+        tracestart = ape_util_timermicros();
+    }
     ape_gcmem_unmarkall(vm->mem);
     ape_gcmem_markobjlist(ape_globalstore_getobjectdata(vm->globalstore), ape_globalstore_getobjectcount(vm->globalstore));
     if(constants != NULL)
     {
         ape_gcmem_markobjlist((ApeObject*)ape_valarray_data(constants), ape_valarray_count(constants));
     }
-    ape_gcmem_markobjlist((ApeObject*)(vm->globalobjects->values), vm->globalobjects->count);
+    ape_gcmem_markobjlist(vm->globalobjects, vm->globalcount);
     for(i = 0; i < vm->countframes; i++)
     {
-        frame = (ApeFrame*)da_get(vm->frameobjects, i);
+        frame = &vm->frameobjects[i];
         ape_gcmem_markobject(frame->function);
     }
     if(alsostack)
@@ -1061,6 +1140,11 @@ void ape_vm_collectgarbage(ApeVM* vm, ApeValArray* constants, bool alsostack)
     ape_gcmem_markobject(vm->lastpopped);
     ape_gcmem_markobjlist(vm->overloadkeys, APE_OPCODE_MAX);
     ape_gcmem_sweep(vm->mem);
+    if(vm->context->tracer != NULL)
+    {
+        live = ape_gcmem_objectcount(vm->mem);
+        ape_tracer_spancounts(vm->context->tracer, "gc", "collect", NULL, tracestart, "live", live, "freed", before - live);
+    }
 }
 
 bool ape_vm_run(ApeVM* vm, ApeAstCompResult* comp_res, ApeValArray * constants)
@@ -1069,11 +1153,19 @@ bool ape_vm_run(ApeVM* vm, ApeAstCompResult* comp_res, ApeValArray * constants)
     int old_sp;
     int old_this_sp;
     ApeSize old_frames_count;
+    ApeFloat tracestart;
     ApeObject main_fn;
     (void)old_sp;
+    tracestart = 0;
+    if(vm->context->tracer != NULL)
+    {
+        tracestart = ape_util_timermicros();
+    }
     old_sp = vm->stackptr;
     old_this_sp = vm->thisptr;
     old_frames_count = vm->countframes;
+    /* anything refused while compiling has been reported already */
+    vm->context->alloc.refusedbytes = 0;
     main_fn = ape_object_make_function(vm->context, "__main__", comp_res, false, 0, 0, 0);
     if(ape_object_value_isnull(main_fn))
     {
@@ -1085,8 +1177,17 @@ bool ape_vm_run(ApeVM* vm, ApeAstCompResult* comp_res, ApeValArray * constants)
     {
         ape_vm_framepop(vm);
     }
+    /* before the caller gets to destroy 'comp_res' */
+    if(vm->profiler != NULL)
+    {
+        ape_profiler_drain(vm->profiler);
+    }
     APE_ASSERT(vm->stackptr == old_sp);
     vm->thisptr = old_this_sp;
+    if((vm->context->tracer != NULL) && (old_frames_count == 0))
+    {
+        ape_tracer_span(vm->context->tracer, "vm", "run", NULL, tracestart);
+    }
     return res;
 }
 
@@ -1184,7 +1285,6 @@ bool ape_vm_getindex(ApeVM* vm, ApeObject left, ApeObject index, ApeObjType left
     const char* idxname;
     const char* indextn;
     const char* lefttn;
-    ApeSize idxlen;
     ApeInt ix;
     ApeInt leftlen;
     ApeObject objres;
@@ -1197,11 +1297,11 @@ bool ape_vm_getindex(ApeVM* vm, ApeObject left, ApeObject index, ApeObjType left
         ApeObject objfn;
         ApeObject objval;
         ApeObjMemberItem* afn;
-        if(indextype == APE_OBJECT_STRING)
+        /* maps have no pseudoclass - their fields go straight to the map lookup below */
+        if((indextype == APE_OBJECT_STRING) && (lefttype != APE_OBJECT_MAP))
         {
             idxname = ape_object_string_getdata(index);
-            idxlen = ape_object_string_getlength(index);
-            nhash = ape_util_hashstring(idxname, idxlen);
+            nhash = ape_object_string_gethash(index);
             if((afn = builtin_get_object(vm->context, lefttype, idxname, nhash)) != NULL)
             {
                 objval = ape_object_make_null(vm->context);
@@ -1613,6 +1713,315 @@ bool ape_vmdo_comparelogical(ApeVM* vm)
     return true;
 }
 
+/*
+* ADDNUM and friends: the compiler expects both operands to be numbers. the guard is a pair of
+* type checks; anything else goes through ape_vm_math, exactly as the generic opcode would.
+*/
+bool ape_vmdo_binarynum(ApeVM* vm)
+{
+    ApeFloat leftval;
+    ApeFloat rightval;
+    ApeFloat resval;
+    ApeObject left;
+    ApeObject right;
+    right = ape_vm_popstack(vm);
+    left = ape_vm_popstack(vm);
+    if(APE_UNLIKELY(!ape_object_value_isnumber(left) || !ape_object_value_isnumber(right)))
+    {
+        switch(vm->estate.opcode)
+        {
+            case APE_OPCODE_ADDNUM:
+                {
+                    return ape_vm_math(vm, left, right, APE_OPCODE_ADD);
+                }
+                break;
+            case APE_OPCODE_SUBNUM:
+                {
+                    return ape_vm_math(vm, left, right, APE_OPCODE_SUB);
+                }
+                break;
+            case APE_OPCODE_MULNUM:
+                {
+                    return ape_vm_math(vm, left, right, APE_OPCODE_MUL);
+                }
+                break;
+            default:
+                {
+                    return ape_vm_math(vm, left, right, APE_OPCODE_DIV);
+                }
+                break;
+        }
+    }
+    leftval = ape_object_value_asnumber(left);
+    rightval = ape_object_value_asnumber(right);
+    switch(vm->estate.opcode)
+    {
+        case APE_OPCODE_ADDNUM:
+            {
+                resval = leftval + rightval;
+            }
+            break;
+        case APE_OPCODE_SUBNUM:
+            {
+                resval = leftval - rightval;
+            }
+            break;
+        case APE_OPCODE_MULNUM:
+            {
+                resval = leftval * rightval;
+            }
+            break;
+        default:
+            {
+                resval = leftval / rightval;
+            }
+            break;
+    }
+    ape_vm_pushstack(vm, ape_object_make_floatnumber(vm->context, resval));
+    return true;
+}
+
+/*
+* GREATERTHANNUM and friends sit right in front of the generic compare + compare-logical pair.
+* when both operands are numbers the result is computed here and the pair is skipped; otherwise
+* the operands are left on the stack and execution falls through into the generic pair.
+*/
+bool ape_vmdo_comparenum(ApeVM* vm)
+{
+    bool resval;
+    ApeFloat diff;
+    ApeObject left;
+    ApeObject right;
+    right = ape_vm_popstack(vm);
+    left = ape_vm_popstack(vm);
+    diff = 0;
+    if(ape_object_value_isnumber(left) && ape_object_value_isnumber(right))
+    {
+        diff = ape_object_value_asnumber(left) - ape_object_value_asnumber(right);
+    }
+    /* not numbers, or a nan (which the generic path treats in its own way) */
+    if(APE_UNLIKELY(!ape_object_value_isnumber(left) || !ape_object_value_isnumber(right) || isnan(diff)))
+    {
+        ape_vm_pushstack(vm, left);
+        ape_vm_pushstack(vm, right);
+        return true;
+    }
+    switch(vm->estate.opcode)
+    {
+        case APE_OPCODE_GREATERTHANNUM:
+            {
+                resval = diff > 0;
+            }
+            break;
+        case APE_OPCODE_GREATEREQUALNUM:
+            {
+                resval = diff >= 0;
+            }
+            break;
+        case APE_OPCODE_ISEQUALNUM:
+            {
+                resval = (diff == 0);
+            }
+            break;
+        default:
+            {
+                resval = (diff != 0);
+            }
+            break;
+    }
+    ape_vm_pushstack(vm, ape_object_make_bool(vm->context, resval));
+    /* skip the generic pair */
+    vm->currentframe->ip += 2;
+    return true;
+}
+
+/*
+* FORLOOP_PREP and FORLOOP_STEP run the test of a counted for-loop. the counter is a local that
+* the compiler has proven to hold a number, and only these two touch it; the limit is on the stack.
+* STEP bumps the counter in its slot. a true test jumps to the body, a false one skips the generic
+* compare/jump that follows. a limit that is not a number is handed to that generic sequence.
+*/
+bool ape_vmdo_forloop(ApeVM* vm)
+{
+    bool resval;
+    ApeInt pos;
+    ApeInt mode;
+    ApeSize idx;
+    ApeFloat diff;
+    ApeFloat counter;
+    ApeObject limit;
+    ApeObject counterobj;
+    ApeObject* slot;
+    pos = ape_frame_readuint16(vm->currentframe);
+    idx = vm->currentframe->basepointer + ape_frame_readuint8(vm->currentframe);
+    mode = ape_frame_readuint8(vm->currentframe);
+    limit = ape_vm_popstack(vm);
+    slot = (ApeObject*)ape_valdict_getbykey(vm->stackobjects, &idx);
+    counter = ape_object_value_asnumber(*slot);
+    if(vm->estate.opcode == APE_OPCODE_FORLOOPSTEP)
+    {
+        counter += (mode & APE_FORLOOP_DECREMENT) ? -1 : 1;
+        *slot = ape_object_make_floatnumber(vm->context, counter);
+    }
+    /* the stack may be resized by a push below, so don't hold on to the slot */
+    counterobj = *slot;
+    diff = 0;
+    if(ape_object_value_isnumber(limit))
+    {
+        diff = counter - ape_object_value_asnumber(limit);
+    }
+    if(APE_UNLIKELY(!ape_object_value_isnumber(limit) || isnan(diff)))
+    {
+        /* same operand order the generic comparison would have used */
+        if((mode & APE_FORLOOP_CMPMASK) < APE_FORLOOP_GREATERTHAN)
+        {
+            ape_vm_pushstack(vm, limit);
+            ape_vm_pushstack(vm, counterobj);
+        }
+        else
+        {
+            ape_vm_pushstack(vm, counterobj);
+            ape_vm_pushstack(vm, limit);
+        }
+        return true;
+    }
+    switch(mode & APE_FORLOOP_CMPMASK)
+    {
+        case APE_FORLOOP_LESSTHAN:
+            {
+                resval = diff < 0;
+            }
+            break;
+        case APE_FORLOOP_LESSEQUAL:
+            {
+                resval = diff <= 0;
+            }
+            break;
+        case APE_FORLOOP_GREATERTHAN:
+            {
+                resval = diff > 0;
+            }
+            break;
+        default:
+            {
+                resval = diff >= 0;
+            }
+            break;
+    }
+    if(!resval)
+    {
+        vm->currentframe->ip += ape_vm_forlooptaillength(mode);
+        return true;
+    }
+    if(pos < vm->currentframe->ip)
+    {
+        if(!ape_vm_checktimeout(vm))
+        {
+            return false;
+        }
+    }
+    vm->currentframe->ip = pos;
+    return true;
+}
+
+/* number of items foreach visits in 'source', or -1 (with an error raised) if it can't iterate it */
+int ape_vm_iterlength(ApeVM* vm, ApeObject source)
+{
+    ApeObjType type;
+    type = ape_object_value_type(source);
+    if(type == APE_OBJECT_ARRAY)
+    {
+        return ape_object_array_getlength(source);
+    }
+    else if(type == APE_OBJECT_MAP)
+    {
+        return ape_object_map_getlength(source);
+    }
+    else if(type == APE_OBJECT_STRING)
+    {
+        return ape_object_string_getlength(source);
+    }
+    ape_vm_adderror(vm, APE_ERROR_RUNTIME, "cannot get length of %s", ape_object_value_typename(type));
+    return -1;
+}
+
+bool ape_vmdo_iterinit(ApeVM* vm)
+{
+    ApeObject source;
+    source = ape_vm_popstack(vm);
+    if(ape_vm_iterlength(vm, source) < 0)
+    {
+        return false;
+    }
+    ape_vm_pushstack(vm, ape_object_make_fixednumber(vm->context, 0));
+    return true;
+}
+
+/*
+* the length is looked up again on every step, so items added to the source while
+* iterating are visited too, just like with an index loop.
+* key/value pairs are read straight out of maps, without building a {key, value} map for them.
+*/
+bool ape_vmdo_iternext(ApeVM* vm)
+{
+    int ix;
+    int len;
+    bool pairs;
+    ApeInt pos;
+    char chstr[2];
+    ApeObjType type;
+    ApeObject key;
+    ApeObject item;
+    ApeObject index;
+    ApeObject source;
+    pos = ape_frame_readuint16(vm->currentframe);
+    pairs = ape_frame_readuint8(vm->currentframe) != 0;
+    index = ape_vm_popstack(vm);
+    source = ape_vm_popstack(vm);
+    len = ape_vm_iterlength(vm, source);
+    if(len < 0)
+    {
+        return false;
+    }
+    ix = (int)ape_object_value_asnumber(index);
+    if(ix < 0 || ix >= len)
+    {
+        vm->currentframe->ip = pos;
+        return true;
+    }
+    type = ape_object_value_type(source);
+    key = ape_object_make_fixednumber(vm->context, ix);
+    if(type == APE_OBJECT_ARRAY)
+    {
+        item = ape_object_array_getvalue(source, ix);
+    }
+    else if(type == APE_OBJECT_MAP)
+    {
+        if(pairs)
+        {
+            key = ape_object_map_getkeyat(source, ix);
+            item = ape_object_map_getvalueat(source, ix);
+        }
+        else
+        {
+            item = ape_object_getkvpairat(vm->context, source, ix);
+        }
+    }
+    else
+    {
+        chstr[0] = ape_object_string_getdata(source)[ix];
+        chstr[1] = '\0';
+        item = ape_object_make_string(vm->context, chstr);
+    }
+    ape_vm_pushstack(vm, item);
+    if(pairs)
+    {
+        ape_vm_pushstack(vm, key);
+    }
+    ape_vm_pushstack(vm, ape_object_make_fixednumber(vm->context, ix + 1));
+    return true;
+}
+
 bool ape_vmdo_unary(ApeVM* vm)
 {
     bool ok;
@@ -1661,7 +2070,11 @@ bool ape_vmdo_unary(ApeVM* vm)
                 break;
             case APE_OPCODE_NOT:
                 {
-                    if(isfixed)
+                    if(opertype == APE_OBJECT_BOOL)
+                    {
+                        objres = ape_object_make_bool(vm->context, !ape_object_value_asbool(operand));
+                    }
+                    else if(isfixed)
                     {
                         vi = ape_object_value_asfixednumber(operand);
                         vi = !vi;
@@ -1698,6 +2111,73 @@ bool ape_vmdo_unary(ApeVM* vm)
     return true;
 }
 
+/*
+* checks the execution budget. this is only called on backward jumps and calls, since
+* any runaway script has to go through one of those; the clock itself is only read
+* every APE_CONF_CONST_VM_TIMEOUTCHECKINTERVAL ticks.
+* for the same reason, this is where a running profiler's samples are collected.
+*/
+bool ape_vm_checktimeout(ApeVM* vm)
+{
+    if(APE_UNLIKELY(vm->profiler != NULL))
+    {
+        ape_profiler_drain(vm->profiler);
+    }
+    if(APE_LIKELY(!vm->config->max_execution_time_set))
+    {
+        return true;
+    }
+    vm->timeoutticks++;
+    if((vm->timeoutticks & (APE_CONF_CONST_VM_TIMEOUTCHECKINTERVAL - 1)) != 0)
+    {
+        return true;
+    }
+    if(ape_util_timermillis() > vm->deadline)
+    {
+        ape_vm_adderror(vm, APE_ERROR_TIMEOUT, "execution took more than %1.17g ms", vm->config->max_execution_time_ms);
+        return false;
+    }
+    return true;
+}
+
+/*
+* called between instructions once the context went over its heap limit.
+* this is the only place where an emergency collection is safe, since every
+* live object is reachable from the stack, globals or constants here.
+*/
+bool ape_vm_checkheaplimit(ApeVM* vm)
+{
+    ApeAllocator* alloc;
+    alloc = &vm->context->alloc;
+    ape_vm_collectgarbage(vm, vm->estate.constants, true);
+    ape_gcmem_drainpools(vm->mem);
+    if(ape_allocator_overbudget(alloc))
+    {
+        ape_vm_adderror(vm, APE_ERROR_ALLOCATION, "heap limit of %zu bytes exceeded (%zu bytes in use)", alloc->maxbytes, alloc->curbytes);
+        return false;
+    }
+    return true;
+}
+
+/*
+* called after an instruction during which the allocator refused to take the heap past its
+* hard limit. whatever failed may not have said why, or may have carried on without the
+* memory, so the instruction fails here instead.
+*/
+bool ape_vm_checkheaprefused(ApeVM* vm)
+{
+    ApeSize refused;
+    ApeAllocator* alloc;
+    alloc = &vm->context->alloc;
+    refused = alloc->refusedbytes;
+    alloc->refusedbytes = 0;
+    if(ape_errorlist_count(vm->errors) == 0)
+    {
+        ape_vm_adderror(vm, APE_ERROR_ALLOCATION, "heap limit of %zu bytes exceeded (refused %zu more bytes)", alloc->maxbytes, refused);
+    }
+    return false;
+}
+
 bool ape_vmdo_jumpiffalse(ApeVM* vm)
 {
     ApeInt pos;
@@ -1706,6 +2186,13 @@ bool ape_vmdo_jumpiffalse(ApeVM* vm)
     testobj = ape_vm_popstack(vm);
     if(!ape_object_value_asbool(testobj))
     {
+        if(pos < vm->currentframe->ip)
+        {
+            if(!ape_vm_checktimeout(vm))
+            {
+                return false;
+            }
+        }
         vm->currentframe->ip = pos;
     }
     return true;
@@ -1719,6 +2206,13 @@ bool ape_vmdo_jumpiftrue(ApeVM* vm)
     testobj = ape_vm_popstack(vm);
     if(ape_object_value_asbool(testobj))
     {
+        if(pos < vm->currentframe->ip)
+        {
+            if(!ape_vm_checktimeout(vm))
+            {
+                return false;
+            }
+        }
         vm->currentframe->ip = pos;
     }
     return true;
@@ -1728,6 +2222,13 @@ bool ape_vmdo_jumpunconditional(ApeVM* vm)
 {
     ApeInt pos;
     pos = ape_frame_readuint16(vm->currentframe);
+    if(pos < vm->currentframe->ip)
+    {
+        if(!ape_vm_checktimeout(vm))
+        {
+            return false;
+        }
+    }
     vm->currentframe->ip = pos;
     return true;
 }
@@ -2061,8 +2562,7 @@ bool ape_vmdo_defmoduleglobal(ApeVM* vm)
     ApeObject objval;
     ix = ape_frame_readuint16(vm->currentframe);
     objval = ape_vm_popstack(vm);
-    ape_vm_setglobal(vm, ix, objval);
-    return true;
+    return ape_vm_setglobal(vm, ix, objval);
 }
 
 bool ape_vmdo_setmoduleglobal(ApeVM* vm)
@@ -2077,8 +2577,7 @@ bool ape_vmdo_setmoduleglobal(ApeVM* vm)
     {
         return false;
     }
-    ape_vm_setglobal(vm, ix, newvalue);
-    return true;
+    return ape_vm_setglobal(vm, ix, newvalue);
 }
 
 bool ape_vmdo_getmoduleglobal(ApeVM* vm)
@@ -2140,6 +2639,10 @@ bool ape_vmdo_call(ApeVM* vm)
     ApeUShort nargs;
     ApeObject callee;
     nargs = ape_frame_readuint8(vm->currentframe);
+    if(!ape_vm_checktimeout(vm))
+    {
+        return false;
+    }
     callee = ape_vm_getstack(vm, nargs);
     ok = ape_vm_callobjectstack(vm, callee, nargs);
     if(!ok)
@@ -2149,6 +2652,55 @@ bool ape_vmdo_call(ApeVM* vm)
     return true;
 }
 
+/*
+* TAILCALL is emitted for `return f(...)`, and is always followed by RETURNVALUE.
+* if the callee is a script function, and the current frame has no recover handler
+* waiting, the current frame is reused: callee and arguments are moved down to where
+* the current callee sits, and the frame is reinitialized in place.
+* anything else is done as a regular call, and the following RETURNVALUE returns.
+*/
+bool ape_vmdo_tailcall(ApeVM* vm)
+{
+    ApeInt i;
+    ApeInt base;
+    ApeSize idx;
+    ApeUShort nargs;
+    ApeObject callee;
+    ApeObject objval;
+    ApeFrame* frame;
+    nargs = ape_frame_readuint8(vm->currentframe);
+    if(!ape_vm_checktimeout(vm))
+    {
+        return false;
+    }
+    callee = ape_vm_getstack(vm, nargs);
+    frame = vm->currentframe;
+    if((ape_object_value_type(callee) != APE_OBJECT_SCRIPTFUNCTION) || (frame->recoverip >= 0))
+    {
+        return ape_vm_callobjectstack(vm, callee, nargs);
+    }
+    base = frame->basepointer - 1;
+    for(i = 0; i <= (ApeInt)nargs; i++)
+    {
+        objval = ape_vm_getstack(vm, nargs - i);
+        idx = base + i;
+        ape_valdict_set(vm->stackobjects, &idx, &objval);
+    }
+    vm->stackptr = base + nargs + 1;
+    /* to hooks, the reused frame is a return followed by a call */
+    if(APE_UNLIKELY(vm->hookreturn != NULL))
+    {
+        ape_vm_hookframereturn(vm, frame);
+    }
+    ape_vm_frameinit(frame, callee, base + 1);
+    ape_vm_setstackpointer(vm, frame->basepointer + frame->scriptfunc->numlocals);
+    if(APE_UNLIKELY(vm->hookcall != NULL))
+    {
+        ape_vm_hookframecall(vm, frame);
+    }
+    return true;
+}
+
 bool ape_vmdo_returnvalue(ApeVM* vm)
 {
     bool ok;
@@ -2268,6 +2820,20 @@ bool ape_vmdo_currentfunction(ApeVM* vm)
     return true;
 }
 
+#if (APE_CONF_VM_OPSTATS > 1)
+/* a cheap timestamp; cycles where the cpu has a counter readable from user space */
+static uint64_t ape_vm_opstatsclock(void)
+{
+    #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        return __builtin_ia32_rdtsc();
+    #else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t)ts.tv_sec * 1000000000) + (uint64_t)ts.tv_nsec;
+    #endif
+}
+#endif
+
 #define ape_vmexec_prim(fn) \
     if(!((fn)(vm))) \
     { \
@@ -2288,6 +2854,11 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
     ApeSize i;
     ApeError* err;
     ApeScriptFunction* scriptfunc;
+    #if (APE_CONF_VM_OPSTATS > 1)
+        /* locals, since natives called from a handler may run this function again */
+        ApeOpByte opcurrent;
+        uint64_t opstart;
+    #endif
 
     vm->estate.constants = constants;
     #if 0
@@ -2298,13 +2869,17 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
     }
     #endif
     scriptfunc = ape_object_value_asscriptfunction(function);
-    ok = false;
-    ok = ape_vm_frameinit(&vm->estate.newframe, function, vm->stackptr - scriptfunc->numargs);
-    if(!ok)
+    /*
+    * the budget covers the outermost execution; functions called back from
+    * native code share the deadline of whoever started running.
+    */
+    if(vm->config->max_execution_time_set && (vm->countframes == 0))
     {
-        return false;
+        vm->deadline = ape_util_timermillis() + vm->config->max_execution_time_ms;
+        vm->timeoutticks = 0;
     }
-    ok = ape_vm_framepush(vm, vm->estate.newframe);
+    ok = false;
+    ok = ape_vm_framepush(vm, function, vm->stackptr - scriptfunc->numargs);
     if(!ok)
     {
         ape_errorlist_add(vm->errors, APE_ERROR_USER, g_vmpriv_srcposinvalid, "pushing frame failed");
@@ -2315,6 +2890,18 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
     while(vm->currentframe->ip < (ApeInt)vm->currentframe->bcsize)
     {
         vm->estate.opcode = ape_frame_readopcode(vm->currentframe);
+        #if (APE_CONF_VM_OPSTATS > 0)
+            if(vm->estate.opcode < APE_OPCODE_MAX)
+            {
+                vm->opstats.counts[vm->estate.opcode]++;
+                vm->opstats.pairs[vm->opstats.previous][vm->estate.opcode]++;
+                vm->opstats.previous = vm->estate.opcode;
+            }
+            #if (APE_CONF_VM_OPSTATS > 1)
+                opcurrent = vm->estate.opcode;
+                opstart = ape_vm_opstatsclock();
+            #endif
+        #endif
         switch(vm->estate.opcode)
         {
             case APE_OPCODE_CONSTANT:
@@ -2336,6 +2923,38 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
                     ape_vmexec_prim(ape_vmdo_binary);
                 }
                 break;
+            case APE_OPCODE_ADDNUM:
+            case APE_OPCODE_SUBNUM:
+            case APE_OPCODE_MULNUM:
+            case APE_OPCODE_DIVNUM:
+                {
+                    ape_vmexec_prim(ape_vmdo_binarynum);
+                }
+                break;
+            case APE_OPCODE_GREATERTHANNUM:
+            case APE_OPCODE_GREATEREQUALNUM:
+            case APE_OPCODE_ISEQUALNUM:
+            case APE_OPCODE_NOTEQUALNUM:
+                {
+                    ape_vmexec_prim(ape_vmdo_comparenum);
+                }
+                break;
+            case APE_OPCODE_FORLOOPPREP:
+            case APE_OPCODE_FORLOOPSTEP:
+                {
+                    ape_vmexec_prim(ape_vmdo_forloop);
+                }
+                break;
+            case APE_OPCODE_ITERINIT:
+                {
+                    ape_vmexec_prim(ape_vmdo_iterinit);
+                }
+                break;
+            case APE_OPCODE_ITERNEXT:
+                {
+                    ape_vmexec_prim(ape_vmdo_iternext);
+                }
+                break;
             case APE_OPCODE_POP:
                 {
                     ape_vm_popstack(vm);
@@ -2443,6 +3062,11 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
                     ape_vmexec_prim(ape_vmdo_call);
                 }
                 break;
+            case APE_OPCODE_TAILCALL:
+                {
+                    ape_vmexec_prim(ape_vmdo_tailcall);
+                }
+                break;
             case APE_OPCODE_RETURNVALUE:
                 {
                     if(!ape_vmdo_returnvalue(vm))
@@ -2539,16 +3163,30 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
                 }
                 break;
         }
+        if(APE_UNLIKELY(ape_allocator_overbudget(&vm->context->alloc)))
+        {
+            ape_vm_checkheaplimit(vm);
+        }
     fail:
+        #if (APE_CONF_VM_OPSTATS > 1)
+            if(opcurrent < APE_OPCODE_MAX)
+            {
+                vm->opstats.cycles[opcurrent] += ape_vm_opstatsclock() - opstart;
+            }
+        #endif
+        if(APE_UNLIKELY(vm->context->alloc.refusedbytes > 0))
+        {
+            ape_vm_checkheaprefused(vm);
+        }
         if(ape_errorlist_count(vm->errors) > 0)
         {
             err = ape_errorlist_lasterror(vm->errors);
-            if(err->errtype == APE_ERROR_RUNTIME && ape_errorlist_count(vm->errors) == 1)
+            if((err->errtype == APE_ERROR_RUNTIME || err->errtype == APE_ERROR_ALLOCATION) && ape_errorlist_count(vm->errors) == 1)
             {
                 ixrecover = -1;
                 for(ui = vm->countframes - 1; ui >= 0; ui--)
                 {
-                    vm->estate.frame = (ApeFrame*)da_get(vm->frameobjects, ui);
+                    vm->estate.frame = &vm->frameobjects[ui];
                     if(vm->estate.frame->recoverip >= 0 && !vm->estate.frame->isrecovering)
                     {
                         ixrecover = ui;
@@ -2579,6 +3217,11 @@ bool ape_vm_execfunc(ApeVM* vm, ApeObject function, ApeValArray * constants)
                         ape_object_value_seterrortraceback(errobj, err->traceback);
                         err->traceback = NULL;
                     }
+                    /* drop anything pushed for a method call that never happened */
+                    if(vm->thisptr > vm->currentframe->thisptr)
+                    {
+                        vm->thisptr = vm->currentframe->thisptr;
+                    }
                     ape_vm_pushstack(vm, errobj);
                     vm->currentframe->ip = vm->currentframe->recoverip;
                     vm->currentframe->isrecovering = true;